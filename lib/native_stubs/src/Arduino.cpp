@@ -0,0 +1,118 @@
+#include "Arduino.h"
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+
+static const std::chrono::steady_clock::time_point startedAt = std::chrono::steady_clock::now();
+
+__attribute__((weak)) unsigned long millis() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - startedAt).count();
+}
+
+__attribute__((weak)) unsigned long micros() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - startedAt).count();
+}
+
+__attribute__((weak)) void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {
+}
+
+__attribute__((weak)) uint32_t esp_random() {
+  return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+// No PSRAM unless a test says otherwise
+__attribute__((weak)) bool psramFound() {
+  return false;
+}
+
+#if defined(_WIN32) || (defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)))
+size_t strlcpy(char* dst, const char* src, size_t size) {
+  size_t length = strlen(src);
+  if (size > 0) {
+    size_t copied = length < size - 1 ? length : size - 1;
+    memcpy(dst, src, copied);
+    dst[copied] = '\0';
+  }
+  return length;
+}
+
+size_t strlcat(char* dst, const char* src, size_t size) {
+  size_t used = strnlen(dst, size);
+  if (used == size) {
+    return size + strlen(src);
+  }
+  return used + strlcpy(dst + used, src, size - used);
+}
+#endif
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t written = 0;
+  while (size-- > 0) {
+    written += write(*buffer++);
+  }
+  return written;
+}
+
+size_t Print::println(const char* text) {
+  return write(text) + write("\r\n");
+}
+
+size_t Print::printf(const char* format, ...) {
+  char small[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(small, sizeof(small), format, args);
+  va_end(args);
+  if (length < 0) {
+    return 0;
+  }
+  if ((size_t)length < sizeof(small)) {
+    return write((const uint8_t*)small, length);
+  }
+  std::string large(length + 1, '\0');
+  va_start(args, format);
+  vsnprintf(&large[0], large.size(), format, args);
+  va_end(args);
+  return write((const uint8_t*)large.data(), length);
+}
+
+// Host streams hold all their data already, so the end of it is the end
+// (no waiting out the timeout)
+size_t Stream::readBytes(char* buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = read();
+    if (c < 0) {
+      break;
+    }
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char* buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = read();
+    if (c < 0 || c == terminator) {
+      break;
+    }
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return muted ? 1 : fwrite(&c, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  return muted ? size : fwrite(buffer, 1, size, stdout);
+}
@@ -0,0 +1,102 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+// Host stand-in for the ESP32 Arduino core: just what the modules built in
+// the native environment use. Serial prints to stdout, millis()/micros()
+// follow the host's monotonic clock and esp_random() is rand() (all weak, so
+// a test can run its own clock or pick the random numbers), and FreeRTOS
+// calls are no-ops for a single-threaded test.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+
+#include "native_freertos.h"
+
+#define PROGMEM
+#define IRAM_ATTR
+#define F(text) (text)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+uint32_t esp_random();
+bool psramFound();
+
+#if defined(_WIN32) || (defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)))
+size_t strlcpy(char* dst, const char* src, size_t size);
+size_t strlcat(char* dst, const char* src, size_t size);
+#endif
+
+class String {
+public:
+  String(const char* text = "") : value(text != nullptr ? text : "") {}
+
+  const char* c_str() const { return value.c_str(); }
+  unsigned int length() const { return (unsigned int)value.size(); }
+  bool isEmpty() const { return value.empty(); }
+  bool equalsIgnoreCase(const String& other) const { return strcasecmp(c_str(), other.c_str()) == 0; }
+  bool operator==(const char* other) const { return value == other; }
+  bool operator!=(const char* other) const { return value != other; }
+
+private:
+  std::string value;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+  virtual void flush() {}
+
+  size_t print(const char* text) { return write(text); }
+  size_t println(const char* text = "");
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+  Stream() : timeoutMs(1000) {}
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual size_t readBytes(char* buffer, size_t length);
+  size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+  size_t readBytesUntil(char terminator, char* buffer, size_t length);
+  void setTimeout(unsigned long ms) { timeoutMs = ms; }
+
+protected:
+  unsigned long timeoutMs;
+};
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  operator bool() const { return true; }
+  using Print::write;
+
+  // Host only: drop the log (long simulations that log every update)
+  bool muted = false;
+};
+
+extern HardwareSerial Serial;
+
+#endif // NATIVE_ARDUINO_H
@@ -0,0 +1,140 @@
+#include "FS.h"
+
+namespace fs {
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+  if (!data || !writable) {
+    return 0;
+  }
+  if (append) {
+    position_ = data->size();
+  }
+  if (position_ + size > data->size()) {
+    data->resize(position_ + size);
+  }
+  memcpy(data->data() + position_, buffer, size);
+  position_ += size;
+  owner->writes++;
+  owner->written += size;
+  return size;
+}
+
+int File::available() {
+  return data && position_ < data->size() ? (int)(data->size() - position_) : 0;
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek() {
+  return data && position_ < data->size() ? (*data)[position_] : -1;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+  size_t count = (size_t)available();
+  if (count > size) {
+    count = size;
+  }
+  if (count > 0) {
+    memcpy(buffer, data->data() + position_, count);
+    position_ += count;
+  }
+  return count;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!data) {
+    return false;
+  }
+  size_t base = mode == SeekSet ? 0 : mode == SeekCur ? position_ : data->size();
+  if (base + pos > data->size()) {
+    return false;
+  }
+  position_ = base + pos;
+  return true;
+}
+
+void File::close() {
+  *this = File();
+}
+
+const char* File::name() const {
+  const char* slash = strrchr(path_.c_str(), '/');
+  return slash != nullptr ? slash + 1 : path_.c_str();
+}
+
+File File::openNextFile(const char* mode) {
+  if (!directory || next >= entries.size()) {
+    return File();
+  }
+  return owner->open(entries[next++].c_str(), mode);
+}
+
+File FS::open(const char* path, const char* mode, bool create) {
+  File file;
+  file.owner = this;
+  file.path_ = path;
+  std::map<std::string, File::Data>::iterator found = files.find(path);
+
+  if (mode[0] == 'r' && found == files.end()) {
+    // No such file: a directory when files live under it
+    std::string prefix = path;
+    if (prefix.empty() || prefix[prefix.size() - 1] != '/') {
+      prefix += '/';
+    }
+    for (found = files.lower_bound(prefix); found != files.end(); ++found) {
+      if (found->first.compare(0, prefix.size(), prefix) != 0) {
+        break;
+      }
+      file.entries.push_back(found->first);
+    }
+    if (file.entries.empty() && !create) {
+      return File();
+    }
+    file.directory = true;
+    return file;
+  }
+
+  if (found == files.end() || mode[0] == 'w') {
+    File::Data empty(new std::vector<uint8_t>());
+    files[path] = empty;
+    file.data = empty;
+  } else {
+    file.data = found->second;
+  }
+  file.writable = mode[0] != 'r' || mode[1] == '+';
+  file.append = mode[0] == 'a';
+  file.position_ = file.append ? file.data->size() : 0;
+  return file;
+}
+
+bool FS::exists(const char* path) {
+  return files.count(path) > 0;
+}
+
+bool FS::remove(const char* path) {
+  return files.erase(path) > 0;
+}
+
+bool FS::rename(const char* from, const char* to) {
+  std::map<std::string, File::Data>::iterator found = files.find(from);
+  if (found == files.end()) {
+    return false;
+  }
+  File::Data data = found->second;
+  files.erase(found);
+  files[to] = data;
+  return true;
+}
+
+size_t FS::usedBytes() const {
+  size_t used = 0;
+  for (std::map<std::string, File::Data>::const_iterator it = files.begin(); it != files.end(); ++it) {
+    used += it->second->size();
+  }
+  return used;
+}
+
+} // namespace fs
@@ -0,0 +1,92 @@
+#ifndef NATIVE_FS_H
+#define NATIVE_FS_H
+
+// In-memory stand-in for the ESP32 fs::FS (SPIFFS semantics: flat paths,
+// directories exist only as prefixes of file paths). A default-constructed
+// FS starts empty, so each test gets a fresh "flash".
+
+#include "Arduino.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class FS;
+
+class File : public Stream {
+public:
+  File() : writable(false), append(false), directory(false), position_(0), owner(nullptr), next(0) {}
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size) override;
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t read(uint8_t* buffer, size_t size);
+  size_t readBytes(char* buffer, size_t length) override { return read((uint8_t*)buffer, length); }
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const { return position_; }
+  size_t size() const { return data ? data->size() : 0; }
+  void close();
+  operator bool() const { return data != nullptr || directory; }
+  const char* path() const { return path_.c_str(); }
+  const char* name() const;
+  bool isDirectory() const { return directory; }
+  File openNextFile(const char* mode = FILE_READ);
+  using Print::write;
+
+private:
+  friend class FS;
+  typedef std::shared_ptr<std::vector<uint8_t> > Data;
+
+  std::string path_;
+  Data data;                        // Null for a directory
+  bool writable;
+  bool append;                      // Every write goes to the end
+  bool directory;
+  size_t position_;
+  FS* owner;
+  std::vector<std::string> entries; // Directory listing taken at open()
+  size_t next;
+};
+
+class FS {
+public:
+  File open(const char* path, const char* mode = FILE_READ, bool create = false);
+  File open(const String& path, const char* mode = FILE_READ, bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+  bool exists(const char* path);
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool remove(const char* path);
+  bool remove(const String& path) { return remove(path.c_str()); }
+  bool rename(const char* from, const char* to);
+  bool rename(const String& from, const String& to) { return rename(from.c_str(), to.c_str()); }
+  bool mkdir(const char*) { return true; }
+  bool rmdir(const char*) { return true; }
+
+  // Host-side accounting for benchmarks
+  size_t usedBytes() const;
+  uint32_t writeCalls() const { return writes; }
+  uint64_t bytesWritten() const { return written; }
+
+private:
+  friend class File;
+  std::map<std::string, File::Data> files;
+  uint32_t writes = 0;
+  uint64_t written = 0;
+};
+
+} // namespace fs
+
+using fs::FS;
+using fs::File;
+
+#endif // NATIVE_FS_H
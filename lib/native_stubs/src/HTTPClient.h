@@ -0,0 +1,49 @@
+#ifndef NATIVE_HTTPCLIENT_H
+#define NATIVE_HTTPCLIENT_H
+
+// HTTPClient without a network: GET() fails unless a test has staged a
+// response with respondWith(), whose body is then read from the given client
+
+#include "Arduino.h"
+#include "WiFi.h"
+#include <map>
+
+#define HTTP_CODE_OK 200
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+
+class HTTPClient {
+public:
+  HTTPClient() : code(HTTPC_ERROR_CONNECTION_REFUSED), body(nullptr), bodySize(-1) {}
+
+  bool begin(WiFiClient&, const char*) { return true; }
+  void end() {}
+  void setTimeout(uint16_t) {}
+  void setReuse(bool) {}
+  void addHeader(const String&, const String&) {}
+  void collectHeaders(const char* [], size_t) {}
+  int GET() { return code; }
+
+  int getSize() { return bodySize; }
+  WiFiClient* getStreamPtr() { return body; }
+  String header(const char* name) {
+    std::map<std::string, std::string>::const_iterator found = headers.find(name);
+    return String(found != headers.end() ? found->second.c_str() : "");
+  }
+
+  // Test side: the next GET() returns statusCode with this body
+  // (size -1 = no Content-Length)
+  void respondWith(int statusCode, WiFiClient* stream, int size) {
+    code = statusCode;
+    body = stream;
+    bodySize = size;
+  }
+  void setResponseHeader(const char* name, const char* value) { headers[name] = value; }
+
+private:
+  int code;
+  WiFiClient* body;
+  int bodySize;
+  std::map<std::string, std::string> headers;
+};
+
+#endif // NATIVE_HTTPCLIENT_H
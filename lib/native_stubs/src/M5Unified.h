@@ -0,0 +1,26 @@
+#ifndef NATIVE_M5UNIFIED_H
+#define NATIVE_M5UNIFIED_H
+
+// The M5GFX color and text datum constants the display code refers to; the
+// drawing itself goes through DisplaySurface (FramebufferSurface on the host)
+
+#include "Arduino.h"
+
+#define TFT_BLACK 0x0000
+#define TFT_NAVY 0x000F
+#define TFT_MAROON 0x7800
+#define TFT_PURPLE 0x780F
+#define TFT_DARKGREY 0x7BEF
+#define TFT_RED 0xF800
+#define TFT_GREEN 0x07E0
+#define TFT_YELLOW 0xFFE0
+#define TFT_ORANGE 0xFDA0
+#define TFT_WHITE 0xFFFF
+
+enum textdatum_t : uint8_t {
+  TL_DATUM = 0, TC_DATUM = 1, TR_DATUM = 2,
+  ML_DATUM = 4, MC_DATUM = 5, MR_DATUM = 6,
+  BL_DATUM = 8, BC_DATUM = 9, BR_DATUM = 10
+};
+
+#endif // NATIVE_M5UNIFIED_H
@@ -0,0 +1,12 @@
+#include "WiFi.h"
+
+WiFiClass WiFi;
+
+int WiFiClient::read(uint8_t*, size_t) {
+  return -1;
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
@@ -0,0 +1,43 @@
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+// No network on the host: WiFi never connects, and a WiFiClient is an empty
+// stream that tests can subclass to serve canned bytes
+
+#include "Arduino.h"
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+class WiFiClass {
+public:
+  wl_status_t status() { return WL_DISCONNECTED; }
+};
+
+extern WiFiClass WiFi;
+
+class WiFiClient : public Stream {
+public:
+  virtual uint8_t connected() { return 0; }
+  virtual int read(uint8_t* buffer, size_t size);
+  virtual void stop() {}
+
+  size_t write(uint8_t) override { return 0; }
+  int available() override { return 0; }
+  int read() override;
+  int peek() override { return -1; }
+  size_t readBytes(char* buffer, size_t length) override {
+    int count = read((uint8_t*)buffer, length);
+    return count > 0 ? count : 0;
+  }
+  using Stream::readBytes;
+  using Print::write;
+};
+
+#endif // NATIVE_WIFI_H
@@ -0,0 +1,27 @@
+#include "esp_heap_caps.h"
+#include <stdlib.h>
+
+__attribute__((weak)) void* heap_caps_malloc(size_t size, uint32_t) {
+  return malloc(size);
+}
+
+__attribute__((weak)) void* heap_caps_realloc(void* ptr, size_t size, uint32_t) {
+  return realloc(ptr, size);
+}
+
+__attribute__((weak)) void heap_caps_free(void* ptr) {
+  free(ptr);
+}
+
+// The host heap has no meaningful limit; report an ESP32-sized internal heap
+__attribute__((weak)) size_t heap_caps_get_free_size(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? 0 : 200000;
+}
+
+__attribute__((weak)) size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? 0 : 110000;
+}
+
+__attribute__((weak)) size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+  return heap_caps_get_free_size(caps);
+}
@@ -0,0 +1,64 @@
+#ifndef NATIVE_FREERTOS_H
+#define NATIVE_FREERTOS_H
+
+// FreeRTOS for a single-threaded host test: locks always succeed, created
+// tasks never run (tests drive the work themselves), queued items are dropped
+// and delays return at once.
+
+#include <stdint.h>
+
+typedef void* TaskHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef void* QueueHandle_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef struct { int unused; } portMUX_TYPE;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xffffffffu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+  static int mutex;
+  return &mutex;
+}
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
+inline void vSemaphoreDelete(SemaphoreHandle_t) {}
+
+inline BaseType_t xTaskCreatePinnedToCore(void (*)(void*), const char*, uint32_t, void*, UBaseType_t,
+                                          TaskHandle_t* handle, BaseType_t) {
+  static int task;
+  if (handle != nullptr) {
+    *handle = &task;
+  }
+  return pdPASS;
+}
+inline QueueHandle_t xQueueCreate(UBaseType_t, UBaseType_t) {
+  static int queue;
+  return &queue;
+}
+inline BaseType_t xQueueSend(QueueHandle_t, const void*, TickType_t) { return pdTRUE; }
+inline BaseType_t xQueueReceive(QueueHandle_t, void*, TickType_t) { return pdFALSE; }
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+  static int task;
+  return &task;
+}
+inline void vTaskDelete(TaskHandle_t) {}
+inline void vTaskDelay(TickType_t) {}
+inline void vTaskDelayUntil(TickType_t* previous, TickType_t increment) { *previous += increment; }
+inline TickType_t xTaskGetTickCount() { return 0; }
+inline BaseType_t xTaskNotifyGive(TaskHandle_t) { return pdPASS; }
+inline uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) { return 0; }
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) { return 0; }
+
+#endif // NATIVE_FREERTOS_H
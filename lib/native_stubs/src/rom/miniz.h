@@ -0,0 +1,133 @@
+#ifndef NATIVE_ROM_MINIZ_H
+#define NATIVE_ROM_MINIZ_H
+
+// The ESP32 ROM's tinfl/crc32 API on top of zlib. zlib's state lives in an
+// arena inside the decompressor, so freeing it mid-stream leaks nothing
+// (like tinfl, there is nothing to tear down). When the stream ends, the bit
+// buffer is left the way ROM tinfl (miniz 1.15, raw deflate) leaves it: the
+// unused high bits of the last deflate byte, then the bytes its fast path
+// had already read past the end (up to 4, as far as the input went).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+
+typedef unsigned long mz_ulong;
+
+#define TINFL_LZ_DICT_SIZE 32768
+#define TINFL_FLAG_HAS_MORE_INPUT 2
+
+typedef enum {
+  TINFL_STATUS_BAD_PARAM = -3,
+  TINFL_STATUS_ADLER32_MISMATCH = -2,
+  TINFL_STATUS_FAILED = -1,
+  TINFL_STATUS_DONE = 0,
+  TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+  TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+typedef struct {
+  z_stream z;
+  int started;
+  int finished;
+  uint32_t m_num_bits;  // tinfl's look-ahead, rebuilt when the stream ends
+  uint64_t m_bit_buf;
+  uint8_t lastIn;       // Last byte zlib took (holds the end-of-block bits)
+  int lastBlockDone;
+  uint32_t padding;     // Unused bits of lastIn once the last block ended
+  size_t arenaUsed;
+  unsigned char arena[48 * 1024]; // Raw inflate with a 32KB window needs about 40KB
+} tinfl_decompressor;
+
+static inline voidpf tinfl_arena_alloc(voidpf opaque, uInt items, uInt size) {
+  tinfl_decompressor* r = (tinfl_decompressor*)opaque;
+  size_t bytes = ((size_t)items * size + 15) & ~(size_t)15;
+  if (r->arenaUsed + bytes > sizeof(r->arena)) {
+    return Z_NULL;
+  }
+  voidpf block = r->arena + r->arenaUsed;
+  r->arenaUsed += bytes;
+  return block;
+}
+
+static inline void tinfl_arena_free(voidpf, voidpf) {
+}
+
+#define tinfl_init(r) \
+  do { (r)->started = 0; (r)->finished = 0; (r)->m_num_bits = 0; (r)->m_bit_buf = 0; \
+       (r)->lastIn = 0; (r)->lastBlockDone = 0; (r)->padding = 0; (r)->arenaUsed = 0; } while (0)
+
+static inline tinfl_status tinfl_decompress(tinfl_decompressor* r, const uint8_t* in, size_t* inSize,
+                                            uint8_t* outStart, uint8_t* outNext, size_t* outSize,
+                                            uint32_t flags) {
+  (void)outStart;
+  (void)flags;
+  if (r->finished) {
+    *inSize = 0;
+    *outSize = 0;
+    return TINFL_STATUS_DONE;
+  }
+  if (!r->started) {
+    memset(&r->z, 0, sizeof(r->z));
+    r->z.zalloc = tinfl_arena_alloc;
+    r->z.zfree = tinfl_arena_free;
+    r->z.opaque = r;
+    if (inflateInit2(&r->z, -15) != Z_OK) {
+      return TINFL_STATUS_FAILED;
+    }
+    r->started = 1;
+  }
+  r->z.next_in = (Bytef*)in;
+  r->z.avail_in = (uInt)*inSize;
+  r->z.next_out = outNext;
+  r->z.avail_out = (uInt)*outSize;
+  // Z_BLOCK stops at block ends with the unused bit count in data_type, which
+  // is the only place zlib shows it before discarding the final padding
+  int result;
+  for (;;) {
+    uInt inBefore = r->z.avail_in;
+    uInt outBefore = r->z.avail_out;
+    result = inflate(&r->z, r->lastBlockDone ? Z_NO_FLUSH : Z_BLOCK);
+    if (result != Z_OK) {
+      break;
+    }
+    if (r->z.avail_in < inBefore) {
+      r->lastIn = r->z.next_in[-1];
+    }
+    if (!r->lastBlockDone && (r->z.data_type & 192) == 192) {
+      r->lastBlockDone = 1;
+      r->padding = r->z.data_type & 7;
+      continue;
+    }
+    if (r->z.avail_in == 0 || r->z.avail_out == 0 ||
+        (r->z.avail_in == inBefore && r->z.avail_out == outBefore)) {
+      break;
+    }
+  }
+  size_t consumed = *inSize - r->z.avail_in;
+  *inSize = consumed;
+  *outSize -= r->z.avail_out;
+  if (result == Z_STREAM_END) {
+    r->finished = 1;
+    r->m_num_bits = r->padding;
+    r->m_bit_buf = r->padding ? (uint64_t)(r->lastIn >> (8 - r->padding)) : 0;
+    size_t ahead = r->z.avail_in < 4 ? r->z.avail_in : 4;
+    for (size_t i = 0; i < ahead; i++) {
+      r->m_bit_buf |= (uint64_t)in[consumed + i] << r->m_num_bits;
+      r->m_num_bits += 8;
+    }
+    *inSize += ahead;
+    return TINFL_STATUS_DONE;
+  }
+  if (result != Z_OK && result != Z_BUF_ERROR) {
+    return TINFL_STATUS_FAILED;
+  }
+  return r->z.avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
+
+static inline mz_ulong mz_crc32(mz_ulong crc, const unsigned char* data, size_t length) {
+  return crc32(crc, data, (uInt)length);
+}
+
+#endif // NATIVE_ROM_MINIZ_H
@@ -0,0 +1,12 @@
+#ifndef NATIVE_SECRETS_H
+#define NATIVE_SECRETS_H
+
+// Placeholder credentials for native builds; src/secrets.h, when present, is
+// found first. Settings such as WIFI_CONNECT_TIMEOUT come from config.h, and
+// ICON_SERVER_URL stays unset so icon downloads are disabled.
+#define WIFI_SSID "native"
+#define WIFI_PASSWORD ""
+#define CMC_API_KEY "native"
+#define FMP_API_KEY "native"
+
+#endif // NATIVE_SECRETS_H
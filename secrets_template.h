@@ -12,17 +12,18 @@
 // CoinMarketCap API Configuration (Cryptocurrency Data)
 #define CMC_API_KEY "YOUR_COINMARKETCAP_API_KEY_HERE"
 #define API_BASE_URL "https://pro-api.coinmarketcap.com/v2/cryptocurrency/quotes/latest"
-#define API_SYMBOLS "BTC,ETH,XRP"
-#define API_CONVERT "CAD"
+#define CMC_MAP_URL "https://pro-api.coinmarketcap.com/v1/cryptocurrency/map"  // Symbol -> id lookup
+#define API_CONVERT "CAD"  // Quote currency of every crypto request; other display currencies are converted locally
 
 // Financial Modeling Prep API Configuration (Stock Data)
 #define FMP_API_KEY "YOUR_FINANCIAL_MODELING_PREP_API_KEY_HERE"
 #define FMP_BASE_URL "https://financialmodelingprep.com/stable/quote"
-#define STOCK_SYMBOL "MSFT"
+#define FMP_BATCH_URL "https://financialmodelingprep.com/stable/batch-quote"  // Several symbols at once
 
-// Construct the full API endpoints
-#define API_ENDPOINT API_BASE_URL "?CMC_PRO_API_KEY=" CMC_API_KEY "&symbol=" API_SYMBOLS "&convert=" API_CONVERT
-#define STOCK_ENDPOINT FMP_BASE_URL "?symbol=" STOCK_SYMBOL "&apikey=" FMP_API_KEY
+// Symbols are taken from the assets[] table in main.cpp and added to each request
+
+// Exchange rates (only fetched when an asset's display currency differs from its quote currency)
+#define FX_RATES_URL "https://open.er-api.com/v6/latest/USD"  // Rates per US dollar
 
 // MQTT Configuration (Home Assistant / Mosquitto)
 #define MQTT_BROKER "YOUR_HOME_ASSISTANT_IP"  // e.g., "192.168.1.100"
@@ -32,4 +33,16 @@
 #define MQTT_CLIENT_ID "m5crypto"              // Unique client identifier
 #define MQTT_TOPIC_PREFIX "m5crypto"           // Base topic for all messages
 
+// Fleet mode (several displays, one set of API requests)
+// "standalone": fetch on its own; "gateway": fetch and publish snapshots for the fleet;
+// "display": show the gateway's snapshots, no HTTPS; "auto": display that takes over
+// as gateway when none is online. Fleet devices share MQTT_TOPIC_PREFIX.
+#define FLEET_ROLE "standalone"
+
+// Streaming price feed (optional - sub-second crypto prices; polling is the fallback)
+#define STREAM_URL "wss://ws.kraken.com/v2"    // "" to disable; "ws://<pc-ip>:8765/" for tools/ws_replay.py
+
+// Icon Server (optional - icons for symbols without a built-in icon)
+#define ICON_SERVER_URL ""                     // e.g., "http://192.168.1.100:8080/icons"
+
 #endif // SECRETS_TEMPLATE_H
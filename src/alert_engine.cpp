@@ -0,0 +1,377 @@
+#include "alert_engine.h"
+#include "mem_alloc.h"
+#include <math.h>
+
+static const size_t LINE_LEN = 64;
+
+AlertEngine::AlertEngine()
+  : rules(nullptr),
+    capacity(0),
+    count(0),
+    assets(nullptr),
+    assetCount(0),
+    queueHead(0),
+    queueCount(0),
+    fired(0),
+    suppressed(0),
+    dropped(0),
+    rejected(0) {
+  memset(groupStart, 0, sizeof(groupStart));
+  for (int a = 0; a < SCHEDULER_MAX_ASSETS; a++) {
+    for (int s = 0; s < SERIES_COUNT; s++) {
+      lastValue[a][s] = NAN;
+    }
+  }
+}
+
+AlertEngine::~AlertEngine() {
+  memFree(rules);
+}
+
+bool AlertEngine::begin(const AssetData assetList[], int assetListCount, size_t ruleCapacity) {
+  assets = assetList;
+  assetCount = assetListCount < SCHEDULER_MAX_ASSETS ? assetListCount : SCHEDULER_MAX_ASSETS;
+  if (rules == nullptr) {
+    rules = (Rule*)memAlloc(ruleCapacity * sizeof(Rule), MEM_BULK);
+    if (rules == nullptr) {
+      Serial.println("Alerts: no memory for rules, alerts disabled");
+      return false;
+    }
+    capacity = ruleCapacity;
+  }
+  return true;
+}
+
+int AlertEngine::setRules(const char* text, size_t length) {
+  if (rules == nullptr) {
+    return 0;
+  }
+  count = 0;
+  int added = parseRules(text, length);
+  index();
+  Serial.printf("Alerts: %u rules\n", (unsigned)count);
+  return added;
+}
+
+int AlertEngine::addRules(const char* text, size_t length) {
+  if (rules == nullptr) {
+    return 0;
+  }
+  int added = parseRules(text, length);
+  index();
+  Serial.printf("Alerts: %d rules added, %u in all\n", added, (unsigned)count);
+  return added;
+}
+
+bool AlertEngine::load(fs::FS& fs) {
+  if (rules == nullptr || !fs.exists(ALERT_RULES_PATH)) {
+    return false;
+  }
+  File file = fs.open(ALERT_RULES_PATH, FILE_READ);
+  if (!file) {
+    return false;
+  }
+  count = 0;
+  char line[LINE_LEN];
+  while (file.available() > 0) {
+    size_t length = file.readBytesUntil('\n', line, sizeof(line) - 1);
+    line[length] = '\0';
+    parseRules(line, length);
+  }
+  file.close();
+  index();
+  Serial.printf("Alerts: %u rules from %s\n", (unsigned)count, ALERT_RULES_PATH);
+  return true;
+}
+
+bool AlertEngine::save(fs::FS& fs) const {
+  if (rules == nullptr) {
+    return false;
+  }
+  File file = fs.open(ALERT_RULES_PATH, FILE_WRITE);
+  if (!file) {
+    Serial.println("Alerts: Cannot write rules");
+    return false;
+  }
+  char line[LINE_LEN];
+  for (size_t i = 0; i < count; i++) {
+    formatRule(rules[i], line, sizeof(line));
+    file.println(line);
+  }
+  file.close();
+  return true;
+}
+
+// Every line of text into the table (unsorted; index() follows)
+int AlertEngine::parseRules(const char* text, size_t length) {
+  int added = 0;
+  bool full = false;
+  size_t start = 0;
+  while (start < length) {
+    size_t end = start;
+    while (end < length && text[end] != '\n') {
+      end++;
+    }
+    char line[LINE_LEN];
+    size_t lineLength = end - start < sizeof(line) - 1 ? end - start : sizeof(line) - 1;
+    memcpy(line, text + start, lineLength);
+    line[lineLength] = '\0';
+    start = end + 1;
+
+    char* comment = strchr(line, '#');
+    if (comment != nullptr) {
+      *comment = '\0';
+    }
+    if (strspn(line, " \t\r") == strlen(line)) {
+      continue; // Blank
+    }
+    Rule rule;
+    if (!parseRule(line, rule)) {
+      Serial.printf("Alerts: Bad rule '%s'\n", line);
+      rejected++;
+    } else if (count >= capacity) {
+      if (!full) {
+        Serial.printf("Alerts: Table full (%u rules), dropping the rest\n", (unsigned)capacity);
+        full = true;
+      }
+      rejected++;
+    } else {
+      rules[count++] = rule;
+      added++;
+    }
+  }
+  return added;
+}
+
+// "<SYMBOL> above|below <price>", "<SYMBOL> move <percent> <window>",
+// "<SYMBOL> stale <seconds>"
+bool AlertEngine::parseRule(const char* line, Rule& rule) {
+  char symbol[16];
+  char kind[8];
+  char window[8] = "";
+  float value = 0.0f;
+  if (sscanf(line, "%15s %7s %f %7s", symbol, kind, &value, window) < 3 || !(value > 0.0f)) {
+    return false;
+  }
+
+  int asset = -1;
+  for (int i = 0; i < assetCount; i++) {
+    if (strcasecmp(assets[i].symbol, symbol) == 0) {
+      asset = i;
+      break;
+    }
+  }
+  if (asset < 0) {
+    return false;
+  }
+
+  rule.asset = (uint8_t)asset;
+  rule.firedAt = 0;
+  rule.threshold = value;
+  if (strcmp(kind, "above") == 0) {
+    rule.series = SERIES_PRICE;
+  } else if (strcmp(kind, "below") == 0) {
+    rule.series = SERIES_NEGATED_PRICE;
+    rule.threshold = -value;
+  } else if (strcmp(kind, "stale") == 0) {
+    rule.series = SERIES_AGE;
+  } else if (strcmp(kind, "move") == 0) {
+    for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+      char name[8];
+      MarketStats::windowName(w, name, sizeof(name));
+      if (strcmp(window, name) == 0) {
+        rule.series = SERIES_MOVE + w;
+        return true;
+      }
+    }
+    return false; // Not one of STATS_WINDOWS_SEC
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void AlertEngine::formatRule(const Rule& rule, char* out, size_t size) const {
+  const char* symbol = assets[rule.asset].symbol;
+  switch (rule.series) {
+    case SERIES_PRICE:
+      snprintf(out, size, "%s above %.7g", symbol, rule.threshold);
+      break;
+    case SERIES_NEGATED_PRICE:
+      snprintf(out, size, "%s below %.7g", symbol, -rule.threshold);
+      break;
+    case SERIES_AGE:
+      snprintf(out, size, "%s stale %.0f", symbol, rule.threshold);
+      break;
+    default: {
+      char window[8];
+      MarketStats::windowName(rule.series - SERIES_MOVE, window, sizeof(window));
+      snprintf(out, size, "%s move %.7g %s", symbol, rule.threshold, window);
+      break;
+    }
+  }
+}
+
+int AlertEngine::compareRules(const void* a, const void* b) {
+  const Rule* ra = static_cast<const Rule*>(a);
+  const Rule* rb = static_cast<const Rule*>(b);
+  if (ra->asset != rb->asset) {
+    return ra->asset < rb->asset ? -1 : 1;
+  }
+  if (ra->series != rb->series) {
+    return ra->series < rb->series ? -1 : 1;
+  }
+  if (ra->threshold != rb->threshold) {
+    return ra->threshold < rb->threshold ? -1 : 1;
+  }
+  return 0;
+}
+
+// Sort the table and record where each (asset, series) group starts
+void AlertEngine::index() {
+  qsort(rules, count, sizeof(Rule), compareRules);
+  const int groups = SCHEDULER_MAX_ASSETS * SERIES_COUNT;
+  size_t r = 0;
+  for (int g = 0; g < groups; g++) {
+    groupStart[g] = (uint32_t)r;
+    while (r < count && rules[r].asset * SERIES_COUNT + rules[r].series == g) {
+      r++;
+    }
+  }
+  groupStart[groups] = (uint32_t)r;
+}
+
+void AlertEngine::check(uint8_t asset, const AssetData& data, const AssetStats* stats, time_t now) {
+  if (rules == nullptr || asset >= assetCount) {
+    return;
+  }
+  if (data.price > 0.0f) {
+    advance(asset, SERIES_PRICE, data.price, now);
+    advance(asset, SERIES_NEGATED_PRICE, -data.price, now);
+  }
+
+  // A closed market's price is old on purpose; start over when it opens
+  long age = assetAgeSeconds(data, now);
+  if (age >= 0 && !data.marketClosed) {
+    advance(asset, SERIES_AGE, (float)age, now);
+  } else {
+    lastValue[asset][SERIES_AGE] = NAN;
+  }
+
+  for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+    float change = stats != nullptr ? stats->windowChange[w] : NAN;
+    if (isnan(change)) {
+      lastValue[asset][SERIES_MOVE + w] = NAN;
+    } else {
+      advance(asset, SERIES_MOVE + w, fabsf(change), now);
+    }
+  }
+}
+
+// The series went from its last value to this one: fire the rules it rose
+// through (previous < threshold <= value)
+void AlertEngine::advance(uint8_t asset, uint8_t series, float value, time_t now) {
+  float& last = lastValue[asset][series];
+  float previous = last;
+  last = value;
+  if (isnan(previous) || !(value > previous)) {
+    return;
+  }
+
+  int group = asset * SERIES_COUNT + series;
+  uint32_t low = groupStart[group];
+  uint32_t high = groupStart[group + 1];
+  if (low == high) {
+    return;
+  }
+  // First threshold above the previous value
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (rules[mid].threshold <= previous) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  uint32_t end = groupStart[group + 1];
+  for (uint32_t i = low; i < end && rules[i].threshold <= value; i++) {
+    fire(rules[i], value, now);
+  }
+}
+
+void AlertEngine::fire(Rule& rule, float value, time_t now) {
+  if (rule.firedAt != 0 && (uint32_t)now - rule.firedAt < ALERT_COOLDOWN_SEC) {
+    suppressed++;
+    return;
+  }
+  rule.firedAt = (uint32_t)now;
+  fired++;
+  if (queueCount >= ALERT_QUEUE_SIZE) {
+    dropped++;
+    return;
+  }
+
+  AlertEvent& event = queue[(queueHead + queueCount) % ALERT_QUEUE_SIZE];
+  queueCount++;
+  event.asset = rule.asset;
+  event.window = 0;
+  event.threshold = rule.threshold;
+  event.value = value;
+  event.at = now;
+  switch (rule.series) {
+    case SERIES_PRICE:
+      event.kind = ALERT_ABOVE;
+      break;
+    case SERIES_NEGATED_PRICE:
+      event.kind = ALERT_BELOW;
+      event.threshold = -rule.threshold;
+      event.value = -value;
+      break;
+    case SERIES_AGE:
+      event.kind = ALERT_STALE;
+      break;
+    default:
+      event.kind = ALERT_MOVE;
+      event.window = rule.series - SERIES_MOVE;
+      break;
+  }
+}
+
+bool AlertEngine::takeFired(AlertEvent& event) {
+  if (queueCount == 0) {
+    return false;
+  }
+  event = queue[queueHead];
+  queueHead = (queueHead + 1) % ALERT_QUEUE_SIZE;
+  queueCount--;
+  return true;
+}
+
+void AlertEngine::describe(const AlertEvent& event, char* out, size_t size) const {
+  const char* symbol = event.asset < assetCount ? assets[event.asset].symbol : "?";
+  switch (event.kind) {
+    case ALERT_ABOVE:
+    case ALERT_BELOW:
+      snprintf(out, size, "%s %s %.7g", symbol, kindName(event.kind), event.threshold);
+      break;
+    case ALERT_MOVE: {
+      char window[8];
+      MarketStats::windowName(event.window, window, sizeof(window));
+      snprintf(out, size, "%s moved %.1f%% in %s", symbol, event.value, window);
+      break;
+    }
+    case ALERT_STALE:
+      snprintf(out, size, "%s no price for %lds", symbol, (long)event.value);
+      break;
+  }
+}
+
+const char* AlertEngine::kindName(AlertKind kind) {
+  switch (kind) {
+    case ALERT_ABOVE: return "above";
+    case ALERT_BELOW: return "below";
+    case ALERT_MOVE: return "move";
+    case ALERT_STALE: return "stale";
+  }
+  return "?";
+}
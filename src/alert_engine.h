@@ -0,0 +1,127 @@
+#ifndef ALERT_ENGINE_H
+#define ALERT_ENGINE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <time.h>
+#include "config.h"
+#include "crypto_display.h"
+#include "market_stats.h"
+
+enum AlertKind : uint8_t {
+  ALERT_ABOVE,  // Price rose to or through a level
+  ALERT_BELOW,  // Price fell to or through a level
+  ALERT_MOVE,   // Percent change over a MarketStats window reached a size (either way)
+  ALERT_STALE   // Price age reached a number of seconds
+};
+
+// One rule that fired, for loop() to sound, show and publish
+struct AlertEvent {
+  uint8_t asset;
+  AlertKind kind;
+  uint8_t window;   // ALERT_MOVE: MarketStats window index
+  float threshold;  // As written in the rule (level, percent or seconds)
+  float value;      // Price, percent change or age that crossed it
+  time_t at;
+};
+
+// Price alert rules, checked on every price without scanning them.
+//
+// Rules are text, one per line ('#' starts a comment):
+//   BTC above 100000
+//   ETH below 2500
+//   XRP move 5 15m      (percent, window from STATS_WINDOWS_SEC)
+//   MSFT stale 900      (seconds)
+//
+// Every rule watches one series per asset: the price (above), the negated
+// price (below, so it also fires on a rise), the price age, or the size of
+// one window's change. The table is kept sorted by (asset, series,
+// threshold) with the start of each series indexed, so when a series moves
+// from old to new only the rules with old < threshold <= new are visited:
+// a binary search for the first, then a walk over the ones crossed. A check
+// costs O(log n) whatever the rule count, and a jump over several levels
+// between two checks fires all of them. Falls (and the first value seen)
+// fire nothing; a rule that fired stays quiet for ALERT_COOLDOWN_SEC.
+// Main loop only.
+class AlertEngine {
+public:
+  AlertEngine();
+  ~AlertEngine();
+
+  // Allocate the rule table (PSRAM when present) and name the assets rules
+  // may refer to. Without it every call is a no-op.
+  bool begin(const AssetData assets[], int count, size_t capacity = ALERT_MAX_RULES);
+
+  // Replace (or extend) the rules from text; bad lines are logged and
+  // skipped. Returns the number of rules added.
+  int setRules(const char* text, size_t length);
+  int addRules(const char* text, size_t length);
+
+  // Rules on flash (ALERT_RULES_PATH)
+  bool load(fs::FS& fs);
+  bool save(fs::FS& fs) const;
+
+  // Compare an asset's price, age and window changes with the last check
+  // (stats may be null). Fired rules are queued for takeFired().
+  void check(uint8_t asset, const AssetData& data, const AssetStats* stats, time_t now);
+
+  // Next fired alert, oldest first; false when none are waiting
+  bool takeFired(AlertEvent& event);
+
+  // "BTC above 100,000" etc. for toasts and logs
+  void describe(const AlertEvent& event, char* out, size_t size) const;
+  static const char* kindName(AlertKind kind);
+
+  // Statistics
+  size_t ruleCount() const { return count; }
+  uint32_t firedCount() const { return fired; }
+  uint32_t suppressedCount() const { return suppressed; } // Crossed during the cooldown
+  uint32_t droppedCount() const { return dropped; }       // Queue full
+  uint32_t rejectedCount() const { return rejected; }     // Bad lines or no room
+
+private:
+  enum Series : uint8_t {
+    SERIES_PRICE = 0,
+    SERIES_NEGATED_PRICE,
+    SERIES_AGE,
+    SERIES_MOVE,  // One per window from here
+    SERIES_COUNT = SERIES_MOVE + STATS_WINDOW_COUNT
+  };
+
+  struct Rule {
+    float threshold;    // In series units (negated for below)
+    uint32_t firedAt;   // Epoch seconds, 0 = never
+    uint8_t asset;
+    uint8_t series;
+  };
+
+  Rule* rules;          // [capacity], sorted by (asset, series, threshold)
+  size_t capacity;
+  size_t count;
+  const AssetData* assets;
+  int assetCount;
+
+  // rules[groupStart[g]] .. rules[groupStart[g + 1] - 1] watch series g
+  // (g = asset * SERIES_COUNT + series)
+  uint32_t groupStart[SCHEDULER_MAX_ASSETS * SERIES_COUNT + 1];
+  float lastValue[SCHEDULER_MAX_ASSETS][SERIES_COUNT]; // NAN until first seen
+
+  AlertEvent queue[ALERT_QUEUE_SIZE];
+  uint8_t queueHead;
+  uint8_t queueCount;
+
+  uint32_t fired;
+  uint32_t suppressed;
+  uint32_t dropped;
+  uint32_t rejected;
+
+  int parseRules(const char* text, size_t length);
+  bool parseRule(const char* line, Rule& rule);
+  void formatRule(const Rule& rule, char* out, size_t size) const;
+  void index();
+  void advance(uint8_t asset, uint8_t series, float value, time_t now);
+  void fire(Rule& rule, float value, time_t now);
+  static int compareRules(const void* a, const void* b);
+};
+
+#endif // ALERT_ENGINE_H
@@ -1,13 +1,82 @@
 #include "api_client.h"
+#include "metrics.h"
+#include "trace.h"
+#include "time_utils.h"
+#include "json_arena.h"
 #include "secrets.h"
+#include <Preferences.h>
 #include <time.h>
 
+#ifndef FMP_BATCH_URL
+#define FMP_BATCH_URL "https://financialmodelingprep.com/stable/batch-quote"
+#endif
+
+#ifndef CMC_MAP_URL
+#define CMC_MAP_URL "https://pro-api.coinmarketcap.com/v1/cryptocurrency/map"
+#endif
+
+#ifndef FX_RATES_URL
+#define FX_RATES_URL "https://open.er-api.com/v6/latest/USD"
+#endif
+
 APIClient::APIClient() {
   lastError = "";
+  lastErrorKind = FETCH_ERROR_NONE;
+  connectedHost[0] = '\0';
+  connectedPort = 0;
+  for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+    dnsCache[i].host[0] = '\0';
+    dnsCache[i].resolvedAt = 0;
+  }
+  wifiEstimateMs = 0;
+  memset(dnsEstimateMs, 0, sizeof(dnsEstimateMs));
+  memset(tlsEstimateMs, 0, sizeof(tlsEstimateMs));
+  fxTable = nullptr;
+  idsResolvedAt = 0;
+  lastIdAttempt = 0;
+}
+
+void APIClient::setFxTable(const FxTable* table) {
+  fxTable = table;
+}
+
+const char* APIClient::quoteCurrency(const AssetData& asset) {
+  if (!asset.isStock) {
+    return API_CONVERT;
+  }
+  return asset.exchange == EXCHANGE_TSX ? "CAD" : "USD";
+}
+
+bool APIClient::toDisplayCurrency(const AssetData& asset, float quoted, float& out) {
+  const char* from = quoteCurrency(asset);
+  if (strcmp(from, asset.currency) == 0) {
+    out = quoted;
+    return true;
+  }
+  if (fxTable == nullptr || !fxTable->convert(quoted, from, asset.currency, out)) {
+    // The FX provider's problem, not this response's: no error is recorded
+    Serial.printf("No exchange rate %s->%s, keeping the cached %s price\n", from, asset.currency, asset.symbol);
+    return false;
+  }
+  return true;
+}
+
+// Moving average with 1/4 weight; the first sample seeds it
+static void smoothEstimate(uint32_t& estimate, uint32_t sample) {
+  if (estimate == 0) {
+    estimate = sample > 0 ? sample : 1;
+  } else {
+    estimate += ((int32_t)sample - (int32_t)estimate) / 4;
+  }
+}
+
+static uint32_t estimateOrDefault(uint32_t estimate) {
+  return estimate > 0 ? estimate : PREWARM_DEFAULT_LEAD_MS;
 }
 
 bool APIClient::connectWiFi(const char* ssid, const char* password, unsigned long timeout) {
   Serial.printf("Attempting to connect to WiFi: %s\n", ssid);
+  unsigned long connectStart = millis();
   
   // Disconnect any existing connection
   WiFi.disconnect(true);
@@ -43,6 +112,7 @@ bool APIClient::connectWiFi(const char* ssid, const char* password, unsigned lon
   }
   
   if (WiFi.status() == WL_CONNECTED) {
+    smoothEstimate(wifiEstimateMs, millis() - connectStart);
     Serial.println("\nWiFi connected successfully!");
     Serial.printf("IP address: %s\n", WiFi.localIP().toString().c_str());
     Serial.printf("Signal strength: %d dBm\n", WiFi.RSSI());
@@ -51,7 +121,7 @@ bool APIClient::connectWiFi(const char* ssid, const char* password, unsigned lon
     wl_status_t finalStatus = WiFi.status();
     Serial.printf("\nWiFi connection failed. Final status: %d\n", finalStatus);
     
-    String errorMsg = "WiFi connection failed: ";
+    FixedString<64> errorMsg("WiFi connection failed: ");
     switch(finalStatus) {
       case WL_NO_SSID_AVAIL:
         errorMsg += "Network not found";
@@ -70,7 +140,7 @@ bool APIClient::connectWiFi(const char* ssid, const char* password, unsigned lon
         break;
     }
     
-    setError(errorMsg.c_str());
+    setError(errorMsg.c_str(), FETCH_ERROR_NETWORK);
     return false;
   }
 }
@@ -79,202 +149,352 @@ bool APIClient::isWiFiConnected() {
   return WiFi.status() == WL_CONNECTED;
 }
 
-bool APIClient::fetchCryptoData(CryptoData cryptos[], int count) {
+const char* APIClient::providerUrl(Provider provider) {
+  switch (provider) {
+    case PROVIDER_CMC: return API_BASE_URL;
+    case PROVIDER_FMP: return FMP_BASE_URL; // Batch quotes share the host
+    case PROVIDER_FX: return FX_RATES_URL;
+    default: return nullptr;
+  }
+}
+
+uint32_t APIClient::prewarmLeadMs(Provider provider) {
+  uint32_t lead = PREWARM_MARGIN_MS;
+  if (!isWiFiConnected()) {
+    lead += estimateOrDefault(wifiEstimateMs);
+  }
+  char host[sizeof(connectedHost)];
+  uint16_t port;
+  const char* url = providerUrl(provider);
+  if (url == nullptr || !parseHost(url, host, sizeof(host), port)) {
+    return lead;
+  }
+  if (client.connected() && strcmp(connectedHost, host) == 0 && connectedPort == port) {
+    return lead; // Already warm
+  }
+  DnsEntry* cached = findDnsEntry(host);
+  if (cached == nullptr || millis() - cached->resolvedAt >= DNS_CACHE_TTL_MS) {
+    lead += estimateOrDefault(dnsEstimateMs[provider]);
+  }
+  return lead + estimateOrDefault(tlsEstimateMs[provider]);
+}
+
+bool APIClient::prewarm(Provider provider) {
+  const char* url = providerUrl(provider);
+  if (url == nullptr) {
+    return false;
+  }
+  if (!isWiFiConnected()) {
+    Serial.println("Prewarm: WiFi down, reconnecting ahead of the next fetch");
+    trace.begin(TRACE_WIFI_RECONNECT);
+    bool reconnected = connectWiFi(WIFI_SSID, WIFI_PASSWORD, WIFI_CONNECT_TIMEOUT);
+    trace.end(TRACE_WIFI_RECONNECT);
+    if (!reconnected) {
+      return false;
+    }
+  }
+  client.setInsecure(); // Skip SSL certificate verification
+  return openConnection(provider, url);
+}
+
+bool APIClient::fetchCryptoData(AssetData* cryptos[], int count) {
   if (!isWiFiConnected()) {
-    setError("WiFi not connected");
+    setError("WiFi not connected", FETCH_ERROR_NETWORK);
+    return false;
+  }
+  
+  // A failed lookup counts against CMC like a failed price request; the next
+  // attempt goes by symbol until CMC_ID_RETRY_MS has passed
+  if (idsNeedResolving(cryptos, count) && !resolveCryptoIds(cryptos, count)) {
+    return false;
+  }
+  
+  // By id the response holds exactly one coin per asset; an empty aux drops the
+  // supplemental fields (tags, supply, rank...) that nothing here reads
+  bool byId = true;
+  char ids[96] = "";
+  for (int i = 0; i < count && byId; i++) {
+    char id[12];
+    snprintf(id, sizeof(id), i > 0 ? ",%lu" : "%lu", (unsigned long)cryptos[i]->cmcId);
+    byId = cryptos[i]->cmcId != 0 && strlcat(ids, id, sizeof(ids)) < sizeof(ids);
+  }
+  
+  char url[320];
+  if (byId) {
+    int length = snprintf(url, sizeof(url), "%s?CMC_PRO_API_KEY=%s&id=%s&convert=%s&aux=",
+                          API_BASE_URL, CMC_API_KEY, ids, API_CONVERT);
+    if (length <= 0 || (size_t)length >= sizeof(url)) {
+      setError("Request URL too long", FETCH_ERROR_CLIENT);
+      return false;
+    }
+  } else if (!buildUrl(url, sizeof(url), API_BASE_URL "?CMC_PRO_API_KEY=" CMC_API_KEY "&symbol=",
+                       cryptos, count, "&convert=" API_CONVERT)) {
     return false;
   }
   
+  unsigned long fetchStart = millis();
   client.setInsecure(); // Skip SSL certificate verification
-  http.begin(client, API_ENDPOINT);
+  if (!openConnection(PROVIDER_CMC, url)) {
+    metrics.recordFetch(PROVIDER_CMC, millis() - fetchStart, false);
+    return false;
+  }
+  http.begin(client, url);
   http.setTimeout(15000); // 15 second timeout
   http.addHeader("Accept", "application/json");
+  HttpBodyStream::prepareRequest(http);
   
   Serial.println("Making API request to CoinMarketCap...");
-  Serial.println(API_ENDPOINT);
+  Serial.println(url);
   
+  trace.begin(TRACE_HTTP_WAIT, PROVIDER_CMC);
   int httpCode = http.GET();
+  trace.end(TRACE_HTTP_WAIT, PROVIDER_CMC);
   
   Serial.printf("HTTP Response Code: %d\n", httpCode);
   
   if (httpCode == HTTP_CODE_OK) {
-    String payload = http.getString();
+    // The body is read (and inflated) as the parser consumes it
+    trace.begin(TRACE_BODY_READ, PROVIDER_CMC);
+    bool parsed = body.begin(http) && parseJsonResponse(body, cryptos, count, byId);
+    parsed = endBody(PROVIDER_CMC) && parsed;
+    trace.end(TRACE_BODY_READ, PROVIDER_CMC);
     http.end();
-    
-    return parseJsonResponse(payload, cryptos, count);
+    metrics.recordFetch(PROVIDER_CMC, millis() - fetchStart, true);
+    return parsed;
   } else if (httpCode > 0) {
     // Got a response but not OK
-    String errorPayload = http.getString();
+    ErrorBody errorPayload = readErrorBody();
     http.end();
+    metrics.recordFetch(PROVIDER_CMC, millis() - fetchStart, false);
     
     Serial.printf("HTTP Error Response: %s\n", errorPayload.c_str());
     
     // Check for common API errors
     if (httpCode == 401) {
-      setError("API Key invalid or expired");
+      setError("API Key invalid or expired", FETCH_ERROR_CLIENT);
     } else if (httpCode == 403) {
-      setError("API access forbidden - check your plan");  
+      setError("API access forbidden - check your plan", FETCH_ERROR_CLIENT);  
     } else if (httpCode == 429) {
-      setError("API rate limit exceeded");
+      setError("API rate limit exceeded", FETCH_ERROR_RATE_LIMIT);
     } else {
-      setError(("HTTP error " + String(httpCode) + ": " + errorPayload).c_str());
+      setErrorf(httpErrorKind(httpCode), "HTTP error %d: %s", httpCode, errorPayload.c_str());
     }
     return false;
   } else {
     // Connection error
     http.end();
-    setError(("Connection failed: " + String(httpCode)).c_str());
+    metrics.recordFetch(PROVIDER_CMC, millis() - fetchStart, false);
+    setErrorf(FETCH_ERROR_NETWORK, "Connection failed: %d", httpCode);
     return false;
   }
 }
 
-bool APIClient::parseJsonResponse(const String& payload, CryptoData cryptos[], int count) {
-  Serial.println("=== API Response Debug ===");
-  Serial.printf("Payload length: %d\n", payload.length());
-  Serial.println("First 500 characters of response:");
-  Serial.println(payload.substring(0, 500));
-  Serial.println("=========================");
-  
-  // Use larger buffer for CoinMarketCap API response (32KB for multi-crypto JSON)
-  DynamicJsonDocument doc(32768);
-  
+bool APIClient::parseJsonResponse(Stream& payload, AssetData* cryptos[], int count, bool byId) {
+  // Sized from past responses; the first guess is 32KB for multi-crypto JSON
+  ArenaJsonDocument doc(JSON_USER_CMC_QUOTES, 32768);
+  unsigned long parseStart = micros();
+  trace.begin(TRACE_PARSE, PROVIDER_CMC);
   DeserializationError error = deserializeJson(doc, payload);
+  trace.end(TRACE_PARSE, PROVIDER_CMC);
+  metrics.recordParse(PROVIDER_CMC, micros() - parseStart, doc.memoryUsage());
+  
   if (error) {
     Serial.printf("JSON parsing error: %s\n", error.c_str());
-    setError(("JSON parsing failed: " + String(error.c_str())).c_str());
+    setErrorf(FETCH_ERROR_RESPONSE, "JSON parsing failed: %s", error.c_str());
     return false;
   }
   
   // Check if response has the expected structure
   if (!doc.containsKey("data")) {
     Serial.println("Response missing 'data' key");
-    setError("API response missing 'data' section");
+    setError("API response missing 'data' section", FETCH_ERROR_RESPONSE);
     return false;
   }
   
   // Parse each cryptocurrency
   for (int i = 0; i < count; i++) {
-    const char* symbol = cryptos[i].symbol;
+    const char* symbol = cryptos[i]->symbol;
     Serial.printf("Parsing %s...\n", symbol);
     
-    // Check if symbol exists in data
-    if (!doc["data"].containsKey(symbol)) {
-      Serial.printf("Missing data for %s\n", symbol);
-      setError(("Missing data for " + String(symbol)).c_str());
-      return false;
+    // By id: data is keyed by id with one object each. By symbol: an array of
+    // every coin sharing the ticker, the first being the best match.
+    JsonObject coin;
+    if (byId) {
+      char key[12];
+      snprintf(key, sizeof(key), "%lu", (unsigned long)cryptos[i]->cmcId);
+      coin = doc["data"][key];
+    } else if (doc["data"][symbol].is<JsonArray>() && doc["data"][symbol].size() > 0) {
+      coin = doc["data"][symbol][0];
     }
-    
-    // Check if it's an array with at least one element
-    if (!doc["data"][symbol].is<JsonArray>() || doc["data"][symbol].size() == 0) {
-      Serial.printf("Invalid data structure for %s\n", symbol);
-      setError(("Invalid data structure for " + String(symbol)).c_str());
+    if (coin.isNull()) {
+      Serial.printf("Missing data for %s\n", symbol);
+      setErrorf(FETCH_ERROR_RESPONSE, "Missing data for %s", symbol);
       return false;
     }
     
-    // Check for price data
-    if (!doc["data"][symbol][0]["quote"]["CAD"]["price"].is<float>()) {
+    // Check for price data (quoted in API_CONVERT)
+    JsonObject quote = coin["quote"][API_CONVERT];
+    if (!quote["price"].is<float>()) {
       Serial.printf("Missing price data for %s\n", symbol);
-      setError(("Missing price data for " + String(symbol)).c_str());
+      setErrorf(FETCH_ERROR_RESPONSE, "Missing price data for %s", symbol);
       return false;
     }
     
-    // Extract the new price and update tracking
-    float newPrice = doc["data"][symbol][0]["quote"]["CAD"]["price"];
+    // Extract the new price in the display currency and update tracking
+    // No rate yet: this asset keeps its cached price, the others still update
+    float newPrice;
+    if (!toDisplayCurrency(*cryptos[i], quote["price"], newPrice)) {
+      cryptos[i]->fetchFailed = true;
+      continue;
+    }
     
     // Track price movement (only if not first update)
-    if (!cryptos[i].firstUpdate && newPrice != cryptos[i].price) {
-      cryptos[i].priceIncreased = (newPrice > cryptos[i].price);
-      cryptos[i].previousPrice = cryptos[i].price;
+    if (!cryptos[i]->firstUpdate && newPrice != cryptos[i]->price) {
+      cryptos[i]->priceIncreased = (newPrice > cryptos[i]->price);
+      cryptos[i]->previousPrice = cryptos[i]->price;
     }
     
-    // Update price and timestamp
-    cryptos[i].price = newPrice;
-    cryptos[i].lastUpdated = doc["data"][symbol][0]["quote"]["CAD"]["last_updated"];
-    cryptos[i].firstUpdate = false;
+    // Update price, change and timestamp (copied: the document is freed on return)
+    cryptos[i]->price = newPrice;
+    cryptos[i]->change1h = quote["percent_change_1h"] | 0.0f;
+    cryptos[i]->change24h = quote["percent_change_24h"] | 0.0f;
+    cryptos[i]->change7d = quote["percent_change_7d"] | 0.0f;
+    const char* lastUpdated = quote["last_updated"] | "";
+    strlcpy(cryptos[i]->lastUpdated, lastUpdated, sizeof(cryptos[i]->lastUpdated));
+    cryptos[i]->sourceTime = parseIso8601(lastUpdated);
+    cryptos[i]->fetchTime = time(nullptr);
+    cryptos[i]->firstUpdate = false;
+    cryptos[i]->fetchFailed = false;
     
-    Serial.printf("%s price: %.2f CAD\n", symbol, cryptos[i].price);
+    Serial.printf("%s price: %.2f %s\n", symbol, cryptos[i]->price, cryptos[i]->currency);
   }
   
   Serial.println("JSON parsing successful!");
   return true;
 }
 
-bool APIClient::fetchStockData(AssetData& stock) {
+bool APIClient::fetchStockData(AssetData* stocks[], int count) {
   if (!isWiFiConnected()) {
-    setError("WiFi not connected");
+    setError("WiFi not connected", FETCH_ERROR_NETWORK);
+    return false;
+  }
+  
+  // The single-quote endpoint takes one symbol; several go through batch-quote
+  char url[320];
+  bool built = (count == 1)
+    ? buildUrl(url, sizeof(url), FMP_BASE_URL "?symbol=", stocks, count, "&apikey=" FMP_API_KEY)
+    : buildUrl(url, sizeof(url), FMP_BATCH_URL "?symbols=", stocks, count, "&apikey=" FMP_API_KEY);
+  if (!built) {
     return false;
   }
   
+  unsigned long fetchStart = millis();
   client.setInsecure(); // Skip SSL certificate verification
-  http.begin(client, STOCK_ENDPOINT);
+  if (!openConnection(PROVIDER_FMP, url)) {
+    metrics.recordFetch(PROVIDER_FMP, millis() - fetchStart, false);
+    return false;
+  }
+  http.begin(client, url);
   http.setTimeout(15000); // 15 second timeout
   http.addHeader("Accept", "application/json");
+  HttpBodyStream::prepareRequest(http);
   
   Serial.println("Making API request to Financial Modeling Prep...");
-  Serial.println(STOCK_ENDPOINT);
+  Serial.println(url);
   
+  trace.begin(TRACE_HTTP_WAIT, PROVIDER_FMP);
   int httpCode = http.GET();
+  trace.end(TRACE_HTTP_WAIT, PROVIDER_FMP);
   Serial.printf("HTTP Response Code: %d\n", httpCode);
   
   if (httpCode == HTTP_CODE_OK) {
-    String payload = http.getString();
+    trace.begin(TRACE_BODY_READ, PROVIDER_FMP);
+    bool parsed = body.begin(http) && parseStockJsonResponse(body, stocks, count);
+    parsed = endBody(PROVIDER_FMP) && parsed;
+    trace.end(TRACE_BODY_READ, PROVIDER_FMP);
     http.end();
-    return parseStockJsonResponse(payload, stock);
+    metrics.recordFetch(PROVIDER_FMP, millis() - fetchStart, true);
+    return parsed;
   } else if (httpCode > 0) {
-    String errorPayload = http.getString();
+    ErrorBody errorPayload = readErrorBody();
     http.end();
+    metrics.recordFetch(PROVIDER_FMP, millis() - fetchStart, false);
     Serial.printf("HTTP Error Response: %s\n", errorPayload.c_str());
     
     if (httpCode == 401) {
-      setError("Stock API Key invalid or expired");
+      setError("Stock API Key invalid or expired", FETCH_ERROR_CLIENT);
     } else if (httpCode == 403) {
-      setError("Stock API access forbidden - check your plan");
+      setError("Stock API access forbidden - check your plan", FETCH_ERROR_CLIENT);
     } else if (httpCode == 429) {
-      setError("Stock API rate limit exceeded");
+      setError("Stock API rate limit exceeded", FETCH_ERROR_RATE_LIMIT);
     } else {
-      setError(("HTTP error " + String(httpCode) + ": " + errorPayload).c_str());
+      setErrorf(httpErrorKind(httpCode), "HTTP error %d: %s", httpCode, errorPayload.c_str());
     }
     return false;
   } else {
     http.end();
-    setError(("Stock API connection failed: " + String(httpCode)).c_str());
+    metrics.recordFetch(PROVIDER_FMP, millis() - fetchStart, false);
+    setErrorf(FETCH_ERROR_NETWORK, "Stock API connection failed: %d", httpCode);
     return false;
   }
 }
 
-bool APIClient::parseStockJsonResponse(const String& payload, AssetData& stock) {
-  Serial.println("=== Stock API Response Debug ===");
-  Serial.printf("Payload length: %d\n", payload.length());
-  Serial.println("First 200 characters of response:");
-  Serial.println(payload.substring(0, 200));
-  Serial.println("================================");
-  
-  DynamicJsonDocument doc(8192); // 8KB buffer sufficient for single stock response
+bool APIClient::parseStockJsonResponse(Stream& payload, AssetData* stocks[], int count) {
+  ArenaJsonDocument doc(JSON_USER_FMP_QUOTES, 8192 * count); // First guess: 8KB per quote object
+  unsigned long parseStart = micros();
+  trace.begin(TRACE_PARSE, PROVIDER_FMP);
   DeserializationError error = deserializeJson(doc, payload);
+  trace.end(TRACE_PARSE, PROVIDER_FMP);
+  metrics.recordParse(PROVIDER_FMP, micros() - parseStart, doc.memoryUsage());
   
   if (error) {
     Serial.printf("Stock JSON parsing error: %s\n", error.c_str());
-    setError(("Stock JSON parsing failed: " + String(error.c_str())).c_str());
+    setErrorf(FETCH_ERROR_RESPONSE, "Stock JSON parsing failed: %s", error.c_str());
     return false;
   }
   
-  // FMP stable API returns an array with one object for single stock quote
+  // FMP stable API returns an array with one object per requested symbol
   if (!doc.is<JsonArray>() || doc.size() == 0) {
     Serial.println("Stock response is not an array or is empty");
-    setError("Invalid stock API response structure");
+    setError("Invalid stock API response structure", FETCH_ERROR_RESPONSE);
     return false;
   }
   
-  JsonObject stockObj = doc[0];
-  
-  if (!stockObj.containsKey("price")) {
-    Serial.println("Missing 'price' field in stock response");
-    setError("Missing stock price data");
-    return false;
+  JsonArray quotes = doc.as<JsonArray>();
+  for (int i = 0; i < count; i++) {
+    AssetData& stock = *stocks[i];
+    
+    // Match quotes by symbol (order is not guaranteed for batches)
+    JsonObject stockObj;
+    for (JsonVariant quote : quotes) {
+      const char* symbol = quote["symbol"] | "";
+      if (strcmp(symbol, stock.symbol) == 0) {
+        stockObj = quote.as<JsonObject>();
+        break;
+      }
+    }
+    
+    if (stockObj.isNull() || !stockObj.containsKey("price")) {
+      Serial.printf("Missing price data for %s\n", stock.symbol);
+      setErrorf(FETCH_ERROR_RESPONSE, "Missing stock price data for %s", stock.symbol);
+      return false;
+    }
+    
+    updateStockQuote(stockObj, stock);
   }
   
-  // Extract new stock price and track movement
-  float newPrice = stockObj["price"];
+  Serial.println("Stock JSON parsing successful!");
+  return true;
+}
+
+void APIClient::updateStockQuote(JsonObject stockObj, AssetData& stock) {
+  // Extract new stock price (in the display currency) and track movement.
+  // No rate yet: the cached price stays.
+  float newPrice;
+  if (!toDisplayCurrency(stock, stockObj["price"], newPrice)) {
+    stock.fetchFailed = true;
+    return;
+  }
   
   // Track price movement (only if not first update)
   if (!stock.firstUpdate && newPrice != stock.price) {
@@ -283,32 +503,400 @@ bool APIClient::parseStockJsonResponse(const String& payload, AssetData& stock)
   }
   
   stock.price = newPrice;
+  stock.change24h = stockObj["changePercentage"] | 0.0f; // Since the previous close
   stock.firstUpdate = false;
+  stock.fetchFailed = false;
+  stock.fetchTime = time(nullptr);
   
   // Extract timestamp and format it like crypto (ISO 8601 format)
-  // NOTE: Static buffer avoids heap allocation and persists beyond function scope
-  static char timestampBuffer[32];
-  
   if (stockObj.containsKey("timestamp")) {
     // FMP provides Unix timestamp, convert to ISO 8601 format like crypto
     unsigned long timestamp = stockObj["timestamp"];
     
-    // Convert Unix timestamp to readable format
+    // Convert Unix timestamp to readable format (into the asset's own buffer)
     time_t rawtime = timestamp;
-    struct tm * timeinfo = gmtime(&rawtime);
-    strftime(timestampBuffer, sizeof(timestampBuffer), "%Y-%m-%dT%H:%M:%S.000Z", timeinfo);
-    stock.lastUpdated = timestampBuffer;
+    struct tm timeinfo;
+    gmtime_r(&rawtime, &timeinfo);
+    strftime(stock.lastUpdated, sizeof(stock.lastUpdated), "%Y-%m-%dT%H:%M:%S.000Z", &timeinfo);
+    stock.sourceTime = rawtime;
     
-    Serial.printf("Converted timestamp %lu to: %s\n", timestamp, timestampBuffer);
+    Serial.printf("Converted timestamp %lu to: %s\n", timestamp, stock.lastUpdated);
   } else {
-    // Fallback if no timestamp field
-    stock.lastUpdated = "Just now";
+    // Fallback if no timestamp field: the fetch time is the best we know
+    strlcpy(stock.lastUpdated, "Just now", sizeof(stock.lastUpdated));
+    stock.sourceTime = stock.fetchTime;
     Serial.println("No timestamp field found, using 'Just now'");
   }
   
-  Serial.printf("%s price extracted: %.2f USD\n", stock.symbol, stock.price);
-  Serial.println("Stock JSON parsing successful!");
+  Serial.printf("%s price extracted: %.2f %s\n", stock.symbol, stock.price, stock.currency);
+}
+
+bool APIClient::fetchFxRates(FxTable& table) {
+  if (!isWiFiConnected()) {
+    setError("WiFi not connected", FETCH_ERROR_NETWORK);
+    return false;
+  }
+  
+  unsigned long fetchStart = millis();
+  client.setInsecure(); // Skip SSL certificate verification
+  if (!openConnection(PROVIDER_FX, FX_RATES_URL)) {
+    metrics.recordFetch(PROVIDER_FX, millis() - fetchStart, false);
+    return false;
+  }
+  http.begin(client, FX_RATES_URL);
+  http.setTimeout(15000);
+  http.addHeader("Accept", "application/json");
+  HttpBodyStream::prepareRequest(http);
+  
+  trace.begin(TRACE_HTTP_WAIT, PROVIDER_FX);
+  int httpCode = http.GET();
+  trace.end(TRACE_HTTP_WAIT, PROVIDER_FX);
+  if (httpCode != HTTP_CODE_OK) {
+    http.end();
+    metrics.recordFetch(PROVIDER_FX, millis() - fetchStart, false);
+    setErrorf(httpErrorKind(httpCode), "FX rates HTTP error %d", httpCode);
+    return false;
+  }
+  
+  // The response lists ~160 currencies; keep only the ones in the table
+  StaticJsonDocument<256> filter;
+  filter["result"] = true;
+  filter["time_last_update_unix"] = true;
+  for (int i = 0; i < table.currencyCount(); i++) {
+    filter["rates"][table.currency(i)] = true;
+  }
+  
+  ArenaJsonDocument doc(JSON_USER_FX_RATES, 512);
+  DeserializationError error = DeserializationError::IncompleteInput;
+  trace.begin(TRACE_BODY_READ, PROVIDER_FX);
+  if (body.begin(http)) {
+    unsigned long parseStart = micros();
+    trace.begin(TRACE_PARSE, PROVIDER_FX);
+    error = deserializeJson(doc, body, DeserializationOption::Filter(filter));
+    trace.end(TRACE_PARSE, PROVIDER_FX);
+    metrics.recordParse(PROVIDER_FX, micros() - parseStart, doc.memoryUsage());
+  }
+  bool complete = endBody(PROVIDER_FX);
+  trace.end(TRACE_BODY_READ, PROVIDER_FX);
+  http.end();
+  metrics.recordFetch(PROVIDER_FX, millis() - fetchStart, true);
   
+  if (!complete) {
+    return false;
+  }
+  if (error) {
+    setErrorf(FETCH_ERROR_RESPONSE, "FX JSON parsing failed: %s", error.c_str());
+    return false;
+  }
+  const char* result = doc["result"] | "";
+  if (strcmp(result, "success") != 0) {
+    setError("FX rates request unsuccessful", FETCH_ERROR_RESPONSE);
+    return false;
+  }
+  
+  for (int i = 0; i < table.currencyCount(); i++) {
+    const char* code = table.currency(i);
+    float perUsd = doc["rates"][code] | 0.0f;
+    if (perUsd <= 0.0f) {
+      setErrorf(FETCH_ERROR_RESPONSE, "No FX rate for %s", code);
+      return false;
+    }
+    table.setRate(code, perUsd);
+    Serial.printf("FX: 1 USD = %.4f %s\n", perUsd, code);
+  }
+  table.markUpdated(doc["time_last_update_unix"] | (long)time(nullptr));
+  return true;
+}
+
+// Missing ids are retried at most every CMC_ID_RETRY_MS; resolved ones are
+// looked up again once CMC_ID_REFRESH_SEC has passed
+bool APIClient::idsNeedResolving(AssetData* cryptos[], int count) {
+  if (lastIdAttempt != 0 && millis() - lastIdAttempt < CMC_ID_RETRY_MS) {
+    return false;
+  }
+  for (int i = 0; i < count; i++) {
+    if (cryptos[i]->cmcId == 0) {
+      return true;
+    }
+  }
+  time_t now = time(nullptr);
+  return isClockSynced(now) && now - (time_t)idsResolvedAt > CMC_ID_REFRESH_SEC;
+}
+
+bool APIClient::resolveCryptoIds(AssetData* cryptos[], int count) {
+  lastIdAttempt = millis();
+  if (lastIdAttempt == 0) {
+    lastIdAttempt = 1;
+  }
+  
+  Preferences prefs;
+  if (!prefs.begin("cmc_ids", false)) {
+    Serial.println("NVS unavailable for CoinMarketCap ids, using symbol lookups");
+    return true;
+  }
+  time_t now = time(nullptr);
+  bool synced = isClockSynced(now);
+  
+  // Cached ids first; each symbol carries its own lookup stamp ("<SYM>_t"),
+  // so only the missing and expired ones go to the map endpoint
+  AssetData* lookup[MAX_ASSETS];
+  int lookupCount = 0;
+  uint32_t oldest = UINT32_MAX;
+  for (int i = 0; i < count && lookupCount < MAX_ASSETS; i++) {
+    char stampKey[16];
+    snprintf(stampKey, sizeof(stampKey), "%s_t", cryptos[i]->symbol);
+    cryptos[i]->cmcId = prefs.getUInt(cryptos[i]->symbol, 0);
+    uint32_t stamp = prefs.getUInt(stampKey, 0);
+    if (cryptos[i]->cmcId == 0 || (synced && now - (time_t)stamp > CMC_ID_REFRESH_SEC)) {
+      lookup[lookupCount++] = cryptos[i];
+    } else if (stamp < oldest) {
+      oldest = stamp;
+    }
+  }
+  if (lookupCount == 0) {
+    idsResolvedAt = oldest;
+    prefs.end();
+    return true;
+  }
+  
+  char url[320];
+  if (!buildUrl(url, sizeof(url), CMC_MAP_URL "?CMC_PRO_API_KEY=" CMC_API_KEY "&symbol=",
+                lookup, lookupCount, "")) {
+    prefs.end();
+    return false;
+  }
+  
+  unsigned long fetchStart = millis();
+  client.setInsecure(); // Skip SSL certificate verification
+  if (!openConnection(PROVIDER_CMC, url)) {
+    metrics.recordFetch(PROVIDER_CMC, millis() - fetchStart, false);
+    prefs.end();
+    return false;
+  }
+  http.begin(client, url);
+  http.setTimeout(15000);
+  http.addHeader("Accept", "application/json");
+  HttpBodyStream::prepareRequest(http);
+  Serial.println("Resolving CoinMarketCap ids...");
+  
+  int httpCode = http.GET();
+  if (httpCode != HTTP_CODE_OK) {
+    http.end();
+    metrics.recordFetch(PROVIDER_CMC, millis() - fetchStart, false);
+    setErrorf(httpErrorKind(httpCode), "Id lookup HTTP error %d", httpCode);
+    prefs.end();
+    return false;
+  }
+  
+  // Every coin sharing a ticker comes back; keep just what picks the right one
+  StaticJsonDocument<128> filter;
+  filter["data"][0]["id"] = true;
+  filter["data"][0]["symbol"] = true;
+  filter["data"][0]["rank"] = true;
+  ArenaJsonDocument doc(JSON_USER_CMC_MAP, 4096);
+  DeserializationError error = DeserializationError::IncompleteInput;
+  if (body.begin(http)) {
+    error = deserializeJson(doc, body, DeserializationOption::Filter(filter));
+  }
+  bool complete = endBody(PROVIDER_CMC);
+  http.end();
+  metrics.recordFetch(PROVIDER_CMC, millis() - fetchStart, true);
+  if (!complete) {
+    prefs.end();
+    return false;
+  }
+  if (error) {
+    setErrorf(FETCH_ERROR_RESPONSE, "Id lookup JSON parsing failed: %s", error.c_str());
+    prefs.end();
+    return false;
+  }
+  
+  // The best-ranked coin wins (rank 0 means unranked)
+  for (int i = 0; i < lookupCount; i++) {
+    uint32_t bestId = 0;
+    uint32_t bestRank = UINT32_MAX;
+    for (JsonVariant coin : doc["data"].as<JsonArray>()) {
+      const char* symbol = coin["symbol"] | "";
+      uint32_t rank = coin["rank"] | 0;
+      if (strcmp(symbol, lookup[i]->symbol) != 0) {
+        continue;
+      }
+      if (rank == 0) {
+        rank = UINT32_MAX - 1;
+      }
+      if (rank < bestRank) {
+        bestRank = rank;
+        bestId = coin["id"] | 0;
+      }
+    }
+    if (bestId != 0) {
+      lookup[i]->cmcId = bestId;
+      prefs.putUInt(lookup[i]->symbol, bestId);
+      if (synced) {
+        char stampKey[16];
+        snprintf(stampKey, sizeof(stampKey), "%s_t", lookup[i]->symbol);
+        prefs.putUInt(stampKey, (uint32_t)now);
+        oldest = (uint32_t)now < oldest ? (uint32_t)now : oldest;
+      } else {
+        oldest = 0; // Stamped on a lookup once the clock is set
+      }
+      Serial.printf("CoinMarketCap id for %s: %lu\n", lookup[i]->symbol, (unsigned long)bestId);
+    } else if (lookup[i]->cmcId == 0) {
+      Serial.printf("No CoinMarketCap id for %s, using symbol lookups\n", lookup[i]->symbol);
+    }
+  }
+  
+  idsResolvedAt = oldest;
+  prefs.end();
+  return true;
+}
+
+// Finish the response body: drains what the parser left (keeping the
+// connection reusable), verifies gzip and records the sizes
+bool APIClient::endBody(Provider provider) {
+  bool complete = body.end();
+  metrics.recordResponseBytes(provider, body.wireBytes(), body.decodedBytes());
+  if (body.isCompressed()) {
+    metrics.recordInflate(provider, body.inflateMicros(), body.bufferBytes());
+    Serial.printf("Body: %u bytes gzip -> %u bytes, inflate %lu us\n", (unsigned)body.wireBytes(),
+                  (unsigned)body.decodedBytes(), (unsigned long)body.inflateMicros());
+  } else {
+    Serial.printf("Body: %u bytes\n", (unsigned)body.wireBytes());
+  }
+  if (!complete) {
+    setErrorf(FETCH_ERROR_NETWORK, "Response body: %s", body.getError());
+  }
+  return complete;
+}
+
+// Start of an error response for the log (error bodies may be gzipped too)
+ErrorBody APIClient::readErrorBody() {
+  char text[ErrorBody::capacity() + 1];
+  size_t length = body.begin(http) ? body.readBytes(text, sizeof(text) - 1) : 0;
+  body.end();
+  ErrorBody result;
+  result.append(text, length);
+  return result;
+}
+
+// Build "<prefix>SYM1,SYM2,...<suffix>" into url
+bool APIClient::buildUrl(char* url, size_t size, const char* prefix, AssetData* assets[], int count,
+                         const char* suffix) {
+  size_t length = strlcpy(url, prefix, size);
+  for (int i = 0; i < count && length < size; i++) {
+    if (i > 0) {
+      length = strlcat(url, ",", size);
+    }
+    length = strlcat(url, assets[i]->symbol, size);
+  }
+  if (length < size) {
+    length = strlcat(url, suffix, size);
+  }
+  if (length >= size) {
+    setError("Request URL too long", FETCH_ERROR_CLIENT);
+    return false;
+  }
+  return true;
+}
+
+// Extract the host (and port) from "https://host[:port]/path?query"
+bool APIClient::parseHost(const char* url, char* host, size_t size, uint16_t& port) {
+  const char* hostStart = strstr(url, "://");
+  hostStart = hostStart ? hostStart + 3 : url;
+  size_t hostLength = strcspn(hostStart, ":/?");
+  if (hostLength == 0 || hostLength >= size) {
+    return false;
+  }
+  memcpy(host, hostStart, hostLength);
+  host[hostLength] = '\0';
+  port = (hostStart[hostLength] == ':') ? atoi(hostStart + hostLength + 1) : 443;
+  return true;
+}
+
+APIClient::DnsEntry* APIClient::findDnsEntry(const char* host) {
+  for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+    if (strcmp(dnsCache[i].host, host) == 0) {
+      return &dnsCache[i];
+    }
+  }
+  return nullptr;
+}
+
+bool APIClient::resolveHost(Provider provider, const char* host, IPAddress& address) {
+  DnsEntry* entry = findDnsEntry(host);
+  if (entry != nullptr && millis() - entry->resolvedAt < DNS_CACHE_TTL_MS) {
+    address = entry->address;
+    return true;
+  }
+  
+  unsigned long start = millis();
+  trace.begin(TRACE_DNS, provider);
+  bool resolved = WiFi.hostByName(host, address);
+  trace.end(TRACE_DNS, provider);
+  if (!resolved) {
+    setErrorf(FETCH_ERROR_NETWORK, "DNS lookup failed: %s", host);
+    return false;
+  }
+  uint32_t elapsed = millis() - start;
+  metrics.recordDns(provider, elapsed);
+  smoothEstimate(dnsEstimateMs[provider], elapsed);
+  
+  if (entry == nullptr) {
+    // Take a free slot, else replace the stalest entry
+    entry = &dnsCache[0];
+    for (int i = 1; i < DNS_CACHE_SIZE && entry->host[0] != '\0'; i++) {
+      if (dnsCache[i].host[0] == '\0' || (long)(dnsCache[i].resolvedAt - entry->resolvedAt) < 0) {
+        entry = &dnsCache[i];
+      }
+    }
+    strlcpy(entry->host, host, sizeof(entry->host));
+  }
+  entry->address = address;
+  entry->resolvedAt = millis();
+  return true;
+}
+
+bool APIClient::openConnection(Provider provider, const char* url) {
+  char host[sizeof(connectedHost)];
+  uint16_t port;
+  if (!parseHost(url, host, sizeof(host), port)) {
+    setError("Invalid API URL", FETCH_ERROR_CLIENT);
+    return false;
+  }
+  
+  // A kept-alive connection to the same host is reused as is
+  if (client.connected() && strcmp(connectedHost, host) == 0 && connectedPort == port) {
+    return true;
+  }
+  client.stop();
+  connectedHost[0] = '\0';
+  
+  // DNS and TLS are done explicitly (instead of inside http.GET) so each
+  // phase can be timed; HTTPClient then reuses the open connection
+  IPAddress address;
+  if (!resolveHost(provider, host, address)) {
+    return false;
+  }
+  
+  unsigned long start = millis();
+  trace.begin(TRACE_TLS, provider);
+  bool connected = client.connect(address, port, host, nullptr, nullptr, nullptr);
+  trace.end(TRACE_TLS, provider);
+  if (!connected) {
+    // The cached address may have moved: look it up again next time
+    DnsEntry* entry = findDnsEntry(host);
+    if (entry != nullptr) {
+      entry->host[0] = '\0';
+    }
+    setErrorf(FETCH_ERROR_NETWORK, "Connection failed: %s", host);
+    return false;
+  }
+  uint32_t elapsed = millis() - start;
+  metrics.recordTlsHandshake(provider, elapsed);
+  smoothEstimate(tlsEstimateMs[provider], elapsed);
+  
+  strlcpy(connectedHost, host, sizeof(connectedHost));
+  connectedPort = port;
   return true;
 }
 
@@ -335,7 +923,35 @@ void APIClient::scanNetworks() {
   WiFi.scanDelete();
 }
 
-void APIClient::setError(const char* error) {
-  lastError = String(error);
-  Serial.printf("API Error: %s\n", error);
+FetchError APIClient::getLastErrorKind() {
+  return lastErrorKind;
+}
+
+FetchError APIClient::httpErrorKind(int httpCode) {
+  if (httpCode <= 0) {
+    return FETCH_ERROR_NETWORK; // HTTPClient's connection/timeout codes
+  }
+  if (httpCode == 401 || httpCode == 403) {
+    return FETCH_ERROR_CLIENT;
+  }
+  if (httpCode == 429) {
+    return FETCH_ERROR_RATE_LIMIT;
+  }
+  return httpCode >= 500 ? FETCH_ERROR_SERVER : FETCH_ERROR_RESPONSE;
+}
+
+void APIClient::setError(const char* error, FetchError kind) {
+  lastError = error;
+  lastErrorKind = kind;
+  Serial.printf("API Error: %s\n", lastError.c_str());
+}
+
+void APIClient::setErrorf(FetchError kind, const char* format, ...) {
+  lastError.clear();
+  va_list args;
+  va_start(args, format);
+  lastError.appendv(format, args);
+  va_end(args);
+  lastErrorKind = kind;
+  Serial.printf("API Error: %s\n", lastError.c_str());
 }
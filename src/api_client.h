@@ -6,6 +6,13 @@
 #include <WiFiClientSecure.h>
 #include <ArduinoJson.h>
 #include "crypto_display.h"
+#include "providers.h"
+#include "fx_table.h"
+#include "http_body.h"
+#include "fixed_string.h"
+
+// Start of an error response body, kept for the error message
+typedef FixedString<201> ErrorBody;
 
 class APIClient {
 public:
@@ -17,27 +24,85 @@ public:
   // Check if WiFi is connected
   bool isWiFiConnected();
   
-  // Fetch cryptocurrency data from API
-  bool fetchCryptoData(CryptoData cryptos[], int count);
+  // Bring up WiFi, DNS and TLS for the provider's next request ahead of time
+  bool prewarm(Provider provider);
+  
+  // How long before a deadline prewarm() should start: the estimated time of
+  // the phases still missing (WiFi, DNS, TLS) plus PREWARM_MARGIN_MS
+  uint32_t prewarmLeadMs(Provider provider);
+  
+  // Fetch cryptocurrency data from API (one request for all given assets).
+  // Goes by CoinMarketCap id once resolved, by symbol until then.
+  bool fetchCryptoData(AssetData* cryptos[], int count);
+  
+  // Fill in cmcId from the NVS cache, asking the map endpoint for missing or
+  // expired entries (every CMC_ID_REFRESH_SEC). False (with the error set)
+  // only when the lookup request failed; unknown symbols stay on symbol lookups.
+  bool resolveCryptoIds(AssetData* cryptos[], int count);
+  
+  // Fetch stock data from Financial Modeling Prep API (one request for all given assets)
+  bool fetchStockData(AssetData* stocks[], int count);
   
-  // Fetch stock data from Financial Modeling Prep API
-  bool fetchStockData(AssetData& stock);
+  // Fetch exchange rates for every currency in the table (one request)
+  bool fetchFxRates(FxTable& table);
+  
+  // Convert quotes into each asset's display currency (optional when they match)
+  void setFxTable(const FxTable* table);
+  
+  // Currency a provider quotes this asset in (crypto: API_CONVERT, stocks: listing currency)
+  static const char* quoteCurrency(const AssetData& asset);
   
   // Get last error message
   const char* getLastError();
   
+  // Class of the last error (for retry decisions)
+  FetchError getLastErrorKind();
+  
   // Scan for available WiFi networks (diagnostic)
   void scanNetworks();
   
 private:
-  String lastError;
+  FixedString<API_ERROR_LEN> lastError;
+  FetchError lastErrorKind;
   WiFiClientSecure client;
   HTTPClient http;
+  HttpBodyStream body;    // Response body, inflated when gzip
+  char connectedHost[64]; // Host the TLS client is currently connected to
+  uint16_t connectedPort;
+  
+  // Resolved addresses, reused for DNS_CACHE_TTL_MS
+  struct DnsEntry {
+    char host[64];
+    IPAddress address;
+    unsigned long resolvedAt;
+  };
+  DnsEntry dnsCache[DNS_CACHE_SIZE];
+  
+  // Moving estimates of each connection phase (0 = not measured yet)
+  uint32_t wifiEstimateMs;
+  uint32_t dnsEstimateMs[PROVIDER_COUNT];
+  uint32_t tlsEstimateMs[PROVIDER_COUNT];
+  const FxTable* fxTable;
+  uint32_t idsResolvedAt;         // Epoch seconds of the oldest per-symbol id lookup (from NVS)
+  unsigned long lastIdAttempt;    // millis() of the last lookup attempt (0 = none)
   
   // Helper functions
-  bool parseJsonResponse(const String& payload, CryptoData cryptos[], int count);
-  bool parseStockJsonResponse(const String& payload, AssetData& stock);
-  void setError(const char* error);
+  bool openConnection(Provider provider, const char* url);
+  static bool parseHost(const char* url, char* host, size_t size, uint16_t& port);
+  static const char* providerUrl(Provider provider);
+  bool resolveHost(Provider provider, const char* host, IPAddress& address);
+  DnsEntry* findDnsEntry(const char* host);
+  bool buildUrl(char* url, size_t size, const char* prefix, AssetData* assets[], int count, const char* suffix);
+  bool endBody(Provider provider);
+  ErrorBody readErrorBody();
+  bool parseJsonResponse(Stream& payload, AssetData* cryptos[], int count, bool byId);
+  bool idsNeedResolving(AssetData* cryptos[], int count);
+  bool parseStockJsonResponse(Stream& payload, AssetData* stocks[], int count);
+  void updateStockQuote(JsonObject quote, AssetData& stock);
+  bool toDisplayCurrency(const AssetData& asset, float quoted, float& out);
+  static FetchError httpErrorKind(int httpCode);
+  void setError(const char* error, FetchError kind);
+  void setErrorf(FetchError kind, const char* format, ...) __attribute__((format(printf, 3, 4)));
 };
 
 #endif // API_CLIENT_H
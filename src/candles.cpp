@@ -0,0 +1,129 @@
+#include "candles.h"
+#include "time_utils.h"
+#include "mem_alloc.h"
+
+static const uint32_t INTERVAL_SECONDS[CANDLE_INTERVAL_COUNT] = {60, 300, 3600, 86400};
+static const char* const INTERVAL_NAMES[CANDLE_INTERVAL_COUNT] = {"1m", "5m", "1h", "1d"};
+
+CandleAggregator::CandleAggregator() {
+  series = nullptr;
+  lock = nullptr;
+}
+
+void CandleAggregator::begin() {
+  if (series == nullptr) {
+    series = (Series(*)[CANDLE_INTERVAL_COUNT])memCalloc(CANDLE_MAX_ASSETS, sizeof(*series), MEM_BULK);
+    if (series == nullptr) {
+      Serial.println("Candles: no memory for history, candles disabled");
+      return;
+    }
+  }
+  if (lock == nullptr) {
+    lock = xSemaphoreCreateMutex();
+  }
+}
+
+uint32_t CandleAggregator::intervalSeconds(CandleInterval interval) {
+  return INTERVAL_SECONDS[interval];
+}
+
+const char* CandleAggregator::intervalName(CandleInterval interval) {
+  return INTERVAL_NAMES[interval];
+}
+
+void CandleAggregator::addSample(uint8_t asset, float price, time_t at) {
+  if (asset >= CANDLE_MAX_ASSETS || price <= 0.0f || lock == nullptr || !isClockSynced(at)) {
+    return;
+  }
+
+  xSemaphoreTake(lock, portMAX_DELAY);
+  for (int i = 0; i < CANDLE_INTERVAL_COUNT; i++) {
+    Series& s = series[asset][i];
+    time_t bucket = at - at % INTERVAL_SECONDS[i];
+
+    if (s.current.start != 0 && bucket < s.current.start) {
+      continue; // Clock stepped back: keep the newer candle intact
+    }
+    if (bucket != s.current.start) {
+      if (s.current.start != 0) {
+        s.history[s.head] = s.current;
+        s.head = (s.head + 1) % CANDLE_HISTORY;
+        if (s.count < CANDLE_HISTORY) {
+          s.count++;
+        }
+        s.closedPending = true;
+      }
+      s.current.start = bucket;
+      s.current.open = price;
+      s.current.high = price;
+      s.current.low = price;
+      s.current.samples = 0;
+    }
+
+    if (price > s.current.high) s.current.high = price;
+    if (price < s.current.low) s.current.low = price;
+    s.current.close = price;
+    if (s.current.samples < UINT16_MAX) {
+      s.current.samples++;
+    }
+  }
+  xSemaphoreGive(lock);
+}
+
+bool CandleAggregator::takeClosed(uint8_t& asset, CandleInterval& interval, Candle& candle) {
+  if (lock == nullptr) {
+    return false;
+  }
+
+  bool found = false;
+  xSemaphoreTake(lock, portMAX_DELAY);
+  for (int a = 0; a < CANDLE_MAX_ASSETS && !found; a++) {
+    for (int i = 0; i < CANDLE_INTERVAL_COUNT; i++) {
+      Series& s = series[a][i];
+      if (s.closedPending) {
+        s.closedPending = false;
+        asset = a;
+        interval = (CandleInterval)i;
+        candle = s.history[(s.head + CANDLE_HISTORY - 1) % CANDLE_HISTORY];
+        found = true;
+        break;
+      }
+    }
+  }
+  xSemaphoreGive(lock);
+  return found;
+}
+
+int CandleAggregator::historyCount(uint8_t asset, CandleInterval interval) const {
+  if (asset >= CANDLE_MAX_ASSETS || lock == nullptr) {
+    return 0;
+  }
+  return series[asset][interval].count;
+}
+
+Candle CandleAggregator::closedCandle(uint8_t asset, CandleInterval interval, int age) const {
+  Candle candle = {};
+  if (asset >= CANDLE_MAX_ASSETS || lock == nullptr) {
+    return candle;
+  }
+
+  xSemaphoreTake(lock, portMAX_DELAY);
+  const Series& s = series[asset][interval];
+  if (age >= 0 && age < s.count) {
+    candle = s.history[(s.head + CANDLE_HISTORY - 1 - age) % CANDLE_HISTORY];
+  }
+  xSemaphoreGive(lock);
+  return candle;
+}
+
+Candle CandleAggregator::currentCandle(uint8_t asset, CandleInterval interval) const {
+  Candle candle = {};
+  if (asset >= CANDLE_MAX_ASSETS || lock == nullptr) {
+    return candle;
+  }
+
+  xSemaphoreTake(lock, portMAX_DELAY);
+  candle = series[asset][interval].current;
+  xSemaphoreGive(lock);
+  return candle;
+}
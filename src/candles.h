@@ -0,0 +1,68 @@
+#ifndef CANDLES_H
+#define CANDLES_H
+
+#include <Arduino.h>
+#include <time.h>
+#include "config.h"
+
+enum CandleInterval : uint8_t {
+  CANDLE_1M,
+  CANDLE_5M,
+  CANDLE_1H,
+  CANDLE_1D,
+  CANDLE_INTERVAL_COUNT
+};
+
+// One open/high/low/close bar
+struct Candle {
+  time_t start;      // UTC start of the bucket (0 = empty)
+  float open;
+  float high;
+  float low;
+  float close;
+  uint16_t samples;  // Prices folded in (saturates)
+};
+
+// Rolling OHLC candles per asset at 1m, 5m, 1h and 1d, aligned to UTC bucket
+// boundaries. Each interval keeps the candle being built plus the last
+// CANDLE_HISTORY closed ones in a ring. addSample() is O(1) and never
+// allocates, so the stream task can feed it every tick; the main loop drains
+// newly closed candles with takeClosed() for publishing.
+class CandleAggregator {
+public:
+  CandleAggregator();
+
+  // Allocate the history (PSRAM when present) and create the lock; call once
+  // before any sample. Without it every call is a no-op.
+  void begin();
+
+  // Fold one price observed at wall-clock time `at` into every interval
+  void addSample(uint8_t asset, float price, time_t at);
+
+  // Pop one candle closed since the last call; false when none is waiting
+  bool takeClosed(uint8_t& asset, CandleInterval& interval, Candle& candle);
+
+  // Closed candles, newest first (age 0 = most recently closed)
+  int historyCount(uint8_t asset, CandleInterval interval) const;
+  Candle closedCandle(uint8_t asset, CandleInterval interval, int age) const;
+
+  // Candle still being built (start == 0 before the first sample)
+  Candle currentCandle(uint8_t asset, CandleInterval interval) const;
+
+  static uint32_t intervalSeconds(CandleInterval interval);
+  static const char* intervalName(CandleInterval interval); // "1m", "5m", "1h", "1d"
+
+private:
+  struct Series {
+    Candle current;
+    Candle history[CANDLE_HISTORY];
+    uint8_t head;     // Next history slot to write
+    uint8_t count;
+    bool closedPending; // Newest closed candle not taken yet
+  };
+
+  Series (*series)[CANDLE_INTERVAL_COUNT]; // [CANDLE_MAX_ASSETS], allocated by begin()
+  SemaphoreHandle_t lock;
+};
+
+#endif // CANDLES_H
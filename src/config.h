@@ -7,9 +7,125 @@
 #define CENTER_X (SCREEN_WIDTH / 2)
 
 // Timing configuration
-#define API_UPDATE_INTERVAL 300000  // 5 minutes in milliseconds
+#define REFRESH_CRYPTO_MS 60000     // 1 minute between crypto refreshes (trades 24/7)
+#define REFRESH_STOCK_MS 300000     // 5 minutes between stock refreshes during a session
+#define REFRESH_SLOW_MS 1800000     // 30 minutes for illiquid assets
 #define DISPLAY_DURATION 10000      // 10 seconds per crypto display
 #define WIFI_CONNECT_TIMEOUT 20000  // 20 seconds WiFi timeout
+#define WIFI_BOOT_RESTART_MS 10000  // Restart this long after WiFi fails at boot
+#define STALE_THRESHOLD_SEC 900     // 15 minutes before a price is shown as stale
+#define STALENESS_PUBLISH_INTERVAL 60000 // 1 minute between MQTT staleness updates
+
+// HTTP response bodies (API requests; icons have their own settings below)
+#define HTTP_ACCEPT_GZIP true         // Ask providers for gzip and inflate while parsing
+#define HTTP_BODY_INPUT_SIZE 512      // Bytes read from the socket at a time
+#define HTTP_BODY_TIMEOUT_MS 15000    // Longest wait for the next body bytes
+
+// Connection prewarming: WiFi, DNS and TLS are brought up just ahead of each
+// fetch deadline, by a moving estimate of how long each phase takes
+#define PREWARM_MARGIN_MS 500         // Slack added to the estimated lead time
+#define PREWARM_DEFAULT_LEAD_MS 3000  // Per phase, until it has been measured
+#define DNS_CACHE_SIZE 4
+#define DNS_CACHE_TTL_MS 60000        // Arduino's resolver hides record TTLs; stay below typical CDN TTLs
+
+// Retries and per-provider circuit breakers
+#define RETRY_BASE_MS 5000            // First retry after a network/server/response error
+#define RETRY_MAX_MS 300000           // Backoff cap (delays double per consecutive failure)
+#define RETRY_RATE_LIMIT_MS 60000     // Least wait after HTTP 429
+#define BREAKER_FAILURE_THRESHOLD 5   // Consecutive failures that open the breaker
+#define BREAKER_OPEN_MS 300000        // First open period; doubles after each failed probe
+#define BREAKER_MAX_OPEN_MS 3600000
+
+// CoinMarketCap symbol-to-id resolution (cached in NVS)
+#define CMC_ID_REFRESH_SEC 2592000    // 30 days before ids are looked up again
+#define CMC_ID_RETRY_MS 3600000       // 1 hour between attempts while an id is missing
+
+// Exchange rates (display currencies derived from each provider's quote currency)
+#define FX_MAX_CURRENCIES 6
+#define FX_REFRESH_MS 3600000         // 1 hour between rate refreshes
+#define FX_RETRY_MS 300000            // Longest retry delay after a failed refresh (breaker aside)
+
+// Size of the assets[] table in main.cpp (checked at compile time); every
+// per-asset table below is sized from it
+#define MAX_ASSETS 16
+
+// Refresh scheduler (per-asset cadences come from the assets[] table in main.cpp)
+#define SCHEDULER_MAX_ASSETS MAX_ASSETS
+#define SCHEDULER_BATCH_WINDOW_MS 2000 // Assets due this close together share one request
+
+// Streaming price feed (WebSocket ticker; the URL lives in secrets.h as STREAM_URL)
+#define STREAM_APPLY_INTERVAL_MS 250  // Ticks are folded into the display at most this often
+#define STREAM_MAX_SYMBOLS MAX_ASSETS
+#define STREAM_FRAME_BUFFER 2048      // Largest text message kept; bigger ones are dropped
+#define STREAM_IDLE_TIMEOUT_MS 15000  // Reconnect when nothing arrives for this long
+#define STREAM_BACKOFF_MIN_MS 1000
+#define STREAM_BACKOFF_MAX_MS 60000
+
+// OHLC candles (1m/5m/1h/1d per asset, published to MQTT as each one closes)
+#define CANDLE_MAX_ASSETS MAX_ASSETS
+#define CANDLE_HISTORY 12             // Closed candles kept per asset and interval
+
+// Market statistics (change windows, EMAs, volatility)
+#define STATS_MAX_ASSETS MAX_ASSETS
+#define STATS_HISTORY 64              // Ring samples per asset (one per STATS_SAMPLE_SEC at most)
+#define STATS_SAMPLE_SEC 60
+#define STATS_WINDOWS_SEC {300, 900, 3600} // Percent-change windows (must fit in the ring)
+#define STATS_WINDOW_COUNT 3
+#define STATS_EMA_FAST_SEC 300.0f     // EMA time constants
+#define STATS_EMA_SLOW_SEC 3600.0f
+
+// Fleet mode (FLEET_ROLE in secrets.h)
+#define FLEET_ELECTION_WAIT_MS 5000       // Listen for a live gateway before claiming the role
+#define FLEET_ELECTION_JITTER_MS 3000     // Random extra wait so candidates don't claim together
+#define FLEET_SNAPSHOT_MIN_INTERVAL_MS 1000 // Gateway publishes each asset at most this often
+#define FLEET_FANOUT_MAX_MS 60000         // Older snapshots are retained replays, not latency
+
+// Market calendar (session times are exchange-local; all supported exchanges are Eastern)
+#define MARKET_TZ "EST5EDT,M3.2.0,M11.1.0" // POSIX TZ rule for America/New_York and Toronto
+#define MARKET_POST_CLOSE_DELAY_SEC 300     // Final stock fetch 5 minutes after the close
+
+// Metrics endpoint (Prometheus text format at http://<device-ip>:METRICS_PORT/metrics)
+#define METRICS_PORT 9100
+
+// Heap placement (mem_alloc.h)
+#define MEM_SAMPLE_MS 1000            // Largest-free-block low-water sampling period
+
+// Shared JSON arena (json_arena.h)
+#define JSON_ARENA_HEADROOM_PCT 25    // Capacity above each document's measured peak
+#define JSON_ARENA_ROUND_BYTES 256    // Needs are rounded up to this
+#define MQTT_PAYLOAD_MAX 896          // Serialized payload buffer; fits PubSubClient's 1024 with the topic
+
+// Price history on SPIFFS (price_history.h); 12 bytes per point. The defaults
+// keep ~2 days of raw points, ~25 days of 15 minute closes and ~1 year of
+// 4 hour closes for 5 assets in about 480 KB
+#define HISTORY_MAX_ASSETS 16         // Symbols the store can tell apart (ids are never reused; >= MAX_ASSETS)
+#define HISTORY_SAMPLE_SEC 60         // Least spacing of raw points per asset
+#define HISTORY_FLUSH_MS 300000       // Buffered points are written this often (fewer flash writes)
+#define HISTORY_BUFFER_RECORDS 64     // Points buffered in RAM before an early flush
+#define HISTORY_SEGMENT_RECORDS 1024  // Records per segment file (12 KB)
+#define HISTORY_RAW_SEGMENTS 16       // Closed raw segments kept before compaction
+#define HISTORY_ROLLUP_1_SEC 900      // First rollup bucket (15 minutes)
+#define HISTORY_ROLLUP_1_SEGMENTS 12
+#define HISTORY_ROLLUP_2_SEC 14400    // Second rollup bucket (4 hours)
+#define HISTORY_ROLLUP_2_SEGMENTS 12  // The oldest of these is dropped
+
+// Price alerts (alert_engine.h); 12 bytes per rule
+#define ALERT_MAX_RULES 512           // Rules held in RAM (PSRAM when present)
+#define ALERT_RULES_PATH "/alerts.txt" // Rules on SPIFFS, one per line
+#define ALERT_COOLDOWN_SEC 300        // A rule that fired stays quiet this long
+#define ALERT_QUEUE_SIZE 8            // Fired alerts waiting for loop()
+#define ALERT_TOAST_MS 5000
+#define ALERT_TONE_HZ 2000            // Buzzer
+#define ALERT_TONE_MS 200             // 0 = silent
+#define ALERT_FLASHES 3               // Screen inversions per alert
+#define ALERT_FLASH_MS 150
+
+// Inline string capacities (fixed_string.h), terminator included
+#define API_ERROR_LEN 256             // APIClient::getLastError()
+#define MQTT_TOPIC_LEN 96             // Topics built by MQTTClient and FleetSync
+
+// Phase trace ring buffer (8 bytes per event)
+#define TRACE_BUFFER_EVENTS 512
 
 // Display layout
 #define ICON_SIZE 24
@@ -17,8 +133,31 @@
 #define ICON_Y_POS 12
 #define TEXT_Y_POS 8
 #define PRICE_Y_POS 43
+#define CHANGE_Y_POS 65              // 24h change line under the price
 #define UPDATE_LABEL_Y_POS 83
 #define UPDATE_TIME_Y_POS 103
+#define TOAST_Y_POS 80               // Toasts cover the "Last updated" footer
+#define TOAST_HEIGHT 40
+#define STATUS_DOT_Y_POS 14           // Status bar: WiFi, MQTT, fetch dots top-right
+#define STATUS_DOT_RADIUS 3
+#define STATUS_DOT_SPACING 9
+
+// Overview page (button B): a table of assets, paged
+#define GRID_COLUMNS 2
+#define GRID_ROWS 4
+#define GRID_Y_POS 24                 // Under the page header
+
+// Ticker mode (button B): every asset scrolling across one strip
+#define TICKER_Y_POS 40               // Strip top: clear of the status bar and toasts
+#define TICKER_HEIGHT 40
+#define TICKER_FRAME_MS 25            // 40 fps, paced by the render task
+#define TICKER_STEP_PX 2              // Scroll per frame (80 px/s)
+#define TICKER_ITEM_GAP 24            // Space between assets
+#define TICKER_MAX_ASSETS MAX_ASSETS
+#define TICKER_FRAME_SAMPLES 256      // Recent frame times kept for percentiles
+
+// Overlay timing
+#define TOAST_MS 2500                 // How long a toast stays up
 
 // Frame styling
 #define FRAME_MARGIN 4
@@ -29,5 +168,23 @@
 #define COLOR_TEXT TFT_WHITE
 #define COLOR_PRICE TFT_YELLOW
 #define COLOR_FRAME TFT_DARKGREY
+#define COLOR_STALE TFT_ORANGE        // Age text when the price is stale
+#define COLOR_STALE_PRICE TFT_DARKGREY // Price text when stale
+#define COLOR_CHANGE_UP TFT_GREEN
+#define COLOR_CHANGE_DOWN TFT_RED
+#define COLOR_TOAST_INFO TFT_NAVY
+#define COLOR_TOAST_ERROR TFT_MAROON
+#define COLOR_TOAST_ALERT TFT_PURPLE
+#define COLOR_STATUS_OK TFT_GREEN
+#define COLOR_STATUS_BUSY TFT_YELLOW
+#define COLOR_STATUS_ERROR TFT_RED
+
+// Icon cache (icons fetched from ICON_SERVER_URL, stored on SPIFFS)
+#define ICON_CACHE_MAX_ENTRIES 32     // Icons kept on flash before LRU eviction
+#define ICON_RAM_SLOTS 4              // Decoded icons kept in RAM
+#define ICON_PENDING_MAX 4            // Symbols queued for download at once
+#define ICON_FETCH_TIMEOUT 5000       // 5 seconds HTTP timeout per icon
+#define ICON_FETCH_RETRY_MS 600000    // 10 minutes before retrying a failed icon
+#define ICON_INDEX_FLUSH_MS 600000    // 10 minutes between LRU index writes
 
 #endif // CONFIG_H
@@ -1,37 +1,118 @@
 #include "crypto_display.h"
 #include "icons.h"
+#include "trace.h"
+#include "time_utils.h"
 
-CryptoDisplay::CryptoDisplay() {
+long assetAgeSeconds(const AssetData& asset, time_t now) {
+  if (asset.sourceTime == 0 || !isClockSynced(now)) {
+    return -1;
+  }
+  long age = (long)(now - asset.sourceTime);
+  return age < 0 ? 0 : age; // Provider clocks may run slightly ahead
+}
+
+bool isAssetStale(const AssetData& asset, time_t now) {
+  if (asset.marketClosed) {
+    return false;
+  }
+  return assetAgeSeconds(asset, now) > STALE_THRESHOLD_SEC;
+}
+
+CryptoDisplay::CryptoDisplay(DisplaySurface& target) : surface(target), ticker(target), grid(target) {
+  iconCache = nullptr;
+  gridPage = -1;
+  surfaceLock = nullptr;
+  iconPending = false;
+  pendingIconX = 0;
+  pendingIconY = 0;
+  screen = UI_SCREEN_NONE;
+  messageTitle = "";
+  messageColor = COLOR_TEXT;
+  messageText[0] = '\0';
+  toastText[0] = '\0';
+  toastKind = TOAST_INFO;
+  toastShownAt = 0;
+  toastMs = 0;
+  toastActive = false;
+  toastDrawn = false;
+  footerDirty = false;
+  flashToggles = 0;
+  flashToggledAt = 0;
+  inverted = false;
+  for (int i = 0; i < STATUS_INDICATOR_COUNT; i++) {
+    status[i] = STATUS_OFF;
+  }
+  statusDirty = true;
 }
 
 void CryptoDisplay::begin() {
-  M5.Lcd.setRotation(3);
+  surface.begin();
   // Brightness is controlled via GPIO27 PWM in main.cpp (M5StickC Plus2)
-  M5.Lcd.fillScreen(COLOR_BACKGROUND);
+  surface.fillScreen(COLOR_BACKGROUND);
+  
+  // Price font, rasterized once; without it prices go through drawString
+  surface.setTextFont(2);
+  surface.setTextSize(2);
+  if (!priceAtlas.build(surface)) {
+    Serial.println("Glyph atlas unavailable - prices drawn as text");
+  }
   setupDisplaySettings();
+  
+  surfaceLock = xSemaphoreCreateMutex();
+  ticker.begin(surfaceLock);
 }
 
 void CryptoDisplay::setupDisplaySettings() {
-  M5.Lcd.setTextColor(COLOR_TEXT, COLOR_BACKGROUND);
-  M5.Lcd.setTextFont(2);
-  M5.Lcd.setTextSize(1);
+  surface.setTextColor(COLOR_TEXT, COLOR_BACKGROUND);
+  surface.setTextFont(2);
+  surface.setTextSize(1);
+}
+
+void CryptoDisplay::displayAsset(AssetData& asset) {
+  xSemaphoreTake(surfaceLock, portMAX_DELAY);
+  ticker.stop();
+  drawAsset(asset);
+  xSemaphoreGive(surfaceLock);
 }
 
-void CryptoDisplay::displayAsset(const AssetData& asset) {
+void CryptoDisplay::drawAsset(AssetData& asset) {
   // Only clear and redraw when switching to a different cryptocurrency
-  static String lastSymbol = "";
-  static String lastPrice = "";
-  static String lastUpdated = "";
+  static FixedString<16> lastSymbol;
+  static PriceText lastPrice;
+  static char lastAgeText[48] = "";
+  static bool lastStale = false;
+  
+  // The age text only changes once a minute, so this also limits time redraws
+  time_t now = time(nullptr);
+  char ageText[48];
+  formatAge(ageText, sizeof(ageText), asset, now);
+  bool stale = isAssetStale(asset, now);
+  
+  // Coming back from a message screen repaints everything
+  bool assetChanged = screen != UI_SCREEN_ASSET || (lastSymbol != asset.symbol);
+  screen = UI_SCREEN_ASSET;
+  PriceText currentPrice = formatPrice(asset.price);
+  bool priceChanged = (lastPrice != currentPrice) || (stale != lastStale);
+  bool timeChanged = (strcmp(lastAgeText, ageText) != 0);
+  
+  surface.beginFrame();
   
-  bool assetChanged = (lastSymbol != String(asset.symbol));
-  String currentPrice = formatPrice(asset.price);
-  bool priceChanged = (lastPrice != currentPrice);
-  bool timeChanged = (lastUpdated != String(asset.lastUpdated));
+  // A toast hides the footer: its changes wait until the toast comes down
+  expireToast(millis());
+  bool footerChanged = !toastActive && (assetChanged || timeChanged || footerDirty);
+  
+  // Only frames that change content are traced (the frame outline is redrawn every call)
+  bool contentChanged = assetChanged || priceChanged || footerChanged;
+  if (contentChanged) {
+    trace.begin(TRACE_RENDER);
+  }
   
   if (assetChanged) {
     // Full screen refresh when switching assets
-    M5.Lcd.fillScreen(COLOR_BACKGROUND);
+    surface.fillScreen(COLOR_BACKGROUND);
     setupDisplaySettings();
+    toastDrawn = false;
+    statusDirty = true;
     
     // Calculate centered positions
     AssetData centeredAsset = asset;
@@ -42,37 +123,51 @@ void CryptoDisplay::displayAsset(const AssetData& asset) {
     // Icon is 24px tall, so to center icon with text center: iconY = 16 - 12 = 4
     // Adding a bit more for better visual balance
     int iconY = TEXT_Y_POS + 4; // Position icon to be centered with text middle
-    displayIcon(centeredAsset.symbol, centeredAsset.iconX, iconY);
+    iconPending = !displayIcon(centeredAsset.symbol, centeredAsset.iconX, iconY);
+    if (iconPending) {
+      displayIconPlaceholder(centeredAsset.symbol, centeredAsset.iconX, iconY);
+      pendingIconX = centeredAsset.iconX;
+      pendingIconY = iconY;
+    }
     
     // Display asset name
-    M5.Lcd.setTextSize(2);
-    M5.Lcd.setTextDatum(TL_DATUM);
-    M5.Lcd.setTextColor(COLOR_TEXT, COLOR_BACKGROUND);
-    M5.Lcd.drawString(centeredAsset.name, centeredAsset.textX, TEXT_Y_POS);
-    
-    // Display static labels
-    M5.Lcd.setTextSize(1);
-    M5.Lcd.setTextColor(COLOR_TEXT, COLOR_BACKGROUND);
-    M5.Lcd.setTextDatum(TC_DATUM);
-    M5.Lcd.drawString("Last updated:", CENTER_X, UPDATE_LABEL_Y_POS);
+    surface.setTextSize(2);
+    surface.setTextDatum(TL_DATUM);
+    surface.setTextColor(COLOR_TEXT, COLOR_BACKGROUND);
+    surface.drawString(centeredAsset.name, centeredAsset.textX, TEXT_Y_POS);
     
     // Draw frame
     drawFrame();
     
-    lastSymbol = String(asset.symbol);
+    lastSymbol = asset.symbol;
+  } else if (iconPending) {
+    // Swap the placeholder for the real icon once the background fetch lands
+    if (displayIcon(asset.symbol, pendingIconX, pendingIconY)) {
+      iconPending = false;
+    }
   }
   
   // Update price if it changed (without clearing screen)
   if (priceChanged || assetChanged) {
-    // Clear only price area - avoid frame edges
-    M5.Lcd.fillRect(FRAME_MARGIN + 2, PRICE_Y_POS - 5, 
-                   SCREEN_WIDTH - (FRAME_MARGIN * 2) - 4, 25, COLOR_BACKGROUND);
+    uint16_t priceColor = stale ? COLOR_STALE_PRICE : COLOR_PRICE;
+    bool useAtlas = priceAtlas.ready() && priceAtlas.covers(currentPrice.c_str());
+    
+    // Same layout and color as the price on screen: it stays put, so only
+    // the digits that changed are drawn over it
+    bool rolling = useAtlas && !assetChanged && stale == lastStale &&
+                   priceAtlas.sameLayout(currentPrice.c_str(), lastPrice.c_str());
+    if (!rolling) {
+      // Clear only price area - avoid frame edges
+      surface.fillRect(FRAME_MARGIN + 2, PRICE_Y_POS - 5, 
+                     SCREEN_WIDTH - (FRAME_MARGIN * 2) - 4, 25, COLOR_BACKGROUND);
+    }
     
-    M5.Lcd.setTextSize(2);
-    M5.Lcd.setTextColor(COLOR_PRICE, COLOR_BACKGROUND);
+    surface.setTextSize(2);
+    surface.setTextColor(priceColor, COLOR_BACKGROUND);
     
     // Calculate actual width of price text (size 2 font)
-    int priceWidth = M5.Lcd.textWidth(currentPrice);
+    int priceWidth = useAtlas ? priceAtlas.textWidth(currentPrice.c_str())
+                              : surface.textWidth(currentPrice.c_str());
     int arrowSpacing = 8; // Space between price and arrow
     int totalWidth = priceWidth + arrowSpacing + ARROW_WIDTH;
     
@@ -81,8 +176,13 @@ void CryptoDisplay::displayAsset(const AssetData& asset) {
     int arrowX = priceX + priceWidth + arrowSpacing;
     
     // Draw price text (left-aligned from calculated position)
-    M5.Lcd.setTextDatum(TL_DATUM);
-    M5.Lcd.drawString(currentPrice, priceX, PRICE_Y_POS);
+    if (useAtlas) {
+      priceAtlas.drawText(surface, currentPrice.c_str(), priceX, PRICE_Y_POS, priceColor, COLOR_BACKGROUND,
+                          rolling ? lastPrice.c_str() : nullptr);
+    } else {
+      surface.setTextDatum(TL_DATUM);
+      surface.drawString(currentPrice.c_str(), priceX, PRICE_Y_POS);
+    }
     
     // Display price movement arrow (vertically centered with price text)
     // Text size 2 is ~16px height, arrow is 12px height
@@ -90,26 +190,50 @@ void CryptoDisplay::displayAsset(const AssetData& asset) {
     int arrowY = PRICE_Y_POS + 6;  // Lower positioning for better centering
     displayPriceArrow(asset, arrowX, arrowY);
     
+    drawChange(asset, stale);
+    
     lastPrice = currentPrice;
+    lastStale = stale;
+  }
+  
+  // The label only needs drawing after a clear
+  if (footerChanged && (assetChanged || footerDirty)) {
+    surface.setTextSize(1);
+    surface.setTextColor(COLOR_TEXT, COLOR_BACKGROUND);
+    surface.setTextDatum(TC_DATUM);
+    surface.drawString("Last updated:", CENTER_X, UPDATE_LABEL_Y_POS);
   }
   
   // Update timestamp if it changed (without clearing screen)
-  if (timeChanged || assetChanged) {
+  if (footerChanged) {
     // Clear only timestamp area - avoid frame edges
-    M5.Lcd.fillRect(FRAME_MARGIN + 2, UPDATE_TIME_Y_POS - 5, 
+    surface.fillRect(FRAME_MARGIN + 2, UPDATE_TIME_Y_POS - 5, 
                    SCREEN_WIDTH - (FRAME_MARGIN * 2) - 4, 20, COLOR_BACKGROUND);
     
-    M5.Lcd.setTextSize(1);
-    M5.Lcd.setTextColor(COLOR_TEXT, COLOR_BACKGROUND);
-    M5.Lcd.setTextDatum(TC_DATUM);
-    M5.Lcd.drawString(asset.lastUpdated, CENTER_X, UPDATE_TIME_Y_POS);
+    surface.setTextSize(1);
+    surface.setTextColor(stale ? COLOR_STALE : COLOR_TEXT, COLOR_BACKGROUND);
+    surface.setTextDatum(TC_DATUM);
+    surface.drawString(ageText, CENTER_X, UPDATE_TIME_Y_POS);
     
-    lastUpdated = String(asset.lastUpdated);
+    strlcpy(lastAgeText, ageText, sizeof(lastAgeText));
+    footerDirty = false;
   }
   
+  drawOverlays();
+  
   // Always redraw frame to ensure it's complete (lightweight operation)
   drawFrame();
   
+  surface.endFrame();
+  if (contentChanged) {
+    trace.end(TRACE_RENDER);
+  }
+  
+  // The latest fetch is now on screen
+  if (asset.fetchTime != 0 && asset.displayTime < asset.fetchTime) {
+    asset.displayTime = now;
+  }
+  
   // Serial output only on changes
   if (assetChanged || priceChanged) {
     Serial.printf("%s %s: %s - Updated: %s\n", 
@@ -121,10 +245,163 @@ void CryptoDisplay::displayAsset(const AssetData& asset) {
 }
 
 // Backward compatibility wrapper
-void CryptoDisplay::displayCrypto(const CryptoData& crypto) {
+void CryptoDisplay::displayCrypto(CryptoData& crypto) {
   displayAsset(crypto);
 }
 
+void CryptoDisplay::displayGrid(const AssetData assets[], int count, int page) {
+  xSemaphoreTake(surfaceLock, portMAX_DELAY);
+  ticker.stop();
+  surface.beginFrame();
+  
+  if (screen != UI_SCREEN_GRID) {
+    screen = UI_SCREEN_GRID;
+    surface.fillScreen(COLOR_BACKGROUND);
+    setupDisplaySettings();
+    drawFrame();
+    grid.invalidate();
+    gridPage = -1;
+    toastDrawn = false;
+    statusDirty = true;
+    footerDirty = false;
+  }
+  
+  int pages = (count + GRID_CELLS - 1) / GRID_CELLS;
+  if (page != gridPage) {
+    drawGridHeader(page, pages);
+    gridPage = page;
+  }
+  
+  // A toast that came down took part of the table with it
+  expireToast(millis());
+  if (footerDirty) {
+    grid.invalidateBand(TOAST_Y_POS, TOAST_HEIGHT);
+    footerDirty = false;
+  }
+  
+  time_t now = time(nullptr);
+  for (int slot = 0; slot < GRID_CELLS; slot++) {
+    int index = page * GRID_CELLS + slot;
+    if (index >= count) {
+      grid.clearCell(slot);
+      continue;
+    }
+    const AssetData& asset = assets[index];
+    char change[16] = "";
+    if (!asset.firstUpdate) {
+      snprintf(change, sizeof(change), "%+.2f%%", asset.change24h);
+    }
+    grid.setCell(slot, asset.symbol, formatPrice(asset.price).c_str(),
+                 isAssetStale(asset, now) ? COLOR_STALE_PRICE : COLOR_PRICE,
+                 change, asset.change24h >= 0.0f ? COLOR_CHANGE_UP : COLOR_CHANGE_DOWN);
+  }
+  
+  // Cells under a toast wait until it comes down
+  grid.draw(TOAST_Y_POS, toastActive ? TOAST_HEIGHT : 0);
+  
+  drawOverlays();
+  surface.endFrame();
+  xSemaphoreGive(surfaceLock);
+}
+
+void CryptoDisplay::drawGridHeader(int page, int pages) {
+  char header[40];
+  if (pages > 1) {
+    snprintf(header, sizeof(header), "Overview  %d/%d", page + 1, pages);
+  } else {
+    strlcpy(header, "Overview", sizeof(header));
+  }
+  // Clear of the status dots on the right
+  surface.fillRect(FRAME_MARGIN + 2, FRAME_MARGIN + 2, CENTER_X, GRID_Y_POS - FRAME_MARGIN - 2, COLOR_BACKGROUND);
+  surface.setTextFont(2);
+  surface.setTextSize(1);
+  surface.setTextColor(COLOR_TEXT, COLOR_BACKGROUND);
+  surface.setTextDatum(TL_DATUM);
+  surface.drawString(header, FRAME_MARGIN + 6, FRAME_MARGIN + 3);
+}
+
+bool CryptoDisplay::displayTicker(const AssetData assets[], int count) {
+  xSemaphoreTake(surfaceLock, portMAX_DELAY);
+  time_t now = time(nullptr);
+  
+  // Prices first, so the first frame already has them
+  for (int i = 0; i < count; i++) {
+    const AssetData& asset = assets[i];
+    int8_t direction = asset.firstUpdate ? 0 : (asset.priceIncreased ? 1 : -1);
+    ticker.setItem(i, asset.symbol, formatPrice(asset.price).c_str(),
+                   isAssetStale(asset, now) ? COLOR_STALE_PRICE : COLOR_PRICE, direction);
+  }
+  ticker.setItemCount(count);
+  
+  bool entering = screen != UI_SCREEN_TICKER;
+  if (entering && !ticker.start()) {
+    xSemaphoreGive(surfaceLock);
+    return false;
+  }
+  
+  surface.beginFrame();
+  if (entering) {
+    // Static parts; the strip itself belongs to the render task from here on
+    screen = UI_SCREEN_TICKER;
+    surface.fillScreen(COLOR_BACKGROUND);
+    setupDisplaySettings();
+    surface.setTextSize(2);
+    surface.setTextDatum(TL_DATUM);
+    surface.drawString("Markets", FRAME_MARGIN + 8, TEXT_Y_POS);
+    drawFrame();
+    toastDrawn = false;
+    statusDirty = true;
+    footerDirty = true;
+  }
+  
+  // Copied once; downloads that are still pending keep a placeholder
+  for (int i = 0; i < count; i++) {
+    if (!ticker.hasIcon(i)) {
+      ticker.setIcon(i, iconPixels(assets[i].symbol));
+    }
+  }
+  
+  expireToast(millis());
+  if (footerDirty && !toastActive) {
+    drawTickerFooter(count);
+    footerDirty = false;
+  }
+  drawOverlays();
+  surface.endFrame();
+  xSemaphoreGive(surfaceLock);
+  return true;
+}
+
+void CryptoDisplay::drawTickerFooter(int count) {
+  char footer[32];
+  snprintf(footer, sizeof(footer), "%d assets - B for single view", count);
+  surface.fillRect(FRAME_MARGIN + 2, UPDATE_TIME_Y_POS - 5,
+                   SCREEN_WIDTH - (FRAME_MARGIN * 2) - 4, 20, COLOR_BACKGROUND);
+  surface.setTextSize(1);
+  surface.setTextColor(COLOR_TEXT, COLOR_BACKGROUND);
+  surface.setTextDatum(TC_DATUM);
+  surface.drawString(footer, CENTER_X, UPDATE_TIME_Y_POS);
+}
+
+// 24h change under the price, green when up and red when down
+void CryptoDisplay::drawChange(const AssetData& asset, bool stale) {
+  surface.fillRect(FRAME_MARGIN + 2, CHANGE_Y_POS - 2,
+                   SCREEN_WIDTH - (FRAME_MARGIN * 2) - 4, 12, COLOR_BACKGROUND);
+  if (asset.firstUpdate) {
+    return;
+  }
+  
+  char changeText[24];
+  snprintf(changeText, sizeof(changeText), "%+.2f%% %s", asset.change24h,
+           asset.isStock ? "today" : "24h");
+  uint16_t color = asset.change24h >= 0.0f ? COLOR_CHANGE_UP : COLOR_CHANGE_DOWN;
+  
+  surface.setTextSize(1);
+  surface.setTextColor(stale ? COLOR_STALE_PRICE : color, COLOR_BACKGROUND);
+  surface.setTextDatum(TC_DATUM);
+  surface.drawString(changeText, CENTER_X, CHANGE_Y_POS);
+}
+
 void CryptoDisplay::displayPriceArrow(const AssetData& asset, int x, int y) {
   // Only show arrow after first update (when we have previous price to compare)
   if (asset.firstUpdate) {
@@ -133,48 +410,145 @@ void CryptoDisplay::displayPriceArrow(const AssetData& asset, int x, int y) {
   
   if (asset.priceIncreased) {
     // Green up arrow
-    M5.Lcd.pushImage(x, y, ARROW_WIDTH, ARROW_HEIGHT, up_arrow);
+    surface.pushImage(x, y, ARROW_WIDTH, ARROW_HEIGHT, up_arrow);
   } else {
     // Red down arrow  
-    M5.Lcd.pushImage(x, y, ARROW_WIDTH, ARROW_HEIGHT, down_arrow);
+    surface.pushImage(x, y, ARROW_WIDTH, ARROW_HEIGHT, down_arrow);
   }
 }
 
 void CryptoDisplay::displayError(const char* message) {
-  M5.Lcd.fillScreen(COLOR_BACKGROUND);
-  setupDisplaySettings();
-  
-  M5.Lcd.setTextSize(2);
-  M5.Lcd.setTextColor(TFT_RED);
-  M5.Lcd.setTextDatum(MC_DATUM);
-  M5.Lcd.drawString("ERROR", CENTER_X, 40);
-  
-  M5.Lcd.setTextSize(1);
-  M5.Lcd.setTextColor(COLOR_TEXT);
-  M5.Lcd.drawString(message, CENTER_X, 70);
-  
+  showMessage("ERROR", TFT_RED, message);
   Serial.printf("ERROR: %s\n", message);
 }
 
-void CryptoDisplay::displayWiFiStatus(const char* status) {
-  M5.Lcd.fillScreen(COLOR_BACKGROUND);
+void CryptoDisplay::displayWiFiStatus(const char* message) {
+  showMessage("WiFi", TFT_YELLOW, message);
+  Serial.printf("WiFi: %s\n", message);
+}
+
+void CryptoDisplay::showMessage(const char* title, uint16_t color, const char* message) {
+  xSemaphoreTake(surfaceLock, portMAX_DELAY);
+  ticker.stop();
+  screen = UI_SCREEN_MESSAGE;
+  messageTitle = title;
+  messageColor = color;
+  strlcpy(messageText, message, sizeof(messageText));
+  
+  surface.beginFrame();
+  surface.fillScreen(COLOR_BACKGROUND);
   setupDisplaySettings();
   
-  M5.Lcd.setTextSize(2);
-  M5.Lcd.setTextColor(TFT_YELLOW);
-  M5.Lcd.setTextDatum(MC_DATUM);
-  M5.Lcd.drawString("WiFi", CENTER_X, 40);
+  surface.setTextSize(2);
+  surface.setTextColor(messageColor);
+  surface.setTextDatum(MC_DATUM);
+  surface.drawString(messageTitle, CENTER_X, 40);
   
-  M5.Lcd.setTextSize(1);
-  M5.Lcd.setTextColor(COLOR_TEXT);
-  M5.Lcd.drawString(status, CENTER_X, 70);
+  surface.setTextSize(1);
+  surface.setTextColor(COLOR_TEXT);
+  surface.drawString(messageText, CENTER_X, 70);
   
-  Serial.printf("WiFi: %s\n", status);
+  // The clear took the overlays with it
+  toastDrawn = false;
+  statusDirty = true;
+  drawOverlays();
+  surface.endFrame();
+  xSemaphoreGive(surfaceLock);
+}
+
+void CryptoDisplay::showToast(const char* message, ToastKind kind, uint32_t durationMs) {
+  strlcpy(toastText, message, sizeof(toastText));
+  toastKind = kind;
+  toastShownAt = millis();
+  toastMs = durationMs;
+  toastActive = true;
+  toastDrawn = false;
+}
+
+void CryptoDisplay::flash(int times) {
+  // Always end on the normal screen, even from the middle of a flash
+  flashToggles = times * 2 + (inverted ? 1 : 0);
+  flashToggledAt = millis() - ALERT_FLASH_MS; // First inversion on the next draw
+}
+
+void CryptoDisplay::setStatus(StatusIndicator indicator, StatusLevel level) {
+  if (status[indicator] != level) {
+    status[indicator] = level;
+    statusDirty = true;
+  }
+}
+
+void CryptoDisplay::updateOverlays(unsigned long now) {
+  bool expired = toastActive && now - toastShownAt >= toastMs;
+  if (!expired && !statusDirty && (toastDrawn || !toastActive) && flashToggles == 0) {
+    return;
+  }
+  xSemaphoreTake(surfaceLock, portMAX_DELAY);
+  surface.beginFrame();
+  expireToast(now);
+  drawOverlays();
+  surface.endFrame();
+  xSemaphoreGive(surfaceLock);
+}
+
+// Take the toast down once its time is up; the screen under it is repainted
+// (the asset footer by the next displayAsset)
+bool CryptoDisplay::expireToast(unsigned long now) {
+  if (!toastActive || now - toastShownAt < toastMs) {
+    return false;
+  }
+  toastActive = false;
+  toastDrawn = false;
+  surface.fillRect(FRAME_MARGIN + 4, TOAST_Y_POS, SCREEN_WIDTH - (FRAME_MARGIN * 2) - 8, TOAST_HEIGHT,
+                   COLOR_BACKGROUND);
+  footerDirty = true;
+  return true;
+}
+
+void CryptoDisplay::drawOverlays() {
+  if (toastActive && !toastDrawn) {
+    drawToast();
+    toastDrawn = true;
+  }
+  if (statusDirty) {
+    drawStatusBar();
+    statusDirty = false;
+  }
+  if (flashToggles > 0 && millis() - flashToggledAt >= ALERT_FLASH_MS) {
+    inverted = !inverted;
+    surface.invert(inverted);
+    flashToggles--;
+    flashToggledAt = millis();
+  }
+}
+
+void CryptoDisplay::drawToast() {
+  uint16_t background = toastKind == TOAST_ERROR ? COLOR_TOAST_ERROR
+                        : toastKind == TOAST_ALERT ? COLOR_TOAST_ALERT : COLOR_TOAST_INFO;
+  surface.fillRect(FRAME_MARGIN + 4, TOAST_Y_POS, SCREEN_WIDTH - (FRAME_MARGIN * 2) - 8, TOAST_HEIGHT,
+                   background);
+  surface.setTextSize(1);
+  surface.setTextColor(COLOR_TEXT, background);
+  surface.setTextDatum(MC_DATUM);
+  surface.drawString(toastText, CENTER_X, TOAST_Y_POS + TOAST_HEIGHT / 2);
+}
+
+// WiFi, MQTT and fetch dots in the top-right corner, clear of the asset name
+void CryptoDisplay::drawStatusBar() {
+  static const uint16_t colors[] = {COLOR_FRAME, COLOR_STATUS_OK, COLOR_STATUS_BUSY, COLOR_STATUS_ERROR};
+  int x = SCREEN_WIDTH - FRAME_MARGIN - 8 - (STATUS_INDICATOR_COUNT - 1) * STATUS_DOT_SPACING;
+  for (int i = 0; i < STATUS_INDICATOR_COUNT; i++) {
+    surface.fillCircle(x + i * STATUS_DOT_SPACING, STATUS_DOT_Y_POS, STATUS_DOT_RADIUS, colors[status[i]]);
+  }
+}
+
+void CryptoDisplay::setIconCache(IconCache* cache) {
+  iconCache = cache;
 }
 
 void CryptoDisplay::drawFrame() {
   // Draw a complete border frame
-  M5.Lcd.drawRoundRect(
+  surface.drawRoundRect(
     FRAME_MARGIN, 
     FRAME_MARGIN, 
     SCREEN_WIDTH - (FRAME_MARGIN * 2), 
@@ -184,7 +558,7 @@ void CryptoDisplay::drawFrame() {
   );
   
   // Draw a second frame line for better visibility (optional)
-  M5.Lcd.drawRoundRect(
+  surface.drawRoundRect(
     FRAME_MARGIN + 1, 
     FRAME_MARGIN + 1, 
     SCREEN_WIDTH - (FRAME_MARGIN * 2) - 2, 
@@ -194,46 +568,91 @@ void CryptoDisplay::drawFrame() {
   );
 }
 
-void CryptoDisplay::displayIcon(const char* symbol, int x, int y) {
+// Built-in icon, else the downloaded one (flash or RAM); nullptr while the
+// fetch is still pending. All are ICON_SIZE square.
+const uint16_t* CryptoDisplay::iconPixels(const char* symbol) {
   if (strcmp(symbol, "BTC") == 0) {
-    M5.Lcd.pushImage(x, y, BTC_ICON_WIDTH, BTC_ICON_HEIGHT, btc_icon);
+    return btc_icon;
   } 
   else if (strcmp(symbol, "ETH") == 0) {
-    M5.Lcd.pushImage(x, y, ETH_ICON_WIDTH, ETH_ICON_HEIGHT, eth_icon);
+    return eth_icon;
   }
   else if (strcmp(symbol, "XRP") == 0) {
-    M5.Lcd.pushImage(x, y, XRP_ICON_WIDTH, XRP_ICON_HEIGHT, xrp_icon);
+    return xrp_icon;
   }
   else if (strcmp(symbol, "MSFT") == 0) {
-    M5.Lcd.pushImage(x, y, MSFT_ICON_WIDTH, MSFT_ICON_HEIGHT, msft_icon);
+    return msft_icon;
   }
+  return iconCache ? iconCache->lookup(symbol) : nullptr;
 }
 
-String CryptoDisplay::formatPrice(float price) {
-  String num = String(price, 2);
-  int decimalPos = num.indexOf('.');
+bool CryptoDisplay::displayIcon(const char* symbol, int x, int y) {
+  const uint16_t* pixels = iconPixels(symbol);
+  if (pixels == nullptr) {
+    return false;
+  }
+  surface.pushImage(x, y, ICON_SIZE, ICON_SIZE, pixels);
+  return true;
+}
+
+void CryptoDisplay::displayIconPlaceholder(const char* symbol, int x, int y) {
+  // Grey disc with the symbol's first letter, same footprint as a real icon
+  int radius = ICON_SIZE / 2;
+  surface.fillCircle(x + radius, y + radius, radius - 1, COLOR_FRAME);
   
-  if (decimalPos == -1) return num; // No decimal point found
+  char initial[2] = { symbol[0], '\0' };
+  surface.setTextSize(1);
+  surface.setTextColor(COLOR_TEXT, COLOR_FRAME);
+  surface.setTextDatum(MC_DATUM);
+  surface.drawString(initial, x + radius, y + radius);
+}
+
+PriceText CryptoDisplay::formatPrice(float price) {
+  char num[24];
+  snprintf(num, sizeof(num), "%.2f", price);
+  const char* decimalPart = strchr(num, '.');
   
-  String integerPart = num.substring(0, decimalPos);
-  String decimalPart = num.substring(decimalPos);
+  if (decimalPart == nullptr) return PriceText(num); // No decimal point found
   
   // Format integer part with commas
-  String formatted = "";
-  int length = integerPart.length();
+  PriceText formatted;
+  int length = decimalPart - num;
   
   for (int i = 0; i < length; i++) {
     if (i > 0 && (length - i) % 3 == 0) {
-      formatted += ",";
+      formatted += ',';
     }
-    formatted += integerPart[i];
+    formatted += num[i];
   }
   
-  return formatted + decimalPart;
+  formatted += decimalPart;
+  return formatted;
+}
+
+void CryptoDisplay::formatAge(char* out, size_t size, const AssetData& asset, time_t now) {
+  long age = assetAgeSeconds(asset, now);
+  if (age < 0) {
+    // No parsed timestamp yet (or clock not synced): show the raw text
+    strlcpy(out, asset.lastUpdated[0] ? asset.lastUpdated : "--", size);
+    return;
+  }
+  
+  const char* note = asset.marketClosed ? "Market Closed - " :
+                     asset.fetchFailed ? "Update Failed - " : "";
+  long minutes = age / 60;
+  if (minutes < 1) {
+    snprintf(out, size, "%sjust now", note);
+  } else if (minutes < 60) {
+    snprintf(out, size, "%s%ldm ago", note, minutes);
+  } else if (minutes < 48 * 60) {
+    snprintf(out, size, "%s%ldh %ldm ago", note, minutes / 60, minutes % 60);
+  } else {
+    snprintf(out, size, "%s%ldd ago", note, minutes / (24 * 60));
+  }
 }
 
 void CryptoDisplay::clearDisplayArea(int x, int y, int width, int height) {
-  M5.Lcd.fillRect(x, y, width, height, COLOR_BACKGROUND);
+  surface.fillRect(x, y, width, height, COLOR_BACKGROUND);
 }
 
 void CryptoDisplay::calculateCenterPosition(AssetData& asset) {
@@ -2,58 +2,213 @@
 #define CRYPTO_DISPLAY_H
 
 #include <M5Unified.h>
+#include <time.h>
 #include "config.h"
+#include "icon_cache.h"
+#include "display_surface.h"
+#include "market_calendar.h"
+#include "fixed_string.h"
+#include "glyph_atlas.h"
+#include "ticker_view.h"
+#include "grid_view.h"
+
+// Price as shown, e.g. "104,231.50"
+typedef FixedString<24> PriceText;
 
 // Structure to hold cryptocurrency and stock data
 struct AssetData {
   const char* symbol;
   const char* name;
   float price;
-  const char* lastUpdated;
+  char lastUpdated[32];  // Source timestamp as text (owned copy, ISO 8601 when known)
   int iconX;
   int textX;
   int nameWidth;  // Approximate width in pixels for centering
   bool isStock;   // true for stocks, false for crypto
   const char* currency; // "CAD" for crypto, "USD" for stocks
+  Exchange exchange;    // Trading calendar (EXCHANGE_NONE for crypto)
+  uint32_t refreshIntervalMs; // Target time between refreshes
   
   // Price movement tracking
   float previousPrice; // Track previous price for comparison
   bool priceIncreased; // true if price went up, false if down
   bool firstUpdate;    // true on first load (no arrow shown)
+  
+  // Freshness tracking (epoch seconds, 0 = unknown)
+  time_t sourceTime;   // When the provider says the price was last updated
+  time_t fetchTime;    // When we finished fetching it
+  time_t displayTime;  // When that fetch first reached the screen
+  bool marketClosed;   // Stock market closed (price is the last close)
+  bool fetchFailed;    // Last fetch failed (price is cached)
+  
+  // Percent change from the provider (stocks: change24h is the day's change).
+  // change24h follows the live price between fetches (see MarketStats).
+  float change1h;
+  float change24h;
+  float change7d;
+  
+  uint32_t cmcId;      // CoinMarketCap id (0 = unresolved, requests fall back to the symbol)
 };
 
+// Seconds since the source timestamp of the current price (-1 if unknown)
+long assetAgeSeconds(const AssetData& asset, time_t now);
+
+// True when the price is older than STALE_THRESHOLD_SEC (closed markets are never stale)
+bool isAssetStale(const AssetData& asset, time_t now);
+
 // Keep backward compatibility
 typedef AssetData CryptoData;
 
+// What fills the screen under the overlays
+enum UiScreen : uint8_t {
+  UI_SCREEN_NONE,     // Nothing drawn yet
+  UI_SCREEN_MESSAGE,  // Full-screen status or error (boot, waiting for data)
+  UI_SCREEN_ASSET,    // Price view
+  UI_SCREEN_GRID,     // Overview table, GRID_CELLS assets per page
+  UI_SCREEN_TICKER    // Every asset scrolling across one strip
+};
+
+enum ToastKind : uint8_t {
+  TOAST_INFO,
+  TOAST_ERROR,
+  TOAST_ALERT
+};
+
+// Status bar dots, left to right
+enum StatusIndicator : uint8_t {
+  STATUS_WIFI,
+  STATUS_MQTT,
+  STATUS_FETCH,
+  STATUS_INDICATOR_COUNT
+};
+
+enum StatusLevel : uint8_t {
+  STATUS_OFF,    // Grey: unknown or not in use
+  STATUS_OK,
+  STATUS_BUSY,   // Request in flight
+  STATUS_ERROR
+};
+
 // Cryptocurrency display class
 class CryptoDisplay {
 public:
-  CryptoDisplay();
+  explicit CryptoDisplay(DisplaySurface& target);
   
   // Initialize display settings
   void begin();
   
   // Display a single cryptocurrency or stock
-  void displayAsset(const AssetData& asset);
-  void displayCrypto(const CryptoData& crypto); // Backward compatibility
+  // Records asset.displayTime once a new fetch is on screen
+  void displayAsset(AssetData& asset);
+  void displayCrypto(CryptoData& crypto); // Backward compatibility
+  
+  // Overview page: call from loop() like displayAsset(). Shows assets
+  // page * GRID_CELLS onwards; only cells whose text changed are redrawn.
+  void displayGrid(const AssetData assets[], int count, int page);
+  
+  // Ticker mode: call from loop() like displayAsset(); hands new prices to
+  // the render task and draws the overlays. Returns false when the ticker
+  // can't run (no memory), so the caller can fall back to displayAsset().
+  // Any other screen stops it.
+  bool displayTicker(const AssetData assets[], int count);
   
   // Display price movement arrow
   void displayPriceArrow(const AssetData& asset, int x, int y);
   
-  // Display error message
+  // Full-screen error message (stays until an asset is displayed)
   void displayError(const char* message);
   
-  // Display WiFi connection status
-  void displayWiFiStatus(const char* status);
+  // Full-screen WiFi/boot status (stays until an asset is displayed)
+  void displayWiFiStatus(const char* message);
+  
+  // Timed message over the footer of whatever screen is up; never blocks
+  void showToast(const char* message, ToastKind kind, uint32_t durationMs = TOAST_MS);
+  
+  // Invert the screen and back `times` times, ALERT_FLASH_MS apart; played
+  // out by the display calls and updateOverlays(), never blocks
+  void flash(int times = ALERT_FLASHES);
+  
+  // Status bar dot (redrawn only when the level changes)
+  void setStatus(StatusIndicator indicator, StatusLevel level);
+  
+  // Draw pending overlay changes and take down an expired toast. displayAsset()
+  // does this itself; call it when no asset is being displayed, or to show a
+  // status change before a blocking request.
+  void updateOverlays(unsigned long now);
+  
+  UiScreen getScreen() const { return screen; }
+  
+  // Use an icon cache for symbols without a built-in icon (optional)
+  void setIconCache(IconCache* cache);
+  
+  // Drawing target (exposes per-frame draw statistics)
+  DisplaySurface& getSurface() { return surface; }
+  
+  // Pre-rasterized price digits (blit statistics)
+  const GlyphAtlas& getPriceAtlas() const { return priceAtlas; }
+  
+  // Ticker render task (frame statistics)
+  const TickerView& getTicker() const { return ticker; }
   
 private:
+  DisplaySurface& surface;
+  IconCache* iconCache;
+  GlyphAtlas priceAtlas; // Font 2 at size 2; empty when the surface can't rasterize
+  TickerView ticker;
+  GridView grid;
+  int gridPage;         // Page in the header (-1 = none drawn)
+  SemaphoreHandle_t surfaceLock; // Shared with the ticker's render task
+  
+  // Placeholder shown while a downloaded icon is pending
+  bool iconPending;
+  int pendingIconX;
+  int pendingIconY;
+  
+  UiScreen screen;
+  
+  // Full-screen message, kept so it can be repainted
+  const char* messageTitle;
+  uint16_t messageColor;
+  char messageText[48];
+  
+  // Toast overlay
+  char toastText[40];
+  ToastKind toastKind;
+  unsigned long toastShownAt;
+  uint32_t toastMs;
+  bool toastActive;
+  bool toastDrawn;
+  bool footerDirty;     // Toast came down: footer needs repainting
+  
+  // Screen flash
+  uint8_t flashToggles; // Inversions left to play
+  unsigned long flashToggledAt;
+  bool inverted;
+  
+  // Status bar
+  StatusLevel status[STATUS_INDICATOR_COUNT];
+  bool statusDirty;
+  
+
   // Helper functions
+  void drawAsset(AssetData& asset);
+  void showMessage(const char* title, uint16_t color, const char* message);
+  bool expireToast(unsigned long now);
+  void drawOverlays();
+  void drawToast();
+  void drawStatusBar();
   void setupDisplaySettings();
   void drawFrame();
-  void displayIcon(const char* symbol, int x, int y);
+  void drawTickerFooter(int count);
+  void drawGridHeader(int page, int pages);
+  const uint16_t* iconPixels(const char* symbol);
+  bool displayIcon(const char* symbol, int x, int y);
+  void displayIconPlaceholder(const char* symbol, int x, int y);
   void displayCenteredText(const char* text, int x, int y, int textSize, uint16_t color);
   void clearDisplayArea(int x, int y, int width, int height);
-  String formatPrice(float price);
+  PriceText formatPrice(float price);
+  void formatAge(char* out, size_t size, const AssetData& asset, time_t now);
+  void drawChange(const AssetData& asset, bool stale);
   void calculateCenterPosition(AssetData& asset);
 };
 
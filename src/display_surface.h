@@ -0,0 +1,88 @@
+#ifndef DISPLAY_SURFACE_H
+#define DISPLAY_SURFACE_H
+
+#include <stdint.h>
+
+// Drawing statistics gathered by a surface. Pixel counts are what the
+// controller would receive, so bytesPushed() is the SPI-equivalent traffic.
+struct SurfaceStats {
+  uint32_t drawCalls;
+  uint32_t pixelsWritten;
+  uint32_t fullClears;
+
+  uint32_t bytesPushed() const { return pixelsWritten * 2; } // RGB565
+};
+
+// Thin drawing interface used by CryptoDisplay so rendering can be measured
+// without the LCD. Colors are RGB565; text datums use the M5GFX numbering
+// (bits 0-1 horizontal: left/center/right, bits 2-3 vertical: top/middle/bottom).
+class DisplaySurface {
+public:
+  virtual ~DisplaySurface() {}
+
+  // One-time hardware setup (rotation etc.)
+  virtual void begin() {}
+
+  virtual int width() const = 0;
+  virtual int height() const = 0;
+
+  // Primitives
+  virtual void fillScreen(uint16_t color) = 0;
+  virtual void fillRect(int x, int y, int w, int h, uint16_t color) = 0;
+  virtual void drawRoundRect(int x, int y, int w, int h, int r, uint16_t color) = 0;
+  virtual void fillCircle(int x, int y, int r, uint16_t color) = 0;
+  virtual void pushImage(int x, int y, int w, int h, const uint16_t* pixels) = 0;
+
+  // Text
+  virtual void setTextFont(int font) = 0;
+  virtual void setTextSize(int size) = 0;
+  virtual void setTextColor(uint16_t fg) = 0;
+  virtual void setTextColor(uint16_t fg, uint16_t bg) = 0;
+  virtual void setTextDatum(uint8_t datum) = 0;
+  virtual int drawString(const char* text, int x, int y) = 0;
+  virtual int textWidth(const char* text) = 0;
+  virtual int fontHeight() const = 0;
+
+  // Rasterize one character of the current font and size, left edge at x,
+  // into a w x h 1-bit mask (rows of (w + 7) / 8 bytes, MSB first, set =
+  // ink, zeroed by the caller). Used to build glyph atlases; surfaces that
+  // can't read glyphs back return false.
+  virtual bool rasterizeChar(char /*c*/, int /*x*/, int /*w*/, int /*h*/, uint8_t* /*mask*/) { return false; }
+
+  // Invert the whole panel (a controller command: nothing is redrawn or
+  // counted). Surfaces without one ignore it.
+  virtual void invert(bool /*on*/) {}
+
+  // Frame accounting: everything drawn between beginFrame() and endFrame()
+  // is attributed to one frame; totals accumulate across frames
+  void beginFrame() { frame = SurfaceStats(); }
+  void endFrame() { lastFrame = frame; frames++; }
+
+  const SurfaceStats& lastFrameStats() const { return lastFrame; }
+  const SurfaceStats& totalStats() const { return totals; }
+  uint32_t frameCount() const { return frames; }
+  void resetStats() { frame = lastFrame = totals = SurfaceStats(); frames = 0; }
+
+protected:
+  DisplaySurface() : frame(), lastFrame(), totals(), frames(0) {}
+
+  void countDraw(uint32_t pixels) {
+    frame.drawCalls++;
+    frame.pixelsWritten += pixels;
+    totals.drawCalls++;
+    totals.pixelsWritten += pixels;
+  }
+
+  void countClear() {
+    frame.fullClears++;
+    totals.fullClears++;
+  }
+
+private:
+  SurfaceStats frame;
+  SurfaceStats lastFrame;
+  SurfaceStats totals;
+  uint32_t frames;
+};
+
+#endif // DISPLAY_SURFACE_H
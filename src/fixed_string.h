@@ -0,0 +1,120 @@
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+// String with inline storage for hot paths: never touches the heap, so it
+// can't fragment it over weeks of uptime. N includes the terminator. Text
+// that doesn't fit is cut at capacity() and truncated() reports it.
+template <size_t N>
+class FixedString {
+  static_assert(N > 1, "FixedString needs room for at least one character");
+
+public:
+  FixedString() : len(0), cut(false) { text[0] = '\0'; }
+  FixedString(const char* s) : len(0), cut(false) {
+    text[0] = '\0';
+    append(s);
+  }
+
+  FixedString& operator=(const char* s) {
+    clear();
+    return append(s);
+  }
+  FixedString& operator+=(const char* s) { return append(s); }
+  FixedString& operator+=(char c) { return append(c); }
+
+  FixedString& append(const char* s) { return append(s, s != nullptr ? strlen(s) : 0); }
+
+  FixedString& append(const char* s, size_t count) {
+    size_t room = N - 1 - len;
+    if (count > room) {
+      count = room;
+      cut = true;
+    }
+    memcpy(text + len, s, count);
+    len += count;
+    text[len] = '\0';
+    return *this;
+  }
+
+  FixedString& append(char c) {
+    if (len >= N - 1) {
+      cut = true;
+      return *this;
+    }
+    text[len++] = c;
+    text[len] = '\0';
+    return *this;
+  }
+
+  // vprintf-style append, for variadic wrappers
+  FixedString& appendv(const char* format, va_list args) {
+    size_t room = N - len;
+    int written = vsnprintf(text + len, room, format, args);
+    if (written < 0) {
+      text[len] = '\0';
+      return *this;
+    }
+    if ((size_t)written >= room) {
+      written = room - 1;
+      cut = true;
+    }
+    len += written;
+    return *this;
+  }
+
+  // printf-style append
+  __attribute__((format(printf, 2, 3)))
+  FixedString& appendf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    appendv(format, args);
+    va_end(args);
+    return *this;
+  }
+
+  // printf-style replace
+  __attribute__((format(printf, 2, 3)))
+  FixedString& format(const char* format, ...) {
+    clear();
+    va_list args;
+    va_start(args, format);
+    appendv(format, args);
+    va_end(args);
+    return *this;
+  }
+
+  void clear() {
+    len = 0;
+    cut = false;
+    text[0] = '\0';
+  }
+
+  void toLowerCase() {
+    for (size_t i = 0; i < len; i++) {
+      text[i] = tolower(text[i]);
+    }
+  }
+
+  const char* c_str() const { return text; }
+  size_t length() const { return len; }
+  bool isEmpty() const { return len == 0; }
+  bool truncated() const { return cut; }
+  static constexpr size_t capacity() { return N - 1; }
+
+  bool operator==(const char* s) const { return strcmp(text, s) == 0; }
+  bool operator!=(const char* s) const { return strcmp(text, s) != 0; }
+  template <size_t M>
+  bool operator==(const FixedString<M>& other) const { return strcmp(text, other.c_str()) == 0; }
+  template <size_t M>
+  bool operator!=(const FixedString<M>& other) const { return strcmp(text, other.c_str()) != 0; }
+
+private:
+  char text[N];
+  size_t len;
+  bool cut;
+};
+
+#endif // FIXED_STRING_H
@@ -0,0 +1,291 @@
+#include "fleet.h"
+#include "metrics.h"
+#include "json_arena.h"
+#include "time_utils.h"
+#include "secrets.h"
+#include <ArduinoJson.h>
+#include <WiFi.h>
+#include <sys/time.h>
+
+#ifndef FLEET_ROLE
+#define FLEET_ROLE "standalone"
+#endif
+
+// Wall-clock time split into seconds and milliseconds (JSON stays 32-bit)
+static bool epochNow(time_t& seconds, uint16_t& millisPart) {
+  struct timeval now;
+  gettimeofday(&now, nullptr);
+  if (!isClockSynced(now.tv_sec)) {
+    return false;
+  }
+  seconds = now.tv_sec;
+  millisPart = now.tv_usec / 1000;
+  return true;
+}
+
+static FleetRole parseRole(const char* name) {
+  if (strcmp(name, "gateway") == 0) return FLEET_ROLE_GATEWAY;
+  if (strcmp(name, "display") == 0) return FLEET_ROLE_DISPLAY;
+  if (strcmp(name, "auto") == 0) return FLEET_ROLE_AUTO;
+  if (strcmp(name, "standalone") != 0) {
+    Serial.printf("Fleet: Unknown FLEET_ROLE '%s', running standalone\n", name);
+  }
+  return FLEET_ROLE_STANDALONE;
+}
+
+FleetSync::FleetSync() {
+  mqtt = nullptr;
+  assets = nullptr;
+  assetCount = 0;
+  nodeId[0] = '\0';
+  wasConnected = false;
+  appliedSinceLoop = 0;
+  memset(published, 0, sizeof(published));
+  snapshotsPublished = 0;
+  snapshotsReceived = 0;
+  promotions = 0;
+}
+
+void FleetSync::begin(MQTTClient& client, AssetData* assetList, int count) {
+  mqtt = &client;
+  assets = assetList;
+  assetCount = count < SCHEDULER_MAX_ASSETS ? count : SCHEDULER_MAX_ASSETS;
+  FleetRole role = parseRole(FLEET_ROLE);
+  if (role == FLEET_ROLE_STANDALONE) {
+    return;
+  }
+
+  // Every device needs its own client id or the broker keeps kicking one off
+  String mac = WiFi.macAddress();
+  mac.replace(":", "");
+  mac.toLowerCase();
+  snprintf(nodeId, sizeof(nodeId), "%s-%s", MQTT_CLIENT_ID, mac.c_str() + 6);
+  mqtt->setClientId(nodeId);
+
+  statusTopic.format("%s/status", MQTT_TOPIC_PREFIX);
+  claimTopic.format("%s/fleet/gateway", MQTT_TOPIC_PREFIX);
+  snapshotPrefix.format("%s/fleet/snapshot/", MQTT_TOPIC_PREFIX);
+  nodeTopic.format("%s/fleet/node/%s", MQTT_TOPIC_PREFIX, nodeId);
+
+  election.begin(role, nodeId);
+  mqtt->setWillTopic(election.isGateway() ? statusTopic.c_str() : nodeTopic.c_str());
+  mqtt->subscribe(statusTopic.c_str());
+  mqtt->subscribe(claimTopic.c_str());
+  MqttTopic snapshotFilter = snapshotPrefix;
+  snapshotFilter += "+";
+  mqtt->subscribe(snapshotFilter.c_str());
+
+  Serial.printf("Fleet: %s as %s\n", roleName(), nodeId);
+}
+
+const char* FleetSync::roleName() const {
+  switch (election.getRole()) {
+    case FLEET_ROLE_GATEWAY: return "gateway";
+    case FLEET_ROLE_DISPLAY: return "display";
+    case FLEET_ROLE_AUTO: return "auto";
+    default: return "standalone";
+  }
+}
+
+int FleetSync::loop() {
+  int applied = appliedSinceLoop;
+  appliedSinceLoop = 0;
+  if (election.getRole() == FLEET_ROLE_STANDALONE) {
+    return applied;
+  }
+
+  bool connected = mqtt->isConnected();
+  if (connected && !wasConnected) {
+    if (election.isGateway()) {
+      memset(published, 0, sizeof(published)); // Resend every snapshot
+    }
+    apply(election.connected(millis(), esp_random()));
+  }
+  wasConnected = connected;
+  if (!connected) {
+    return applied;
+  }
+
+  apply(election.poll(millis()));
+  if (election.isGateway()) {
+    publishSnapshots();
+  }
+  return applied;
+}
+
+void FleetSync::handleMessage(const char* topic, const uint8_t* payload, unsigned int length) {
+  if (election.getRole() == FLEET_ROLE_STANDALONE) {
+    return;
+  }
+
+  if (statusTopic == topic) {
+    bool online = (length == 6 && memcmp(payload, "online", 6) == 0);
+    apply(election.statusSeen(online, millis(), esp_random()));
+  } else if (claimTopic == topic) {
+    handleClaim(payload, length);
+  } else if (strncmp(topic, snapshotPrefix.c_str(), snapshotPrefix.length()) == 0) {
+    if (!election.isGateway()) {
+      applySnapshot(topic + snapshotPrefix.length(), payload, length);
+    }
+  }
+}
+
+void FleetSync::apply(FleetAction action) {
+  switch (action) {
+    case FLEET_ACTION_CLAIM: publishClaim(); break;
+    case FLEET_ACTION_PROMOTE: promote(); break;
+    case FLEET_ACTION_DEMOTE: demote(); break;
+    default: break;
+  }
+}
+
+void FleetSync::promote() {
+  Serial.println("Fleet: No gateway online, taking over");
+  promotions++;
+
+  // Clear this node's display status, then reconnect with the gateway's Last Will
+  mqtt->publish(nodeTopic.c_str(), "", true);
+  mqtt->setWillTopic(statusTopic.c_str());
+  if (mqtt->restart()) {
+    wasConnected = true;
+    publishClaim();
+    mqtt->publishDiscoveryConfigs(assets, assetCount);
+  }
+  memset(published, 0, sizeof(published));
+}
+
+void FleetSync::demote() {
+  Serial.printf("Fleet: %s is the gateway, stepping down\n", election.getGatewayId());
+  mqtt->setWillTopic(nodeTopic.c_str());
+  mqtt->restart(); // Clean disconnect: the old status Last Will doesn't fire
+  wasConnected = mqtt->isConnected();
+}
+
+void FleetSync::publishClaim() {
+  char payload[80];
+  snprintf(payload, sizeof(payload), "{\"id\":\"%s\",\"forced\":%s}",
+           nodeId, election.getRole() == FLEET_ROLE_GATEWAY ? "true" : "false");
+  mqtt->publish(claimTopic.c_str(), payload, true);
+}
+
+void FleetSync::handleClaim(const uint8_t* payload, unsigned int length) {
+  ArenaJsonDocument doc(JSON_USER_FLEET, 128);
+  if (length == 0 || deserializeJson(doc, (const char*)payload, length) != DeserializationError::Ok) {
+    election.claimSeen("", false);
+    return;
+  }
+  apply(election.claimSeen(doc["id"] | "", doc["forced"] | false));
+}
+
+void FleetSync::publishSnapshots() {
+  unsigned long now = millis();
+  for (int i = 0; i < assetCount; i++) {
+    const AssetData& asset = assets[i];
+    Published& last = published[i];
+    if (asset.price <= 0.0) {
+      continue; // Nothing fetched yet
+    }
+    bool changed = !last.valid || asset.price != last.price || asset.sourceTime != last.sourceTime ||
+                   asset.marketClosed != last.marketClosed || asset.fetchFailed != last.fetchFailed;
+    if (!changed || (last.valid && now - last.sentAt < FLEET_SNAPSHOT_MIN_INTERVAL_MS)) {
+      continue;
+    }
+    if (publishSnapshot(i)) {
+      last.price = asset.price;
+      last.sourceTime = asset.sourceTime;
+      last.marketClosed = asset.marketClosed;
+      last.fetchFailed = asset.fetchFailed;
+      last.sentAt = now;
+      last.valid = true;
+    }
+  }
+}
+
+bool FleetSync::publishSnapshot(int index) {
+  const AssetData& asset = assets[index];
+  ArenaJsonDocument doc(JSON_USER_FLEET, 384);
+  doc["price"] = asset.price;
+  doc["prev"] = asset.previousPrice;
+  doc["up"] = asset.priceIncreased;
+  doc["first"] = asset.firstUpdate;
+  doc["updated"] = asset.lastUpdated;
+  doc["source_time"] = (long)asset.sourceTime;
+  doc["fetch_time"] = (long)asset.fetchTime;
+  doc["closed"] = asset.marketClosed;
+  doc["failed"] = asset.fetchFailed;
+  doc["ch_1h"] = asset.change1h;
+  doc["ch_24h"] = asset.change24h;
+  doc["ch_7d"] = asset.change7d;
+  time_t sentSeconds;
+  uint16_t sentMillis;
+  if (epochNow(sentSeconds, sentMillis)) {
+    doc["sent_s"] = (long)sentSeconds;
+    doc["sent_ms"] = sentMillis;
+  }
+
+  if (doc.overflowed()) {
+    return false; // Counted by the arena; the next snapshot gets more room
+  }
+  char payload[384];
+  size_t length = serializeJson(doc, payload, sizeof(payload));
+  if (length == 0 || length >= sizeof(payload)) {
+    return false;
+  }
+  MqttTopic topic = snapshotPrefix;
+  topic += asset.symbol;
+  if (!mqtt->publish(topic.c_str(), payload, true)) {
+    return false;
+  }
+  snapshotsPublished++;
+  return true;
+}
+
+void FleetSync::applySnapshot(const char* symbol, const uint8_t* payload, unsigned int length) {
+  AssetData* asset = nullptr;
+  for (int i = 0; i < assetCount; i++) {
+    if (strcmp(assets[i].symbol, symbol) == 0) {
+      asset = &assets[i];
+      break;
+    }
+  }
+  if (asset == nullptr || length == 0) {
+    return; // Not shown here, or a cleared retained snapshot
+  }
+
+  ArenaJsonDocument doc(JSON_USER_FLEET, 384);
+  DeserializationError error = deserializeJson(doc, (const char*)payload, length);
+  if (error) {
+    Serial.printf("Fleet: Bad snapshot for %s: %s\n", symbol, error.c_str());
+    return;
+  }
+
+  asset->price = doc["price"] | asset->price;
+  asset->previousPrice = doc["prev"] | asset->previousPrice;
+  asset->priceIncreased = doc["up"] | false;
+  asset->firstUpdate = doc["first"] | false;
+  strlcpy(asset->lastUpdated, doc["updated"] | "", sizeof(asset->lastUpdated));
+  asset->sourceTime = (time_t)(doc["source_time"] | 0L);
+  asset->fetchTime = (time_t)(doc["fetch_time"] | 0L);
+  asset->marketClosed = doc["closed"] | false;
+  asset->fetchFailed = doc["failed"] | false;
+  asset->change1h = doc["ch_1h"] | 0.0f;
+  asset->change24h = doc["ch_24h"] | 0.0f;
+  asset->change7d = doc["ch_7d"] | 0.0f;
+  snapshotsReceived++;
+  appliedSinceLoop++;
+
+  // Fan-out latency: gateway publish to here, on NTP time. Retained snapshots
+  // replayed on (re)subscribe are old and would only skew the histogram.
+  time_t nowSeconds;
+  uint16_t nowMillis;
+  if (doc.containsKey("sent_s") && epochNow(nowSeconds, nowMillis)) {
+    long latencyMs = (long)(nowSeconds - (time_t)doc["sent_s"].as<long>()) * 1000L +
+                     (long)nowMillis - doc["sent_ms"].as<long>();
+    if (latencyMs < 0) {
+      latencyMs = 0; // Clock skew between devices
+    }
+    if (latencyMs <= FLEET_FANOUT_MAX_MS) {
+      metrics.recordFanout(latencyMs);
+    }
+  }
+}
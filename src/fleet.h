@@ -0,0 +1,91 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "crypto_display.h"
+#include "fleet_election.h"
+#include "mqtt_client.h"
+
+// Fleet mode: one gateway device fetches prices and publishes a retained
+// snapshot per asset over MQTT; every other device shows those snapshots and
+// makes no HTTPS requests at all.
+//
+// Topics under <prefix>/fleet:
+//   gateway         retained claim {"id":..,"forced":..} of the acting gateway
+//   snapshot/<SYM>  retained latest state of one asset
+//   node/<id>       retained online/offline of each display (its Last Will)
+// The acting gateway's Last Will is <prefix>/status, so when it drops off the
+// broker flips that to "offline" and "auto" devices elect a successor: after a
+// random wait the first one that still sees no gateway online claims the role.
+// Simultaneous claims settle on the lowest client id; a configured gateway
+// always beats an elected one (see FleetElection).
+
+class FleetSync {
+public:
+  FleetSync();
+
+  // Read FLEET_ROLE, give this device its own client id and Last Will
+  // (call before mqttClient.begin())
+  void begin(MQTTClient& mqtt, AssetData* assets, int count);
+
+  // Run elections and publish changed snapshots when acting as gateway.
+  // Returns the number of assets updated from snapshots since the last call.
+  int loop();
+
+  // Messages from MQTTClient's message handler
+  void handleMessage(const char* topic, const uint8_t* payload, unsigned int length);
+
+  // True when this device fetches prices itself (standalone or acting gateway)
+  bool fetchesPrices() const { return election.getRole() == FLEET_ROLE_STANDALONE || election.isGateway(); }
+
+  FleetRole getRole() const { return election.getRole(); }
+  const char* roleName() const;
+  bool isGateway() const { return election.isGateway(); }
+  const char* getGatewayId() const { return election.getGatewayId(); }
+
+  // Counters for metrics
+  uint32_t getSnapshotsPublished() const { return snapshotsPublished; }
+  uint32_t getSnapshotsReceived() const { return snapshotsReceived; }
+  uint32_t getPromotions() const { return promotions; }
+
+private:
+  // Last snapshot sent per asset, to publish only what changed
+  struct Published {
+    float price;
+    time_t sourceTime;
+    bool marketClosed;
+    bool fetchFailed;
+    unsigned long sentAt;
+    bool valid;
+  };
+
+  MQTTClient* mqtt;
+  AssetData* assets;
+  int assetCount;
+  FleetElection election;
+  char nodeId[32];
+  MqttTopic statusTopic;
+  MqttTopic claimTopic;
+  MqttTopic snapshotPrefix;
+  MqttTopic nodeTopic;
+
+  bool wasConnected;
+  int appliedSinceLoop;
+
+  Published published[SCHEDULER_MAX_ASSETS];
+  uint32_t snapshotsPublished;
+  uint32_t snapshotsReceived;
+  uint32_t promotions;
+
+  void apply(FleetAction action);
+  void promote();
+  void demote();
+  void publishClaim();
+  void publishSnapshots();
+  bool publishSnapshot(int index);
+  void handleClaim(const uint8_t* payload, unsigned int length);
+  void applySnapshot(const char* symbol, const uint8_t* payload, unsigned int length);
+};
+
+#endif // FLEET_H
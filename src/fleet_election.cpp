@@ -0,0 +1,88 @@
+#include "fleet_election.h"
+
+FleetElection::FleetElection() {
+  role = FLEET_ROLE_STANDALONE;
+  nodeId[0] = '\0';
+  gateway = false;
+  gatewayOnline = false;
+  gatewayId[0] = '\0';
+  electionAt = 0;
+}
+
+void FleetElection::begin(FleetRole fleetRole, const char* id) {
+  role = fleetRole;
+  strlcpy(nodeId, id, sizeof(nodeId));
+  gateway = (role == FLEET_ROLE_GATEWAY);
+  gatewayOnline = false;
+  gatewayId[0] = '\0';
+  electionAt = 0;
+}
+
+FleetAction FleetElection::connected(unsigned long now, uint32_t random) {
+  if (gateway) {
+    return claim();
+  }
+  if (role == FLEET_ROLE_AUTO) {
+    scheduleElection(now, FLEET_ELECTION_WAIT_MS, random);
+  }
+  return FLEET_ACTION_NONE;
+}
+
+FleetAction FleetElection::statusSeen(bool online, unsigned long now, uint32_t random) {
+  gatewayOnline = online;
+  if (!gatewayOnline && !gateway && role == FLEET_ROLE_AUTO) {
+    Serial.println("Fleet: Gateway offline, starting election");
+    scheduleElection(now, 0, random);
+  }
+  return FLEET_ACTION_NONE;
+}
+
+FleetAction FleetElection::claimSeen(const char* id, bool forced) {
+  strlcpy(gatewayId, id, sizeof(gatewayId));
+  if (!gateway || id[0] == '\0' || strcmp(id, nodeId) == 0) {
+    return FLEET_ACTION_NONE;
+  }
+
+  // Two gateways: a configured one beats an elected one, then lowest id wins
+  bool otherWins = forced ? (role != FLEET_ROLE_GATEWAY || strcmp(id, nodeId) < 0)
+                          : (role != FLEET_ROLE_GATEWAY && strcmp(id, nodeId) < 0);
+  if (!otherWins) {
+    return claim(); // Reassert so the retained claim ends up naming us
+  }
+  if (role == FLEET_ROLE_AUTO) {
+    gateway = false;
+    return FLEET_ACTION_DEMOTE;
+  }
+  Serial.printf("Fleet: %s is also configured as gateway\n", id);
+  return FLEET_ACTION_NONE;
+}
+
+FleetAction FleetElection::poll(unsigned long now) {
+  if (electionAt == 0 || (long)(now - electionAt) < 0) {
+    return FLEET_ACTION_NONE;
+  }
+  electionAt = 0;
+  if (gateway || gatewayOnline) {
+    return FLEET_ACTION_NONE;
+  }
+  gateway = true;
+  strlcpy(gatewayId, nodeId, sizeof(gatewayId));
+  return FLEET_ACTION_PROMOTE;
+}
+
+// Wait delayMs plus a random share of FLEET_ELECTION_JITTER_MS, so the first
+// candidate to claim is usually seen by the others before they try
+void FleetElection::scheduleElection(unsigned long now, unsigned long delayMs, uint32_t random) {
+  if (electionAt != 0) {
+    return;
+  }
+  electionAt = now + delayMs + random % (FLEET_ELECTION_JITTER_MS + 1);
+  if (electionAt == 0) {
+    electionAt = 1;
+  }
+}
+
+FleetAction FleetElection::claim() {
+  strlcpy(gatewayId, nodeId, sizeof(gatewayId));
+  return FLEET_ACTION_CLAIM;
+}
@@ -0,0 +1,67 @@
+#ifndef FLEET_ELECTION_H
+#define FLEET_ELECTION_H
+
+#include <Arduino.h>
+#include "config.h"
+
+enum FleetRole : uint8_t {
+  FLEET_ROLE_STANDALONE, // Fetch and publish on its own, no fleet topics
+  FLEET_ROLE_GATEWAY,    // Always the gateway
+  FLEET_ROLE_DISPLAY,    // Never fetches, only shows snapshots
+  FLEET_ROLE_AUTO        // Display that takes over when no gateway is online
+};
+
+// What FleetSync has to do after an election event
+enum FleetAction : uint8_t {
+  FLEET_ACTION_NONE,
+  FLEET_ACTION_CLAIM,    // Publish (or reassert) this node's retained claim
+  FLEET_ACTION_PROMOTE,  // Take over: gateway Last Will, then claim
+  FLEET_ACTION_DEMOTE    // Step down to display with the node Last Will
+};
+
+// Gateway election rules, apart from MQTT and JSON so they can be run for a
+// whole simulated fleet. An "auto" node that sees no gateway online waits
+// (plus a random share of FLEET_ELECTION_JITTER_MS) and claims the role if
+// there is still none; when two gateways see each other's claims, a
+// configured one beats an elected one and then the lowest id wins.
+//
+// random is a fresh random number (esp_random() on the device) for the jitter.
+class FleetElection {
+public:
+  FleetElection();
+
+  void begin(FleetRole fleetRole, const char* id);
+
+  // The MQTT connection came up. A gateway claims again; an auto node gives
+  // retained status/claim messages FLEET_ELECTION_WAIT_MS to arrive first.
+  FleetAction connected(unsigned long now, uint32_t random);
+
+  // <prefix>/status changed: "online", or "offline" from the gateway's Last Will
+  FleetAction statusSeen(bool online, unsigned long now, uint32_t random);
+
+  // A claim on <prefix>/fleet/gateway; id is "" when cleared or unreadable
+  FleetAction claimSeen(const char* id, bool forced);
+
+  // Call while connected: PROMOTE once the wait ran out with no gateway online
+  FleetAction poll(unsigned long now);
+
+  FleetRole getRole() const { return role; }
+  const char* getNodeId() const { return nodeId; }
+  bool isGateway() const { return gateway; }
+  bool isGatewayOnline() const { return gatewayOnline; }
+  const char* getGatewayId() const { return gatewayId; }
+  bool electionPending() const { return electionAt != 0; }
+
+private:
+  FleetRole role;
+  char nodeId[32];
+  bool gateway;             // Acting as gateway right now
+  bool gatewayOnline;       // Last <prefix>/status seen was "online"
+  char gatewayId[32];       // Id in the last claim seen or sent
+  unsigned long electionAt; // 0 = no election pending
+
+  void scheduleElection(unsigned long now, unsigned long delayMs, uint32_t random);
+  FleetAction claim();
+};
+
+#endif // FLEET_ELECTION_H
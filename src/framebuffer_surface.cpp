@@ -0,0 +1,321 @@
+#include "framebuffer_surface.h"
+
+// Host-only backend: excluded from firmware builds (the PNG writer alone needs
+// ~190KB of scratch buffers)
+#ifndef ARDUINO
+
+#include <stdio.h>
+#include <string.h>
+
+FramebufferSurface::FramebufferSurface() {
+  memset(buffer, 0, sizeof(buffer));
+  textFont = 1;
+  textSize = 1;
+  textFg = 0xFFFF;
+  textBg = 0x0000;
+  textHasBackground = false;
+  textDatum = 0;
+}
+
+int FramebufferSurface::width() const {
+  return SCREEN_WIDTH;
+}
+
+int FramebufferSurface::height() const {
+  return SCREEN_HEIGHT;
+}
+
+void FramebufferSurface::fillScreen(uint16_t color) {
+  for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+    buffer[i] = color;
+  }
+  countDraw(SCREEN_WIDTH * SCREEN_HEIGHT);
+  countClear();
+}
+
+void FramebufferSurface::fillRect(int x, int y, int w, int h, uint16_t color) {
+  int written = 0;
+  for (int row = y; row < y + h; row++) {
+    for (int col = x; col < x + w; col++) {
+      written += plot(col, row, color);
+    }
+  }
+  countDraw(written);
+}
+
+void FramebufferSurface::drawRoundRect(int x, int y, int w, int h, int r, uint16_t color) {
+  int written = 0;
+
+  // Straight edges
+  for (int col = x + r; col < x + w - r; col++) {
+    written += plot(col, y, color);
+    written += plot(col, y + h - 1, color);
+  }
+  for (int row = y + r; row < y + h - r; row++) {
+    written += plot(x, row, color);
+    written += plot(x + w - 1, row, color);
+  }
+
+  // Corners (midpoint circle, one octant mirrored into each quarter)
+  int left = x + r;
+  int right = x + w - r - 1;
+  int top = y + r;
+  int bottom = y + h - r - 1;
+  int dx = 0;
+  int dy = r;
+  int decision = 1 - r;
+  while (dx <= dy) {
+    written += plot(right + dx, bottom + dy, color) + plot(right + dy, bottom + dx, color);
+    written += plot(left - dx, bottom + dy, color) + plot(left - dy, bottom + dx, color);
+    written += plot(right + dx, top - dy, color) + plot(right + dy, top - dx, color);
+    written += plot(left - dx, top - dy, color) + plot(left - dy, top - dx, color);
+    dx++;
+    if (decision < 0) {
+      decision += 2 * dx + 1;
+    } else {
+      dy--;
+      decision += 2 * (dx - dy) + 1;
+    }
+  }
+
+  countDraw(written);
+}
+
+void FramebufferSurface::fillCircle(int x, int y, int r, uint16_t color) {
+  int written = 0;
+  for (int dy = -r; dy <= r; dy++) {
+    for (int dx = -r; dx <= r; dx++) {
+      if (dx * dx + dy * dy <= r * r) {
+        written += plot(x + dx, y + dy, color);
+      }
+    }
+  }
+  countDraw(written);
+}
+
+void FramebufferSurface::pushImage(int x, int y, int w, int h, const uint16_t* pixels) {
+  int written = 0;
+  for (int row = 0; row < h; row++) {
+    for (int col = 0; col < w; col++) {
+      written += plot(x + col, y + row, pixels[row * w + col]);
+    }
+  }
+  countDraw(written);
+}
+
+void FramebufferSurface::setTextFont(int font) {
+  textFont = font;
+}
+
+void FramebufferSurface::setTextSize(int size) {
+  textSize = size;
+}
+
+void FramebufferSurface::setTextColor(uint16_t fg) {
+  textFg = fg;
+  textHasBackground = false;
+}
+
+void FramebufferSurface::setTextColor(uint16_t fg, uint16_t bg) {
+  textFg = fg;
+  textBg = bg;
+  textHasBackground = true;
+}
+
+void FramebufferSurface::setTextDatum(uint8_t datum) {
+  textDatum = datum;
+}
+
+int FramebufferSurface::drawString(const char* text, int x, int y) {
+  int boxWidth = textWidth(text);
+  int boxHeight = fontHeight();
+
+  // Resolve datum to the top-left corner of the text box
+  int horizontal = textDatum & 0x03;
+  int vertical = textDatum & 0x0C;
+  if (horizontal == 1) x -= boxWidth / 2;
+  else if (horizontal == 2) x -= boxWidth;
+  if (vertical == 4) y -= boxHeight / 2;
+  else if (vertical == 8) y -= boxHeight;
+
+  int cell = charWidth();
+  int written = 0;
+
+  for (int i = 0; text[i] != '\0'; i++) {
+    int cellX = x + i * cell;
+    for (int row = 0; row < boxHeight; row++) {
+      for (int col = 0; col < cell; col++) {
+        if (inkAt(text[i], col, row)) {
+          written += plot(cellX + col, y + row, textFg);
+        } else if (textHasBackground) {
+          written += plot(cellX + col, y + row, textBg);
+        }
+      }
+    }
+  }
+
+  countDraw(written);
+  return boxWidth;
+}
+
+int FramebufferSurface::textWidth(const char* text) {
+  return (int)strlen(text) * charWidth();
+}
+
+bool FramebufferSurface::rasterizeChar(char c, int x, int w, int h, uint8_t* mask) {
+  int stride = (w + 7) / 8;
+  for (int row = 0; row < h && row < fontHeight(); row++) {
+    for (int col = x; col < w && col < x + charWidth(); col++) {
+      if (col >= 0 && inkAt(c, col - x, row)) {
+        mask[row * stride + (col >> 3)] |= 0x80 >> (col & 7);
+      }
+    }
+  }
+  return true;
+}
+
+uint16_t FramebufferSurface::pixel(int x, int y) const {
+  if (x < 0 || y < 0 || x >= SCREEN_WIDTH || y >= SCREEN_HEIGHT) {
+    return 0;
+  }
+  return buffer[y * SCREEN_WIDTH + x];
+}
+
+int FramebufferSurface::countDifferences(const FramebufferSurface& other) const {
+  int differences = 0;
+  for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+    if (buffer[i] != other.buffer[i]) {
+      differences++;
+    }
+  }
+  return differences;
+}
+
+int FramebufferSurface::plot(int x, int y, uint16_t color) {
+  if (x < 0 || y < 0 || x >= SCREEN_WIDTH || y >= SCREEN_HEIGHT) {
+    return 0;
+  }
+  buffer[y * SCREEN_WIDTH + x] = color;
+  return 1;
+}
+
+int FramebufferSurface::charWidth() const {
+  // GLCD font 1 is 6x8; font 2 averages 8 pixels per glyph at 16 pixels tall
+  return (textFont == 1 ? 6 : 8) * textSize;
+}
+
+bool FramebufferSurface::inkAt(char c, int col, int row) const {
+  int inset = textSize; // Leave a one-pixel (scaled) gutter around each glyph
+  return c != ' ' &&
+         col >= inset && col < charWidth() - inset &&
+         row >= inset * 2 && row < fontHeight() - inset * 2;
+}
+
+int FramebufferSurface::fontHeight() const {
+  return (textFont == 1 ? 8 : 16) * textSize;
+}
+
+// --- PNG output (stored deflate blocks, no compression library needed) ---
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t length) {
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+  }
+  return ~crc;
+}
+
+static void writeBigEndian32(uint8_t* out, uint32_t value) {
+  out[0] = (uint8_t)(value >> 24);
+  out[1] = (uint8_t)(value >> 16);
+  out[2] = (uint8_t)(value >> 8);
+  out[3] = (uint8_t)value;
+}
+
+static bool writeChunk(FILE* file, const char* type, const uint8_t* data, uint32_t length) {
+  uint8_t header[8];
+  writeBigEndian32(header, length);
+  memcpy(header + 4, type, 4);
+
+  uint32_t crc = crc32Update(0, header + 4, 4);
+  crc = crc32Update(crc, data, length);
+  uint8_t trailer[4];
+  writeBigEndian32(trailer, crc);
+
+  return fwrite(header, 1, 8, file) == 8 &&
+         (length == 0 || fwrite(data, 1, length, file) == length) &&
+         fwrite(trailer, 1, 4, file) == 4;
+}
+
+bool FramebufferSurface::writePng(const char* path) const {
+  static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  const uint32_t rowBytes = 1 + SCREEN_WIDTH * 3; // Filter byte + RGB888
+  const uint32_t rawBytes = rowBytes * SCREEN_HEIGHT;
+  const uint32_t blockMax = 65535;
+  const uint32_t blockCount = (rawBytes + blockMax - 1) / blockMax;
+  const uint32_t idatBytes = 2 + rawBytes + blockCount * 5 + 4;
+
+  // Scanlines: filter type 0, RGB565 expanded to RGB888
+  static uint8_t raw[(1 + SCREEN_WIDTH * 3) * SCREEN_HEIGHT];
+  uint8_t* out = raw;
+  for (int y = 0; y < SCREEN_HEIGHT; y++) {
+    *out++ = 0;
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+      uint16_t color = buffer[y * SCREEN_WIDTH + x];
+      uint8_t r = (color >> 11) & 0x1F;
+      uint8_t g = (color >> 5) & 0x3F;
+      uint8_t b = color & 0x1F;
+      *out++ = (uint8_t)((r << 3) | (r >> 2));
+      *out++ = (uint8_t)((g << 2) | (g >> 4));
+      *out++ = (uint8_t)((b << 3) | (b >> 2));
+    }
+  }
+
+  // zlib stream of stored blocks plus Adler-32
+  static uint8_t idat[2 + sizeof(raw) + ((sizeof(raw) + 65534) / 65535) * 5 + 4];
+  uint8_t* z = idat;
+  *z++ = 0x78;
+  *z++ = 0x01;
+  uint32_t adlerA = 1;
+  uint32_t adlerB = 0;
+  for (uint32_t offset = 0; offset < rawBytes; offset += blockMax) {
+    uint32_t length = rawBytes - offset < blockMax ? rawBytes - offset : blockMax;
+    *z++ = (offset + length == rawBytes) ? 1 : 0;
+    *z++ = (uint8_t)length;
+    *z++ = (uint8_t)(length >> 8);
+    *z++ = (uint8_t)~length;
+    *z++ = (uint8_t)(~length >> 8);
+    memcpy(z, raw + offset, length);
+    z += length;
+    for (uint32_t i = 0; i < length; i++) {
+      adlerA = (adlerA + raw[offset + i]) % 65521;
+      adlerB = (adlerB + adlerA) % 65521;
+    }
+  }
+  writeBigEndian32(z, (adlerB << 16) | adlerA);
+
+  uint8_t ihdr[13];
+  writeBigEndian32(ihdr, SCREEN_WIDTH);
+  writeBigEndian32(ihdr + 4, SCREEN_HEIGHT);
+  ihdr[8] = 8;  // Bit depth
+  ihdr[9] = 2;  // Color type: truecolor
+  ihdr[10] = 0; // Compression
+  ihdr[11] = 0; // Filter
+  ihdr[12] = 0; // Interlace
+
+  FILE* file = fopen(path, "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  bool ok = fwrite(signature, 1, sizeof(signature), file) == sizeof(signature) &&
+            writeChunk(file, "IHDR", ihdr, sizeof(ihdr)) &&
+            writeChunk(file, "IDAT", idat, idatBytes) &&
+            writeChunk(file, "IEND", nullptr, 0);
+  fclose(file);
+  return ok;
+}
+
+#endif // ARDUINO
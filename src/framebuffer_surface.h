@@ -0,0 +1,60 @@
+#ifndef FRAMEBUFFER_SURFACE_H
+#define FRAMEBUFFER_SURFACE_H
+
+#include "display_surface.h"
+#include "config.h"
+
+// In-memory RGB565 DisplaySurface for host-side rendering benchmarks and
+// golden-image comparisons. Geometry is rasterized exactly; text is drawn as
+// solid glyph cells using the font's cell size (the LCD fonts are not
+// available off-device), which keeps layout and pixel counts realistic.
+class FramebufferSurface : public DisplaySurface {
+public:
+  FramebufferSurface();
+
+  int width() const override;
+  int height() const override;
+
+  void fillScreen(uint16_t color) override;
+  void fillRect(int x, int y, int w, int h, uint16_t color) override;
+  void drawRoundRect(int x, int y, int w, int h, int r, uint16_t color) override;
+  void fillCircle(int x, int y, int r, uint16_t color) override;
+  void pushImage(int x, int y, int w, int h, const uint16_t* pixels) override;
+
+  void setTextFont(int font) override;
+  void setTextSize(int size) override;
+  void setTextColor(uint16_t fg) override;
+  void setTextColor(uint16_t fg, uint16_t bg) override;
+  void setTextDatum(uint8_t datum) override;
+  int drawString(const char* text, int x, int y) override;
+  int textWidth(const char* text) override;
+  int fontHeight() const override;
+  bool rasterizeChar(char c, int x, int w, int h, uint8_t* mask) override;
+
+  // Framebuffer access
+  uint16_t pixel(int x, int y) const;
+  const uint16_t* pixels() const { return buffer; }
+
+  // Number of pixels that differ from another framebuffer (0 = identical)
+  int countDifferences(const FramebufferSurface& other) const;
+
+  // Write the framebuffer as an uncompressed 24-bit PNG. Returns false on I/O error.
+  bool writePng(const char* path) const;
+
+private:
+  uint16_t buffer[SCREEN_WIDTH * SCREEN_HEIGHT];
+
+  int textFont;
+  int textSize;
+  uint16_t textFg;
+  uint16_t textBg;
+  bool textHasBackground;
+  uint8_t textDatum;
+
+  // Writes one pixel if on screen; returns 1 if written (for counting)
+  int plot(int x, int y, uint16_t color);
+  int charWidth() const;
+  bool inkAt(char c, int col, int row) const; // Solid cell with a gutter
+};
+
+#endif // FRAMEBUFFER_SURFACE_H
@@ -0,0 +1,62 @@
+#include "fx_table.h"
+
+FxTable::FxTable() {
+  memset(entries, 0, sizeof(entries));
+  count = 0;
+  pairsNeeded = false;
+  updatedAt = 0;
+}
+
+int FxTable::find(const char* code) const {
+  for (int i = 0; i < count; i++) {
+    if (strcmp(entries[i].code, code) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int FxTable::add(const char* code) {
+  int index = find(code);
+  if (index >= 0) {
+    return index;
+  }
+  if (count >= FX_MAX_CURRENCIES || strlen(code) != 3) {
+    Serial.printf("FX: Cannot track currency '%s'\n", code);
+    return -1;
+  }
+  Entry& entry = entries[count];
+  strlcpy(entry.code, code, sizeof(entry.code));
+  entry.perUsd = (strcmp(code, "USD") == 0) ? 1.0f : 0.0f;
+  return count++;
+}
+
+void FxTable::addPair(const char* from, const char* to) {
+  if (strcmp(from, to) == 0) {
+    return;
+  }
+  if (add(from) >= 0 && add(to) >= 0) {
+    pairsNeeded = true;
+  }
+}
+
+void FxTable::setRate(const char* code, float perUsd) {
+  int index = find(code);
+  if (index >= 0 && perUsd > 0.0f) {
+    entries[index].perUsd = perUsd;
+  }
+}
+
+bool FxTable::convert(float amount, const char* from, const char* to, float& out) const {
+  if (strcmp(from, to) == 0) {
+    out = amount;
+    return true;
+  }
+  int fromIndex = find(from);
+  int toIndex = find(to);
+  if (fromIndex < 0 || toIndex < 0 || entries[fromIndex].perUsd <= 0.0f || entries[toIndex].perUsd <= 0.0f) {
+    return false;
+  }
+  out = amount * (entries[toIndex].perUsd / entries[fromIndex].perUsd);
+  return true;
+}
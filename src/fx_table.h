@@ -0,0 +1,50 @@
+#ifndef FX_TABLE_H
+#define FX_TABLE_H
+
+#include <Arduino.h>
+#include <time.h>
+#include "config.h"
+
+// Small table of fiat exchange rates, all stored as units per US dollar so
+// any pair converts through one cross rate. Each asset is fetched once in its
+// provider's quote currency and converted here into its display currency, so
+// adding display currencies costs no extra provider requests - only this
+// table, refreshed on its own slower schedule (FX_REFRESH_MS).
+class FxTable {
+public:
+  FxTable();
+
+  // Register a conversion the device will need (both codes join the table)
+  void addPair(const char* from, const char* to);
+
+  // True when some registered pair actually needs a rate
+  bool isNeeded() const { return pairsNeeded; }
+
+  // Currencies to request from the rate provider
+  int currencyCount() const { return count; }
+  const char* currency(int index) const { return entries[index].code; }
+
+  // Store a rate (units of `code` per US dollar) from the provider
+  void setRate(const char* code, float perUsd);
+  void markUpdated(time_t at) { updatedAt = at; }
+  time_t getUpdatedAt() const { return updatedAt; }
+
+  // Convert amount; false while either rate is unknown (same currency always works)
+  bool convert(float amount, const char* from, const char* to, float& out) const;
+
+private:
+  struct Entry {
+    char code[4];
+    float perUsd;    // 0 = not fetched yet
+  };
+
+  Entry entries[FX_MAX_CURRENCIES];
+  int count;
+  bool pairsNeeded;
+  time_t updatedAt;
+
+  int find(const char* code) const;
+  int add(const char* code);
+};
+
+#endif // FX_TABLE_H
@@ -0,0 +1,204 @@
+#include "glyph_atlas.h"
+#include "mem_alloc.h"
+
+const char* GlyphAtlas::PRICE_CHARSET = "0123456789,.$-";
+
+static bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+GlyphAtlas::GlyphAtlas()
+  : charset(PRICE_CHARSET),
+    glyphCount(0),
+    masks(nullptr),
+    cell(nullptr),
+    maskBytes(0),
+    cellBytes(0),
+    cellHeight(0),
+    maxAdvance(0),
+    blits(0),
+    skipped(0),
+    fullDraws(0),
+    rollingDraws(0) {
+  memset(glyphs, 0, sizeof(glyphs));
+}
+
+GlyphAtlas::~GlyphAtlas() {
+  release();
+}
+
+void GlyphAtlas::release() {
+  memFree(masks);
+  memFree(cell);
+  masks = nullptr;
+  cell = nullptr;
+  maskBytes = 0;
+  cellBytes = 0;
+}
+
+int GlyphAtlas::glyphIndex(char c) const {
+  if (c == '\0') {
+    return -1;
+  }
+  const char* found = strchr(charset, c);
+  return found != nullptr && found - charset < glyphCount ? (int)(found - charset) : -1;
+}
+
+bool GlyphAtlas::build(DisplaySurface& surface, const char* chars) {
+  release();
+  charset = chars;
+  glyphCount = (int)strlen(chars);
+  cellHeight = surface.fontHeight();
+  if (glyphCount > MAX_GLYPHS) {
+    glyphCount = 0;
+    return false;
+  }
+
+  // Digits get the widest digit's advance so changing one never moves the rest
+  int advances[MAX_GLYPHS];
+  int digitAdvance = 0;
+  for (int i = 0; i < glyphCount; i++) {
+    char text[2] = { charset[i], '\0' };
+    advances[i] = surface.textWidth(text);
+    if (isDigit(charset[i]) && advances[i] > digitAdvance) {
+      digitAdvance = advances[i];
+    }
+  }
+
+  size_t total = 0;
+  maxAdvance = 0;
+  for (int i = 0; i < glyphCount; i++) {
+    int advance = isDigit(charset[i]) ? digitAdvance : advances[i];
+    glyphs[i].offset = (uint16_t)total;
+    glyphs[i].advance = (uint8_t)advance;
+    total += (size_t)(advance + 7) / 8 * cellHeight;
+    if (advance > maxAdvance) {
+      maxAdvance = advance;
+    }
+  }
+  if (cellHeight <= 0 || maxAdvance <= 0 || maxAdvance > 255 || total > UINT16_MAX) {
+    return false;
+  }
+
+  // Masks are read by the CPU only; the cell is what gets pushed over SPI
+  uint8_t* built = (uint8_t*)memCalloc(total, 1, MEM_INTERNAL);
+  uint16_t* scratch = (uint16_t*)memAlloc((size_t)maxAdvance * cellHeight * sizeof(uint16_t), MEM_DMA);
+  if (built == nullptr || scratch == nullptr) {
+    memFree(built);
+    memFree(scratch);
+    return false;
+  }
+
+  for (int i = 0; i < glyphCount; i++) {
+    // Narrower digits sit centered in the shared advance
+    int x = (glyphs[i].advance - advances[i]) / 2;
+    if (!surface.rasterizeChar(charset[i], x, glyphs[i].advance, cellHeight, built + glyphs[i].offset)) {
+      memFree(built);
+      memFree(scratch);
+      return false;
+    }
+  }
+
+  masks = built;
+  cell = scratch;
+  maskBytes = total;
+  cellBytes = (size_t)maxAdvance * cellHeight * sizeof(uint16_t);
+  Serial.printf("Glyph atlas: %d glyphs, %d pixels tall, %u bytes\n",
+                glyphCount, cellHeight, (unsigned)memoryBytes());
+  return true;
+}
+
+bool GlyphAtlas::covers(const char* text) const {
+  for (int i = 0; text[i] != '\0'; i++) {
+    if (glyphIndex(text[i]) < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int GlyphAtlas::textWidth(const char* text) const {
+  int width = 0;
+  for (int i = 0; text[i] != '\0'; i++) {
+    int index = glyphIndex(text[i]);
+    if (index >= 0) {
+      width += glyphs[index].advance;
+    }
+  }
+  return width;
+}
+
+bool GlyphAtlas::sameLayout(const char* a, const char* b) const {
+  int i = 0;
+  for (; a[i] != '\0' && b[i] != '\0'; i++) {
+    bool digitA = isDigit(a[i]);
+    bool digitB = isDigit(b[i]);
+    if (digitA != digitB || (!digitA && a[i] != b[i])) {
+      return false;
+    }
+  }
+  return a[i] == b[i]; // Both ended
+}
+
+int GlyphAtlas::drawText(DisplaySurface& surface, const char* text, int x, int y,
+                         uint16_t fg, uint16_t bg, const char* previous) {
+  bool rolling = previous != nullptr && sameLayout(text, previous);
+  if (rolling) {
+    rollingDraws++;
+  } else {
+    fullDraws++;
+  }
+
+  int startX = x;
+  for (int i = 0; text[i] != '\0'; i++) {
+    int index = glyphIndex(text[i]);
+    if (index < 0) {
+      continue;
+    }
+    if (rolling && text[i] == previous[i]) {
+      skipped++;
+    } else {
+      blit(surface, index, x, y, fg, bg);
+    }
+    x += glyphs[index].advance;
+  }
+  return x - startX;
+}
+
+int GlyphAtlas::drawText(uint16_t* buffer, int bufferWidth, int bufferHeight, const char* text, int x, int y,
+                         uint16_t fg, uint16_t bg) const {
+  int startX = x;
+  for (int i = 0; text[i] != '\0'; i++) {
+    int index = glyphIndex(text[i]);
+    if (index < 0) {
+      continue;
+    }
+    const Glyph& glyph = glyphs[index];
+    int stride = (glyph.advance + 7) / 8;
+    int left = x < 0 ? -x : 0;
+    int right = x + glyph.advance > bufferWidth ? bufferWidth - x : glyph.advance;
+    for (int r = y < 0 ? -y : 0; r < cellHeight && y + r < bufferHeight; r++) {
+      const uint8_t* row = masks + glyph.offset + r * stride;
+      uint16_t* out = buffer + (y + r) * bufferWidth;
+      for (int c = left; c < right; c++) {
+        out[x + c] = (row[c >> 3] & (0x80 >> (c & 7))) ? fg : bg;
+      }
+    }
+    x += glyph.advance;
+  }
+  return x - startX;
+}
+
+void GlyphAtlas::blit(DisplaySurface& surface, int index, int x, int y, uint16_t fg, uint16_t bg) {
+  const Glyph& glyph = glyphs[index];
+  int stride = (glyph.advance + 7) / 8;
+  const uint8_t* row = masks + glyph.offset;
+  uint16_t* out = cell;
+  for (int r = 0; r < cellHeight; r++, row += stride) {
+    for (int c = 0; c < glyph.advance; c++) {
+      *out++ = (row[c >> 3] & (0x80 >> (c & 7))) ? fg : bg;
+    }
+  }
+  surface.pushImage(x, y, glyph.advance, cellHeight, cell);
+  blits++;
+}
@@ -0,0 +1,84 @@
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include <Arduino.h>
+#include "display_surface.h"
+
+// Characters pre-rasterized from the surface's font (by default those a
+// price can contain), for redraws that skip font rendering and measuring.
+//
+// Glyphs are stored as 1-bit masks (font 2 has no anti-aliasing, so nothing
+// is lost) and expanded to RGB565 into one DMA-capable cell buffer per blit.
+// All digits share the widest digit's advance, so a price's width follows
+// from its characters, and a new price with the same layout (length and
+// separator positions) as the one on screen only needs the digits that
+// changed drawn, ticker style.
+class GlyphAtlas {
+public:
+  GlyphAtlas();
+  ~GlyphAtlas();
+
+  // Rasterize charset (at most MAX_GLYPHS characters) in the surface's
+  // current font and size. Returns false (and the caller keeps using
+  // drawString) when the surface can't read glyphs back.
+  bool build(DisplaySurface& surface, const char* charset = PRICE_CHARSET);
+  bool ready() const { return masks != nullptr; }
+
+  // True when every character of text is in the atlas
+  bool covers(const char* text) const;
+
+  // Width without measuring; text must be covered
+  int textWidth(const char* text) const;
+  int height() const { return cellHeight; }
+
+  // Draw text with its top-left at x,y. When previous is the text already
+  // drawn at the same spot and has the same layout, only the cells that
+  // differ are drawn. Returns the width.
+  int drawText(DisplaySurface& surface, const char* text, int x, int y,
+               uint16_t fg, uint16_t bg, const char* previous = nullptr);
+
+  // Draw text into an RGB565 buffer (for off-screen strips), clipped to it.
+  // Uncovered characters are skipped. Returns the width.
+  int drawText(uint16_t* buffer, int bufferWidth, int bufferHeight, const char* text, int x, int y,
+               uint16_t fg, uint16_t bg) const;
+
+  // Same length, separators in the same places
+  bool sameLayout(const char* a, const char* b) const;
+
+  // Statistics
+  size_t memoryBytes() const { return maskBytes + cellBytes; }
+  uint32_t blitCount() const { return blits; }          // Glyph cells drawn
+  uint32_t skippedCount() const { return skipped; }     // Unchanged cells left alone
+  uint32_t fullDrawCount() const { return fullDraws; }  // Whole-text draws
+  uint32_t rollingDrawCount() const { return rollingDraws; } // Changed digits only
+
+  static const char* PRICE_CHARSET; // "0123456789,.$-"
+  static constexpr int MAX_GLYPHS = 40;
+
+private:
+  struct Glyph {
+    uint16_t offset; // Into masks
+    uint8_t advance;
+  };
+
+  const char* charset;
+  int glyphCount;
+  Glyph glyphs[MAX_GLYPHS];
+  uint8_t* masks;
+  uint16_t* cell; // One glyph in RGB565, pushed to the surface
+  size_t maskBytes;
+  size_t cellBytes;
+  int cellHeight;
+  int maxAdvance;
+
+  uint32_t blits;
+  uint32_t skipped;
+  uint32_t fullDraws;
+  uint32_t rollingDraws;
+
+  int glyphIndex(char c) const;
+  void release();
+  void blit(DisplaySurface& surface, int index, int x, int y, uint16_t fg, uint16_t bg);
+};
+
+#endif // GLYPH_ATLAS_H
@@ -0,0 +1,131 @@
+#include "grid_view.h"
+#include <M5Unified.h>
+
+// Table area: inside the frame, under the header
+static const int GRID_X = FRAME_MARGIN + 4;
+static const int GRID_WIDTH = SCREEN_WIDTH - (FRAME_MARGIN + 4) * 2;
+static const int GRID_HEIGHT = SCREEN_HEIGHT - FRAME_MARGIN - 4 - GRID_Y_POS;
+
+// One-pixel dividers between columns
+static const int CELL_WIDTH = (GRID_WIDTH - (GRID_COLUMNS - 1)) / GRID_COLUMNS;
+static const int CELL_HEIGHT = GRID_HEIGHT / GRID_ROWS;
+static const int CELL_PADDING = 4;
+
+GridView::GridView(DisplaySurface& target) : surface(target) {
+  for (int i = 0; i < GRID_CELLS; i++) {
+    cells[i].priceColor = COLOR_PRICE;
+    cells[i].changeColor = COLOR_TEXT;
+    cells[i].dirty = true;
+  }
+  dividersDirty = true;
+  cellDraws = 0;
+}
+
+void GridView::cellRect(int slot, int& x, int& y, int& w, int& h) {
+  int column = slot % GRID_COLUMNS;
+  int row = slot / GRID_COLUMNS;
+  x = GRID_X + column * (CELL_WIDTH + 1);
+  y = GRID_Y_POS + row * CELL_HEIGHT;
+  w = CELL_WIDTH;
+  h = CELL_HEIGHT;
+}
+
+void GridView::invalidate() {
+  for (int i = 0; i < GRID_CELLS; i++) {
+    cells[i].dirty = true;
+  }
+  dividersDirty = true;
+}
+
+void GridView::invalidateBand(int bandY, int bandHeight) {
+  for (int i = 0; i < GRID_CELLS; i++) {
+    int x, y, w, h;
+    cellRect(i, x, y, w, h);
+    if (overlaps(y, h, bandY, bandHeight)) {
+      cells[i].dirty = true;
+    }
+  }
+  dividersDirty = true;
+}
+
+void GridView::setCell(int slot, const char* symbol, const char* price, uint16_t priceColor,
+                       const char* change, uint16_t changeColor) {
+  Cell& cell = cells[slot];
+  if (cell.symbol == symbol && cell.price == price && cell.change == change &&
+      cell.priceColor == priceColor && cell.changeColor == changeColor) {
+    return;
+  }
+  cell.symbol = symbol;
+  cell.price = price;
+  cell.change = change;
+  cell.priceColor = priceColor;
+  cell.changeColor = changeColor;
+  cell.dirty = true;
+}
+
+void GridView::clearCell(int slot) {
+  setCell(slot, "", "", COLOR_PRICE, "", COLOR_TEXT);
+}
+
+int GridView::draw(int bandY, int bandHeight) {
+  int drawn = 0;
+  for (int i = 0; i < GRID_CELLS; i++) {
+    if (!cells[i].dirty) {
+      continue;
+    }
+    int x, y, w, h;
+    cellRect(i, x, y, w, h);
+    if (overlaps(y, h, bandY, bandHeight)) {
+      continue;
+    }
+    drawCell(i);
+    cells[i].dirty = false;
+    drawn++;
+  }
+  // Dividers run the full height, so they wait for the band too
+  if (dividersDirty && bandHeight <= 0) {
+    drawDividers();
+    dividersDirty = false;
+  }
+  cellDraws += drawn;
+  return drawn;
+}
+
+void GridView::drawCell(int slot) {
+  const Cell& cell = cells[slot];
+  int x, y, w, h;
+  cellRect(slot, x, y, w, h);
+  surface.fillRect(x, y, w, h, COLOR_BACKGROUND);
+  if (cell.symbol.isEmpty()) {
+    return;
+  }
+
+  // Top line: symbol left, 24h change right (GLCD font, 8 px)
+  surface.setTextFont(1);
+  surface.setTextSize(1);
+  surface.setTextColor(COLOR_TEXT, COLOR_BACKGROUND);
+  surface.setTextDatum(TL_DATUM);
+  surface.drawString(cell.symbol.c_str(), x + CELL_PADDING, y + 1);
+  if (!cell.change.isEmpty()) {
+    surface.setTextColor(cell.changeColor, COLOR_BACKGROUND);
+    surface.setTextDatum(TR_DATUM);
+    surface.drawString(cell.change.c_str(), x + w - CELL_PADDING, y + 1);
+  }
+
+  // Price below (font 2, 16 px)
+  surface.setTextFont(2);
+  surface.setTextColor(cell.priceColor, COLOR_BACKGROUND);
+  surface.setTextDatum(TL_DATUM);
+  surface.drawString(cell.price.c_str(), x + CELL_PADDING, y + 9);
+}
+
+void GridView::drawDividers() {
+  for (int column = 1; column < GRID_COLUMNS; column++) {
+    int x = GRID_X + column * (CELL_WIDTH + 1) - 1;
+    surface.fillRect(x, GRID_Y_POS, 1, CELL_HEIGHT * GRID_ROWS, COLOR_FRAME);
+  }
+}
+
+bool GridView::overlaps(int y, int h, int bandY, int bandHeight) {
+  return bandHeight > 0 && y < bandY + bandHeight && bandY < y + h;
+}
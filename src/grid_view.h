@@ -0,0 +1,64 @@
+#ifndef GRID_VIEW_H
+#define GRID_VIEW_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "display_surface.h"
+#include "fixed_string.h"
+
+#define GRID_CELLS (GRID_COLUMNS * GRID_ROWS)
+
+// Overview page: up to GRID_CELLS assets in a table of cells (symbol and
+// 24h change on top, price below).
+//
+// Each cell keeps the text it last drew and redraws only itself, and only
+// when that text changes, so a price update costs one cell instead of a
+// full-screen repaint. Main loop only; the caller owns the screen around it
+// (header, frame, overlays).
+class GridView {
+public:
+  explicit GridView(DisplaySurface& target);
+
+  // The screen was cleared: every cell and the dividers draw again
+  void invalidate();
+
+  // Something drew over rows y..y+height (a toast): the cells there draw again
+  void invalidateBand(int y, int height);
+
+  // Cell contents; marks the cell dirty only when something changed
+  void setCell(int slot, const char* symbol, const char* price, uint16_t priceColor,
+               const char* change, uint16_t changeColor);
+  void clearCell(int slot); // Empty slot (last page)
+
+  // Draw the dirty cells, except those overlapping rows y..y+height (kept
+  // dirty until the band is free; pass a zero height for none). Returns the
+  // number of cells drawn.
+  int draw(int bandY, int bandHeight);
+
+  // Cell geometry
+  static void cellRect(int slot, int& x, int& y, int& w, int& h);
+
+  // Statistics
+  uint32_t cellDrawCount() const { return cellDraws; }
+
+private:
+  struct Cell {
+    FixedString<12> symbol;
+    FixedString<24> price;
+    FixedString<16> change;
+    uint16_t priceColor;
+    uint16_t changeColor;
+    bool dirty;
+  };
+
+  DisplaySurface& surface;
+  Cell cells[GRID_CELLS];
+  bool dividersDirty;
+  uint32_t cellDraws;
+
+  void drawCell(int slot);
+  void drawDividers();
+  static bool overlaps(int y, int h, int bandY, int bandHeight);
+};
+
+#endif // GRID_VIEW_H
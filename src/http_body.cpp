@@ -0,0 +1,394 @@
+#include "http_body.h"
+#include "mem_alloc.h"
+
+// gzip member header flags (RFC 1952)
+#define GZIP_FHCRC 0x02
+#define GZIP_FEXTRA 0x04
+#define GZIP_FNAME 0x08
+#define GZIP_FCOMMENT 0x10
+
+HttpBodyStream::HttpBodyStream() {
+  source = nullptr;
+  inflator = nullptr;
+  window = nullptr;
+  gzip = false;
+  wireCount = 0;
+  decodedCount = 0;
+  inflateUs = 0;
+  bufferSize = 0;
+  failure = nullptr;
+}
+
+HttpBodyStream::~HttpBodyStream() {
+  release();
+}
+
+void HttpBodyStream::prepareRequest(HTTPClient& http) {
+  static const char* headers[] = {"Content-Encoding", "Transfer-Encoding"};
+  http.collectHeaders(headers, 2);
+#if HTTP_ACCEPT_GZIP
+  // HTTPClient already sends "Accept-Encoding: identity;q=1,chunked;q=0.1,*;q=0";
+  // servers merge repeated fields, and listing gzip explicitly overrides the *
+  http.addHeader("Accept-Encoding", "gzip");
+#endif
+}
+
+bool HttpBodyStream::begin(HTTPClient& http) {
+  release();
+  source = http.getStreamPtr();
+  remaining = http.getSize();
+  chunked = http.header("Transfer-Encoding").equalsIgnoreCase("chunked");
+  chunkRemaining = 0;
+  bodyDone = false;
+  inputPos = 0;
+  inputLength = 0;
+  gzip = false;
+  wireCount = 0;
+  decodedCount = 0;
+  inflateUs = 0;
+  bufferSize = sizeof(input);
+  failure = nullptr;
+  if (chunked) {
+    remaining = -1;
+  }
+  if (source == nullptr) {
+    return fail("No response stream");
+  }
+
+  String encoding = http.header("Content-Encoding");
+  if (encoding.isEmpty() || encoding.equalsIgnoreCase("identity")) {
+    return true;
+  }
+  if (!encoding.equalsIgnoreCase("gzip")) {
+    return fail("Unsupported Content-Encoding");
+  }
+
+  gzip = true;
+  // About 43KB per request: PSRAM keeps it out of the heap TLS is using right now
+  inflator = (tinfl_decompressor*)memAlloc(sizeof(tinfl_decompressor), MEM_BULK);
+  window = (uint8_t*)memAlloc(TINFL_LZ_DICT_SIZE, MEM_BULK);
+  if (inflator == nullptr || window == nullptr) {
+    return fail("Out of memory for inflate");
+  }
+  bufferSize += sizeof(tinfl_decompressor) + TINFL_LZ_DICT_SIZE;
+  tinfl_init(inflator);
+  windowOffset = 0;
+  outputPos = 0;
+  outputEnd = 0;
+  inflateDone = false;
+  needsInput = true;
+  crc = 0;
+  return readGzipHeader();
+}
+
+bool HttpBodyStream::end() {
+  if (source != nullptr && failure == nullptr) {
+    if (gzip) {
+      while (!inflateDone && failure == nullptr) {
+        outputPos = outputEnd;
+        if (!inflateMore()) {
+          break;
+        }
+      }
+    }
+    while (!bodyDone && failure == nullptr) {
+      inputPos = inputLength;
+      if (!fillInput()) {
+        break;
+      }
+    }
+  }
+  release();
+  return failure == nullptr;
+}
+
+void HttpBodyStream::release() {
+  memFree(inflator);
+  memFree(window);
+  inflator = nullptr;
+  window = nullptr;
+  source = nullptr;
+}
+
+bool HttpBodyStream::fail(const char* message) {
+  if (failure == nullptr) {
+    failure = message;
+  }
+  return false;
+}
+
+int HttpBodyStream::available() {
+  if (source == nullptr) {
+    return 0;
+  }
+  return gzip ? (int)(outputEnd - outputPos) : (int)(inputLength - inputPos);
+}
+
+bool HttpBodyStream::ensureOutput() {
+  if (source == nullptr || failure != nullptr) {
+    return false;
+  }
+  if (gzip) {
+    return outputPos < outputEnd || inflateMore();
+  }
+  return inputPos < inputLength || fillInput();
+}
+
+int HttpBodyStream::read() {
+  if (!ensureOutput()) {
+    return -1;
+  }
+  return gzip ? window[outputPos++] : input[inputPos++];
+}
+
+int HttpBodyStream::peek() {
+  if (!ensureOutput()) {
+    return -1;
+  }
+  return gzip ? window[outputPos] : input[inputPos];
+}
+
+// Overrides Stream's per-byte timed reads: the socket wait happens in
+// readRaw, and the end of the body returns at once instead of timing out
+size_t HttpBodyStream::readBytes(char* buffer, size_t length) {
+  size_t copied = 0;
+  while (copied < length && ensureOutput()) {
+    const uint8_t* from = gzip ? window + outputPos : input + inputPos;
+    size_t& pos = gzip ? outputPos : inputPos;
+    size_t count = (gzip ? outputEnd : inputLength) - pos;
+    if (count > length - copied) {
+      count = length - copied;
+    }
+    memcpy(buffer + copied, from, count);
+    pos += count;
+    copied += count;
+  }
+  return copied;
+}
+
+// Inflate into the window until some output is ready; false at the end or on error
+bool HttpBodyStream::inflateMore() {
+  while (!inflateDone) {
+    if (needsInput && inputPos == inputLength && !fillInput()) {
+      return fail("Truncated gzip body");
+    }
+    size_t inBytes = inputLength - inputPos;
+    size_t outBytes = TINFL_LZ_DICT_SIZE - windowOffset;
+    uint32_t start = micros();
+    tinfl_status status = tinfl_decompress(inflator, input + inputPos, &inBytes, window, window + windowOffset,
+                                           &outBytes, TINFL_FLAG_HAS_MORE_INPUT);
+    inflateUs += micros() - start;
+    if (status < TINFL_STATUS_DONE) {
+      return fail("Corrupt gzip body");
+    }
+
+    inputPos += inBytes;
+    needsInput = (status == TINFL_STATUS_NEEDS_MORE_INPUT);
+    crc = mz_crc32(crc, window + windowOffset, outBytes);
+    decodedCount += outBytes;
+    outputPos = windowOffset;
+    outputEnd = windowOffset + outBytes;
+    windowOffset = (windowOffset + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+    if (status == TINFL_STATUS_DONE) {
+      inflateDone = true;
+      if (!readGzipTrailer()) {
+        return false;
+      }
+    }
+    if (outBytes > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HttpBodyStream::readGzipHeader() {
+  uint8_t header[10];
+  for (size_t i = 0; i < sizeof(header); i++) {
+    int value = inputByte();
+    if (value < 0) {
+      return fail("Truncated gzip header");
+    }
+    header[i] = value;
+  }
+  if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8) {
+    return fail("Not a gzip body");
+  }
+
+  uint8_t flags = header[3];
+  if (flags & GZIP_FEXTRA) {
+    int low = inputByte();
+    int high = inputByte();
+    if (low < 0 || high < 0 || !skipInput(low | (high << 8))) {
+      return fail("Truncated gzip header");
+    }
+  }
+  if (((flags & GZIP_FNAME) && !skipString()) || ((flags & GZIP_FCOMMENT) && !skipString()) ||
+      ((flags & GZIP_FHCRC) && !skipInput(2))) {
+    return fail("Truncated gzip header");
+  }
+  return true;
+}
+
+// CRC-32 and length (mod 2^32) of the decoded data, little-endian. tinfl may
+// have read ahead into it: without the zlib wrapper, its bit buffer still
+// starts with the 0-7 padding bits of the last deflate byte, followed by up
+// to 4 trailer bytes. The rest comes from the input.
+bool HttpBodyStream::readGzipTrailer() {
+  uint32_t fields[2] = {0, 0};
+  uint32_t numBits = inflator->m_num_bits;
+  uint64_t bitBuf = inflator->m_bit_buf;
+  bitBuf >>= numBits & 7;
+  numBits -= numBits & 7;
+  for (uint32_t i = 0; i < 8; i++) {
+    int value;
+    if (numBits >= 8) {
+      value = (int)(bitBuf & 0xff);
+      bitBuf >>= 8;
+      numBits -= 8;
+    } else {
+      value = inputByte();
+    }
+    if (value < 0) {
+      return fail("Truncated gzip trailer");
+    }
+    fields[i / 4] |= (uint32_t)value << (8 * (i % 4));
+  }
+  if (fields[0] != (uint32_t)crc || fields[1] != (uint32_t)decodedCount) {
+    return fail("gzip checksum mismatch");
+  }
+  return true;
+}
+
+int HttpBodyStream::inputByte() {
+  if (inputPos == inputLength && !fillInput()) {
+    return -1;
+  }
+  return input[inputPos++];
+}
+
+bool HttpBodyStream::skipInput(size_t count) {
+  while (count-- > 0) {
+    if (inputByte() < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Zero-terminated header field (file name, comment)
+bool HttpBodyStream::skipString() {
+  int value;
+  do {
+    value = inputByte();
+  } while (value > 0);
+  return value == 0;
+}
+
+bool HttpBodyStream::fillInput() {
+  int count = readSource(input, sizeof(input));
+  if (count <= 0) {
+    return false;
+  }
+  inputPos = 0;
+  inputLength = count;
+  wireCount += count;
+  return true;
+}
+
+// Body bytes with transfer framing removed; 0 at the end of the body, -1 on error
+int HttpBodyStream::readSource(uint8_t* buffer, size_t size) {
+  if (bodyDone || failure != nullptr) {
+    return bodyDone ? 0 : -1;
+  }
+  if (chunked) {
+    if (chunkRemaining == 0) {
+      if (!readChunkHeader()) {
+        return -1;
+      }
+      if (chunkRemaining == 0) {
+        bodyDone = true;
+        return 0;
+      }
+    }
+    if (size > chunkRemaining) {
+      size = chunkRemaining;
+    }
+  } else if (remaining == 0) {
+    bodyDone = true;
+    return 0;
+  } else if (remaining > 0 && size > (size_t)remaining) {
+    size = remaining;
+  }
+
+  int count = readRaw(buffer, size);
+  if (count == 0 && !chunked && remaining < 0) {
+    bodyDone = true; // No length given: the body ends when the server closes
+    return 0;
+  }
+  if (count <= 0) {
+    fail(count == 0 ? "Connection closed mid-body" : "Timed out reading body");
+    return -1;
+  }
+  if (chunked) {
+    chunkRemaining -= count;
+  } else if (remaining > 0) {
+    remaining -= count;
+  }
+  return count;
+}
+
+// Chunk size line ("1a2f[;ext]\r\n"), skipping the CRLF that ends the previous
+// chunk; after the last (zero) chunk the trailer section is read too
+bool HttpBodyStream::readChunkHeader() {
+  char line[24];
+  bool sizeRead = false;
+  while (true) {
+    size_t length = 0;
+    uint8_t c;
+    do {
+      int count = readRaw(&c, 1);
+      if (count <= 0) {
+        return fail("Truncated chunk header");
+      }
+      if (length < sizeof(line) - 1 && c != '\r' && c != '\n') {
+        line[length++] = c;
+      }
+    } while (c != '\n');
+    line[length] = '\0';
+
+    if (!sizeRead) {
+      if (length == 0) {
+        continue; // End of the previous chunk's data
+      }
+      char* endPtr;
+      chunkRemaining = strtoul(line, &endPtr, 16);
+      if (endPtr == line) {
+        return fail("Bad chunk header");
+      }
+      sizeRead = true;
+      if (chunkRemaining > 0) {
+        return true;
+      }
+    } else if (length == 0) {
+      return true; // Blank line after the last chunk's trailers
+    }
+  }
+}
+
+// Up to size bytes from the socket as soon as any arrive; 0 once the server
+// has closed with nothing left, -1 after HTTP_BODY_TIMEOUT_MS without data
+int HttpBodyStream::readRaw(uint8_t* buffer, size_t size) {
+  unsigned long start = millis();
+  while (source->available() <= 0) {
+    if (!source->connected()) {
+      return 0;
+    }
+    if (millis() - start >= HTTP_BODY_TIMEOUT_MS) {
+      return -1;
+    }
+    delay(1);
+  }
+  return source->read(buffer, size);
+}
@@ -0,0 +1,87 @@
+#ifndef HTTP_BODY_H
+#define HTTP_BODY_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include "rom/miniz.h"
+#include "config.h"
+
+// Body of an HTTPClient response as a Stream that deserializeJson reads
+// directly. Chunked transfer encoding is undone here, and a gzip body is
+// inflated as it arrives with the ROM's tinfl. Only the socket buffer
+// (HTTP_BODY_INPUT_SIZE) and tinfl's 32KB window are held, never the
+// decoded body as a whole.
+class HttpBodyStream : public Stream {
+public:
+  HttpBodyStream();
+  ~HttpBodyStream();
+
+  // Before GET(): ask for gzip (HTTP_ACCEPT_GZIP) and keep the headers begin() reads
+  static void prepareRequest(HTTPClient& http);
+
+  // After a GET(); false if the encoding is unsupported or buffers can't be allocated
+  bool begin(HTTPClient& http);
+
+  // Read (or inflate) the rest of the body so a kept-alive connection is left
+  // at the next response, check the gzip trailer and free the buffers.
+  // False if the body was truncated or corrupt.
+  bool end();
+
+  // Stream
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t readBytes(char* buffer, size_t length) override;
+  size_t write(uint8_t) override { return 0; }
+
+  // Last body's numbers, kept after end()
+  bool isCompressed() const { return gzip; }
+  size_t wireBytes() const { return wireCount; }        // Body bytes received (compressed size)
+  size_t decodedBytes() const { return gzip ? decodedCount : wireCount; }
+  uint32_t inflateMicros() const { return inflateUs; }
+  size_t bufferBytes() const { return bufferSize; }    // Heap held while reading
+  const char* getError() const { return failure; }     // nullptr when fine
+
+private:
+  WiFiClient* source;
+  int remaining;           // Content-Length left (-1 = chunked or until close)
+  bool chunked;
+  size_t chunkRemaining;
+  bool bodyDone;           // Every body byte has been taken from the socket
+
+  uint8_t input[HTTP_BODY_INPUT_SIZE];
+  size_t inputPos;
+  size_t inputLength;
+
+  bool gzip;
+  tinfl_decompressor* inflator;
+  uint8_t* window;         // TINFL_LZ_DICT_SIZE ring; decoded bytes are served from it
+  size_t windowOffset;     // Where tinfl writes next
+  size_t outputPos;
+  size_t outputEnd;
+  bool inflateDone;
+  bool needsInput;         // tinfl stopped for input (not for window space)
+  mz_ulong crc;
+
+  size_t wireCount;
+  size_t decodedCount;
+  uint32_t inflateUs;
+  size_t bufferSize;
+  const char* failure;
+
+  bool ensureOutput();
+  bool fillInput();
+  int inputByte();
+  bool skipInput(size_t count);
+  bool skipString();
+  bool readGzipHeader();
+  bool readGzipTrailer();
+  bool inflateMore();
+  int readSource(uint8_t* buffer, size_t size);
+  int readRaw(uint8_t* buffer, size_t size);
+  bool readChunkHeader();
+  bool fail(const char* message);
+  void release();
+};
+
+#endif // HTTP_BODY_H
@@ -0,0 +1,393 @@
+#include "icon_cache.h"
+#include "secrets.h"
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <assert.h>
+
+// Base URL of the icon server, e.g. "http://192.168.1.100:8080/icons".
+// Leave empty to disable downloads (built-in and cached icons still work).
+#ifndef ICON_SERVER_URL
+#define ICON_SERVER_URL ""
+#endif
+
+static const char* ICON_INDEX_PATH = "/icons/index.bin";
+
+IconCache::IconCache() {
+  fs = nullptr;
+  lock = nullptr;
+  requestQueue = nullptr;
+  fetchTask = nullptr;
+  lookupTask = nullptr;
+  memset(flashIndex, 0, sizeof(flashIndex));
+  memset(ramSlots, 0, sizeof(ramSlots));
+  memset(pending, 0, sizeof(pending));
+  useCounter = 0;
+  indexDirty = false;
+  newEntries = false;
+  lastIndexFlush = 0;
+}
+
+bool IconCache::begin(fs::FS& filesystem) {
+  fs = &filesystem;
+  lock = xSemaphoreCreateMutex();
+  requestQueue = xQueueCreate(ICON_PENDING_MAX, SYMBOL_LEN);
+
+  loadIndex();
+
+  if (strlen(ICON_SERVER_URL) == 0) {
+    Serial.println("Icons: No ICON_SERVER_URL configured - downloads disabled");
+    return true;
+  }
+
+  // Low priority task so downloads never compete with the render loop
+  BaseType_t created = xTaskCreatePinnedToCore(fetchTaskEntry, "iconFetch", 6144,
+                                               this, 1, &fetchTask, 0);
+  if (created != pdPASS) {
+    Serial.println("Icons: Failed to start fetch task");
+    fetchTask = nullptr;
+    return false;
+  }
+  return true;
+}
+
+const uint16_t* IconCache::lookup(const char* symbol) {
+  if (fs == nullptr) {
+    return nullptr;
+  }
+
+  // A second caller could have its pixels evicted while it still draws them
+  if (lookupTask == nullptr) {
+    lookupTask = xTaskGetCurrentTaskHandle();
+  }
+  assert(lookupTask == xTaskGetCurrentTaskHandle());
+
+  xSemaphoreTake(lock, portMAX_DELAY);
+
+  // Fast path: already decoded in RAM
+  int slotIndex = findRamSlot(symbol);
+  if (slotIndex >= 0) {
+    ramSlots[slotIndex].lastUsed = ++useCounter;
+    const uint16_t* pixels = ramSlots[slotIndex].pixels;
+    xSemaphoreGive(lock);
+    return pixels;
+  }
+
+  // Stored on flash: load into the least recently used RAM slot (small local read)
+  int entryIndex = findFlashEntry(symbol);
+  if (entryIndex >= 0) {
+    int victim = 0;
+    for (int i = 1; i < ICON_RAM_SLOTS; i++) {
+      if (ramSlots[i].lastUsed < ramSlots[victim].lastUsed) {
+        victim = i;
+      }
+    }
+
+    RamSlot& slot = ramSlots[victim];
+    if (loadFromFlash(symbol, slot)) {
+      slot.lastUsed = ++useCounter;
+      flashIndex[entryIndex].lastUsed = useCounter;
+      indexDirty = true;
+      xSemaphoreGive(lock);
+      return slot.pixels;
+    }
+
+    // File missing or corrupt - forget it and download again
+    Serial.printf("Icons: Cached icon for %s unreadable, refetching\n", symbol);
+    flashIndex[entryIndex].symbol[0] = '\0';
+    flashIndex[entryIndex].lastUsed = 0;
+    indexDirty = true;
+  }
+
+  requestFetch(symbol);
+  xSemaphoreGive(lock);
+  return nullptr;
+}
+
+void IconCache::loop() {
+  if (fs == nullptr || !indexDirty) {
+    return;
+  }
+
+  // New icons are written at once so they survive a reboot; LRU order changes wait
+  unsigned long now = millis();
+  if (!newEntries && lastIndexFlush != 0 && now - lastIndexFlush < ICON_INDEX_FLUSH_MS) {
+    return;
+  }
+
+  saveIndex();
+  lastIndexFlush = now;
+}
+
+int IconCache::findFlashEntry(const char* symbol) {
+  for (int i = 0; i < ICON_CACHE_MAX_ENTRIES; i++) {
+    if (flashIndex[i].lastUsed != 0 && strcmp(flashIndex[i].symbol, symbol) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int IconCache::findRamSlot(const char* symbol) {
+  for (int i = 0; i < ICON_RAM_SLOTS; i++) {
+    if (ramSlots[i].lastUsed != 0 && strcmp(ramSlots[i].symbol, symbol) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool IconCache::loadFromFlash(const char* symbol, RamSlot& slot) {
+  char path[32];
+  buildPath(path, sizeof(path), symbol);
+
+  File file = fs->open(path, FILE_READ);
+  if (!file) {
+    return false;
+  }
+
+  size_t bytesRead = file.read(reinterpret_cast<uint8_t*>(slot.pixels), ICON_BYTES);
+  file.close();
+  if (bytesRead != ICON_BYTES) {
+    slot.lastUsed = 0;
+    return false;
+  }
+
+  strlcpy(slot.symbol, symbol, SYMBOL_LEN);
+  return true;
+}
+
+void IconCache::requestFetch(const char* symbol) {
+  if (fetchTask == nullptr) {
+    return;
+  }
+
+  unsigned long now = millis();
+  int freeIndex = -1;
+
+  for (int i = 0; i < ICON_PENDING_MAX; i++) {
+    PendingEntry& entry = pending[i];
+    if (entry.symbol[0] == '\0') {
+      if (freeIndex < 0) freeIndex = i;
+      continue;
+    }
+    if (strcmp(entry.symbol, symbol) == 0) {
+      // Already queued, or failed recently and still backing off
+      if (entry.inFlight || (long)(now - entry.retryAt) < 0) {
+        return;
+      }
+      freeIndex = i;
+      break;
+    }
+    // Expired failure entries can be reused for other symbols
+    if (!entry.inFlight && (long)(now - entry.retryAt) >= 0 && freeIndex < 0) {
+      freeIndex = i;
+    }
+  }
+
+  if (freeIndex < 0) {
+    return; // Too many downloads outstanding; we'll ask again on the next render
+  }
+
+  char request[SYMBOL_LEN];
+  strlcpy(request, symbol, SYMBOL_LEN);
+  if (xQueueSend(requestQueue, request, 0) != pdTRUE) {
+    return;
+  }
+
+  strlcpy(pending[freeIndex].symbol, symbol, SYMBOL_LEN);
+  pending[freeIndex].inFlight = true;
+  pending[freeIndex].retryAt = 0;
+  Serial.printf("Icons: Queued download for %s\n", symbol);
+}
+
+// Runs on the fetch task. The chosen entry is cleared while its file is
+// rewritten, so lookups skip it without waiting for SPIFFS.
+bool IconCache::storeIcon(const char* symbol, const uint8_t* data) {
+  char evicted[SYMBOL_LEN] = "";
+  xSemaphoreTake(lock, portMAX_DELAY);
+
+  // Pick a free slot, otherwise evict the least recently used icon
+  int target = findFlashEntry(symbol);
+  if (target < 0) {
+    target = 0;
+    for (int i = 0; i < ICON_CACHE_MAX_ENTRIES; i++) {
+      if (flashIndex[i].lastUsed == 0) {
+        target = i;
+        break;
+      }
+      if (flashIndex[i].lastUsed < flashIndex[target].lastUsed) {
+        target = i;
+      }
+    }
+
+    if (flashIndex[target].lastUsed != 0) {
+      strlcpy(evicted, flashIndex[target].symbol, SYMBOL_LEN);
+    }
+  }
+  if (flashIndex[target].lastUsed != 0) {
+    indexDirty = true;
+  }
+  flashIndex[target].symbol[0] = '\0';
+  flashIndex[target].lastUsed = 0;
+  xSemaphoreGive(lock);
+
+  if (evicted[0] != '\0') {
+    char evictPath[32];
+    buildPath(evictPath, sizeof(evictPath), evicted);
+    fs->remove(evictPath);
+    Serial.printf("Icons: Evicted %s\n", evicted);
+  }
+
+  char path[32];
+  buildPath(path, sizeof(path), symbol);
+  File file = fs->open(path, FILE_WRITE);
+  if (!file) {
+    Serial.printf("Icons: Cannot write %s\n", path);
+    return false;
+  }
+  size_t written = file.write(data, ICON_BYTES);
+  file.close();
+
+  if (written != ICON_BYTES) {
+    fs->remove(path);
+    Serial.printf("Icons: Short write for %s\n", symbol);
+    return false;
+  }
+
+  // loop() writes the index on its next call
+  xSemaphoreTake(lock, portMAX_DELAY);
+  strlcpy(flashIndex[target].symbol, symbol, SYMBOL_LEN);
+  flashIndex[target].lastUsed = ++useCounter;
+  indexDirty = true;
+  newEntries = true;
+  xSemaphoreGive(lock);
+  return true;
+}
+
+void IconCache::loadIndex() {
+  File file = fs->open(ICON_INDEX_PATH, FILE_READ);
+  if (!file) {
+    Serial.println("Icons: No icon index on flash, starting empty");
+    return;
+  }
+
+  size_t bytesRead = file.read(reinterpret_cast<uint8_t*>(flashIndex), sizeof(flashIndex));
+  file.close();
+
+  if (bytesRead != sizeof(flashIndex)) {
+    // Index from an older build with a different capacity - start over
+    Serial.println("Icons: Icon index size mismatch, starting empty");
+    memset(flashIndex, 0, sizeof(flashIndex));
+    return;
+  }
+
+  int stored = 0;
+  for (int i = 0; i < ICON_CACHE_MAX_ENTRIES; i++) {
+    flashIndex[i].symbol[SYMBOL_LEN - 1] = '\0';
+    if (flashIndex[i].lastUsed != 0) {
+      stored++;
+      if (flashIndex[i].lastUsed > useCounter) {
+        useCounter = flashIndex[i].lastUsed;
+      }
+    }
+  }
+  Serial.printf("Icons: %d cached icons on flash\n", stored);
+}
+
+// Copies the index under `lock` and writes the copy without it
+void IconCache::saveIndex() {
+  FlashEntry snapshot[ICON_CACHE_MAX_ENTRIES];
+  xSemaphoreTake(lock, portMAX_DELAY);
+  memcpy(snapshot, flashIndex, sizeof(snapshot));
+  indexDirty = false;
+  newEntries = false;
+  xSemaphoreGive(lock);
+
+  File file = fs->open(ICON_INDEX_PATH, FILE_WRITE);
+  size_t written = 0;
+  if (file) {
+    written = file.write(reinterpret_cast<const uint8_t*>(snapshot), sizeof(snapshot));
+    file.close();
+  }
+  if (written != sizeof(snapshot)) {
+    Serial.println("Icons: Cannot write icon index");
+    indexDirty = true; // Try again on a later loop()
+  }
+}
+
+void IconCache::buildPath(char* out, size_t size, const char* symbol) {
+  snprintf(out, size, "/icons/%s.565", symbol);
+}
+
+void IconCache::fetchTaskEntry(void* param) {
+  IconCache* self = static_cast<IconCache*>(param);
+  static uint8_t buffer[ICON_BYTES];
+  char symbol[SYMBOL_LEN];
+
+  for (;;) {
+    if (xQueueReceive(self->requestQueue, symbol, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+
+    bool success = self->downloadIcon(symbol, buffer) && self->storeIcon(symbol, buffer);
+    self->finishFetch(symbol, success);
+  }
+}
+
+bool IconCache::downloadIcon(const char* symbol, uint8_t* buffer) {
+  if (WiFi.status() != WL_CONNECTED) {
+    return false;
+  }
+
+  char url[160];
+  snprintf(url, sizeof(url), "%s/%s.rgb565", ICON_SERVER_URL, symbol);
+
+  WiFiClient iconClient;
+  HTTPClient iconHttp;
+  iconHttp.begin(iconClient, url);
+  iconHttp.setTimeout(ICON_FETCH_TIMEOUT);
+
+  int httpCode = iconHttp.GET();
+  if (httpCode != HTTP_CODE_OK) {
+    Serial.printf("Icons: %s -> HTTP %d\n", url, httpCode);
+    iconHttp.end();
+    return false;
+  }
+
+  if (iconHttp.getSize() != ICON_BYTES) {
+    Serial.printf("Icons: %s has size %d, expected %d\n", url, iconHttp.getSize(), ICON_BYTES);
+    iconHttp.end();
+    return false;
+  }
+
+  WiFiClient* stream = iconHttp.getStreamPtr();
+  stream->setTimeout(ICON_FETCH_TIMEOUT);
+  size_t bytesRead = stream->readBytes(buffer, ICON_BYTES);
+  iconHttp.end();
+
+  if (bytesRead != ICON_BYTES) {
+    Serial.printf("Icons: Short read for %s (%u bytes)\n", symbol, (unsigned)bytesRead);
+    return false;
+  }
+
+  Serial.printf("Icons: Downloaded icon for %s\n", symbol);
+  return true;
+}
+
+void IconCache::finishFetch(const char* symbol, bool success) {
+  xSemaphoreTake(lock, portMAX_DELAY);
+  for (int i = 0; i < ICON_PENDING_MAX; i++) {
+    if (strcmp(pending[i].symbol, symbol) != 0) {
+      continue;
+    }
+    if (success) {
+      pending[i].symbol[0] = '\0';
+    } else {
+      // Keep the entry so lookups don't re-queue it until the retry delay passes
+      pending[i].retryAt = millis() + ICON_FETCH_RETRY_MS;
+    }
+    pending[i].inFlight = false;
+    break;
+  }
+  xSemaphoreGive(lock);
+}
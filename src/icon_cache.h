@@ -0,0 +1,89 @@
+#ifndef ICON_CACHE_H
+#define ICON_CACHE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "config.h"
+
+// Icon cache for symbols without a built-in icon.
+//
+// Icons are raw 24x24 RGB565 images (ICON_BYTES bytes, same layout as the
+// arrays in icons.h) served as <ICON_SERVER_URL>/<SYMBOL>.rgb565. The first
+// time a symbol is shown the request is queued to a background task; the
+// downloaded file is kept in a bounded, LRU-evicted set on SPIFFS so later
+// boots load it from flash without touching the network.
+class IconCache {
+public:
+  IconCache();
+
+  // Load the flash index and start the background fetch task.
+  // SPIFFS must already be mounted.
+  bool begin(fs::FS& fs);
+
+  // Return the icon pixels for a symbol, or nullptr if not available yet.
+  // Never touches the network: a miss on flash queues a background fetch.
+  // The pixels live in a RAM slot that the next lookup() may reuse, so they
+  // are only valid until then, and only one task (the display's) may call it.
+  const uint16_t* lookup(const char* symbol);
+
+  // Persist the LRU index if it changed (cheap, call from loop())
+  void loop();
+
+  // Background fetch task (nullptr when downloads are disabled)
+  TaskHandle_t getTaskHandle() const { return fetchTask; }
+
+private:
+  static constexpr int ICON_BYTES = ICON_SIZE * ICON_SIZE * sizeof(uint16_t);
+  static constexpr int SYMBOL_LEN = 12;
+
+  // Persistent LRU entry for an icon stored on flash
+  struct FlashEntry {
+    char symbol[SYMBOL_LEN];
+    uint32_t lastUsed;  // Monotonic use counter (0 = free slot)
+  };
+
+  // Decoded icon kept in RAM
+  struct RamSlot {
+    char symbol[SYMBOL_LEN];
+    uint32_t lastUsed;
+    uint16_t pixels[ICON_SIZE * ICON_SIZE];
+  };
+
+  // Symbol waiting for (or recently failed) a download
+  struct PendingEntry {
+    char symbol[SYMBOL_LEN];
+    bool inFlight;
+    unsigned long retryAt;  // millis() after which a failed fetch may be retried
+  };
+
+  fs::FS* fs;
+  SemaphoreHandle_t lock;
+  QueueHandle_t requestQueue;
+  TaskHandle_t fetchTask;
+
+  FlashEntry flashIndex[ICON_CACHE_MAX_ENTRIES];
+  RamSlot ramSlots[ICON_RAM_SLOTS];
+  PendingEntry pending[ICON_PENDING_MAX];
+  TaskHandle_t lookupTask;  // The one task allowed to call lookup()
+  uint32_t useCounter;
+  bool indexDirty;
+  bool newEntries;     // Flush the index on the next loop() instead of waiting
+  unsigned long lastIndexFlush;
+
+  // Helpers (callers hold `lock` unless noted)
+  int findFlashEntry(const char* symbol);
+  int findRamSlot(const char* symbol);
+  bool loadFromFlash(const char* symbol, RamSlot& slot);
+  void requestFetch(const char* symbol);
+  bool storeIcon(const char* symbol, const uint8_t* data); // Takes `lock` itself
+  void loadIndex();
+  void saveIndex();                                        // Takes `lock` itself
+  static void buildPath(char* out, size_t size, const char* symbol);
+
+  // Background task: downloads queued symbols (does not hold `lock` during I/O)
+  static void fetchTaskEntry(void* param);
+  bool downloadIcon(const char* symbol, uint8_t* buffer);
+  void finishFetch(const char* symbol, bool success);
+};
+
+#endif // ICON_CACHE_H
@@ -0,0 +1,108 @@
+#include "json_arena.h"
+#include "mem_alloc.h"
+
+JsonArena jsonArena;
+
+JsonArena::JsonArena()
+  : buffer(nullptr),
+    size(0),
+    inUse(false),
+    resizes(0),
+    fallbacks(0) {
+  memset(needs, 0, sizeof(needs));
+  memset(peaks, 0, sizeof(peaks));
+  memset(overflowCounts, 0, sizeof(overflowCounts));
+}
+
+size_t JsonArena::capacityFor(JsonUser user, size_t hint) const {
+  return needs[user] > 0 ? needs[user] : hint;
+}
+
+size_t JsonArena::largestNeed() const {
+  size_t largest = 0;
+  for (int i = 0; i < JSON_USER_COUNT; i++) {
+    if (needs[i] > largest) {
+      largest = needs[i];
+    }
+  }
+  return largest;
+}
+
+void* JsonArena::acquire(size_t request) {
+  if (inUse) {
+    // Nested document: rare, so a one-off block beats sizing the arena for two
+    fallbacks++;
+    return memAlloc(request, MEM_BULK);
+  }
+
+  // Size for the largest known user so the next document fits too. The first
+  // cycle runs on the hints; once measured, an oversized buffer shrinks once.
+  size_t target = request > largestNeed() ? request : largestNeed();
+  if (buffer == nullptr || size < request || size > target * 2) {
+    memFree(buffer); // Freed first: the old contents are dead and both may not fit
+    buffer = (uint8_t*)memAlloc(target, MEM_BULK);
+    size = buffer != nullptr ? target : 0;
+    resizes++;
+    if (buffer == nullptr) {
+      return nullptr; // The document reports zero capacity and overflows
+    }
+  }
+  inUse = true;
+  return buffer;
+}
+
+void JsonArena::release(void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  if (ptr == buffer) {
+    inUse = false; // Kept for the next document
+    return;
+  }
+  memFree(ptr);
+}
+
+void* JsonArena::resize(void* ptr, size_t request) {
+  // Only shrinkToFit()/garbageCollect() reallocate; the arena stays put
+  if (ptr == buffer && request <= size) {
+    return buffer;
+  }
+  if (ptr == buffer) {
+    return nullptr;
+  }
+  return memRealloc(ptr, request, MEM_BULK);
+}
+
+void JsonArena::record(JsonUser user, size_t used, size_t capacity, bool overflowed) {
+  if (used > peaks[user]) {
+    peaks[user] = used;
+  }
+
+  size_t wanted = (size_t)peaks[user] * (100 + JSON_ARENA_HEADROOM_PCT) / 100;
+  if (overflowed) {
+    // Usage stops at capacity, so the real need is unknown: double and retry
+    overflowCounts[user]++;
+    if (capacity * 2 > wanted) {
+      wanted = capacity * 2;
+    }
+    Serial.printf("JSON: %s document overflowed %u bytes, next gets %u\n",
+                  userName(user), (unsigned)capacity, (unsigned)wanted);
+  }
+  wanted = (wanted + JSON_ARENA_ROUND_BYTES - 1) / JSON_ARENA_ROUND_BYTES * JSON_ARENA_ROUND_BYTES;
+  if (wanted > needs[user]) {
+    needs[user] = wanted; // Only grows, so steady state never resizes
+  }
+}
+
+const char* JsonArena::userName(JsonUser user) {
+  switch (user) {
+    case JSON_USER_CMC_QUOTES: return "cmc_quotes";
+    case JSON_USER_CMC_MAP: return "cmc_map";
+    case JSON_USER_FMP_QUOTES: return "fmp_quotes";
+    case JSON_USER_FX_RATES: return "fx_rates";
+    case JSON_USER_MQTT_STATE: return "mqtt_state";
+    case JSON_USER_MQTT_DISCOVERY: return "mqtt_discovery";
+    case JSON_USER_FLEET: return "fleet";
+    default: return "unknown";
+  }
+}
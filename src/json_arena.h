@@ -0,0 +1,88 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// Every JSON document built or parsed on the main loop, for per-user sizing
+enum JsonUser : uint8_t {
+  JSON_USER_CMC_QUOTES = 0,
+  JSON_USER_CMC_MAP,
+  JSON_USER_FMP_QUOTES,
+  JSON_USER_FX_RATES,
+  JSON_USER_MQTT_STATE,
+  JSON_USER_MQTT_DISCOVERY,
+  JSON_USER_FLEET,
+  JSON_USER_COUNT
+};
+
+// One persistent MEM_BULK buffer that backs every main-loop JSON document in
+// turn. Each user's document is sized from its own measured peak plus
+// JSON_ARENA_HEADROOM_PCT, and the buffer is resized only when a need grows
+// (or on the first cycle, shrinks well below the initial guesses), so steady
+// state allocates nothing. Not thread-safe: the price stream task keeps its
+// own stack documents.
+class JsonArena {
+public:
+  JsonArena();
+
+  // Capacity to give the user's next document: measured need, else the hint
+  size_t capacityFor(JsonUser user, size_t hint) const;
+
+  // Hand out the arena for a document of the given capacity. A second
+  // document while the arena is taken gets its own MEM_BULK block.
+  void* acquire(size_t size);
+  void release(void* ptr);
+  void* resize(void* ptr, size_t size);
+
+  // Called as each document goes away; an overflow doubles the user's need
+  void record(JsonUser user, size_t used, size_t capacity, bool overflowed);
+
+  static const char* userName(JsonUser user); // "cmc_quotes", "mqtt_state", ...
+
+  size_t bufferSize() const { return size; }
+  size_t peak(JsonUser user) const { return peaks[user]; }
+  size_t need(JsonUser user) const { return needs[user]; }
+  uint32_t overflows(JsonUser user) const { return overflowCounts[user]; }
+  uint32_t resizeCount() const { return resizes; }     // Arena buffer (re)allocations
+  uint32_t fallbackCount() const { return fallbacks; } // Documents served outside the arena
+
+private:
+  uint8_t* buffer;
+  size_t size;
+  bool inUse;
+  size_t needs[JSON_USER_COUNT];
+  size_t peaks[JSON_USER_COUNT];
+  uint32_t overflowCounts[JSON_USER_COUNT];
+  uint32_t resizes;
+  uint32_t fallbacks;
+
+  size_t largestNeed() const;
+};
+
+extern JsonArena jsonArena;
+
+// ArduinoJson allocator over the shared arena
+struct ArenaAllocator {
+  void* allocate(size_t size) { return jsonArena.acquire(size); }
+  void deallocate(void* ptr) { jsonArena.release(ptr); }
+  void* reallocate(void* ptr, size_t size) { return jsonArena.resize(ptr, size); }
+};
+
+// A document on the arena that reports its usage when it goes out of scope.
+// Check overflowed() (or the DeserializationError) before trusting it.
+class ArenaJsonDocument : public BasicJsonDocument<ArenaAllocator> {
+public:
+  ArenaJsonDocument(JsonUser user, size_t hint)
+      : BasicJsonDocument<ArenaAllocator>(jsonArena.capacityFor(user, hint)), user(user) {}
+
+  ~ArenaJsonDocument() {
+    jsonArena.record(user, memoryUsage(), capacity(), overflowed());
+  }
+
+private:
+  JsonUser user;
+};
+
+#endif // JSON_ARENA_H
@@ -0,0 +1,119 @@
+#include "lcd_surface.h"
+#include "config.h"
+
+LcdSurface::LcdSurface() {
+  textHasBackground = false;
+  textFont = 1;
+  textSize = 1;
+}
+
+void LcdSurface::begin() {
+  M5.Lcd.setRotation(3);
+}
+
+int LcdSurface::width() const {
+  return SCREEN_WIDTH;
+}
+
+int LcdSurface::height() const {
+  return SCREEN_HEIGHT;
+}
+
+void LcdSurface::fillScreen(uint16_t color) {
+  M5.Lcd.fillScreen(color);
+  countDraw(SCREEN_WIDTH * SCREEN_HEIGHT);
+  countClear();
+}
+
+void LcdSurface::fillRect(int x, int y, int w, int h, uint16_t color) {
+  M5.Lcd.fillRect(x, y, w, h, color);
+  countDraw(w * h);
+}
+
+void LcdSurface::drawRoundRect(int x, int y, int w, int h, int r, uint16_t color) {
+  M5.Lcd.drawRoundRect(x, y, w, h, r, color);
+  countDraw(2 * (w + h)); // Outline only
+}
+
+void LcdSurface::fillCircle(int x, int y, int r, uint16_t color) {
+  M5.Lcd.fillCircle(x, y, r, color);
+  countDraw((4 * r * r * 355) / 452); // pi * r^2 in integer math
+}
+
+void LcdSurface::pushImage(int x, int y, int w, int h, const uint16_t* pixels) {
+  M5.Lcd.pushImage(x, y, w, h, pixels);
+  countDraw(w * h);
+}
+
+void LcdSurface::setTextFont(int font) {
+  M5.Lcd.setTextFont(font);
+  textFont = font;
+}
+
+void LcdSurface::setTextSize(int size) {
+  M5.Lcd.setTextSize(size);
+  textSize = size;
+}
+
+void LcdSurface::setTextColor(uint16_t fg) {
+  M5.Lcd.setTextColor(fg);
+  textHasBackground = false;
+}
+
+void LcdSurface::setTextColor(uint16_t fg, uint16_t bg) {
+  M5.Lcd.setTextColor(fg, bg);
+  textHasBackground = true;
+}
+
+void LcdSurface::setTextDatum(uint8_t datum) {
+  M5.Lcd.setTextDatum(datum);
+}
+
+int LcdSurface::drawString(const char* text, int x, int y) {
+  int drawn = M5.Lcd.drawString(text, x, y);
+  // With a background color the whole text box is written, otherwise
+  // roughly half of it (glyph pixels only)
+  int pixels = drawn * M5.Lcd.fontHeight();
+  countDraw(textHasBackground ? pixels : pixels / 2);
+  return drawn;
+}
+
+int LcdSurface::textWidth(const char* text) {
+  return M5.Lcd.textWidth(text);
+}
+
+int LcdSurface::fontHeight() const {
+  return M5.Lcd.fontHeight();
+}
+
+bool LcdSurface::rasterizeChar(char c, int x, int w, int h, uint8_t* mask) {
+  // Drawn into a 1-bit sprite and read back; nothing reaches the panel
+  M5Canvas canvas(&M5.Lcd);
+  canvas.setColorDepth(1);
+  canvas.setPsram(false);
+  if (canvas.createSprite(w, h) == nullptr) {
+    return false;
+  }
+  canvas.fillSprite(0);
+  canvas.setTextFont(textFont);
+  canvas.setTextSize(textSize);
+  canvas.setTextColor(1);
+  canvas.setTextDatum(TL_DATUM);
+  char text[2] = { c, '\0' };
+  canvas.drawString(text, x, 0);
+
+  int stride = (w + 7) / 8;
+  for (int row = 0; row < h; row++) {
+    for (int col = 0; col < w; col++) {
+      if (canvas.readPixel(col, row) != 0) {
+        mask[row * stride + (col >> 3)] |= 0x80 >> (col & 7);
+      }
+    }
+  }
+  canvas.deleteSprite();
+  return true;
+}
+
+void LcdSurface::invert(bool on) {
+  M5.Lcd.invertDisplay(on);
+}
@@ -0,0 +1,40 @@
+#ifndef LCD_SURFACE_H
+#define LCD_SURFACE_H
+
+#include <M5Unified.h>
+#include "display_surface.h"
+
+// DisplaySurface backed by the M5StickC Plus2 LCD
+class LcdSurface : public DisplaySurface {
+public:
+  LcdSurface();
+
+  void begin() override;
+
+  int width() const override;
+  int height() const override;
+
+  void fillScreen(uint16_t color) override;
+  void fillRect(int x, int y, int w, int h, uint16_t color) override;
+  void drawRoundRect(int x, int y, int w, int h, int r, uint16_t color) override;
+  void fillCircle(int x, int y, int r, uint16_t color) override;
+  void pushImage(int x, int y, int w, int h, const uint16_t* pixels) override;
+
+  void setTextFont(int font) override;
+  void setTextSize(int size) override;
+  void setTextColor(uint16_t fg) override;
+  void setTextColor(uint16_t fg, uint16_t bg) override;
+  void setTextDatum(uint8_t datum) override;
+  int drawString(const char* text, int x, int y) override;
+  int textWidth(const char* text) override;
+  int fontHeight() const override;
+  bool rasterizeChar(char c, int x, int w, int h, uint8_t* mask) override;
+  void invert(bool on) override;
+
+private:
+  bool textHasBackground; // Text cells are filled only when a background color is set
+  int textFont;           // Mirrored for rasterizeChar()
+  int textSize;
+};
+
+#endif // LCD_SURFACE_H
@@ -17,31 +17,82 @@
 #include <Arduino.h>
 #include <M5Unified.h>
 #include <time.h>
+#include <SPIFFS.h>
 #include "config.h"
 #include "crypto_display.h"
+#include "lcd_surface.h"
 #include "api_client.h"
 #include "mqtt_client.h"
+#include "icon_cache.h"
+#include "metrics.h"
+#include "trace.h"
+#include "market_calendar.h"
+#include "time_utils.h"
+#include "scheduler.h"
+#include "retry_policy.h"
+#include "mem_alloc.h"
+#include "price_stream.h"
+#include "fleet.h"
+#include "candles.h"
+#include "market_stats.h"
+#include "fx_table.h"
+#include "price_history.h"
+#include "alert_engine.h"
 #include "secrets.h"
 
 // Global objects
-CryptoDisplay display;
+LcdSurface lcdSurface;
+CryptoDisplay display(lcdSurface);
+IconCache iconCache;
 APIClient apiClient;
 MQTTClient mqttClient;
+RefreshScheduler scheduler;
+RetryPolicy retryPolicy;
+PriceStream priceStream;
+FleetSync fleet;
+CandleAggregator candles;
+MarketStats marketStats;
+FxTable fxTable;
+PriceHistory priceHistory;
+AlertEngine alerts;
 
 // Asset data array (crypto + stocks) - Adjusted for proportional font widths
 AssetData assets[] = {
-  {"BTC", "Bitcoin", 0.0, "", 0, 0, 90, false, "CAD", 0.0, false, true},     // Crypto - "Bitcoin" adjusted for actual width
-  {"ETH", "Ethereum", 0.0, "", 0, 0, 102, false, "CAD", 0.0, false, true},   // Crypto - "Ethereum" adjusted for actual width
-  {"XRP", "XRP", 0.0, "", 0, 0, 42, false, "CAD", 0.0, false, true},         // Crypto - "XRP" adjusted for actual width  
-  {"MSFT", "Microsoft", 0.0, "Market Closed", 0, 0, 120, true, "USD", 0.0, false, true}   // Stock - "Microsoft" = adjusted for actual width
+  {"BTC", "Bitcoin", 0.0, "", 0, 0, 90, false, "CAD", EXCHANGE_NONE, REFRESH_CRYPTO_MS, 0.0, false, true},     // Crypto - "Bitcoin" adjusted for actual width
+  {"ETH", "Ethereum", 0.0, "", 0, 0, 102, false, "CAD", EXCHANGE_NONE, REFRESH_CRYPTO_MS, 0.0, false, true},   // Crypto - "Ethereum" adjusted for actual width
+  {"XRP", "XRP", 0.0, "", 0, 0, 42, false, "CAD", EXCHANGE_NONE, REFRESH_CRYPTO_MS, 0.0, false, true},         // Crypto - "XRP" adjusted for actual width  
+  {"MSFT", "Microsoft", 0.0, "Market Closed", 0, 0, 120, true, "USD", EXCHANGE_NASDAQ, REFRESH_STOCK_MS, 0.0, false, true}   // Stock - "Microsoft" = adjusted for actual width
 };
 const int assetCount = sizeof(assets) / sizeof(assets[0]);
+static_assert(sizeof(assets) / sizeof(assets[0]) <= MAX_ASSETS,
+              "assets[] has more entries than MAX_ASSETS (config.h)");
+static_assert(HISTORY_MAX_ASSETS >= MAX_ASSETS, "HISTORY_MAX_ASSETS must cover every asset");
 
 // Timing variables
-unsigned long lastApiUpdate = 0;
 unsigned long lastDisplaySwitch = 0;
+unsigned long lastStalenessPublish = 0;
+unsigned long lastStreamApply = 0;
+unsigned long nextFxRefresh = 0;
+unsigned long prewarmedDeadline = 0;    // Deadline the current warm connection was opened for
+unsigned long refreshDeadline = 0;      // Earliest deadline among the last fetched assets
+bool refreshLagPending = false;         // Record deadline-to-screen once it is drawn
+unsigned long restartRequestedAt = 0;
+bool restartPending = false;            // WiFi failed at boot: restart after WIFI_BOOT_RESTART_MS
+bool spiffsMounted = false;
+uint16_t wifiFailures = 0;              // Consecutive failed reconnects (backs off like a provider)
+uint32_t publishedBreakerChanges = 0;
+bool mqttWasConnected = false;
 int currentAssetIndex = 0;
 bool dataLoaded = false;
+// Button B cycles the views: one asset at a time, overview table, ticker
+enum DisplayMode : uint8_t {
+  DISPLAY_MODE_SINGLE,
+  DISPLAY_MODE_GRID,
+  DISPLAY_MODE_TICKER,
+  DISPLAY_MODE_COUNT
+};
+DisplayMode displayMode = DISPLAY_MODE_SINGLE;
+int gridPage = 0;
 
 // Brightness control variables - M5Unified API (works on all M5 devices)
 constexpr uint8_t BRIGHTNESS_LEVELS[] = {51, 102, 153, 204, 255}; // 5 levels: 20%, 40%, 60%, 80%, 100%
@@ -52,9 +103,24 @@ unsigned long lastButtonPress = 0;
 constexpr unsigned long BUTTON_DEBOUNCE_MS = 200; // Debounce delay
 
 // Function declarations
-bool fetchAndUpdateData();
+bool refreshDueAssets(int& refreshedCount);
+void prewarmNextFetch(unsigned long now);
+bool refreshFxRates();
+unsigned long retryDelay(Provider provider, unsigned long retryMs, unsigned long refreshIntervalMs);
 void cycleBrightness();
-bool isMarketOpen();
+void setDisplayMode(DisplayMode mode);
+void nextGridPage();
+void handleButtons(unsigned long now);
+void waitForRestart();
+void showFetching();
+void handleCommand(const char* command);
+void handleMqttMessage(const char* topic, const uint8_t* payload, unsigned int length);
+void handleSerialCommands();
+void printHistorySummary();
+void checkAlerts();
+void publishClosedCandles();
+bool shouldFetchStock(const AssetData& asset, time_t now);
+unsigned long stockRecheckDelay(const AssetData& asset, time_t now);
 void setupTime();
 
 void setup() {
@@ -65,6 +131,20 @@ void setup() {
   M5.begin();
   display.begin();
   
+  // Alert rules live in RAM (PSRAM when present), a copy on flash
+  alerts.begin(assets, assetCount);
+  
+  // Mount SPIFFS for the icon cache, price history and alert rules (formats on first boot)
+  spiffsMounted = SPIFFS.begin(true);
+  if (spiffsMounted) {
+    iconCache.begin(SPIFFS);
+    display.setIconCache(&iconCache);
+    priceHistory.begin(SPIFFS);
+    alerts.load(SPIFFS);
+  } else {
+    Serial.println("SPIFFS mount failed - downloaded icons, price history and saved alerts disabled");
+  }
+  
   // Set initial brightness - M5Unified API
   M5.Display.setBrightness(BRIGHTNESS_LEVELS[currentBrightnessIndex]);
   Serial.printf("Initial brightness set to: %d/255 (%d%%)\n", 
@@ -82,147 +162,491 @@ void setup() {
     display.displayError("WiFi connection failed");
     Serial.printf("WiFi Error: %s\n", apiClient.getLastError());
     Serial.println("Retrying in 10 seconds...");
-    delay(10000);
-    ESP.restart(); // Restart and try again
+    display.setStatus(STATUS_WIFI, STATUS_ERROR);
+    restartRequestedAt = millis();
+    restartPending = true; // loop() keeps the UI alive, then restarts
+    return;
   }
   
   display.displayWiFiStatus("Connected! Loading data...");
   
+  // Start the Prometheus metrics endpoint
+  metrics.registerTask("loop", xTaskGetCurrentTaskHandle());
+  metrics.registerTask("iconFetch", iconCache.getTaskHandle());
+  metrics.registerTask("ticker", display.getTicker().getTaskHandle());
+  metrics.setTicker(&display.getTicker());
+  metrics.setSurface(&lcdSurface);
+  metrics.setGlyphAtlas(&display.getPriceAtlas());
+  metrics.begin();
+  
   // Setup time synchronization with NTP
   setupTime();
   
   // Initialize MQTT connection to Home Assistant
   display.displayWiFiStatus("Connecting to MQTT...");
+  mqttClient.setCommandHandler(handleCommand);
+  mqttClient.setMessageHandler(handleMqttMessage);
+  mqttClient.setMarketStats(&marketStats);
+  fleet.begin(mqttClient, assets, assetCount); // Client id and Last Will depend on the role
+  metrics.setFleet(&fleet);
+  metrics.setRetryPolicy(&retryPolicy);
+  metrics.setHistory(&priceHistory);
+  metrics.setAlerts(&alerts);
+  MqttTopic alertTopic;
+  alertTopic.format("%s/alerts/set", MQTT_TOPIC_PREFIX);
+  mqttClient.subscribe(alertTopic.c_str());
+  alertTopic.format("%s/alerts/add", MQTT_TOPIC_PREFIX);
+  mqttClient.subscribe(alertTopic.c_str());
   if (mqttClient.begin(MQTT_BROKER, MQTT_PORT, MQTT_USER, MQTT_PASSWORD)) {
     Serial.println("MQTT connected to Home Assistant");
     // Publish discovery configs so Home Assistant auto-creates entities
-    mqttClient.publishDiscoveryConfigs(assets, assetCount);
+    // (in a fleet only the gateway speaks for the prices)
+    if (fleet.fetchesPrices()) {
+      mqttClient.publishDiscoveryConfigs(assets, assetCount);
+    }
   } else {
     Serial.println("MQTT connection failed - will retry in background");
   }
   
-  // Initial data fetch
-  if (fetchAndUpdateData()) {
+  // Each asset is quoted once per provider currency; display currencies come from the FX table
+  for (int i = 0; i < assetCount; i++) {
+    fxTable.addPair(APIClient::quoteCurrency(assets[i]), assets[i].currency);
+  }
+  apiClient.setFxTable(&fxTable);
+  if (fleet.fetchesPrices()) {
+    refreshFxRates();
+  }
+  
+  // Initial data fetch (every asset starts out due)
+  scheduler.begin(assets, assetCount, millis());
+  metrics.setScheduler(&scheduler);
+  
+  // Candle and statistics history (PSRAM when present)
+  candles.begin();
+  marketStats.begin();
+  
+  // Stream crypto ticks (polling stays the fallback while it is down)
+  if (fleet.getRole() != FLEET_ROLE_DISPLAY) {
+    priceStream.setPaused(!fleet.fetchesPrices());
+    priceStream.setCandles(&candles);
+    priceStream.begin(assets, assetCount);
+    metrics.registerTask("priceStream", priceStream.getTaskHandle());
+    metrics.setPriceStream(&priceStream);
+  }
+  
+  int refreshedCount = 0;
+  if (!fleet.fetchesPrices()) {
+    // Fleet display: prices arrive as retained snapshots from the gateway
+    display.displayWiFiStatus("Waiting for gateway...");
+  } else if (refreshDueAssets(refreshedCount)) {
     dataLoaded = true;
     Serial.println("Initial data loaded successfully");
     // Publish initial prices to Home Assistant
     mqttClient.publishPrices(assets, assetCount);
   } else {
-    display.displayError("Failed to load initial data");
-    delay(3000);
+    display.displayError("Failed to load initial data"); // Stays up until a retry lands
   }
   
-  lastApiUpdate = millis();
   lastDisplaySwitch = millis();
 }
 
 void loop() {
+  metrics.recordLoopIteration();
   M5.update(); // Handle button presses
+  if (restartPending) {
+    waitForRestart();
+    return;
+  }
   mqttClient.loop(); // Maintain MQTT connection
+  if (fleet.loop() > 0) { // Gateway election, snapshots in or out
+    dataLoaded = true;
+  }
+  priceStream.setPaused(!fleet.fetchesPrices());
+  metrics.handleClient(); // Serve /metrics scrapes
+  handleSerialCommands();
+  iconCache.loop(); // Persist icon LRU order occasionally
   
   unsigned long currentTime = millis();
+  memSampleHeap(currentTime); // Largest-free-block low-water mark
+  priceHistory.sample(assets, assetCount, time(nullptr)); // New quotes onto flash (buffered)
+  priceHistory.loop(currentTime);
+  
+  handleButtons(currentTime);
   
-  // Handle Button A press for brightness control
-  if (M5.BtnA.wasPressed() && (currentTime - lastButtonPress > BUTTON_DEBOUNCE_MS)) {
-    cycleBrightness();
-    lastButtonPress = currentTime;
+  // Exchange rates on their own, slower schedule
+  if (fleet.fetchesPrices() && fxTable.isNeeded() && (long)(currentTime - nextFxRefresh) >= 0) {
+    refreshFxRates();
   }
   
-  // Check if we need to update data from API
-  if (currentTime - lastApiUpdate >= API_UPDATE_INTERVAL) {
-    display.displayWiFiStatus("Updating prices...");
-    
-    if (fetchAndUpdateData()) {
-      dataLoaded = true;
-      Serial.println("Data updated successfully");
-      // Publish updated prices to Home Assistant via MQTT
-      mqttClient.publishPrices(assets, assetCount);
+  // Connect ahead of the next fetch so its request leaves on the deadline
+  if (fleet.fetchesPrices()) {
+    prewarmNextFetch(currentTime);
+  }
+  
+  // Refresh whichever assets are due (a heap peek when nothing is)
+  if (fleet.fetchesPrices() && scheduler.timeUntilNextDue(millis()) == 0) {
+    int refreshedCount = 0;
+    if (refreshDueAssets(refreshedCount)) {
+      if (refreshedCount > 0) {
+        dataLoaded = true;
+        // Publish updated prices to Home Assistant via MQTT
+        mqttClient.publishPrices(assets, assetCount);
+      }
     } else {
       Serial.println("Failed to update data, using cached values");
-      display.displayError("Update failed");
-      delay(2000); // Show error briefly
+      display.showToast("Update failed", TOAST_ERROR);
     }
-    
-    lastApiUpdate = currentTime;
-    lastDisplaySwitch = currentTime; // Reset display timer
   }
   
-  // Display asset data if available
+  // Breaker state whenever it changes, and again after an MQTT reconnect
+  bool mqttConnected = mqttClient.isConnected();
+  if (fleet.fetchesPrices() && mqttConnected &&
+      (!mqttWasConnected || retryPolicy.changeCount() != publishedBreakerChanges)) {
+    mqttClient.publishBreakers(retryPolicy, millis());
+    publishedBreakerChanges = retryPolicy.changeCount();
+  }
+  mqttWasConnected = mqttConnected;
+  
+  // Status bar: connectivity as of this pass
+  display.setStatus(STATUS_WIFI, apiClient.isWiFiConnected() ? STATUS_OK : STATUS_ERROR);
+  display.setStatus(STATUS_MQTT, mqttConnected ? STATUS_OK : STATUS_ERROR);
+  
+  // Candles that closed since the last pass
+  publishClosedCandles();
+  
+  // Publish how old each price is (ages even when no fetch happens)
+  if (dataLoaded && fleet.fetchesPrices() &&
+      currentTime - lastStalenessPublish >= STALENESS_PUBLISH_INTERVAL) {
+    mqttClient.publishStaleness(assets, assetCount);
+    lastStalenessPublish = currentTime;
+  }
+  
+  // Fold streamed ticks into the asset table at the display rate
+  if (fleet.fetchesPrices() && currentTime - lastStreamApply >= STREAM_APPLY_INTERVAL_MS) {
+    if (priceStream.applyTicks(assets, assetCount, currentAssetIndex) > 0) {
+      dataLoaded = true;
+      time_t now = time(nullptr);
+      for (int i = 0; i < assetCount; i++) {
+        if (priceStream.covers(i)) {
+          marketStats.recordPrice(i, assets[i], now);
+        }
+      }
+    }
+    lastStreamApply = currentTime;
+  }
+  
+  // Alert rules against this pass's prices
   if (dataLoaded) {
-    // Switch to next asset every DISPLAY_DURATION milliseconds
-    if (currentTime - lastDisplaySwitch >= DISPLAY_DURATION) {
-      currentAssetIndex = (currentAssetIndex + 1) % assetCount;
-      lastDisplaySwitch = currentTime;
+    checkAlerts();
+  }
+  
+  // Display asset data if available (overlays are drawn with it)
+  if (dataLoaded) {
+    // Ticker mode: the render task scrolls, this only hands over prices
+    if (displayMode == DISPLAY_MODE_TICKER && !display.displayTicker(assets, assetCount)) {
+      display.showToast("Ticker unavailable", TOAST_ERROR);
+      displayMode = DISPLAY_MODE_SINGLE;
+    }
+    
+    if (displayMode == DISPLAY_MODE_GRID) {
+      // Pages turn every DISPLAY_DURATION (or on a long press of button A)
+      if (currentTime - lastDisplaySwitch >= DISPLAY_DURATION) {
+        nextGridPage();
+      }
+      display.displayGrid(assets, assetCount, gridPage);
+    } else if (displayMode == DISPLAY_MODE_SINGLE) {
+      // Switch to next asset every DISPLAY_DURATION milliseconds
+      if (currentTime - lastDisplaySwitch >= DISPLAY_DURATION) {
+        currentAssetIndex = (currentAssetIndex + 1) % assetCount;
+        lastDisplaySwitch = currentTime;
+      }
+      
+      unsigned long renderStart = micros();
+      display.displayAsset(assets[currentAssetIndex]);
+      metrics.recordRender(micros() - renderStart);
+      
+      uint32_t tickLatencyUs = priceStream.takeRenderLatencyUs(currentAssetIndex);
+      if (tickLatencyUs > 0) {
+        metrics.recordTickToPixel(tickLatencyUs / 1000);
+      }
     }
     
-    display.displayAsset(assets[currentAssetIndex]);
+    // The ticker strip picks new prices up within a frame
+    if (refreshLagPending) {
+      long lag = (long)(millis() - refreshDeadline);
+      metrics.recordRefreshLag(lag > 0 ? lag : 0);
+      refreshLagPending = false;
+    }
+  } else {
+    display.updateOverlays(millis()); // Status bar and toasts over the message screen
   }
   
   // Small delay to prevent excessive CPU usage (50ms = responsive button presses)
   delay(50);
 }
 
-bool fetchAndUpdateData() {
+// Refresh every asset whose deadline has arrived, with one request per provider.
+// Returns false only when every request made failed.
+bool refreshDueAssets(int& refreshedCount) {
+  refreshedCount = 0;
+  uint8_t due[SCHEDULER_MAX_ASSETS];
+  int dueCount = scheduler.takeDue(millis(), due, SCHEDULER_MAX_ASSETS);
+  if (dueCount == 0) {
+    return true;
+  }
+  
+  TraceScope traceScope(TRACE_UPDATE);
+  
   if (!apiClient.isWiFiConnected()) {
     Serial.println("WiFi disconnected, attempting reconnection...");
-    if (!apiClient.connectWiFi(WIFI_SSID, WIFI_PASSWORD, WIFI_CONNECT_TIMEOUT)) {
+    display.setStatus(STATUS_WIFI, STATUS_BUSY);
+    display.updateOverlays(millis());
+    trace.begin(TRACE_WIFI_RECONNECT);
+    bool reconnected = apiClient.connectWiFi(WIFI_SSID, WIFI_PASSWORD, WIFI_CONNECT_TIMEOUT);
+    trace.end(TRACE_WIFI_RECONNECT);
+    if (!reconnected) {
+      // Not the providers' fault, so no breaker: just back off the reconnects
+      if (wifiFailures < UINT16_MAX) {
+        wifiFailures++;
+      }
+      unsigned long retryMs = RetryPolicy::retryDelayMs(wifiFailures, FETCH_ERROR_NETWORK);
+      for (int i = 0; i < dueCount; i++) {
+        unsigned long interval = assets[due[i]].refreshIntervalMs;
+        scheduler.schedule(due[i], millis(), retryMs < interval ? retryMs : interval);
+      }
       return false;
     }
   }
+  wifiFailures = 0;
+  
+  // Group due assets by provider; closed markets don't get a request at all
+  AssetData* cryptos[SCHEDULER_MAX_ASSETS];
+  uint8_t cryptoIndex[SCHEDULER_MAX_ASSETS];
+  int cryptoCount = 0;
+  AssetData* stocks[SCHEDULER_MAX_ASSETS];
+  uint8_t stockIndex[SCHEDULER_MAX_ASSETS];
+  int stockCount = 0;
+  time_t now = time(nullptr);
+  
+  for (int i = 0; i < dueCount; i++) {
+    AssetData& asset = assets[due[i]];
+    if (!asset.isStock && priceStream.isLive() && priceStream.covers(due[i])) {
+      // Already streaming: count it as refreshed so MQTT still gets a snapshot
+      scheduler.recordRefresh(due[i], millis());
+      scheduler.schedule(due[i], millis(), asset.refreshIntervalMs);
+      refreshedCount++;
+      continue;
+    }
+    if (!asset.isStock) {
+      cryptoIndex[cryptoCount] = due[i];
+      cryptos[cryptoCount++] = &asset;
+      continue;
+    }
+    
+    MarketCalendar* calendar = marketCalendarFor(asset.exchange);
+    asset.marketClosed = calendar != nullptr && isClockSynced(now) && !calendar->isOpen(now);
+    if (shouldFetchStock(asset, now)) {
+      stockIndex[stockCount] = due[i];
+      stocks[stockCount++] = &asset;
+    } else {
+      // Closed and the post-close price is already in hand - sleep until it matters
+      scheduler.schedule(due[i], millis(), stockRecheckDelay(asset, now));
+    }
+  }
   
-  bool cryptoSuccess = false;
-  bool stockSuccess = false;
+  int requests = 0;
+  int failures = 0;
+  bool anyFetched = false;
+  unsigned long earliestDeadline = 0;
   
-  // Fetch cryptocurrency data (first 3 assets) - pass directly, no copying needed
-  constexpr int cryptoCount = 3;
-  if (apiClient.fetchCryptoData(assets, cryptoCount)) {
-    Serial.println("Successfully fetched cryptocurrency data:");
-    // Update price tracking for each crypto asset
+  if (cryptoCount > 0) {
+    bool fetched = false;
+    unsigned long retryMs = 0;
+    if (retryPolicy.allowRequest(PROVIDER_CMC, millis())) {
+      requests++;
+      showFetching();
+      fetched = apiClient.fetchCryptoData(cryptos, cryptoCount);
+      if (fetched) {
+        Serial.println("Successfully fetched cryptocurrency data:");
+        retryPolicy.recordSuccess(PROVIDER_CMC);
+      } else {
+        Serial.printf("Failed to fetch crypto data: %s\n", apiClient.getLastError());
+        failures++;
+        retryMs = retryPolicy.recordFailure(PROVIDER_CMC, apiClient.getLastErrorKind(), millis());
+      }
+    } else {
+      retryMs = retryPolicy.blockedForMs(PROVIDER_CMC, millis());
+      Serial.printf("Crypto breaker open, next attempt in %lus\n", retryMs / 1000);
+    }
+    
     for (int i = 0; i < cryptoCount; i++) {
-      Serial.printf("  %s: $%.2f %s", assets[i].symbol, assets[i].price, assets[i].currency);
-      if (!assets[i].firstUpdate) {
-        Serial.printf(" (%s)", assets[i].priceIncreased ? "UP" : "DOWN");
+      AssetData& crypto = *cryptos[i];
+      // A fetched asset may still have been skipped (no exchange rate yet)
+      if (!fetched) {
+        crypto.fetchFailed = true;
+      }
+      if (fetched && !crypto.fetchFailed) {
+        Serial.printf("  %s: $%.2f %s", crypto.symbol, crypto.price, crypto.currency);
+        if (!crypto.firstUpdate) {
+          Serial.printf(" (%s)", crypto.priceIncreased ? "UP" : "DOWN");
+        }
+        Serial.println();
+        candles.addSample(cryptoIndex[i], crypto.price, time(nullptr));
+        marketStats.recordQuote(cryptoIndex[i], crypto, time(nullptr));
+        scheduler.recordRefresh(cryptoIndex[i], millis());
+        refreshedCount++;
+        unsigned long dueAt = scheduler.lastDueAt(cryptoIndex[i]);
+        if (!anyFetched || (long)(dueAt - earliestDeadline) < 0) {
+          earliestDeadline = dueAt;
+        }
+        anyFetched = true;
       }
-      Serial.println();
+      scheduler.schedule(cryptoIndex[i], millis(),
+                         fetched ? crypto.refreshIntervalMs
+                                 : retryDelay(PROVIDER_CMC, retryMs, crypto.refreshIntervalMs));
     }
-    cryptoSuccess = true;
-  } else {
-    Serial.printf("Failed to fetch crypto data: %s\n", apiClient.getLastError());
   }
   
-  // Fetch stock data (MSFT - index 3) - price tracking handled in API client
-  if (apiClient.fetchStockData(assets[3])) {
-    // Update status based on market hours
-    if (isMarketOpen()) {
-      // Market is open - keep the API timestamp
-      Serial.printf("Successfully fetched stock data (market open): %s: $%.2f %s", 
-                    assets[3].symbol, assets[3].price, assets[3].currency);
+  if (stockCount > 0) {
+    bool fetched = false;
+    unsigned long retryMs = 0;
+    if (retryPolicy.allowRequest(PROVIDER_FMP, millis())) {
+      requests++;
+      showFetching();
+      fetched = apiClient.fetchStockData(stocks, stockCount);
+      if (fetched) {
+        retryPolicy.recordSuccess(PROVIDER_FMP);
+      } else {
+        Serial.printf("Failed to fetch stock data: %s\n", apiClient.getLastError());
+        failures++;
+        retryMs = retryPolicy.recordFailure(PROVIDER_FMP, apiClient.getLastErrorKind(), millis());
+      }
     } else {
-      // Market is closed - show last price but with "Market Closed" status
-      assets[3].lastUpdated = "Market Closed";
-      Serial.printf("Successfully fetched stock data (market closed): %s: $%.2f %s", 
-                    assets[3].symbol, assets[3].price, assets[3].currency);
+      retryMs = retryPolicy.blockedForMs(PROVIDER_FMP, millis());
+      Serial.printf("Stock breaker open, next attempt in %lus\n", retryMs / 1000);
     }
     
-    // Show price movement indicator
-    if (!assets[3].firstUpdate) {
-      Serial.printf(" (%s)", assets[3].priceIncreased ? "UP" : "DOWN");
+    for (int i = 0; i < stockCount; i++) {
+      AssetData& stock = *stocks[i];
+      if (fetched && !stock.fetchFailed) {
+        Serial.printf("Successfully fetched stock data (market %s): %s: $%.2f %s",
+                      stock.marketClosed ? "closed" : "open",
+                      stock.symbol, stock.price, stock.currency);
+        
+        // Show price movement indicator
+        if (!stock.firstUpdate) {
+          Serial.printf(" (%s)", stock.priceIncreased ? "UP" : "DOWN");
+        }
+        Serial.println();
+        candles.addSample(stockIndex[i], stock.price, time(nullptr));
+        marketStats.recordQuote(stockIndex[i], stock, time(nullptr));
+        scheduler.recordRefresh(stockIndex[i], millis());
+        refreshedCount++;
+        unsigned long dueAt = scheduler.lastDueAt(stockIndex[i]);
+        if (!anyFetched || (long)(dueAt - earliestDeadline) < 0) {
+          earliestDeadline = dueAt;
+        }
+        anyFetched = true;
+      } else if (stock.price > 0.0) {
+        // If we have existing price data, preserve it (fetched: no exchange rate yet)
+        stock.fetchFailed = true;
+        Serial.printf("Using cached stock price: %s: $%.2f %s\n", 
+                      stock.symbol, stock.price, stock.currency);
+      }
+      scheduler.schedule(stockIndex[i], millis(),
+                         fetched ? stock.refreshIntervalMs
+                                 : retryDelay(PROVIDER_FMP, retryMs, stock.refreshIntervalMs));
     }
-    Serial.println();
-    stockSuccess = true;
-  } else {
-    Serial.printf("Failed to fetch stock data: %s\n", apiClient.getLastError());
-    // If we have existing price data, preserve it
-    if (assets[3].price > 0.0) {
-      assets[3].lastUpdated = "Update Failed";
-      Serial.printf("Using cached stock price: %s: $%.2f %s\n", 
-                    assets[3].symbol, assets[3].price, assets[3].currency);
-      stockSuccess = true; // Don't treat this as a complete failure if we have cached data
+  }
+  
+  if (anyFetched) {
+    refreshDeadline = earliestDeadline;
+    refreshLagPending = true;
+  }
+  if (requests > 0) {
+    display.setStatus(STATUS_FETCH, failures == 0 ? STATUS_OK : STATUS_ERROR);
+  }
+  
+  return requests == 0 || failures < requests;
+}
+
+// When to try again after a failed or skipped request: the retry delay, but no
+// later than the normal refresh unless the provider's breaker is holding it off
+unsigned long retryDelay(Provider provider, unsigned long retryMs, unsigned long refreshIntervalMs) {
+  if (retryPolicy.state(provider) == BREAKER_OPEN || retryMs < refreshIntervalMs) {
+    return retryMs;
+  }
+  return refreshIntervalMs;
+}
+
+// Bring up WiFi/DNS/TLS for the earliest upcoming fetch once it is within the
+// estimated lead time, so the request itself can go out on the deadline
+void prewarmNextFetch(unsigned long now) {
+  uint8_t upcoming[SCHEDULER_MAX_ASSETS];
+  unsigned long dueAt[SCHEDULER_MAX_ASSETS];
+  int upcomingCount = scheduler.upcoming(now, 60000, upcoming, dueAt, SCHEDULER_MAX_ASSETS);
+  
+  int next = -1;
+  for (int i = 0; i < upcomingCount; i++) {
+    const AssetData& asset = assets[upcoming[i]];
+    time_t dueWall = time(nullptr) + (long)(dueAt[i] - now) / 1000;
+    bool fetches = asset.isStock ? shouldFetchStock(asset, dueWall)
+                                 : !(priceStream.isLive() && priceStream.covers(upcoming[i]));
+    if (fetches && (next < 0 || (long)(dueAt[i] - dueAt[next]) < 0)) {
+      next = i;
     }
   }
+  if (next < 0 || dueAt[next] == prewarmedDeadline) {
+    return;
+  }
   
-  // Return true if at least one API call succeeded
-  return cryptoSuccess || stockSuccess;
+  Provider provider = assets[upcoming[next]].isStock ? PROVIDER_FMP : PROVIDER_CMC;
+  if (retryPolicy.blockedForMs(provider, now) > 0) {
+    return; // Breaker open: the fetch won't happen
+  }
+  long untilDue = (long)(dueAt[next] - now);
+  if (untilDue > (long)apiClient.prewarmLeadMs(provider)) {
+    return;
+  }
+  prewarmedDeadline = dueAt[next];
+  if (!apiClient.prewarm(provider)) {
+    Serial.printf("Prewarm failed: %s\n", apiClient.getLastError());
+  }
+}
+
+// Publish each candle as it closes (only the device that fetches speaks for prices)
+void publishClosedCandles() {
+  uint8_t asset;
+  CandleInterval interval;
+  Candle candle;
+  while (candles.takeClosed(asset, interval, candle)) {
+    if (fleet.fetchesPrices() && asset < assetCount) {
+      mqttClient.publishCandle(assets[asset], interval, candle);
+    }
+  }
+}
+
+// Refresh the FX table when any display currency needs it; schedules the next attempt
+bool refreshFxRates() {
+  if (!fxTable.isNeeded()) {
+    return true;
+  }
+  if (!retryPolicy.allowRequest(PROVIDER_FX, millis())) {
+    nextFxRefresh = millis() + retryPolicy.blockedForMs(PROVIDER_FX, millis());
+    return false;
+  }
+  showFetching();
+  bool fetched = apiClient.fetchFxRates(fxTable);
+  display.setStatus(STATUS_FETCH, fetched ? STATUS_OK : STATUS_ERROR);
+  if (fetched) {
+    retryPolicy.recordSuccess(PROVIDER_FX);
+    nextFxRefresh = millis() + FX_REFRESH_MS;
+  } else {
+    Serial.printf("Failed to fetch exchange rates: %s\n", apiClient.getLastError());
+    unsigned long retryMs = retryPolicy.recordFailure(PROVIDER_FX, apiClient.getLastErrorKind(), millis());
+    nextFxRefresh = millis() + retryDelay(PROVIDER_FX, retryMs, FX_RETRY_MS);
+  }
+  return fetched;
 }
 
 // Cycle through brightness levels when button A is pressed
@@ -238,29 +662,191 @@ void cycleBrightness() {
   Serial.printf("Brightness changed to: %d/255 (%d%%, level %d)\n", 
                 BRIGHTNESS_LEVELS[currentBrightnessIndex], percentBrightness, currentBrightnessIndex + 1);
   
-  // Optional: Show brightness on screen briefly (uncomment if desired)
-  /*
-  M5.Lcd.fillRect(10, 10, 120, 30, TFT_BLACK);
-  M5.Lcd.setTextColor(TFT_YELLOW, TFT_BLACK);
-  M5.Lcd.setTextSize(1);
-  M5.Lcd.setTextDatum(TL_DATUM);
-  M5.Lcd.drawString("Brightness: " + String(brightnessPercent) + "%", 15, 20);
-  delay(1000);
-  */
+  char toast[24];
+  snprintf(toast, sizeof(toast), "Brightness %d%%", percentBrightness);
+  display.showToast(toast, TOAST_INFO);
+}
+
+void setDisplayMode(DisplayMode mode) {
+  if (mode == displayMode) {
+    return;
+  }
+  static const char* const names[] = {"single", "grid", "ticker"};
+  displayMode = mode;
+  lastDisplaySwitch = millis(); // The new view starts with a full DISPLAY_DURATION
+  Serial.printf("Display mode: %s\n", names[mode]);
+}
+
+void nextGridPage() {
+  int pages = (assetCount + GRID_CELLS - 1) / GRID_CELLS;
+  gridPage = (gridPage + 1) % pages;
+  lastDisplaySwitch = millis();
+}
+
+// Button A cycles the brightness (long press: next overview page), button B
+// cycles the views
+void handleButtons(unsigned long now) {
+  if (displayMode == DISPLAY_MODE_GRID && M5.BtnA.wasHold()) {
+    nextGridPage();
+    lastButtonPress = now;
+  } else if (M5.BtnA.wasClicked() && (now - lastButtonPress > BUTTON_DEBOUNCE_MS)) {
+    cycleBrightness(); // On release, so a long press doesn't also change it
+    lastButtonPress = now;
+  }
+  if (M5.BtnB.wasPressed() && (now - lastButtonPress > BUTTON_DEBOUNCE_MS)) {
+    setDisplayMode((DisplayMode)((displayMode + 1) % DISPLAY_MODE_COUNT));
+    lastButtonPress = now;
+  }
+}
+
+// WiFi never came up at boot: keep the button and screen responsive until the restart
+void waitForRestart() {
+  unsigned long now = millis();
+  handleButtons(now);
+  display.updateOverlays(now);
+  if (now - restartRequestedAt >= WIFI_BOOT_RESTART_MS) {
+    ESP.restart();
+  }
+  delay(50);
+}
+
+// Light the fetch dot before a blocking request, so it shows while the loop waits
+void showFetching() {
+  display.setStatus(STATUS_FETCH, STATUS_BUSY);
+  display.updateOverlays(millis());
+}
+
+// Handle commands received over MQTT (<prefix>/cmd)
+void handleCommand(const char* command) {
+  if (strcmp(command, "trace") == 0) {
+    mqttClient.publishTrace(trace);
+  } else if (strcmp(command, "trace_clear") == 0) {
+    trace.clear();
+  } else if (strcmp(command, "single") == 0) {
+    setDisplayMode(DISPLAY_MODE_SINGLE);
+  } else if (strcmp(command, "grid") == 0) {
+    setDisplayMode(DISPLAY_MODE_GRID);
+  } else if (strcmp(command, "ticker") == 0) {
+    setDisplayMode(DISPLAY_MODE_TICKER);
+  } else {
+    Serial.printf("Unknown command: %s\n", command);
+  }
+}
+
+// Non-command MQTT messages: alert rules (<prefix>/alerts/set replaces them,
+// /alerts/add appends), the rest belongs to fleet mode (gateway status and snapshots)
+void handleMqttMessage(const char* topic, const uint8_t* payload, unsigned int length) {
+  MqttTopic setTopic;
+  setTopic.format("%s/alerts/set", MQTT_TOPIC_PREFIX);
+  MqttTopic addTopic;
+  addTopic.format("%s/alerts/add", MQTT_TOPIC_PREFIX);
+  if (setTopic == topic || addTopic == topic) {
+    if (setTopic == topic) {
+      alerts.setRules((const char*)payload, length);
+    } else {
+      alerts.addRules((const char*)payload, length);
+    }
+    if (spiffsMounted) {
+      alerts.save(SPIFFS);
+    }
+    char toast[24];
+    snprintf(toast, sizeof(toast), "%u alert rules", (unsigned)alerts.ruleCount());
+    display.showToast(toast, TOAST_INFO);
+    return;
+  }
+  fleet.handleMessage(topic, payload, length);
+}
+
+// Compare every asset with the alert rules; fired ones sound the buzzer,
+// flash the screen, show a toast and go out over MQTT
+void checkAlerts() {
+  time_t now = time(nullptr);
+  for (int i = 0; i < assetCount; i++) {
+    alerts.check(i, assets[i], i < marketStats.assetCapacity() ? &marketStats.get(i) : nullptr, now);
+  }
+  
+  AlertEvent event;
+  while (alerts.takeFired(event)) {
+    char message[40];
+    alerts.describe(event, message, sizeof(message));
+    Serial.printf("Alert: %s (now %.4f)\n", message, event.value);
+    display.showToast(message, TOAST_ALERT, ALERT_TOAST_MS);
+    display.flash();
+    if (ALERT_TONE_MS > 0) {
+      M5.Speaker.tone(ALERT_TONE_HZ, ALERT_TONE_MS);
+    }
+    // In a fleet only the gateway speaks for the prices
+    if (fleet.fetchesPrices()) {
+      mqttClient.publishAlert(assets[event.asset], event, message);
+    }
+  }
+}
+
+// Single-character serial commands: 't' dumps the phase trace
+void handleSerialCommands() {
+  while (Serial.available() > 0) {
+    int command = Serial.read();
+    if (command == 't') {
+      trace.writeHex(Serial);
+    } else if (command == 'h') {
+      printHistorySummary();
+    }
+  }
+}
+
+// Last 24 hours of stored prices per asset (serial 'h')
+struct HistorySummary {
+  size_t points;
+  time_t first;
+  float low;
+  float high;
+  float last;
+};
+
+static void addToSummary(const HistoryPoint& point, void* context) {
+  HistorySummary* summary = static_cast<HistorySummary*>(context);
+  if (summary->points++ == 0) {
+    summary->first = point.epoch;
+    summary->low = point.price;
+    summary->high = point.price;
+  }
+  if (point.price < summary->low) {
+    summary->low = point.price;
+  }
+  if (point.price > summary->high) {
+    summary->high = point.price;
+  }
+  summary->last = point.price;
+}
+
+void printHistorySummary() {
+  time_t now = time(nullptr);
+  priceHistory.flush(); // So the query sees everything on flash
+  for (int i = 0; i < assetCount; i++) {
+    HistorySummary summary = {0, 0, 0.0f, 0.0f, 0.0f};
+    priceHistory.query(assets[i].symbol, now - 86400, now, addToSummary, &summary);
+    if (summary.points == 0) {
+      Serial.printf("History %s: no points in the last 24h\n", assets[i].symbol);
+      continue;
+    }
+    Serial.printf("History %s: %u points since %ldm ago, low %.4f high %.4f last %.4f (%lu us)\n",
+                  assets[i].symbol, (unsigned)summary.points, (long)(now - summary.first) / 60,
+                  summary.low, summary.high, summary.last, (unsigned long)priceHistory.lastQueryMicros());
+  }
 }
 
 // Setup NTP time synchronization for Eastern Time (EST/EDT auto-switching)
 void setupTime() {
   Serial.println("Setting up time synchronization...");
   
-  // Configure time for Eastern Time with automatic DST handling
-  // EST: UTC-5, EDT: UTC-4 (automatically switches based on date)
-  configTime(-5 * 3600, 3600, "pool.ntp.org", "time.nist.gov");
+  // Eastern Time via a POSIX TZ rule so DST switches on the right dates
+  // (EST: UTC-5, EDT: UTC-4 from the 2nd Sunday of March to the 1st Sunday of November)
+  configTzTime(MARKET_TZ, "pool.ntp.org", "time.nist.gov");
   
   Serial.print("Waiting for NTP time sync");
   time_t now = time(nullptr);
   int attempts = 0;
-  while (now < 8 * 3600 * 2 && attempts < 20) { // Wait for valid time
+  while (!isClockSynced(now) && attempts < 20) { // Wait for valid time
     delay(500);
     Serial.print(".");
     now = time(nullptr);
@@ -268,7 +854,7 @@ void setupTime() {
   }
   Serial.println();
   
-  if (now > 8 * 3600 * 2) {
+  if (isClockSynced(now)) {
     struct tm timeinfo;
     localtime_r(&now, &timeinfo);
     Serial.printf("Time synchronized: %04d-%02d-%02d %02d:%02d:%02d ET\n",
@@ -279,31 +865,33 @@ void setupTime() {
   }
 }
 
-// Check if US stock market is open (9:05 AM - 4:05 PM ET, Monday-Friday)
-bool isMarketOpen() {
-  time_t now = time(nullptr);
-  struct tm timeinfo;
-  localtime_r(&now, &timeinfo);
-  
-  // Check if it's a weekday (Monday=1, Friday=5)
-  int dayOfWeek = timeinfo.tm_wday;
-  if (dayOfWeek == 0 || dayOfWeek == 6) { // Sunday=0, Saturday=6
-    Serial.println("Market closed: Weekend");
-    return false;
+// Stock quotes are only requested during a session, plus one final fetch
+// after each close to pick up the closing price
+bool shouldFetchStock(const AssetData& asset, time_t now) {
+  MarketCalendar* calendar = marketCalendarFor(asset.exchange);
+  if (calendar == nullptr || !isClockSynced(now)) {
+    return true; // No calendar or no clock: behave as if always open
+  }
+  if (calendar->isOpen(now)) {
+    return true;
   }
   
-  // Check time range: 9:05 AM (09:05) to 4:05 PM (16:05) EDT
-  int currentHour = timeinfo.tm_hour;
-  int currentMinute = timeinfo.tm_min;
-  int currentTimeInMinutes = currentHour * 60 + currentMinute;
-  
-  int marketOpenMinutes = 9 * 60 + 5;  // 9:05 AM = 545 minutes
-  int marketCloseMinutes = 16 * 60 + 5; // 4:05 PM = 965 minutes
-  
-  bool isOpen = (currentTimeInMinutes >= marketOpenMinutes && currentTimeInMinutes <= marketCloseMinutes);
-  
-  Serial.printf("Current time: %02d:%02d ET, Market %s\n", 
-                currentHour, currentMinute, isOpen ? "OPEN" : "CLOSED");
+  time_t finalFetchAt = calendar->lastClose(now) + MARKET_POST_CLOSE_DELAY_SEC;
+  return now >= finalFetchAt && asset.fetchTime < finalFetchAt;
+}
+
+// How long a closed-market stock can sleep: until the post-close fetch if it
+// is still ahead, otherwise until the next open
+unsigned long stockRecheckDelay(const AssetData& asset, time_t now) {
+  MarketCalendar* calendar = marketCalendarFor(asset.exchange);
+  if (calendar == nullptr) {
+    return asset.refreshIntervalMs;
+  }
   
-  return isOpen;
+  time_t finalFetchAt = calendar->lastClose(now) + MARKET_POST_CLOSE_DELAY_SEC;
+  time_t wakeAt = (now < finalFetchAt) ? finalFetchAt : calendar->nextTransition(now);
+  if (wakeAt <= now) {
+    return 1000;
+  }
+  return (unsigned long)(wakeAt - now) * 1000UL;
 }
@@ -0,0 +1,182 @@
+#include "market_calendar.h"
+#include "time_utils.h"
+#include <Arduino.h>
+
+// Dates are encoded as YYYYMMDD. Extend these tables each year from the
+// published exchange calendars (NYSE and NASDAQ share one calendar).
+static const uint32_t US_HOLIDAYS[] = {
+  20250101, 20250109, 20250120, 20250217, 20250418, 20250526, 20250619, 20250704,
+  20250901, 20251127, 20251225,
+  20260101, 20260119, 20260216, 20260403, 20260525, 20260619, 20260703, 20260907,
+  20261126, 20261225,
+  20270101, 20270118, 20270215, 20270326, 20270531, 20270618, 20270705, 20270906,
+  20271125, 20271224,
+};
+
+static const uint32_t US_EARLY_CLOSES[] = {  // 1:00 PM close
+  20250703, 20251128, 20251224,
+  20261127, 20261224,
+  20271126,
+};
+
+static const uint32_t TSX_HOLIDAYS[] = {
+  20250101, 20250217, 20250418, 20250519, 20250701, 20250804, 20250901, 20251013,
+  20251225, 20251226,
+  20260101, 20260216, 20260403, 20260518, 20260701, 20260803, 20260907, 20261012,
+  20261225, 20261228,
+  20270101, 20270215, 20270326, 20270524, 20270701, 20270802, 20270906, 20271011,
+  20271227, 20271228,
+};
+
+static const uint32_t TSX_EARLY_CLOSES[] = {  // 1:00 PM close
+  20251224, 20261224, 20271224,
+};
+
+#define TABLE_SIZE(table) (sizeof(table) / sizeof(table[0]))
+
+static const int SESSION_OPEN_MINUTES = 9 * 60 + 30;   // 9:30 AM
+static const int SESSION_CLOSE_MINUTES = 16 * 60;      // 4:00 PM
+static const int EARLY_CLOSE_MINUTES = 13 * 60;        // 1:00 PM
+static const int MAX_LOOKBACK_DAYS = 7;                // Longer than any exchange closure
+static const int MAX_LOOKAHEAD_DAYS = 14;
+
+static bool tableContains(const uint32_t* table, size_t size, uint32_t date) {
+  // Tables are sorted, but they are small enough that a linear scan is fine
+  for (size_t i = 0; i < size; i++) {
+    if (table[i] == date) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Local time for a given date and minute of day (DST resolved by mktime)
+static time_t localEpoch(int year, int month, int day, int minutes) {
+  struct tm local = {};
+  local.tm_year = year - 1900;
+  local.tm_mon = month - 1;
+  local.tm_mday = day;
+  local.tm_hour = minutes / 60;
+  local.tm_min = minutes % 60;
+  local.tm_isdst = -1;
+  return mktime(&local);
+}
+
+MarketCalendar::MarketCalendar(Exchange exchange) : exchange(exchange) {
+  open = false;
+  transitionAt = 0;
+  previousClose = 0;
+}
+
+bool MarketCalendar::isOpen(time_t now) {
+  if (transitionAt == 0 || now >= transitionAt) {
+    recompute(now);
+  }
+  return open;
+}
+
+time_t MarketCalendar::nextTransition(time_t now) {
+  isOpen(now);
+  return transitionAt;
+}
+
+time_t MarketCalendar::lastClose(time_t now) {
+  isOpen(now);
+  return previousClose;
+}
+
+const char* MarketCalendar::name() const {
+  switch (exchange) {
+    case EXCHANGE_NYSE: return "NYSE";
+    case EXCHANGE_NASDAQ: return "NASDAQ";
+    case EXCHANGE_TSX: return "TSX";
+    default: return "24/7";
+  }
+}
+
+void MarketCalendar::recompute(time_t now) {
+  if (!isClockSynced(now)) {
+    // Without a clock we can't know; report closed and check again shortly
+    open = false;
+    transitionAt = now + 60;
+    return;
+  }
+
+  struct tm today;
+  localtime_r(&now, &today);
+
+  open = false;
+  transitionAt = 0;
+  previousClose = 0;
+
+  // Walk forward day by day from a week ago (to find the last close) until
+  // we find the session that contains or follows now
+  for (int offset = -MAX_LOOKBACK_DAYS; offset <= MAX_LOOKAHEAD_DAYS; offset++) {
+    struct tm date = today;
+    date.tm_mday += offset;
+    date.tm_hour = 12; // Midday avoids DST edge cases when normalizing
+    date.tm_isdst = -1;
+    mktime(&date);
+
+    int year = date.tm_year + 1900;
+    int month = date.tm_mon + 1;
+    int day = date.tm_mday;
+    if (date.tm_wday == 0 || date.tm_wday == 6 || isHoliday(year, month, day)) {
+      continue;
+    }
+
+    time_t openAt = localEpoch(year, month, day, SESSION_OPEN_MINUTES);
+    time_t closeAt = localEpoch(year, month, day, closeMinutes(year, month, day));
+
+    if (now < openAt) {
+      transitionAt = openAt;
+      break;
+    }
+    if (now < closeAt) {
+      open = true;
+      transitionAt = closeAt;
+      break;
+    }
+    previousClose = closeAt;
+  }
+
+  if (transitionAt == 0) {
+    // Ran past the end of the holiday tables' horizon; re-evaluate in an hour
+    transitionAt = now + 3600;
+  }
+
+  struct tm next;
+  localtime_r(&transitionAt, &next);
+  Serial.printf("Market %s %s, next %s at %04d-%02d-%02d %02d:%02d\n",
+                name(), open ? "OPEN" : "CLOSED", open ? "close" : "open",
+                next.tm_year + 1900, next.tm_mon + 1, next.tm_mday, next.tm_hour, next.tm_min);
+}
+
+bool MarketCalendar::isHoliday(int year, int month, int day) const {
+  uint32_t date = year * 10000 + month * 100 + day;
+  if (exchange == EXCHANGE_TSX) {
+    return tableContains(TSX_HOLIDAYS, TABLE_SIZE(TSX_HOLIDAYS), date);
+  }
+  return tableContains(US_HOLIDAYS, TABLE_SIZE(US_HOLIDAYS), date);
+}
+
+int MarketCalendar::closeMinutes(int year, int month, int day) const {
+  uint32_t date = year * 10000 + month * 100 + day;
+  bool early = (exchange == EXCHANGE_TSX)
+    ? tableContains(TSX_EARLY_CLOSES, TABLE_SIZE(TSX_EARLY_CLOSES), date)
+    : tableContains(US_EARLY_CLOSES, TABLE_SIZE(US_EARLY_CLOSES), date);
+  return early ? EARLY_CLOSE_MINUTES : SESSION_CLOSE_MINUTES;
+}
+
+MarketCalendar* marketCalendarFor(Exchange exchange) {
+  static MarketCalendar nyse(EXCHANGE_NYSE);
+  static MarketCalendar nasdaq(EXCHANGE_NASDAQ);
+  static MarketCalendar tsx(EXCHANGE_TSX);
+
+  switch (exchange) {
+    case EXCHANGE_NYSE: return &nyse;
+    case EXCHANGE_NASDAQ: return &nasdaq;
+    case EXCHANGE_TSX: return &tsx;
+    default: return nullptr;
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef MARKET_CALENDAR_H
+#define MARKET_CALENDAR_H
+
+#include <time.h>
+#include <stdint.h>
+
+// Exchanges with a trading calendar (EXCHANGE_NONE = trades 24/7, e.g. crypto)
+enum Exchange : uint8_t {
+  EXCHANGE_NONE = 0,
+  EXCHANGE_NYSE,
+  EXCHANGE_NASDAQ,
+  EXCHANGE_TSX,
+  EXCHANGE_COUNT
+};
+
+// Trading sessions for one exchange: regular hours, weekends, holidays and
+// early closes. Session times are local exchange time; NYSE, NASDAQ and TSX
+// all trade on Eastern time, so the process TZ (MARKET_TZ) must be set.
+//
+// The next open/close transition is precomputed, so isOpen() is a single
+// comparison until that moment passes.
+class MarketCalendar {
+public:
+  explicit MarketCalendar(Exchange exchange);
+
+  // True while a regular session is open
+  bool isOpen(time_t now);
+
+  // Epoch of the next open (when closed) or close (when open)
+  time_t nextTransition(time_t now);
+
+  // Epoch of the most recent close before now (0 if unknown)
+  time_t lastClose(time_t now);
+
+  const char* name() const;
+
+private:
+  Exchange exchange;
+  bool open;
+  time_t transitionAt;
+  time_t previousClose;
+
+  void recompute(time_t now);
+  bool isHoliday(int year, int month, int day) const;
+  int closeMinutes(int year, int month, int day) const;
+};
+
+// Shared calendar instance for an exchange (nullptr for EXCHANGE_NONE)
+MarketCalendar* marketCalendarFor(Exchange exchange);
+
+#endif // MARKET_CALENDAR_H
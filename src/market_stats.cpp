@@ -0,0 +1,135 @@
+#include "market_stats.h"
+#include "mem_alloc.h"
+#include <math.h>
+
+static const uint32_t WINDOW_SECONDS[STATS_WINDOW_COUNT] = STATS_WINDOWS_SEC;
+
+MarketStats::MarketStats() {
+  series = nullptr;
+  memset(stats, 0, sizeof(stats));
+  for (int a = 0; a < STATS_MAX_ASSETS; a++) {
+    for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+      stats[a].windowChange[w] = NAN;
+    }
+    stats[a].volatility = NAN;
+  }
+}
+
+void MarketStats::begin() {
+  if (series == nullptr) {
+    series = (Series*)memCalloc(STATS_MAX_ASSETS, sizeof(Series), MEM_BULK);
+    if (series == nullptr) {
+      Serial.println("MarketStats: no memory for history, statistics disabled");
+    }
+  }
+}
+
+uint32_t MarketStats::windowSeconds(int window) {
+  return WINDOW_SECONDS[window];
+}
+
+void MarketStats::windowName(int window, char* out, size_t size) {
+  unsigned long seconds = WINDOW_SECONDS[window];
+  if (seconds % 86400 == 0) {
+    snprintf(out, size, "%lud", seconds / 86400);
+  } else if (seconds % 3600 == 0) {
+    snprintf(out, size, "%luh", seconds / 3600);
+  } else if (seconds % 60 == 0) {
+    snprintf(out, size, "%lum", seconds / 60);
+  } else {
+    snprintf(out, size, "%lus", seconds);
+  }
+}
+
+void MarketStats::recordQuote(uint8_t asset, AssetData& data, time_t now) {
+  if (asset >= STATS_MAX_ASSETS || data.price <= 0.0f || series == nullptr) {
+    return;
+  }
+  if (data.change24h > -100.0f) {
+    series[asset].reference24h = data.price / (1.0f + data.change24h / 100.0f);
+  }
+  recordPrice(asset, data, now);
+}
+
+void MarketStats::recordPrice(uint8_t asset, AssetData& data, time_t now) {
+  if (asset >= STATS_MAX_ASSETS || data.price <= 0.0f || series == nullptr) {
+    return;
+  }
+  Series& s = series[asset];
+  AssetStats& st = stats[asset];
+  float price = data.price;
+
+  // EMAs weighted by elapsed time, so bursts of ticks don't speed them up
+  if (st.updates == 0) {
+    st.emaFast = price;
+    st.emaSlow = price;
+  } else if (now > s.lastAt) {
+    float elapsed = (float)(now - s.lastAt);
+    st.emaFast += (1.0f - expf(-elapsed / STATS_EMA_FAST_SEC)) * (price - st.emaFast);
+    st.emaSlow += (1.0f - expf(-elapsed / STATS_EMA_SLOW_SEC)) * (price - st.emaSlow);
+  }
+  s.lastAt = now;
+  st.updates++;
+
+  if (s.pushed == 0 || now - sample(s, s.pushed - 1).at >= STATS_SAMPLE_SEC) {
+    pushSample(s, price, now);
+  }
+
+  // Each window's base only moves forward, so this is amortized O(1)
+  uint32_t oldest = s.pushed > STATS_HISTORY ? s.pushed - STATS_HISTORY : 0;
+  for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+    time_t windowStart = now - (time_t)WINDOW_SECONDS[w];
+    if (s.base[w] < oldest) {
+      s.base[w] = oldest;
+    }
+    while (s.base[w] + 1 < s.pushed && sample(s, s.base[w] + 1).at <= windowStart) {
+      s.base[w]++;
+    }
+    const Sample& base = sample(s, s.base[w]);
+    st.windowChange[w] = (base.at <= windowStart) ? (price / base.price - 1.0f) * 100.0f : NAN;
+  }
+
+  st.volatility = s.returnCount >= 2 ? (float)sqrt(s.returnM2 / (s.returnCount - 1)) : NAN;
+
+  if (s.reference24h > 0.0f) {
+    data.change24h = (price / s.reference24h - 1.0f) * 100.0f;
+  }
+}
+
+void MarketStats::pushSample(Series& s, float price, time_t now) {
+  if (s.pushed >= STATS_HISTORY) {
+    // The oldest sample is about to be overwritten: drop its return
+    uint32_t evicted = s.pushed - STATS_HISTORY;
+    removeReturn(s, (sample(s, evicted + 1).price / sample(s, evicted).price - 1.0f) * 100.0f);
+  }
+  if (s.pushed > 0) {
+    addReturn(s, (price / sample(s, s.pushed - 1).price - 1.0f) * 100.0f);
+  }
+  Sample& slot = s.ring[s.pushed % STATS_HISTORY];
+  slot.at = now;
+  slot.price = price;
+  s.pushed++;
+}
+
+void MarketStats::addReturn(Series& s, float value) {
+  s.returnCount += 1;
+  double delta = value - s.returnMean;
+  s.returnMean += delta / s.returnCount;
+  s.returnM2 += delta * (value - s.returnMean);
+}
+
+void MarketStats::removeReturn(Series& s, float value) {
+  if (s.returnCount <= 1) {
+    s.returnCount = 0;
+    s.returnMean = 0;
+    s.returnM2 = 0;
+    return;
+  }
+  s.returnCount -= 1;
+  double delta = value - s.returnMean;
+  s.returnMean -= delta / s.returnCount;
+  s.returnM2 -= delta * (value - s.returnMean);
+  if (s.returnM2 < 0) {
+    s.returnM2 = 0; // Rounding
+  }
+}
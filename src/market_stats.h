@@ -0,0 +1,73 @@
+#ifndef MARKET_STATS_H
+#define MARKET_STATS_H
+
+#include <Arduino.h>
+#include <time.h>
+#include "config.h"
+#include "crypto_display.h"
+
+// Streaming statistics per asset, each update O(1) (amortized for windows):
+//  - percent change over STATS_WINDOWS_SEC, against a history ring sampled
+//    at most once per STATS_SAMPLE_SEC
+//  - fast and slow EMAs with time-based smoothing (irregular updates are fine)
+//  - volatility: standard deviation of per-sample percent returns over the
+//    ring, kept with a sliding Welford update (add newest, remove evicted)
+// It also keeps the provider's 24h change current between fetches by holding
+// the reference price it implies, so a streamed price moves the figure too.
+struct AssetStats {
+  float emaFast;
+  float emaSlow;
+  float windowChange[STATS_WINDOW_COUNT]; // Percent; NAN until history spans the window
+  float volatility;                       // Percent per sample; NAN with fewer than 2 returns
+  uint32_t updates;
+};
+
+class MarketStats {
+public:
+  MarketStats();
+
+  // Allocate the history rings (PSRAM when present); until then updates are ignored
+  void begin();
+
+  // A provider quote arrived (percent_change_* fields already in `data`)
+  void recordQuote(uint8_t asset, AssetData& data, time_t now);
+
+  // Any new price (fetch, streamed tick, fleet snapshot); refreshes data.change24h
+  void recordPrice(uint8_t asset, AssetData& data, time_t now);
+
+  const AssetStats& get(uint8_t asset) const { return stats[asset]; }
+  int assetCapacity() const { return STATS_MAX_ASSETS; }
+
+  static uint32_t windowSeconds(int window);
+  // Label for MQTT/metrics, e.g. "5m", "1h"
+  static void windowName(int window, char* out, size_t size);
+
+private:
+  struct Sample {
+    time_t at;
+    float price;
+  };
+
+  struct Series {
+    Sample ring[STATS_HISTORY];
+    uint32_t pushed;            // Samples ever pushed (ring index = sequence % STATS_HISTORY)
+    uint32_t base[STATS_WINDOW_COUNT]; // Sequence of the newest sample at or before each window start
+    double returnCount;
+    double returnMean;
+    double returnM2;
+    time_t lastAt;              // Time of the last EMA update
+    float reference24h;         // Price 24h ago implied by the provider's change
+  };
+
+  Series* series;                    // [STATS_MAX_ASSETS], allocated by begin()
+  AssetStats stats[STATS_MAX_ASSETS];
+
+  const Sample& sample(const Series& s, uint32_t sequence) const {
+    return s.ring[sequence % STATS_HISTORY];
+  }
+  void pushSample(Series& s, float price, time_t now);
+  void addReturn(Series& s, float value);
+  void removeReturn(Series& s, float value);
+};
+
+#endif // MARKET_STATS_H
@@ -0,0 +1,113 @@
+#include "mem_alloc.h"
+#include <esp_heap_caps.h>
+
+static const uint32_t INTERNAL_CAPS = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+static const uint32_t DMA_CAPS = MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA;
+static const uint32_t PSRAM_CAPS = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+
+static MemPlacementStats placementStats[MEM_PLACEMENT_COUNT];
+static uint32_t largestInternalBlockMin = UINT32_MAX;
+static unsigned long lastHeapSample = 0;
+static bool heapSampled = false;
+
+static uint32_t primaryCaps(MemPlacement placement) {
+  switch (placement) {
+    case MEM_DMA: return DMA_CAPS;
+    case MEM_BULK: return memHasPsram() ? PSRAM_CAPS : INTERNAL_CAPS;
+    default: return INTERNAL_CAPS;
+  }
+}
+
+static void countAllocation(MemPlacement placement, size_t size, void* ptr, bool fellBack) {
+  MemPlacementStats& stats = placementStats[placement];
+  if (ptr == nullptr) {
+    stats.failures++;
+    Serial.printf("memAlloc: %u bytes (%s) failed\n", (unsigned)size, memPlacementName(placement));
+    return;
+  }
+  stats.allocations++;
+  if (fellBack) {
+    stats.fallbacks++;
+  }
+}
+
+void* memAlloc(size_t size, MemPlacement placement) {
+  bool psram = placement == MEM_BULK && memHasPsram();
+  bool fellBack = placement == MEM_BULK && !psram;
+  void* ptr = heap_caps_malloc(size, primaryCaps(placement));
+  if (ptr == nullptr && psram) {
+    // PSRAM full: internal memory is still better than failing the request
+    ptr = heap_caps_malloc(size, INTERNAL_CAPS);
+    fellBack = true;
+  }
+  countAllocation(placement, size, ptr, fellBack);
+  return ptr;
+}
+
+void* memCalloc(size_t count, size_t size, MemPlacement placement) {
+  if (size != 0 && count > SIZE_MAX / size) {
+    return nullptr;
+  }
+  void* ptr = memAlloc(count * size, placement);
+  if (ptr != nullptr) {
+    memset(ptr, 0, count * size);
+  }
+  return ptr;
+}
+
+// Grows in place where the heap allows; a moved block keeps the placement's
+// capabilities (heap_caps_realloc copies into memory with the given caps)
+void* memRealloc(void* ptr, size_t size, MemPlacement placement) {
+  if (ptr == nullptr) {
+    return memAlloc(size, placement);
+  }
+  void* moved = heap_caps_realloc(ptr, size, primaryCaps(placement));
+  if (moved == nullptr && placement == MEM_BULK && memHasPsram()) {
+    moved = heap_caps_realloc(ptr, size, INTERNAL_CAPS);
+  }
+  if (moved == nullptr) {
+    placementStats[placement].failures++;
+  }
+  return moved;
+}
+
+void memFree(void* ptr) {
+  heap_caps_free(ptr);
+}
+
+bool memHasPsram() {
+  static int found = -1; // Probed once; psramInit() runs before setup()
+  if (found < 0) {
+    found = psramFound() ? 1 : 0;
+  }
+  return found == 1;
+}
+
+const char* memPlacementName(MemPlacement placement) {
+  switch (placement) {
+    case MEM_DMA: return "dma";
+    case MEM_INTERNAL: return "internal";
+    case MEM_BULK: return "bulk";
+    default: return "unknown";
+  }
+}
+
+const MemPlacementStats& memPlacementStats(MemPlacement placement) {
+  return placementStats[placement];
+}
+
+void memSampleHeap(unsigned long now) {
+  if (heapSampled && now - lastHeapSample < MEM_SAMPLE_MS) {
+    return;
+  }
+  heapSampled = true;
+  lastHeapSample = now;
+  uint32_t largest = heap_caps_get_largest_free_block(INTERNAL_CAPS);
+  if (largest < largestInternalBlockMin) {
+    largestInternalBlockMin = largest;
+  }
+}
+
+uint32_t memLargestInternalBlockMin() {
+  return largestInternalBlockMin == UINT32_MAX ? 0 : largestInternalBlockMin;
+}
@@ -0,0 +1,39 @@
+#ifndef MEM_ALLOC_H
+#define MEM_ALLOC_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Where a heap buffer should live. WiFi and TLS allocate from internal DRAM,
+// so large long-lived or bulk buffers go to PSRAM to keep that heap whole.
+enum MemPlacement : uint8_t {
+  MEM_DMA = 0,     // Internal, DMA-capable: buffers handed to SPI (LCD canvases)
+  MEM_INTERNAL,    // Internal: small hot objects
+  MEM_BULK,        // PSRAM when present, else internal: JSON arenas, history, inflate buffers
+  MEM_PLACEMENT_COUNT
+};
+
+// Allocation counts per placement
+struct MemPlacementStats {
+  uint32_t allocations;
+  uint32_t failures;
+  uint32_t fallbacks;     // MEM_BULK served from internal memory (no PSRAM or PSRAM full)
+};
+
+void* memAlloc(size_t size, MemPlacement placement);
+void* memCalloc(size_t count, size_t size, MemPlacement placement);
+void* memRealloc(void* ptr, size_t size, MemPlacement placement);
+void memFree(void* ptr);
+
+// True when PSRAM was found at boot (MEM_BULK falls back to internal otherwise)
+bool memHasPsram();
+
+const char* memPlacementName(MemPlacement placement); // "dma", "internal", "bulk"
+const MemPlacementStats& memPlacementStats(MemPlacement placement);
+
+// Track the low-water mark of the largest free internal block, the number that
+// decides whether the next TLS handshake fits (self-throttled to MEM_SAMPLE_MS)
+void memSampleHeap(unsigned long now);
+uint32_t memLargestInternalBlockMin();
+
+#endif // MEM_ALLOC_H
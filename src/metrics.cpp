@@ -0,0 +1,565 @@
+#include "metrics.h"
+#include "scheduler.h"
+#include "price_stream.h"
+#include "fleet.h"
+#include "retry_policy.h"
+#include "price_history.h"
+#include "alert_engine.h"
+#include "glyph_atlas.h"
+#include "ticker_view.h"
+#include "mem_alloc.h"
+#include "json_arena.h"
+#include <esp_heap_caps.h>
+#include <WiFi.h>
+
+Metrics metrics;
+
+// Bucket bounds
+static const uint32_t NETWORK_MS_BOUNDS[] = {50, 100, 250, 500, 1000, 2000, 5000, 10000, 15000};
+static const uint32_t BYTES_BOUNDS[] = {512, 1024, 2048, 4096, 8192, 16384, 32768, 65536};
+static const uint32_t INFLATE_US_BOUNDS[] = {250, 500, 1000, 2500, 5000, 10000, 25000, 50000};
+static const uint32_t PARSE_US_BOUNDS[] = {1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000};
+static const uint32_t RENDER_US_BOUNDS[] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000};
+static const uint32_t LOOP_MS_BOUNDS[] = {55, 60, 75, 100, 250, 500, 1000, 5000, 15000};
+static const uint32_t TICK_MS_BOUNDS[] = {50, 100, 200, 300, 400, 500, 750, 1000, 2500};
+static const uint32_t FANOUT_MS_BOUNDS[] = {5, 10, 25, 50, 100, 250, 500, 1000, 5000};
+static const uint32_t LAG_MS_BOUNDS[] = {50, 100, 250, 500, 1000, 2000, 5000, 10000, 30000};
+
+#define BOUNDS(array) array, (uint8_t)(sizeof(array) / sizeof(array[0]))
+
+// Buffers the response and sends it in chunks so a scrape never builds a String
+class MetricsWriter {
+public:
+  explicit MetricsWriter(WebServer& server) : server(server), length(0) {}
+
+  void printf(const char* format, ...) {
+    char line[160];
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (written <= 0) {
+      return;
+    }
+    size_t lineLength = (size_t)written < sizeof(line) ? (size_t)written : sizeof(line) - 1;
+    if (length + lineLength > sizeof(buffer)) {
+      flush();
+    }
+    memcpy(buffer + length, line, lineLength);
+    length += lineLength;
+  }
+
+  void flush() {
+    if (length > 0) {
+      server.sendContent(buffer, length);
+      length = 0;
+    }
+  }
+
+  void histogram(const char* name, const char* labels, const Histogram& histogram) {
+    const char* separator = labels[0] ? "," : "";
+    uint32_t cumulative = 0;
+    for (int i = 0; i < histogram.bucketCount; i++) {
+      cumulative += histogram.counts[i];
+      printf("%s_bucket{%s%sle=\"%lu\"} %lu\n", name, labels, separator,
+             (unsigned long)histogram.bounds[i], (unsigned long)cumulative);
+    }
+    printf("%s_bucket{%s%sle=\"+Inf\"} %lu\n", name, labels, separator, (unsigned long)histogram.count);
+    printf("%s_sum{%s} %llu\n", name, labels, (unsigned long long)histogram.sum);
+    printf("%s_count{%s} %lu\n", name, labels, (unsigned long)histogram.count);
+  }
+
+  void header(const char* name, const char* type, const char* help) {
+    printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+  }
+
+private:
+  WebServer& server;
+  char buffer[512];
+  size_t length;
+};
+
+Histogram::Histogram(const uint32_t* bounds, uint8_t bucketCount)
+  : bounds(bounds), bucketCount(bucketCount), count(0), sum(0), max(0) {
+  memset(counts, 0, sizeof(counts));
+}
+
+void Histogram::observe(uint32_t value) {
+  int bucket = 0;
+  while (bucket < bucketCount && value > bounds[bucket]) {
+    bucket++;
+  }
+  counts[bucket]++;
+  count++;
+  sum += value;
+  if (value > max) {
+    max = value;
+  }
+}
+
+Metrics::ProviderStats::ProviderStats()
+  : fetchMs(BOUNDS(NETWORK_MS_BOUNDS)),
+    dnsMs(BOUNDS(NETWORK_MS_BOUNDS)),
+    tlsMs(BOUNDS(NETWORK_MS_BOUNDS)),
+    parseUs(BOUNDS(PARSE_US_BOUNDS)),
+    responseBytes(BOUNDS(BYTES_BOUNDS)),
+    decodedBytes(BOUNDS(BYTES_BOUNDS)),
+    inflateUs(BOUNDS(INFLATE_US_BOUNDS)),
+    fetchFailures(0),
+    parseMemoryLast(0),
+    parseMemoryPeak(0),
+    inflateMemoryPeak(0) {
+}
+
+Metrics::Metrics()
+  : server(METRICS_PORT),
+    started(false),
+    renderUs(BOUNDS(RENDER_US_BOUNDS)),
+    loopIntervalMs(BOUNDS(LOOP_MS_BOUNDS)),
+    tickToPixelMs(BOUNDS(TICK_MS_BOUNDS)),
+    fanoutMs(BOUNDS(FANOUT_MS_BOUNDS)),
+    refreshLagMs(BOUNDS(LAG_MS_BOUNDS)),
+    lastLoopStart(0),
+    mqttReconnects(0),
+    mqttReconnectFailures(0),
+    taskCount(0),
+    surface(nullptr),
+    glyphAtlas(nullptr),
+    ticker(nullptr),
+    scheduler(nullptr),
+    stream(nullptr),
+    fleet(nullptr),
+    retryPolicy(nullptr),
+    history(nullptr),
+    alerts(nullptr) {
+  memset(tasks, 0, sizeof(tasks));
+}
+
+void Metrics::begin() {
+  if (started) {
+    return;
+  }
+  server.on("/metrics", HTTP_GET, [this]() { handleMetrics(); });
+  server.begin();
+  started = true;
+  Serial.printf("Metrics: Serving http://%s:%d/metrics\n",
+                WiFi.localIP().toString().c_str(), METRICS_PORT);
+}
+
+void Metrics::handleClient() {
+  if (started) {
+    server.handleClient();
+  }
+}
+
+void Metrics::recordFetch(Provider provider, uint32_t durationMs, bool success) {
+  providers[provider].fetchMs.observe(durationMs);
+  if (!success) {
+    providers[provider].fetchFailures++;
+  }
+}
+
+void Metrics::recordDns(Provider provider, uint32_t durationMs) {
+  providers[provider].dnsMs.observe(durationMs);
+}
+
+void Metrics::recordTlsHandshake(Provider provider, uint32_t durationMs) {
+  providers[provider].tlsMs.observe(durationMs);
+}
+
+void Metrics::recordParse(Provider provider, uint32_t durationUs, size_t memoryUsed) {
+  ProviderStats& stats = providers[provider];
+  stats.parseUs.observe(durationUs);
+  stats.parseMemoryLast = memoryUsed;
+  if (memoryUsed > stats.parseMemoryPeak) {
+    stats.parseMemoryPeak = memoryUsed;
+  }
+}
+
+void Metrics::recordResponseBytes(Provider provider, size_t wireBytes, size_t decodedBytes) {
+  providers[provider].responseBytes.observe(wireBytes);
+  providers[provider].decodedBytes.observe(decodedBytes);
+}
+
+void Metrics::recordInflate(Provider provider, uint32_t durationUs, size_t memoryUsed) {
+  ProviderStats& stats = providers[provider];
+  stats.inflateUs.observe(durationUs);
+  if (memoryUsed > stats.inflateMemoryPeak) {
+    stats.inflateMemoryPeak = memoryUsed;
+  }
+}
+
+void Metrics::recordRender(uint32_t durationUs) {
+  renderUs.observe(durationUs);
+}
+
+void Metrics::recordLoopIteration() {
+  unsigned long now = millis();
+  if (lastLoopStart != 0) {
+    loopIntervalMs.observe(now - lastLoopStart);
+  }
+  lastLoopStart = now;
+}
+
+void Metrics::recordMqttReconnect(bool success) {
+  if (success) {
+    mqttReconnects++;
+  } else {
+    mqttReconnectFailures++;
+  }
+}
+
+void Metrics::recordTickToPixel(uint32_t latencyMs) {
+  tickToPixelMs.observe(latencyMs);
+}
+
+void Metrics::recordFanout(uint32_t latencyMs) {
+  fanoutMs.observe(latencyMs);
+}
+
+void Metrics::recordRefreshLag(uint32_t lagMs) {
+  refreshLagMs.observe(lagMs);
+}
+
+void Metrics::registerTask(const char* name, TaskHandle_t handle) {
+  if (taskCount < MAX_TASKS && handle != nullptr) {
+    tasks[taskCount].name = name;
+    tasks[taskCount].handle = handle;
+    taskCount++;
+  }
+}
+
+void Metrics::setSurface(const DisplaySurface* target) {
+  surface = target;
+}
+
+void Metrics::setGlyphAtlas(const GlyphAtlas* atlas) {
+  glyphAtlas = atlas;
+}
+
+void Metrics::setTicker(const TickerView* target) {
+  ticker = target;
+}
+
+void Metrics::setScheduler(const RefreshScheduler* target) {
+  scheduler = target;
+}
+
+void Metrics::setPriceStream(const PriceStream* target) {
+  stream = target;
+}
+
+void Metrics::setFleet(const FleetSync* target) {
+  fleet = target;
+}
+
+void Metrics::setRetryPolicy(const RetryPolicy* policy) {
+  retryPolicy = policy;
+}
+
+void Metrics::setHistory(const PriceHistory* target) {
+  history = target;
+}
+
+void Metrics::setAlerts(const AlertEngine* target) {
+  alerts = target;
+}
+
+void Metrics::handleMetrics() {
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/plain; version=0.0.4", "");
+
+  MetricsWriter out(server);
+  char labels[40];
+
+  out.header("m5crypto_fetch_duration_ms", "histogram", "HTTP fetch latency per provider");
+  for (int p = 0; p < PROVIDER_COUNT; p++) {
+    snprintf(labels, sizeof(labels), "provider=\"%s\"", providerName((Provider)p));
+    out.histogram("m5crypto_fetch_duration_ms", labels, providers[p].fetchMs);
+  }
+
+  out.header("m5crypto_fetch_failures_total", "counter", "Failed fetches per provider");
+  for (int p = 0; p < PROVIDER_COUNT; p++) {
+    out.printf("m5crypto_fetch_failures_total{provider=\"%s\"} %lu\n",
+               providerName((Provider)p), (unsigned long)providers[p].fetchFailures);
+  }
+
+  if (retryPolicy != nullptr) {
+    out.header("m5crypto_breaker_state", "gauge", "Circuit breaker per provider: 0 closed, 1 open, 2 half-open");
+    for (int p = 0; p < PROVIDER_COUNT; p++) {
+      out.printf("m5crypto_breaker_state{provider=\"%s\"} %d\n",
+                 providerName((Provider)p), (int)retryPolicy->state((Provider)p));
+    }
+    out.header("m5crypto_breaker_trips_total", "counter", "Times each provider's breaker opened");
+    for (int p = 0; p < PROVIDER_COUNT; p++) {
+      out.printf("m5crypto_breaker_trips_total{provider=\"%s\"} %lu\n",
+                 providerName((Provider)p), (unsigned long)retryPolicy->tripCount((Provider)p));
+    }
+  }
+
+  if (alerts != nullptr) {
+    out.header("m5crypto_alert_rules", "gauge", "Alert rules loaded");
+    out.printf("m5crypto_alert_rules %u\n", (unsigned)alerts->ruleCount());
+    out.header("m5crypto_alerts_total", "counter", "Alert rules crossed, by outcome");
+    out.printf("m5crypto_alerts_total{result=\"fired\"} %lu\n", (unsigned long)alerts->firedCount());
+    out.printf("m5crypto_alerts_total{result=\"cooldown\"} %lu\n", (unsigned long)alerts->suppressedCount());
+    out.header("m5crypto_alerts_dropped_total", "counter", "Fired alerts lost to a full queue");
+    out.printf("m5crypto_alerts_dropped_total %lu\n", (unsigned long)alerts->droppedCount());
+    out.header("m5crypto_alert_rules_rejected_total", "counter", "Rule lines not loaded (bad or no room)");
+    out.printf("m5crypto_alert_rules_rejected_total %lu\n", (unsigned long)alerts->rejectedCount());
+  }
+
+  if (history != nullptr) {
+    out.header("m5crypto_history_points", "gauge", "Price points stored on flash per tier");
+    for (int t = 0; t < PriceHistory::TIER_COUNT; t++) {
+      out.printf("m5crypto_history_points{tier=\"%s\"} %lu\n", PriceHistory::tierName((PriceHistory::Tier)t),
+                 (unsigned long)history->storedRecords((PriceHistory::Tier)t));
+    }
+    out.header("m5crypto_history_segments", "gauge", "Segment files per tier (including the active one)");
+    for (int t = 0; t < PriceHistory::TIER_COUNT; t++) {
+      out.printf("m5crypto_history_segments{tier=\"%s\"} %d\n", PriceHistory::tierName((PriceHistory::Tier)t),
+                 history->segmentCount((PriceHistory::Tier)t));
+    }
+    out.header("m5crypto_history_appended_total", "counter", "Price points recorded since boot");
+    out.printf("m5crypto_history_appended_total %lu\n", (unsigned long)history->appendedCount());
+    out.header("m5crypto_history_compactions_total", "counter", "Segments downsampled into a coarser tier");
+    out.printf("m5crypto_history_compactions_total %lu\n", (unsigned long)history->compactionCount());
+    out.header("m5crypto_history_write_errors_total", "counter", "Failed or short history writes");
+    out.printf("m5crypto_history_write_errors_total %lu\n", (unsigned long)history->writeErrorCount());
+    out.header("m5crypto_history_query_segments_total", "counter", "Segments read or skipped by range queries");
+    out.printf("m5crypto_history_query_segments_total{result=\"read\"} %lu\n",
+               (unsigned long)history->segmentsScannedCount());
+    out.printf("m5crypto_history_query_segments_total{result=\"skipped\"} %lu\n",
+               (unsigned long)history->segmentsSkippedCount());
+    out.header("m5crypto_history_flush_us", "gauge", "Duration of the last buffered write");
+    out.printf("m5crypto_history_flush_us %lu\n", (unsigned long)history->lastFlushMicros());
+    out.header("m5crypto_history_query_us", "gauge", "Duration of the last range query");
+    out.printf("m5crypto_history_query_us %lu\n", (unsigned long)history->lastQueryMicros());
+  }
+
+  out.header("m5crypto_dns_duration_ms", "histogram", "DNS lookup time per provider");
+  for (int p = 0; p < PROVIDER_COUNT; p++) {
+    snprintf(labels, sizeof(labels), "provider=\"%s\"", providerName((Provider)p));
+    out.histogram("m5crypto_dns_duration_ms", labels, providers[p].dnsMs);
+  }
+
+  out.header("m5crypto_tls_handshake_ms", "histogram", "TCP connect + TLS handshake time per provider");
+  for (int p = 0; p < PROVIDER_COUNT; p++) {
+    snprintf(labels, sizeof(labels), "provider=\"%s\"", providerName((Provider)p));
+    out.histogram("m5crypto_tls_handshake_ms", labels, providers[p].tlsMs);
+  }
+
+  out.header("m5crypto_json_parse_us", "histogram", "JSON deserialization time per provider");
+  for (int p = 0; p < PROVIDER_COUNT; p++) {
+    snprintf(labels, sizeof(labels), "provider=\"%s\"", providerName((Provider)p));
+    out.histogram("m5crypto_json_parse_us", labels, providers[p].parseUs);
+  }
+
+  out.header("m5crypto_response_bytes", "histogram", "Response body bytes on the wire per provider");
+  for (int p = 0; p < PROVIDER_COUNT; p++) {
+    snprintf(labels, sizeof(labels), "provider=\"%s\"", providerName((Provider)p));
+    out.histogram("m5crypto_response_bytes", labels, providers[p].responseBytes);
+  }
+
+  out.header("m5crypto_response_decoded_bytes", "histogram", "Response body size after gzip inflate per provider");
+  for (int p = 0; p < PROVIDER_COUNT; p++) {
+    snprintf(labels, sizeof(labels), "provider=\"%s\"", providerName((Provider)p));
+    out.histogram("m5crypto_response_decoded_bytes", labels, providers[p].decodedBytes);
+  }
+
+  out.header("m5crypto_inflate_us", "histogram", "Time spent inflating gzip bodies per provider");
+  for (int p = 0; p < PROVIDER_COUNT; p++) {
+    snprintf(labels, sizeof(labels), "provider=\"%s\"", providerName((Provider)p));
+    out.histogram("m5crypto_inflate_us", labels, providers[p].inflateUs);
+  }
+
+  out.header("m5crypto_inflate_memory_peak_bytes", "gauge", "Largest heap held while reading a gzip body");
+  for (int p = 0; p < PROVIDER_COUNT; p++) {
+    out.printf("m5crypto_inflate_memory_peak_bytes{provider=\"%s\"} %lu\n",
+               providerName((Provider)p), (unsigned long)providers[p].inflateMemoryPeak);
+  }
+
+  out.header("m5crypto_json_memory_bytes", "gauge", "JSON document memory used by the last parse");
+  for (int p = 0; p < PROVIDER_COUNT; p++) {
+    out.printf("m5crypto_json_memory_bytes{provider=\"%s\"} %lu\n",
+               providerName((Provider)p), (unsigned long)providers[p].parseMemoryLast);
+  }
+
+  out.header("m5crypto_json_memory_peak_bytes", "gauge", "Largest JSON document memory used since boot");
+  for (int p = 0; p < PROVIDER_COUNT; p++) {
+    out.printf("m5crypto_json_memory_peak_bytes{provider=\"%s\"} %lu\n",
+               providerName((Provider)p), (unsigned long)providers[p].parseMemoryPeak);
+  }
+
+  out.header("m5crypto_render_us", "histogram", "Time to render one display frame");
+  out.histogram("m5crypto_render_us", "", renderUs);
+
+  out.header("m5crypto_loop_interval_ms", "histogram", "Time between main loop iterations (jitter)");
+  out.histogram("m5crypto_loop_interval_ms", "", loopIntervalMs);
+  out.header("m5crypto_loop_interval_max_ms", "gauge", "Longest gap between main loop iterations");
+  out.printf("m5crypto_loop_interval_max_ms %lu\n", (unsigned long)loopIntervalMs.max);
+
+  if (surface != nullptr) {
+    const SurfaceStats& totals = surface->totalStats();
+    out.header("m5crypto_display_bytes_total", "counter", "SPI-equivalent bytes pushed to the display");
+    out.printf("m5crypto_display_bytes_total %lu\n", (unsigned long)totals.bytesPushed());
+    out.header("m5crypto_display_frame_bytes", "gauge", "SPI-equivalent bytes pushed by the last frame");
+    out.printf("m5crypto_display_frame_bytes %lu\n", (unsigned long)surface->lastFrameStats().bytesPushed());
+    out.header("m5crypto_display_clears_total", "counter", "Full-screen clears");
+    out.printf("m5crypto_display_clears_total %lu\n", (unsigned long)totals.fullClears);
+  }
+
+  if (glyphAtlas != nullptr && glyphAtlas->ready()) {
+    out.header("m5crypto_glyph_blits_total", "counter", "Price glyph cells drawn from the atlas");
+    out.printf("m5crypto_glyph_blits_total %lu\n", (unsigned long)glyphAtlas->blitCount());
+    out.header("m5crypto_glyph_skipped_total", "counter", "Unchanged price glyph cells not redrawn");
+    out.printf("m5crypto_glyph_skipped_total %lu\n", (unsigned long)glyphAtlas->skippedCount());
+    out.header("m5crypto_price_draws_total", "counter", "Price redraws by kind");
+    out.printf("m5crypto_price_draws_total{mode=\"full\"} %lu\n", (unsigned long)glyphAtlas->fullDrawCount());
+    out.printf("m5crypto_price_draws_total{mode=\"rolling\"} %lu\n", (unsigned long)glyphAtlas->rollingDrawCount());
+  }
+
+  if (ticker != nullptr && ticker->frameCount() > 0) {
+    out.header("m5crypto_ticker_frame_us", "gauge", "Ticker frame time (compose and push), recent frames");
+    static const int quantiles[] = {50, 95, 99};
+    for (int q : quantiles) {
+      out.printf("m5crypto_ticker_frame_us{quantile=\"0.%d\"} %lu\n", q,
+                 (unsigned long)ticker->frameTimePercentile(q));
+    }
+    out.header("m5crypto_ticker_frames_total", "counter", "Ticker frames rendered");
+    out.printf("m5crypto_ticker_frames_total %lu\n", (unsigned long)ticker->frameCount());
+    out.header("m5crypto_ticker_late_frames_total", "counter", "Ticker frames started over 1.5 periods late");
+    out.printf("m5crypto_ticker_late_frames_total %lu\n", (unsigned long)ticker->lateFrameCount());
+  }
+
+  if (scheduler != nullptr) {
+    out.header("m5crypto_refresh_target_seconds", "gauge", "Configured refresh interval per asset");
+    for (int i = 0; i < scheduler->assetCount(); i++) {
+      const AssetData& asset = scheduler->asset(i);
+      out.printf("m5crypto_refresh_target_seconds{symbol=\"%s\"} %.1f\n",
+                 asset.symbol, asset.refreshIntervalMs / 1000.0);
+    }
+    out.header("m5crypto_refresh_achieved_seconds", "gauge", "Smoothed time between successful refreshes per asset");
+    for (int i = 0; i < scheduler->assetCount(); i++) {
+      out.printf("m5crypto_refresh_achieved_seconds{symbol=\"%s\"} %.1f\n",
+                 scheduler->asset(i).symbol, scheduler->achievedIntervalMs(i) / 1000.0);
+    }
+    out.header("m5crypto_refresh_lag_ms", "histogram", "Fetch deadline until the new price is drawn");
+    out.histogram("m5crypto_refresh_lag_ms", "", refreshLagMs);
+    out.header("m5crypto_refreshes_total", "counter", "Successful refreshes per asset");
+    for (int i = 0; i < scheduler->assetCount(); i++) {
+      out.printf("m5crypto_refreshes_total{symbol=\"%s\"} %lu\n",
+                 scheduler->asset(i).symbol, (unsigned long)scheduler->refreshCount(i));
+    }
+  }
+
+  if (stream != nullptr) {
+    out.header("m5crypto_stream_live", "gauge", "1 while the streaming price feed is delivering ticks");
+    out.printf("m5crypto_stream_live %d\n", stream->isLive() ? 1 : 0);
+    out.header("m5crypto_stream_ticks_total", "counter", "Ticker updates received");
+    out.printf("m5crypto_stream_ticks_total %lu\n", (unsigned long)stream->getTicksTotal());
+    out.header("m5crypto_stream_ticks_per_second", "gauge", "Ticker updates received in the last second");
+    out.printf("m5crypto_stream_ticks_per_second %lu\n", (unsigned long)stream->getTicksPerSecond());
+    out.header("m5crypto_stream_frames_total", "counter", "WebSocket frames parsed");
+    out.printf("m5crypto_stream_frames_total %lu\n", (unsigned long)stream->getFramesTotal());
+    out.header("m5crypto_stream_oversized_frames_total", "counter", "Messages dropped for exceeding STREAM_FRAME_BUFFER");
+    out.printf("m5crypto_stream_oversized_frames_total %lu\n", (unsigned long)stream->getOversizedFrames());
+    out.header("m5crypto_stream_reconnects_total", "counter", "Stream connection failures and drops");
+    out.printf("m5crypto_stream_reconnects_total %lu\n", (unsigned long)stream->getReconnects());
+    out.header("m5crypto_tick_to_pixel_ms", "histogram", "Tick arrival until the price is drawn");
+    out.histogram("m5crypto_tick_to_pixel_ms", "", tickToPixelMs);
+  }
+
+  if (fleet != nullptr && fleet->getRole() != FLEET_ROLE_STANDALONE) {
+    out.header("m5crypto_fleet_gateway", "gauge", "1 while this device is the fleet gateway");
+    out.printf("m5crypto_fleet_gateway{role=\"%s\"} %d\n", fleet->roleName(), fleet->isGateway() ? 1 : 0);
+    out.header("m5crypto_fleet_promotions_total", "counter", "Elections this device won");
+    out.printf("m5crypto_fleet_promotions_total %lu\n", (unsigned long)fleet->getPromotions());
+    out.header("m5crypto_fleet_snapshots_published_total", "counter", "Asset snapshots published as gateway");
+    out.printf("m5crypto_fleet_snapshots_published_total %lu\n", (unsigned long)fleet->getSnapshotsPublished());
+    out.header("m5crypto_fleet_snapshots_received_total", "counter", "Asset snapshots applied from the gateway");
+    out.printf("m5crypto_fleet_snapshots_received_total %lu\n", (unsigned long)fleet->getSnapshotsReceived());
+    out.header("m5crypto_fleet_fanout_ms", "histogram", "Gateway snapshot publish until received here");
+    out.histogram("m5crypto_fleet_fanout_ms", "", fanoutMs);
+  }
+
+  out.header("m5crypto_heap_free_bytes", "gauge", "Free internal heap");
+  out.printf("m5crypto_heap_free_bytes %lu\n", (unsigned long)ESP.getFreeHeap());
+  out.header("m5crypto_heap_min_free_bytes", "gauge", "Lowest free heap since boot");
+  out.printf("m5crypto_heap_min_free_bytes %lu\n", (unsigned long)ESP.getMinFreeHeap());
+  out.header("m5crypto_heap_largest_block_bytes", "gauge", "Largest allocatable heap block");
+  out.printf("m5crypto_heap_largest_block_bytes %lu\n", (unsigned long)ESP.getMaxAllocHeap());
+  out.header("m5crypto_heap_largest_block_min_bytes", "gauge",
+             "Lowest largest-allocatable internal block seen (sampled every MEM_SAMPLE_MS)");
+  out.printf("m5crypto_heap_largest_block_min_bytes %lu\n", (unsigned long)memLargestInternalBlockMin());
+
+  static const char* const REGION_NAMES[] = {"internal", "dma", "psram"};
+  static const uint32_t REGION_CAPS[] = {MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+                                         MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA,
+                                         MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT};
+  int regionCount = memHasPsram() ? 3 : 2;
+  out.header("m5crypto_heap_region_free_bytes", "gauge", "Free heap per memory region");
+  for (int r = 0; r < regionCount; r++) {
+    out.printf("m5crypto_heap_region_free_bytes{region=\"%s\"} %lu\n", REGION_NAMES[r],
+               (unsigned long)heap_caps_get_free_size(REGION_CAPS[r]));
+  }
+  out.header("m5crypto_heap_region_largest_block_bytes", "gauge", "Largest allocatable block per memory region");
+  for (int r = 0; r < regionCount; r++) {
+    out.printf("m5crypto_heap_region_largest_block_bytes{region=\"%s\"} %lu\n", REGION_NAMES[r],
+               (unsigned long)heap_caps_get_largest_free_block(REGION_CAPS[r]));
+  }
+
+  out.header("m5crypto_mem_allocations_total", "counter", "mem_alloc allocations per placement");
+  for (int p = 0; p < MEM_PLACEMENT_COUNT; p++) {
+    out.printf("m5crypto_mem_allocations_total{placement=\"%s\"} %lu\n", memPlacementName((MemPlacement)p),
+               (unsigned long)memPlacementStats((MemPlacement)p).allocations);
+  }
+  out.header("m5crypto_mem_alloc_failures_total", "counter", "mem_alloc requests that found no memory");
+  for (int p = 0; p < MEM_PLACEMENT_COUNT; p++) {
+    out.printf("m5crypto_mem_alloc_failures_total{placement=\"%s\"} %lu\n", memPlacementName((MemPlacement)p),
+               (unsigned long)memPlacementStats((MemPlacement)p).failures);
+  }
+  out.header("m5crypto_mem_bulk_fallbacks_total", "counter", "Bulk allocations served from internal memory");
+  out.printf("m5crypto_mem_bulk_fallbacks_total %lu\n", (unsigned long)memPlacementStats(MEM_BULK).fallbacks);
+
+  out.header("m5crypto_json_arena_bytes", "gauge", "Size of the shared JSON arena");
+  out.printf("m5crypto_json_arena_bytes %lu\n", (unsigned long)jsonArena.bufferSize());
+  out.header("m5crypto_json_arena_resizes_total", "counter", "JSON arena (re)allocations; flat once warmed up");
+  out.printf("m5crypto_json_arena_resizes_total %lu\n", (unsigned long)jsonArena.resizeCount());
+  out.header("m5crypto_json_arena_fallbacks_total", "counter", "JSON documents allocated outside the busy arena");
+  out.printf("m5crypto_json_arena_fallbacks_total %lu\n", (unsigned long)jsonArena.fallbackCount());
+  out.header("m5crypto_json_user_peak_bytes", "gauge", "Largest memoryUsage() per JSON document user");
+  for (int u = 0; u < JSON_USER_COUNT; u++) {
+    out.printf("m5crypto_json_user_peak_bytes{user=\"%s\"} %lu\n", JsonArena::userName((JsonUser)u),
+               (unsigned long)jsonArena.peak((JsonUser)u));
+  }
+  out.header("m5crypto_json_user_capacity_bytes", "gauge", "Capacity the next document of each user gets (0 until measured)");
+  for (int u = 0; u < JSON_USER_COUNT; u++) {
+    out.printf("m5crypto_json_user_capacity_bytes{user=\"%s\"} %lu\n", JsonArena::userName((JsonUser)u),
+               (unsigned long)jsonArena.need((JsonUser)u));
+  }
+  out.header("m5crypto_json_overflows_total", "counter", "JSON documents that ran out of capacity");
+  for (int u = 0; u < JSON_USER_COUNT; u++) {
+    out.printf("m5crypto_json_overflows_total{user=\"%s\"} %lu\n", JsonArena::userName((JsonUser)u),
+               (unsigned long)jsonArena.overflows((JsonUser)u));
+  }
+
+  out.header("m5crypto_task_stack_min_free_bytes", "gauge", "Stack high-water mark per task");
+  for (int i = 0; i < taskCount; i++) {
+    out.printf("m5crypto_task_stack_min_free_bytes{task=\"%s\"} %lu\n", tasks[i].name,
+               (unsigned long)uxTaskGetStackHighWaterMark(tasks[i].handle));
+  }
+
+  out.header("m5crypto_wifi_rssi_dbm", "gauge", "WiFi signal strength");
+  out.printf("m5crypto_wifi_rssi_dbm %d\n", (int)WiFi.RSSI());
+
+  out.header("m5crypto_mqtt_reconnects_total", "counter", "MQTT reconnect attempts by result");
+  out.printf("m5crypto_mqtt_reconnects_total{result=\"ok\"} %lu\n", (unsigned long)mqttReconnects);
+  out.printf("m5crypto_mqtt_reconnects_total{result=\"failed\"} %lu\n", (unsigned long)mqttReconnectFailures);
+
+  out.header("m5crypto_uptime_seconds", "counter", "Seconds since boot");
+  out.printf("m5crypto_uptime_seconds %lu\n", millis() / 1000);
+
+  out.flush();
+  server.sendContent("");
+}
@@ -0,0 +1,126 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include "config.h"
+#include "providers.h"
+#include "display_surface.h"
+
+class RefreshScheduler;
+class PriceStream;
+class FleetSync;
+class RetryPolicy;
+class PriceHistory;
+class GlyphAtlas;
+class TickerView;
+class AlertEngine;
+
+// Fixed-bucket histogram. Bucket bounds are shared, counts are owned.
+struct Histogram {
+  static constexpr int MAX_BUCKETS = 10;
+
+  const uint32_t* bounds;  // Upper bounds (inclusive), ascending
+  uint8_t bucketCount;
+  uint32_t counts[MAX_BUCKETS + 1]; // Last slot is +Inf
+  uint32_t count;
+  uint64_t sum;
+  uint32_t max;
+
+  Histogram(const uint32_t* bounds, uint8_t bucketCount);
+  void observe(uint32_t value);
+};
+
+// Device telemetry exposed in Prometheus text format on http://<ip>:METRICS_PORT/metrics.
+// Recording only touches fixed-size counters (no allocation), so it stays on in production.
+class Metrics {
+public:
+  Metrics();
+
+  // Start the HTTP endpoint (call once WiFi is up)
+  void begin();
+
+  // Serve pending scrapes (call in loop)
+  void handleClient();
+
+  // Recording hooks
+  void recordFetch(Provider provider, uint32_t durationMs, bool success);
+  void recordDns(Provider provider, uint32_t durationMs);
+  void recordTlsHandshake(Provider provider, uint32_t durationMs);
+  void recordParse(Provider provider, uint32_t durationUs, size_t memoryUsed);
+  void recordResponseBytes(Provider provider, size_t wireBytes, size_t decodedBytes);
+  void recordInflate(Provider provider, uint32_t durationUs, size_t memoryUsed);
+  void recordRender(uint32_t durationUs);
+  void recordLoopIteration();
+  void recordMqttReconnect(bool success);
+  void recordTickToPixel(uint32_t latencyMs);
+  void recordFanout(uint32_t latencyMs);
+  void recordRefreshLag(uint32_t lagMs);
+
+  // Sources sampled at scrape time
+  void registerTask(const char* name, TaskHandle_t handle);
+  void setSurface(const DisplaySurface* surface);
+  void setGlyphAtlas(const GlyphAtlas* atlas);
+  void setTicker(const TickerView* ticker);
+  void setScheduler(const RefreshScheduler* scheduler);
+  void setPriceStream(const PriceStream* stream);
+  void setFleet(const FleetSync* fleet);
+  void setRetryPolicy(const RetryPolicy* policy);
+  void setHistory(const PriceHistory* history);
+  void setAlerts(const AlertEngine* alerts);
+
+private:
+  static constexpr int MAX_TASKS = 4;
+
+  struct ProviderStats {
+    Histogram fetchMs;
+    Histogram dnsMs;
+    Histogram tlsMs;
+    Histogram parseUs;
+    Histogram responseBytes;
+    Histogram decodedBytes;
+    Histogram inflateUs;
+    uint32_t fetchFailures;
+    uint32_t parseMemoryLast;
+    uint32_t parseMemoryPeak;
+    uint32_t inflateMemoryPeak;
+
+    ProviderStats();
+  };
+
+  struct TaskEntry {
+    const char* name;
+    TaskHandle_t handle;
+  };
+
+  WebServer server;
+  bool started;
+
+  ProviderStats providers[PROVIDER_COUNT];
+  Histogram renderUs;
+  Histogram loopIntervalMs;
+  Histogram tickToPixelMs;
+  Histogram fanoutMs;
+  Histogram refreshLagMs;
+  unsigned long lastLoopStart;
+  uint32_t mqttReconnects;
+  uint32_t mqttReconnectFailures;
+
+  TaskEntry tasks[MAX_TASKS];
+  int taskCount;
+  const DisplaySurface* surface;
+  const GlyphAtlas* glyphAtlas;
+  const TickerView* ticker;
+  const RefreshScheduler* scheduler;
+  const PriceStream* stream;
+  const FleetSync* fleet;
+  const RetryPolicy* retryPolicy;
+  const PriceHistory* history;
+  const AlertEngine* alerts;
+
+  void handleMetrics();
+};
+
+extern Metrics metrics;
+
+#endif // METRICS_H
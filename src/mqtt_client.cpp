@@ -1,6 +1,46 @@
 #include "mqtt_client.h"
+#include "metrics.h"
+#include "json_arena.h"
 #include "secrets.h"
 #include <ArduinoJson.h>
+#include <time.h>
+#include <math.h>
+
+// Round a price to 2-4 decimals depending on its magnitude
+static float roundPrice(float price) {
+  if (price >= 100) {
+    return round(price * 100) / 100;     // 2 decimal places
+  } else if (price >= 1) {
+    return round(price * 1000) / 1000;   // 3 decimal places
+  }
+  return round(price * 10000) / 10000;   // 4 decimal places
+}
+
+// "<prefix>/<symbol, lowercased>/<suffix>"
+static MqttTopic assetTopic(const char* symbol, const char* suffix) {
+  FixedString<16> lower(symbol);
+  lower.toLowerCase();
+  MqttTopic topic;
+  topic.format("%s/%s/%s", MQTT_TOPIC_PREFIX, lower.c_str(), suffix);
+  return topic;
+}
+
+// Serialize into a stack buffer and publish; an overflowed or oversized
+// document is reported and dropped rather than sent truncated
+static bool publishJson(PubSubClient& client, const char* topic, const JsonDocument& doc, bool retained) {
+  if (doc.overflowed()) {
+    Serial.printf("MQTT: Payload for %s overflowed its document, not published\n", topic);
+    return false;
+  }
+  size_t length = measureJson(doc);
+  if (length >= MQTT_PAYLOAD_MAX) {
+    Serial.printf("MQTT: Payload for %s is %u bytes, over %d\n", topic, (unsigned)length, MQTT_PAYLOAD_MAX);
+    return false;
+  }
+  char payload[MQTT_PAYLOAD_MAX];
+  serializeJson(doc, payload, sizeof(payload));
+  return client.publish(topic, (const uint8_t*)payload, length, retained);
+}
 
 MQTTClient::MQTTClient() : client(wifiClient) {
   lastReconnectAttempt = 0;
@@ -8,6 +48,12 @@ MQTTClient::MQTTClient() : client(wifiClient) {
   mqttPort = 1883;
   mqttUser = "";
   mqttPassword = "";
+  commandHandler = nullptr;
+  messageHandler = nullptr;
+  marketStats = nullptr;
+  strlcpy(clientId, MQTT_CLIENT_ID, sizeof(clientId));
+  willTopic = buildTopic("/status");
+  subscriptionCount = 0;
 }
 
 bool MQTTClient::begin(const char* broker, int port, const char* user, const char* password) {
@@ -17,6 +63,9 @@ bool MQTTClient::begin(const char* broker, int port, const char* user, const cha
   mqttPassword = password;
   
   client.setServer(broker, port);
+  client.setCallback([this](char* topic, uint8_t* payload, unsigned int length) {
+    handleMessage(topic, payload, length);
+  });
   
   // Set buffer size for larger discovery messages (must be > 600 for discovery JSON)
   client.setBufferSize(1024);
@@ -54,22 +103,25 @@ bool MQTTClient::reconnect() {
   
   Serial.println("MQTT: Attempting connection...");
   
-  // Build Last Will and Testament topic
-  String statusTopic = buildTopic("/status");
-  
   // Use credentials from secrets.h defines directly
   Serial.printf("MQTT: User='%s', Pass length=%d\n", MQTT_USER, strlen(MQTT_PASSWORD));
   
   bool connected = false;
   
   Serial.println("MQTT: Connecting with authentication...");
-  connected = client.connect(MQTT_CLIENT_ID, MQTT_USER, MQTT_PASSWORD, 
-                             statusTopic.c_str(), 0, true, "offline");
+  connected = client.connect(clientId, MQTT_USER, MQTT_PASSWORD, 
+                             willTopic.c_str(), 0, true, "offline");
+  metrics.recordMqttReconnect(connected);
   
   if (connected) {
     Serial.println("MQTT: Connected successfully!");
     // Publish online status
     publishAvailability(true);
+    // Listen for on-demand commands and restore other subscriptions
+    client.subscribe(buildTopic("/cmd").c_str());
+    for (int i = 0; i < subscriptionCount; i++) {
+      client.subscribe(subscriptions[i].c_str());
+    }
     return true;
   } else {
     Serial.printf("MQTT: Connection failed, state=%d\n", client.state());
@@ -90,9 +142,8 @@ bool MQTTClient::reconnect() {
 }
 
 void MQTTClient::publishAvailability(bool online) {
-  String topic = buildTopic("/status");
   const char* payload = online ? "online" : "offline";
-  client.publish(topic.c_str(), payload, true); // Retained
+  client.publish(willTopic.c_str(), payload, true); // Retained
   Serial.printf("MQTT: Published availability: %s\n", payload);
 }
 
@@ -109,32 +160,66 @@ void MQTTClient::publishDiscoveryConfigs(AssetData assets[], int count) {
     delay(100); // Small delay between messages to avoid overwhelming broker
   }
   
+  // Breaker state per provider: homeassistant/sensor/m5crypto_breaker_fmp/config
+  MqttTopic availabilityTopic = buildTopic("/status");
+  for (int p = 0; p < PROVIDER_COUNT; p++) {
+    const char* provider = providerName((Provider)p);
+    MqttTopic breakerTopic;
+    breakerTopic.format("%s/provider/%s/breaker", MQTT_TOPIC_PREFIX, provider);
+    FixedString<32> name;
+    name.format("Breaker %s", provider);
+    FixedString<48> uniqueId;
+    uniqueId.format("m5crypto_breaker_%s", provider);
+    
+    ArenaJsonDocument doc(JSON_USER_MQTT_DISCOVERY, 1024);
+    doc["name"] = name.c_str();
+    doc["unique_id"] = uniqueId.c_str();
+    doc["state_topic"] = breakerTopic.c_str();
+    doc["value_template"] = "{{ value_json.state }}";
+    doc["icon"] = "mdi:electric-switch";
+    doc["availability_topic"] = availabilityTopic.c_str();
+    doc["json_attributes_topic"] = breakerTopic.c_str();
+    JsonObject device = doc.createNestedObject("device");
+    device["identifiers"][0] = "m5crypto_display";
+    
+    MqttTopic discoveryTopic;
+    discoveryTopic.format("homeassistant/sensor/%s/config", uniqueId.c_str());
+    publishJson(client, discoveryTopic.c_str(), doc, true); // Retained
+  }
+  
   Serial.println("MQTT: Discovery configs published!");
 }
 
 void MQTTClient::publishAssetDiscovery(const AssetData& asset) {
-  // Build discovery topic: homeassistant/sensor/m5crypto_btc/config
-  String symbol = String(asset.symbol);
+  // The payloads point at these buffers (ArduinoJson doesn't copy const char*),
+  // so each one is published before its buffers are rewritten
+  FixedString<16> symbol(asset.symbol);
   symbol.toLowerCase();
+  FixedString<64> name;
+  FixedString<48> uniqueId;
+  MqttTopic discoveryTopic;
   
-  String discoveryTopic = "homeassistant/sensor/m5crypto_" + symbol + "/config";
+  // Build discovery topic: homeassistant/sensor/m5crypto_btc/config
+  discoveryTopic.format("homeassistant/sensor/m5crypto_%s/config", symbol.c_str());
   
   // Build state topic
-  String stateTopic = buildTopic("/" + symbol + "/state");
-  String availabilityTopic = buildTopic("/status");
+  MqttTopic stateTopic = assetTopic(asset.symbol, "state");
+  MqttTopic availabilityTopic = buildTopic("/status");
   
   // Create JSON discovery payload
-  StaticJsonDocument<512> doc;
+  ArenaJsonDocument doc(JSON_USER_MQTT_DISCOVERY, 1024);
   
   // Basic sensor config
-  doc["name"] = String(asset.name) + " Price";
-  doc["unique_id"] = "m5crypto_" + symbol + "_price";
-  doc["state_topic"] = stateTopic;
+  name.format("%s Price", asset.name);
+  uniqueId.format("m5crypto_%s_price", symbol.c_str());
+  doc["name"] = name.c_str();
+  doc["unique_id"] = uniqueId.c_str();
+  doc["state_topic"] = stateTopic.c_str();
   doc["value_template"] = "{{ value_json.price }}";
   doc["unit_of_measurement"] = asset.currency;
   doc["icon"] = getIcon(asset.symbol);
   doc["state_class"] = "measurement";
-  doc["availability_topic"] = availabilityTopic;
+  doc["availability_topic"] = availabilityTopic.c_str();
   
   // Device info (groups all sensors under one device in HA)
   JsonObject device = doc.createNestedObject("device");
@@ -145,15 +230,63 @@ void MQTTClient::publishAssetDiscovery(const AssetData& asset) {
   device["sw_version"] = "2.2";
   
   // Additional attributes (trend, timestamp)
-  doc["json_attributes_topic"] = stateTopic;
-  doc["json_attributes_template"] = "{{ {'trend': value_json.trend, 'updated': value_json.updated} | tojson }}";
+  doc["json_attributes_topic"] = stateTopic.c_str();
+  doc["json_attributes_template"] = "{{ {'trend': value_json.trend, 'updated': value_json.updated, "
+                                    "'change_1h': value_json.change_1h, 'change_24h': value_json.change_24h, "
+                                    "'change_7d': value_json.change_7d, 'ema_fast': value_json.ema_fast, "
+                                    "'ema_slow': value_json.ema_slow, 'volatility': value_json.volatility, "
+                                    "'window_change': value_json.window_change} | tojson }}";
   
   // Serialize and publish
-  String payload;
-  serializeJson(doc, payload);
-  
-  bool success = client.publish(discoveryTopic.c_str(), payload.c_str(), true); // Retained
+  bool success = publishJson(client, discoveryTopic.c_str(), doc, true); // Retained
   Serial.printf("MQTT: Discovery %s -> %s\n", asset.symbol, success ? "OK" : "FAILED");
+  
+  // Companion sensor for price age: homeassistant/sensor/m5crypto_btc_age/config
+  MqttTopic stalenessTopic = assetTopic(asset.symbol, "staleness");
+  name.format("%s Price Age", asset.name);
+  uniqueId.format("m5crypto_%s_age", symbol.c_str());
+  discoveryTopic.format("homeassistant/sensor/%s/config", uniqueId.c_str());
+  
+  doc.clear();
+  doc["name"] = name.c_str();
+  doc["unique_id"] = uniqueId.c_str();
+  doc["state_topic"] = stalenessTopic.c_str();
+  doc["value_template"] = "{{ value_json.age_s }}";
+  doc["unit_of_measurement"] = "s";
+  doc["device_class"] = "duration";
+  doc["state_class"] = "measurement";
+  doc["availability_topic"] = availabilityTopic.c_str();
+  doc["json_attributes_topic"] = stalenessTopic.c_str();
+  JsonObject ageDevice = doc.createNestedObject("device");
+  ageDevice["identifiers"][0] = "m5crypto_display";
+  
+  success = publishJson(client, discoveryTopic.c_str(), doc, true); // Retained
+  Serial.printf("MQTT: Discovery %s age -> %s\n", asset.symbol, success ? "OK" : "FAILED");
+  
+  // One sensor per candle interval: homeassistant/sensor/m5crypto_btc_candle_1h/config
+  for (int i = 0; i < CANDLE_INTERVAL_COUNT; i++) {
+    const char* interval = CandleAggregator::intervalName((CandleInterval)i);
+    FixedString<16> suffix;
+    suffix.format("candle/%s", interval);
+    MqttTopic candleTopic = assetTopic(asset.symbol, suffix.c_str());
+    name.format("%s %s Close", asset.name, interval);
+    uniqueId.format("m5crypto_%s_candle_%s", symbol.c_str(), interval);
+    discoveryTopic.format("homeassistant/sensor/%s/config", uniqueId.c_str());
+    
+    doc.clear();
+    doc["name"] = name.c_str();
+    doc["unique_id"] = uniqueId.c_str();
+    doc["state_topic"] = candleTopic.c_str();
+    doc["value_template"] = "{{ value_json.close }}";
+    doc["unit_of_measurement"] = asset.currency;
+    doc["state_class"] = "measurement";
+    doc["availability_topic"] = availabilityTopic.c_str();
+    doc["json_attributes_topic"] = candleTopic.c_str();
+    JsonObject candleDevice = doc.createNestedObject("device");
+    candleDevice["identifiers"][0] = "m5crypto_display";
+    
+    publishJson(client, discoveryTopic.c_str(), doc, true); // Retained
+  }
 }
 
 void MQTTClient::publishPrices(AssetData assets[], int count) {
@@ -162,32 +295,25 @@ void MQTTClient::publishPrices(AssetData assets[], int count) {
     return;
   }
   
+  TraceScope traceScope(TRACE_MQTT_PUBLISH);
+  
   Serial.println("MQTT: Publishing price updates...");
   
   for (int i = 0; i < count; i++) {
-    publishAssetState(assets[i]);
+    publishAssetState(assets[i], i);
   }
   
   Serial.println("MQTT: Price updates published!");
 }
 
-void MQTTClient::publishAssetState(const AssetData& asset) {
-  String symbol = String(asset.symbol);
-  symbol.toLowerCase();
-  
-  String topic = buildTopic("/" + symbol + "/state");
+void MQTTClient::publishAssetState(const AssetData& asset, int index) {
+  MqttTopic topic = assetTopic(asset.symbol, "state");
   
   // Create JSON state payload
-  StaticJsonDocument<256> doc;
+  ArenaJsonDocument doc(JSON_USER_MQTT_STATE, 512);
   
   // Round price appropriately based on value
-  if (asset.price >= 100) {
-    doc["price"] = round(asset.price * 100) / 100; // 2 decimal places
-  } else if (asset.price >= 1) {
-    doc["price"] = round(asset.price * 1000) / 1000; // 3 decimal places
-  } else {
-    doc["price"] = round(asset.price * 10000) / 10000; // 4 decimal places
-  }
+  doc["price"] = roundPrice(asset.price);
   
   // Determine trend
   if (asset.firstUpdate) {
@@ -198,25 +324,215 @@ void MQTTClient::publishAssetState(const AssetData& asset) {
     doc["trend"] = "down";
   }
   
-  // Include last update timestamp
+  // Include last update timestamp and freshness
+  time_t now = time(nullptr);
   doc["updated"] = asset.lastUpdated;
+  doc["source_time"] = (long)asset.sourceTime;
+  doc["age_s"] = assetAgeSeconds(asset, now);
+  doc["stale"] = isAssetStale(asset, now);
   
-  // Serialize and publish
-  String payload;
-  serializeJson(doc, payload);
+  // Percent change from the provider (24h kept current by MarketStats)
+  if (!asset.isStock) {
+    doc["change_1h"] = asset.change1h;
+    doc["change_7d"] = asset.change7d;
+  }
+  doc["change_24h"] = asset.change24h;
+  
+  // On-device statistics (values still warming up are left out)
+  if (marketStats != nullptr && index < marketStats->assetCapacity() &&
+      marketStats->get(index).updates > 0) {
+    const AssetStats& stats = marketStats->get(index);
+    doc["ema_fast"] = roundPrice(stats.emaFast);
+    doc["ema_slow"] = roundPrice(stats.emaSlow);
+    if (!isnan(stats.volatility)) {
+      doc["volatility"] = stats.volatility;
+    }
+    JsonObject windows = doc.createNestedObject("window_change");
+    for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+      if (!isnan(stats.windowChange[w])) {
+        char name[8];
+        MarketStats::windowName(w, name, sizeof(name));
+        windows[name] = stats.windowChange[w]; // Copied: name is a stack buffer
+      }
+    }
+  }
   
-  bool success = client.publish(topic.c_str(), payload.c_str());
+  // Serialize and publish
+  bool success = publishJson(client, topic.c_str(), doc, false);
   Serial.printf("MQTT: %s $%.2f %s -> %s\n", 
                 asset.symbol, asset.price, asset.currency, 
                 success ? "OK" : "FAILED");
 }
 
-String MQTTClient::buildTopic(const char* suffix) {
-  return String(MQTT_TOPIC_PREFIX) + suffix;
+bool MQTTClient::publishCandle(const AssetData& asset, CandleInterval interval, const Candle& candle) {
+  if (!client.connected()) {
+    return false;
+  }
+  
+  FixedString<16> suffix;
+  suffix.format("candle/%s", CandleAggregator::intervalName(interval));
+  MqttTopic topic = assetTopic(asset.symbol, suffix.c_str());
+  
+  ArenaJsonDocument doc(JSON_USER_MQTT_STATE, 192);
+  doc["start"] = (long)candle.start;
+  doc["open"] = roundPrice(candle.open);
+  doc["high"] = roundPrice(candle.high);
+  doc["low"] = roundPrice(candle.low);
+  doc["close"] = roundPrice(candle.close);
+  doc["samples"] = candle.samples;
+  
+  return publishJson(client, topic.c_str(), doc, true); // Retained: the last closed candle
+}
+
+bool MQTTClient::publishAlert(const AssetData& asset, const AlertEvent& event, const char* message) {
+  if (!client.connected()) {
+    return false;
+  }
+  
+  MqttTopic topic = assetTopic(asset.symbol, "alert");
+  
+  ArenaJsonDocument doc(JSON_USER_MQTT_STATE, 256);
+  doc["kind"] = AlertEngine::kindName(event.kind);
+  if (event.kind == ALERT_MOVE) {
+    char window[8];
+    MarketStats::windowName(event.window, window, sizeof(window));
+    doc["window"] = window; // Copied: the buffer goes out of scope before publishing
+  }
+  bool priceRule = event.kind == ALERT_ABOVE || event.kind == ALERT_BELOW;
+  doc["threshold"] = priceRule ? roundPrice(event.threshold) : event.threshold;
+  doc["value"] = priceRule ? roundPrice(event.value) : event.value;
+  doc["price"] = roundPrice(asset.price);
+  doc["currency"] = asset.currency;
+  doc["time"] = (long)event.at;
+  doc["message"] = message;
+  
+  return publishJson(client, topic.c_str(), doc, false);
+}
+
+void MQTTClient::publishStaleness(AssetData assets[], int count) {
+  if (!client.connected()) {
+    return;
+  }
+  
+  time_t now = time(nullptr);
+  for (int i = 0; i < count; i++) {
+    MqttTopic topic = assetTopic(assets[i].symbol, "staleness");
+    
+    char payload[96];
+    snprintf(payload, sizeof(payload), "{\"age_s\":%ld,\"stale\":%s,\"market_closed\":%s}",
+             assetAgeSeconds(assets[i], now),
+             isAssetStale(assets[i], now) ? "true" : "false",
+             assets[i].marketClosed ? "true" : "false");
+    client.publish(topic.c_str(), payload);
+  }
+}
+
+void MQTTClient::publishBreakers(const RetryPolicy& policy, unsigned long now) {
+  if (!client.connected()) {
+    return;
+  }
+  
+  for (int p = 0; p < PROVIDER_COUNT; p++) {
+    Provider provider = (Provider)p;
+    MqttTopic topic;
+    topic.format("%s/provider/%s/breaker", MQTT_TOPIC_PREFIX, providerName(provider));
+    
+    char payload[128];
+    snprintf(payload, sizeof(payload),
+             "{\"state\":\"%s\",\"failures\":%u,\"trips\":%lu,\"last_error\":\"%s\",\"retry_in_s\":%lu}",
+             RetryPolicy::stateName(policy.state(provider)), policy.consecutiveFailures(provider),
+             (unsigned long)policy.tripCount(provider), fetchErrorName(policy.lastError(provider)),
+             policy.blockedForMs(provider, now) / 1000);
+    client.publish(topic.c_str(), payload, true);
+  }
+}
+
+void MQTTClient::setCommandHandler(CommandHandler handler) {
+  commandHandler = handler;
+}
+
+void MQTTClient::setMarketStats(const MarketStats* stats) {
+  marketStats = stats;
+}
+
+void MQTTClient::setMessageHandler(MessageHandler handler) {
+  messageHandler = handler;
+}
+
+void MQTTClient::setClientId(const char* id) {
+  strlcpy(clientId, id, sizeof(clientId));
+}
+
+void MQTTClient::setWillTopic(const char* topic) {
+  willTopic = topic;
+}
+
+bool MQTTClient::restart() {
+  if (client.connected()) {
+    client.disconnect(); // Clean disconnect: the old Last Will is discarded
+  }
+  return reconnect();
+}
+
+bool MQTTClient::subscribe(const char* topic) {
+  if (subscriptionCount >= MAX_SUBSCRIPTIONS) {
+    Serial.printf("MQTT: Too many subscriptions, dropping %s\n", topic);
+    return false;
+  }
+  subscriptions[subscriptionCount++] = topic;
+  return client.connected() && client.subscribe(topic);
+}
+
+bool MQTTClient::publish(const char* topic, const char* payload, bool retained) {
+  if (!client.connected()) {
+    return false;
+  }
+  return client.publish(topic, payload, retained);
+}
+
+bool MQTTClient::publishTrace(const TraceRecorder& recorder) {
+  if (!client.connected()) {
+    Serial.println("MQTT: Cannot publish trace - not connected");
+    return false;
+  }
+  
+  // Streamed publish: the dump is larger than the client buffer
+  MqttTopic topic = buildTopic("/trace");
+  size_t size = recorder.dumpSize();
+  if (!client.beginPublish(topic.c_str(), size, false)) {
+    Serial.println("MQTT: Trace publish failed");
+    return false;
+  }
+  recorder.writeBinary(client);
+  bool success = client.endPublish() == 1;
+  Serial.printf("MQTT: Trace (%u events, %u bytes) -> %s\n", 
+                recorder.size(), (unsigned)size, success ? "OK" : "FAILED");
+  return success;
+}
+
+void MQTTClient::handleMessage(char* topic, uint8_t* payload, unsigned int length) {
+  if (buildTopic("/cmd") != topic) {
+    if (messageHandler != nullptr) {
+      messageHandler(topic, payload, length);
+    }
+    return;
+  }
+  
+  char command[32];
+  unsigned int commandLength = length < sizeof(command) - 1 ? length : sizeof(command) - 1;
+  memcpy(command, payload, commandLength);
+  command[commandLength] = '\0';
+  
+  Serial.printf("MQTT: Command on %s: %s\n", topic, command);
+  if (commandHandler != nullptr) {
+    commandHandler(command);
+  }
 }
 
-String MQTTClient::buildTopic(const String& suffix) {
-  return String(MQTT_TOPIC_PREFIX) + suffix;
+MqttTopic MQTTClient::buildTopic(const char* suffix) {
+  MqttTopic topic(MQTT_TOPIC_PREFIX);
+  topic += suffix;
+  return topic;
 }
 
 const char* MQTTClient::getIcon(const char* symbol) {
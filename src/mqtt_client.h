@@ -4,6 +4,14 @@
 #include <WiFi.h>
 #include <PubSubClient.h>
 #include "crypto_display.h"
+#include "trace.h"
+#include "candles.h"
+#include "market_stats.h"
+#include "alert_engine.h"
+#include "retry_policy.h"
+#include "fixed_string.h"
+
+typedef FixedString<MQTT_TOPIC_LEN> MqttTopic;
 
 class MQTTClient {
 public:
@@ -27,8 +35,49 @@ public:
   // Publish current prices for all assets
   void publishPrices(AssetData assets[], int count);
   
-  // Publish device availability status
+  // Add change windows, EMAs and volatility to state payloads (optional)
+  void setMarketStats(const MarketStats* stats);
+  
+  // Publish one closed candle to <prefix>/<symbol>/candle/<interval> (retained)
+  bool publishCandle(const AssetData& asset, CandleInterval interval, const Candle& candle);
+  
+  // Publish one fired alert to <prefix>/<symbol>/alert (not retained)
+  bool publishAlert(const AssetData& asset, const AlertEvent& event, const char* message);
+  
+  // Publish price age and stale flag for all assets (<prefix>/<symbol>/staleness)
+  void publishStaleness(AssetData assets[], int count);
+  
+  // Publish each provider's circuit breaker (<prefix>/provider/<name>/breaker, retained)
+  void publishBreakers(const RetryPolicy& policy, unsigned long now);
+  
+  // Publish device availability status (retained, on the LWT topic)
   void publishAvailability(bool online);
+  
+  // Client id and Last Will topic used on the next connect
+  // (defaults: MQTT_CLIENT_ID and <prefix>/status)
+  void setClientId(const char* id);
+  void setWillTopic(const char* topic);
+  const char* getClientId() const { return clientId; }
+  
+  // Drop the connection and reconnect at once (e.g. to re-arm a new Last Will)
+  bool restart();
+  
+  // Subscribe to a topic, kept across reconnects (up to MAX_SUBSCRIPTIONS)
+  bool subscribe(const char* topic);
+  
+  // Publish a raw payload
+  bool publish(const char* topic, const char* payload, bool retained = false);
+  
+  // Handler for messages on subscribed topics other than <prefix>/cmd
+  typedef void (*MessageHandler)(const char* topic, const uint8_t* payload, unsigned int length);
+  void setMessageHandler(MessageHandler handler);
+  
+  // Handler for commands received on <prefix>/cmd (e.g. "trace")
+  typedef void (*CommandHandler)(const char* command);
+  void setCommandHandler(CommandHandler handler);
+  
+  // Publish the binary trace dump to <prefix>/trace
+  bool publishTrace(const TraceRecorder& recorder);
 
 private:
   WiFiClient wifiClient;
@@ -39,18 +88,30 @@ private:
   const char* mqttUser;
   const char* mqttPassword;
   
+  CommandHandler commandHandler;
+  MessageHandler messageHandler;
+  const MarketStats* marketStats;
+  
+  char clientId[32];
+  MqttTopic willTopic;
+  static constexpr int MAX_SUBSCRIPTIONS = 6;
+  MqttTopic subscriptions[MAX_SUBSCRIPTIONS];
+  int subscriptionCount;
+  
   unsigned long lastReconnectAttempt;
   static constexpr unsigned long RECONNECT_INTERVAL = 5000; // 5 seconds between attempts
   
   // Helper to build topic strings
-  String buildTopic(const char* suffix);
-  String buildTopic(const String& suffix);
+  MqttTopic buildTopic(const char* suffix);
   
   // Publish a single asset's discovery config
   void publishAssetDiscovery(const AssetData& asset);
   
-  // Publish a single asset's state
-  void publishAssetState(const AssetData& asset);
+  // Publish a single asset's state (index into the assets array, for statistics)
+  void publishAssetState(const AssetData& asset, int index);
+  
+  // Dispatch an incoming message to the command or message handler
+  void handleMessage(char* topic, uint8_t* payload, unsigned int length);
   
   // Get MDI icon for asset
   const char* getIcon(const char* symbol);
@@ -0,0 +1,514 @@
+#include "price_history.h"
+#include "time_utils.h"
+#include <math.h>
+
+static const char* HISTORY_DIR = "/hist";
+static const char* HISTORY_INDEX_PATH = "/hist/index.bin";
+static const uint32_t HISTORY_INDEX_MAGIC = 0x31534948; // "HIS1"
+static const int COMPACT_CHUNK_RECORDS = 32;            // Records per read/write during compaction and queries
+
+static_assert(HISTORY_ROLLUP_1_SEGMENTS <= HISTORY_RAW_SEGMENTS &&
+              HISTORY_ROLLUP_2_SEGMENTS <= HISTORY_RAW_SEGMENTS,
+              "MAX_SEGMENTS assumes the raw tier has the largest segment budget");
+
+// Written ahead of the symbol table and segment lists; any difference means
+// the files came from a build with another layout and are dropped
+struct IndexHeader {
+  uint32_t magic;
+  uint16_t recordSize;
+  uint16_t segmentRecords;
+  uint16_t maxAssets;
+  uint16_t maxSegments;
+};
+
+PriceHistory::PriceHistory()
+  : fs(nullptr),
+    pendingCount(0),
+    lastSampleRun(0),
+    lastFlush(0),
+    appended(0),
+    compactions(0),
+    writeErrors(0),
+    segmentsScanned(0),
+    segmentsSkipped(0),
+    flushMicros(0),
+    queryMicros(0) {
+  static_assert(sizeof(Record) == 12, "Record layout is stored on flash");
+  memset(symbols, 0, sizeof(symbols));
+  memset(tiers, 0, sizeof(tiers));
+  memset(lastSampleEpoch, 0, sizeof(lastSampleEpoch));
+}
+
+bool PriceHistory::begin(fs::FS& filesystem) {
+  fs = &filesystem;
+  loadIndex();
+  for (int t = 0; t < TIER_COUNT; t++) {
+    recoverActive((Tier)t);
+  }
+  Serial.printf("History: %lu raw, %lu %s, %lu %s points on flash\n",
+                (unsigned long)storedRecords(TIER_RAW),
+                (unsigned long)storedRecords(TIER_ROLLUP_1), tierName(TIER_ROLLUP_1),
+                (unsigned long)storedRecords(TIER_ROLLUP_2), tierName(TIER_ROLLUP_2));
+  return true;
+}
+
+void PriceHistory::sample(const AssetData assets[], int count, time_t now) {
+  if (fs == nullptr || now == lastSampleRun || !isClockSynced(now)) {
+    return;
+  }
+  lastSampleRun = now;
+
+  for (int i = 0; i < count; i++) {
+    const AssetData& asset = assets[i];
+    time_t at = asset.sourceTime > 0 ? asset.sourceTime : asset.fetchTime;
+    if (asset.price <= 0.0 || at <= 0) {
+      continue;
+    }
+    int id = assetId(asset.symbol, true);
+    if (id < 0) {
+      continue;
+    }
+    // Only new quotes count, so a closed market adds nothing
+    if (lastSampleEpoch[id] != 0 && (uint32_t)at < lastSampleEpoch[id] + HISTORY_SAMPLE_SEC) {
+      continue;
+    }
+    lastSampleEpoch[id] = (uint32_t)at;
+    append(id, (uint32_t)at, asset.price);
+  }
+}
+
+void PriceHistory::loop(unsigned long now) {
+  if (pendingCount > 0 && now - lastFlush >= HISTORY_FLUSH_MS) {
+    flush();
+  }
+}
+
+bool PriceHistory::flush() {
+  lastFlush = millis();
+  if (fs == nullptr || pendingCount == 0) {
+    return true;
+  }
+  unsigned long start = micros();
+  bool ok = writeRecords(TIER_RAW, pending, pendingCount);
+  pendingCount = 0; // Dropped on failure rather than retried forever (counted in writeErrors)
+  flushMicros = micros() - start;
+  return ok;
+}
+
+size_t PriceHistory::query(const char* symbol, time_t from, time_t to, HistoryVisitor visitor, void* context) {
+  int id = fs != nullptr ? assetId(symbol, false) : -1;
+  if (id < 0 || to < from || to < 0) {
+    return 0;
+  }
+  uint32_t first = from > 0 ? (uint32_t)from : 0;
+  uint32_t last = (uint32_t)to;
+  unsigned long start = micros();
+  size_t found = 0;
+  Record chunk[COMPACT_CHUNK_RECORDS];
+
+  // Coarsest tier first: it holds the oldest points
+  for (int t = TIER_COUNT - 1; t >= 0; t--) {
+    const TierState& tier = tiers[t];
+    for (uint32_t s = 0; s < tier.count; s++) {
+      const Segment& segment = tier.segments[s];
+      if (segment.records == 0 || segment.maxEpoch < first || segment.minEpoch > last) {
+        segmentsSkipped++;
+        continue;
+      }
+      segmentsScanned++;
+      char path[32];
+      buildPath(path, sizeof(path), (Tier)t, segment.seq);
+      File file = fs->open(path, FILE_READ);
+      if (!file) {
+        continue;
+      }
+      uint32_t remaining = segment.records;
+      while (remaining > 0) {
+        uint32_t want = remaining < (uint32_t)COMPACT_CHUNK_RECORDS ? remaining : COMPACT_CHUNK_RECORDS;
+        size_t got = file.read(reinterpret_cast<uint8_t*>(chunk), want * sizeof(Record)) / sizeof(Record);
+        if (got == 0) {
+          break;
+        }
+        for (size_t i = 0; i < got; i++) {
+          const Record& record = chunk[i];
+          if (record.asset == id && record.epoch >= first && record.epoch <= last) {
+            HistoryPoint point = {(time_t)record.epoch, decodePrice(record)};
+            visitor(point, context);
+            found++;
+          }
+        }
+        remaining -= got;
+      }
+      file.close();
+    }
+  }
+
+  // Newest points are still waiting in RAM
+  for (int i = 0; i < pendingCount; i++) {
+    const Record& record = pending[i];
+    if (record.asset == id && record.epoch >= first && record.epoch <= last) {
+      HistoryPoint point = {(time_t)record.epoch, decodePrice(record)};
+      visitor(point, context);
+      found++;
+    }
+  }
+
+  queryMicros = micros() - start;
+  return found;
+}
+
+namespace {
+struct ArrayQuery {
+  HistoryPoint* out;
+  size_t maxPoints;
+  size_t count;
+};
+
+void collectPoint(const HistoryPoint& point, void* context) {
+  ArrayQuery* query = static_cast<ArrayQuery*>(context);
+  if (query->count < query->maxPoints) {
+    query->out[query->count++] = point;
+  }
+}
+}
+
+size_t PriceHistory::query(const char* symbol, time_t from, time_t to, HistoryPoint* out, size_t maxPoints) {
+  ArrayQuery collected = {out, maxPoints, 0};
+  query(symbol, from, to, collectPoint, &collected);
+  return collected.count;
+}
+
+const char* PriceHistory::tierName(Tier tier) {
+  switch (tier) {
+    case TIER_RAW: return "raw";
+    case TIER_ROLLUP_1: return "rollup_1";
+    case TIER_ROLLUP_2: return "rollup_2";
+    default: return "unknown";
+  }
+}
+
+uint32_t PriceHistory::storedRecords(Tier tier) const {
+  uint32_t total = 0;
+  for (uint32_t s = 0; s < tiers[tier].count; s++) {
+    total += tiers[tier].segments[s].records;
+  }
+  return total;
+}
+
+int PriceHistory::assetId(const char* symbol, bool create) {
+  for (int i = 0; i < HISTORY_MAX_ASSETS; i++) {
+    if (symbols[i][0] != '\0' && strcmp(symbols[i], symbol) == 0) {
+      return i;
+    }
+  }
+  if (!create) {
+    return -1;
+  }
+  // Ids are never reused, so stored records keep pointing at the right symbol
+  for (int i = 0; i < HISTORY_MAX_ASSETS; i++) {
+    if (symbols[i][0] == '\0') {
+      strlcpy(symbols[i], symbol, SYMBOL_LEN);
+      saveIndex();
+      return i;
+    }
+  }
+  return -1;
+}
+
+void PriceHistory::append(uint8_t asset, uint32_t epoch, float price) {
+  Record& record = pending[pendingCount++];
+  record.epoch = epoch;
+  record.asset = asset;
+  record.reserved = 0;
+  encodePrice(price, record);
+  appended++;
+  if (pendingCount == HISTORY_BUFFER_RECORDS) {
+    flush();
+  }
+}
+
+bool PriceHistory::writeRecords(Tier tier, const Record* records, int count) {
+  TierState& state = tiers[tier];
+  int written = 0;
+  while (written < count) {
+    if (state.count == 0 || state.segments[state.count - 1].records >= HISTORY_SEGMENT_RECORDS) {
+      rotate(tier);
+    }
+    Segment& active = state.segments[state.count - 1];
+    int batch = HISTORY_SEGMENT_RECORDS - active.records;
+    if (batch > count - written) {
+      batch = count - written;
+    }
+
+    char path[32];
+    buildPath(path, sizeof(path), tier, active.seq);
+    File file = fs->open(path, FILE_APPEND);
+    if (!file) {
+      writeErrors++;
+      Serial.printf("History: Cannot open %s\n", path);
+      return false;
+    }
+    size_t bytes = file.write(reinterpret_cast<const uint8_t*>(records + written), batch * sizeof(Record));
+    file.close();
+
+    // Only whole records count; a torn one ends the segment so the next
+    // write starts aligned in a fresh file
+    int landed = bytes / sizeof(Record);
+    for (int i = 0; i < landed; i++) {
+      uint32_t epoch = records[written + i].epoch;
+      if (epoch < active.minEpoch) {
+        active.minEpoch = epoch;
+      }
+      if (epoch > active.maxEpoch) {
+        active.maxEpoch = epoch;
+      }
+    }
+    active.records += landed;
+    written += landed;
+    if (landed != batch) {
+      writeErrors++;
+      Serial.printf("History: Short write to %s (flash full?)\n", path);
+      rotate(tier);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Start a new active segment; past the tier's budget the oldest closed
+// segment is folded into the next tier and deleted
+void PriceHistory::rotate(Tier tier) {
+  TierState& state = tiers[tier];
+  while ((int)state.count > segmentBudget(tier)) {
+    Segment oldest = state.segments[0];
+    memmove(&state.segments[0], &state.segments[1], (state.count - 1) * sizeof(Segment));
+    state.count--;
+    if (tier + 1 < TIER_COUNT) {
+      compact(tier, oldest);
+    }
+    char path[32];
+    buildPath(path, sizeof(path), tier, oldest.seq);
+    fs->remove(path);
+  }
+
+  Segment& fresh = state.segments[state.count++];
+  fresh.seq = state.nextSeq++;
+  fresh.minEpoch = UINT32_MAX;
+  fresh.maxEpoch = 0;
+  fresh.records = 0;
+  saveIndex();
+}
+
+// Downsample one segment into the next tier: the last price of each asset
+// in each bucket, stamped with the bucket start
+void PriceHistory::compact(Tier tier, const Segment& segment) {
+  Tier target = (Tier)(tier + 1);
+  uint32_t bucketSec = bucketSeconds(target);
+  struct OpenBucket {
+    uint32_t start;
+    Record close;
+    bool valid;
+  };
+  OpenBucket open[HISTORY_MAX_ASSETS];
+  memset(open, 0, sizeof(open));
+  Record in[COMPACT_CHUNK_RECORDS];
+  Record out[COMPACT_CHUNK_RECORDS];
+  int outCount = 0;
+
+  char path[32];
+  buildPath(path, sizeof(path), tier, segment.seq);
+  File file = fs->open(path, FILE_READ);
+  if (!file) {
+    return;
+  }
+  uint32_t remaining = segment.records;
+  while (remaining > 0) {
+    uint32_t want = remaining < (uint32_t)COMPACT_CHUNK_RECORDS ? remaining : COMPACT_CHUNK_RECORDS;
+    size_t got = file.read(reinterpret_cast<uint8_t*>(in), want * sizeof(Record)) / sizeof(Record);
+    if (got == 0) {
+      break;
+    }
+    remaining -= got;
+    for (size_t i = 0; i < got; i++) {
+      const Record& record = in[i];
+      if (record.asset >= HISTORY_MAX_ASSETS) {
+        continue;
+      }
+      OpenBucket& bucket = open[record.asset];
+      uint32_t start = record.epoch - record.epoch % bucketSec;
+      if (bucket.valid && bucket.start != start) {
+        out[outCount] = bucket.close;
+        out[outCount++].epoch = bucket.start;
+        bucket.valid = false;
+      }
+      if (!bucket.valid || record.epoch >= bucket.close.epoch) {
+        bucket.start = start;
+        bucket.close = record;
+        bucket.valid = true;
+      }
+      if (outCount == COMPACT_CHUNK_RECORDS) {
+        writeRecords(target, out, outCount);
+        outCount = 0;
+      }
+    }
+  }
+  file.close();
+
+  // A bucket that continues into the next segment ends up as two points
+  for (int a = 0; a < HISTORY_MAX_ASSETS; a++) {
+    if (!open[a].valid) {
+      continue;
+    }
+    out[outCount] = open[a].close;
+    out[outCount++].epoch = open[a].start;
+    if (outCount == COMPACT_CHUNK_RECORDS) {
+      writeRecords(target, out, outCount);
+      outCount = 0;
+    }
+  }
+  if (outCount > 0) {
+    writeRecords(target, out, outCount);
+  }
+  compactions++;
+}
+
+// The index is only rewritten when segments change, so the active segment's
+// count and time range are rebuilt from its file
+void PriceHistory::recoverActive(Tier tier) {
+  TierState& state = tiers[tier];
+  if (state.count == 0) {
+    rotate(tier);
+    return;
+  }
+
+  Segment& active = state.segments[state.count - 1];
+  active.records = 0;
+  active.minEpoch = UINT32_MAX;
+  active.maxEpoch = 0;
+  char path[32];
+  buildPath(path, sizeof(path), tier, active.seq);
+  File file = fs->open(path, FILE_READ);
+  if (!file) {
+    return; // Not written yet
+  }
+  bool torn = file.size() % sizeof(Record) != 0;
+  Record chunk[COMPACT_CHUNK_RECORDS];
+  size_t got;
+  while ((got = file.read(reinterpret_cast<uint8_t*>(chunk), sizeof(chunk)) / sizeof(Record)) > 0) {
+    for (size_t i = 0; i < got; i++) {
+      const Record& record = chunk[i];
+      if (record.epoch < active.minEpoch) {
+        active.minEpoch = record.epoch;
+      }
+      if (record.epoch > active.maxEpoch) {
+        active.maxEpoch = record.epoch;
+      }
+      if (tier == TIER_RAW && record.asset < HISTORY_MAX_ASSETS && record.epoch > lastSampleEpoch[record.asset]) {
+        lastSampleEpoch[record.asset] = record.epoch;
+      }
+    }
+    active.records += got;
+  }
+  file.close();
+
+  if (torn || active.records >= HISTORY_SEGMENT_RECORDS) {
+    rotate(tier); // Power was lost mid-write, or it filled up just before
+  }
+}
+
+void PriceHistory::loadIndex() {
+  File file = fs->open(HISTORY_INDEX_PATH, FILE_READ);
+  if (!file) {
+    Serial.println("History: No index on flash, starting empty");
+    removeAll(); // Segments without an index can't be placed
+    return;
+  }
+
+  IndexHeader header;
+  bool ok = file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header) &&
+            header.magic == HISTORY_INDEX_MAGIC && header.recordSize == sizeof(Record) &&
+            header.segmentRecords == HISTORY_SEGMENT_RECORDS && header.maxAssets == HISTORY_MAX_ASSETS &&
+            header.maxSegments == MAX_SEGMENTS &&
+            file.read(reinterpret_cast<uint8_t*>(symbols), sizeof(symbols)) == sizeof(symbols) &&
+            file.read(reinterpret_cast<uint8_t*>(tiers), sizeof(tiers)) == sizeof(tiers);
+  file.close();
+
+  for (int t = 0; ok && t < TIER_COUNT; t++) {
+    ok = tiers[t].count <= (uint32_t)MAX_SEGMENTS;
+  }
+  if (!ok) {
+    Serial.println("History: Index from another layout, starting empty");
+    memset(symbols, 0, sizeof(symbols));
+    memset(tiers, 0, sizeof(tiers));
+    removeAll();
+    return;
+  }
+  for (int i = 0; i < HISTORY_MAX_ASSETS; i++) {
+    symbols[i][SYMBOL_LEN - 1] = '\0';
+  }
+}
+
+void PriceHistory::saveIndex() {
+  File file = fs->open(HISTORY_INDEX_PATH, FILE_WRITE);
+  if (!file) {
+    writeErrors++;
+    Serial.println("History: Cannot write index");
+    return;
+  }
+  IndexHeader header = {HISTORY_INDEX_MAGIC, sizeof(Record), HISTORY_SEGMENT_RECORDS,
+                        HISTORY_MAX_ASSETS, MAX_SEGMENTS};
+  file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const uint8_t*>(symbols), sizeof(symbols));
+  file.write(reinterpret_cast<const uint8_t*>(tiers), sizeof(tiers));
+  file.close();
+}
+
+// SPIFFS has no real directories; drop every file under HISTORY_DIR one at a
+// time so the listing isn't changed under an open iterator
+void PriceHistory::removeAll() {
+  for (;;) {
+    File dir = fs->open(HISTORY_DIR);
+    File entry = dir.openNextFile();
+    if (!entry) {
+      return;
+    }
+    char path[40];
+    strlcpy(path, entry.path(), sizeof(path));
+    entry.close();
+    dir.close();
+    if (!fs->remove(path)) {
+      return;
+    }
+  }
+}
+
+void PriceHistory::buildPath(char* out, size_t size, Tier tier, uint32_t seq) {
+  snprintf(out, size, "%s/%d_%lu.bin", HISTORY_DIR, (int)tier, (unsigned long)seq);
+}
+
+uint32_t PriceHistory::bucketSeconds(Tier tier) {
+  switch (tier) {
+    case TIER_ROLLUP_1: return HISTORY_ROLLUP_1_SEC;
+    case TIER_ROLLUP_2: return HISTORY_ROLLUP_2_SEC;
+    default: return HISTORY_SAMPLE_SEC;
+  }
+}
+
+int PriceHistory::segmentBudget(Tier tier) {
+  switch (tier) {
+    case TIER_ROLLUP_1: return HISTORY_ROLLUP_1_SEGMENTS;
+    case TIER_ROLLUP_2: return HISTORY_ROLLUP_2_SEGMENTS;
+    default: return HISTORY_RAW_SEGMENTS;
+  }
+}
+
+// Eight significant digits (more than a float holds) in an int32 mantissa
+void PriceHistory::encodePrice(float price, Record& record) {
+  int exponent = price > 0 ? (int)floor(log10(price)) - 7 : 0;
+  record.exponent = (int8_t)exponent;
+  record.mantissa = (int32_t)lround(price / pow(10.0, exponent));
+}
+
+float PriceHistory::decodePrice(const Record& record) {
+  return (float)(record.mantissa * pow(10.0, record.exponent));
+}
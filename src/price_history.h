@@ -0,0 +1,135 @@
+#ifndef PRICE_HISTORY_H
+#define PRICE_HISTORY_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <time.h>
+#include "config.h"
+#include "crypto_display.h"
+
+// One stored price
+struct HistoryPoint {
+  time_t epoch;
+  float price;
+};
+
+typedef void (*HistoryVisitor)(const HistoryPoint& point, void* context);
+
+// Price history on SPIFFS that survives reboots.
+//
+// Log-structured: fixed 12-byte records (asset id, epoch, price as mantissa
+// and power of ten) are appended to segment files of HISTORY_SEGMENT_RECORDS
+// records. There are three tiers: raw points at most every
+// HISTORY_SAMPLE_SEC, then HISTORY_ROLLUP_1_SEC and HISTORY_ROLLUP_2_SEC
+// closes. When a tier has more segments than its budget, the oldest one is
+// downsampled into the next tier and deleted; the coarsest tier just drops
+// it. Space on flash is therefore fixed.
+//
+// The min/max epoch of every segment is kept in an index file, so a range
+// query opens only the segments that overlap it. Points are buffered in RAM
+// and written every HISTORY_FLUSH_MS, which bounds flash writes; a reset
+// loses at most that much. Main loop only.
+class PriceHistory {
+public:
+  PriceHistory();
+
+  // Load the index and recover the active segments. SPIFFS must already be
+  // mounted. Without it every call is a no-op.
+  bool begin(fs::FS& fs);
+
+  // Record assets whose source time moved on, at most once per
+  // HISTORY_SAMPLE_SEC each (cheap, call from loop())
+  void sample(const AssetData assets[], int count, time_t now);
+
+  // Write buffered points when HISTORY_FLUSH_MS has passed
+  void loop(unsigned long now);
+  bool flush();
+
+  // Points for a symbol with from <= epoch <= to, oldest first: rollups where
+  // raw points have been compacted, raw points after. Returns the point count.
+  size_t query(const char* symbol, time_t from, time_t to, HistoryVisitor visitor, void* context);
+
+  // Same, into an array; stops once maxPoints are written
+  size_t query(const char* symbol, time_t from, time_t to, HistoryPoint* out, size_t maxPoints);
+
+  enum Tier : uint8_t {
+    TIER_RAW = 0,
+    TIER_ROLLUP_1,
+    TIER_ROLLUP_2,
+    TIER_COUNT
+  };
+
+  static const char* tierName(Tier tier); // "raw", "rollup_1", "rollup_2"
+
+  // Statistics
+  int segmentCount(Tier tier) const { return (int)tiers[tier].count; }
+  uint32_t storedRecords(Tier tier) const;
+  uint32_t appendedCount() const { return appended; }
+  uint32_t compactionCount() const { return compactions; }
+  uint32_t writeErrorCount() const { return writeErrors; }
+  uint32_t segmentsScannedCount() const { return segmentsScanned; }
+  uint32_t segmentsSkippedCount() const { return segmentsSkipped; }
+  uint32_t lastFlushMicros() const { return flushMicros; }
+  uint32_t lastQueryMicros() const { return queryMicros; }
+
+private:
+  static constexpr int SYMBOL_LEN = 12;
+  static constexpr int MAX_SEGMENTS = HISTORY_RAW_SEGMENTS + 1; // Largest budget plus the active one
+
+  // On flash, little-endian as written
+  struct Record {
+    uint32_t epoch;
+    int32_t mantissa;
+    uint8_t asset;
+    int8_t exponent;
+    uint16_t reserved;
+  };
+
+  struct Segment {
+    uint32_t seq;
+    uint32_t minEpoch;
+    uint32_t maxEpoch;
+    uint32_t records;
+  };
+
+  // Segments oldest first; the last one is being appended to
+  struct TierState {
+    Segment segments[MAX_SEGMENTS];
+    uint32_t count;
+    uint32_t nextSeq;
+  };
+
+  fs::FS* fs;
+  char symbols[HISTORY_MAX_ASSETS][SYMBOL_LEN];
+  TierState tiers[TIER_COUNT];
+  Record pending[HISTORY_BUFFER_RECORDS];
+  int pendingCount;
+  uint32_t lastSampleEpoch[HISTORY_MAX_ASSETS];
+  time_t lastSampleRun;
+  unsigned long lastFlush;
+
+  uint32_t appended;
+  uint32_t compactions;
+  uint32_t writeErrors;
+  uint32_t segmentsScanned;
+  uint32_t segmentsSkipped;
+  uint32_t flushMicros;
+  uint32_t queryMicros;
+
+  int assetId(const char* symbol, bool create);
+  void append(uint8_t asset, uint32_t epoch, float price);
+  bool writeRecords(Tier tier, const Record* records, int count);
+  void rotate(Tier tier);
+  void compact(Tier tier, const Segment& segment);
+  void recoverActive(Tier tier);
+  void loadIndex();
+  void saveIndex();
+  void removeAll();
+  static void buildPath(char* out, size_t size, Tier tier, uint32_t seq);
+  static uint32_t bucketSeconds(Tier tier);
+  static int segmentBudget(Tier tier);
+  static void encodePrice(float price, Record& record);
+  static float decodePrice(const Record& record);
+};
+
+#endif // PRICE_HISTORY_H
@@ -0,0 +1,498 @@
+#include "price_stream.h"
+#include <ArduinoJson.h>
+#include "secrets.h"
+
+#ifndef STREAM_URL
+#define STREAM_URL "wss://ws.kraken.com/v2"
+#endif
+
+static const unsigned long HANDSHAKE_TIMEOUT_MS = 10000;
+
+// Only the fields we use are kept when parsing ticker messages
+static StaticJsonDocument<192> tickerFilter;
+
+static void base64Encode(const uint8_t* data, size_t length, char* out) {
+  static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t o = 0;
+  for (size_t i = 0; i < length; i += 3) {
+    uint32_t chunk = (uint32_t)data[i] << 16;
+    if (i + 1 < length) chunk |= (uint32_t)data[i + 1] << 8;
+    if (i + 2 < length) chunk |= data[i + 2];
+    out[o++] = ALPHABET[(chunk >> 18) & 0x3F];
+    out[o++] = ALPHABET[(chunk >> 12) & 0x3F];
+    out[o++] = (i + 1 < length) ? ALPHABET[(chunk >> 6) & 0x3F] : '=';
+    out[o++] = (i + 2 < length) ? ALPHABET[chunk & 0x3F] : '=';
+  }
+  out[o] = '\0';
+}
+
+PriceStream::PriceStream() {
+  client = &secureClient;
+  host[0] = '\0';
+  port = 443;
+  path[0] = '\0';
+  useTls = true;
+  memset(slots, 0, sizeof(slots));
+  slotCount = 0;
+  lock = nullptr;
+  streamTask = nullptr;
+  candles = nullptr;
+  paused = false;
+  connected = false;
+  subscribed = false;
+  lastMessageAt = 0;
+  nextAttemptAt = 0;
+  backoffMs = STREAM_BACKOFF_MIN_MS;
+  ticksTotal = 0;
+  ticksPerSecond = 0;
+  ticksThisSecond = 0;
+  secondStartedAt = 0;
+  reconnects = 0;
+  oversizedFrames = 0;
+}
+
+bool PriceStream::begin(const AssetData* assets, int count) {
+  if (strlen(STREAM_URL) == 0) {
+    Serial.println("Stream: No STREAM_URL configured - polling only");
+    return true;
+  }
+  if (!parseUrl(STREAM_URL)) {
+    Serial.printf("Stream: Invalid STREAM_URL %s\n", STREAM_URL);
+    return false;
+  }
+
+  for (int i = 0; i < count && slotCount < STREAM_MAX_SYMBOLS; i++) {
+    if (assets[i].isStock) {
+      continue;
+    }
+    Slot& slot = slots[slotCount++];
+    snprintf(slot.pair, sizeof(slot.pair), "%s/%s", assets[i].symbol, assets[i].currency);
+    slot.asset = i;
+  }
+  if (slotCount == 0) {
+    return true;
+  }
+
+  tickerFilter["channel"] = true;
+  tickerFilter["method"] = true;
+  tickerFilter["success"] = true;
+  tickerFilter["error"] = true;
+  tickerFilter["data"][0]["symbol"] = true;
+  tickerFilter["data"][0]["last"] = true;
+
+  lock = xSemaphoreCreateMutex();
+
+  // TLS needs a larger stack than the icon fetcher's plain HTTP
+  BaseType_t created = xTaskCreatePinnedToCore(streamTaskEntry, "priceStream", 8192,
+                                               this, 1, &streamTask, 0);
+  if (created != pdPASS) {
+    Serial.println("Stream: Failed to start stream task");
+    streamTask = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool PriceStream::isLive() const {
+  return connected && subscribed && millis() - lastMessageAt < STREAM_IDLE_TIMEOUT_MS;
+}
+
+bool PriceStream::covers(uint8_t asset) const {
+  for (int i = 0; i < slotCount; i++) {
+    if (slots[i].asset == asset) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int PriceStream::applyTicks(AssetData* assets, int count, int visibleAsset) {
+  if (lock == nullptr) {
+    return 0;
+  }
+
+  int updated = 0;
+  time_t now = time(nullptr);
+  xSemaphoreTake(lock, portMAX_DELAY);
+  for (int i = 0; i < slotCount; i++) {
+    Slot& slot = slots[i];
+    if (!slot.pending || slot.asset >= count) {
+      continue;
+    }
+
+    AssetData& asset = assets[slot.asset];
+    float newPrice = slot.price;
+
+    // Track price movement (only if not first update)
+    if (!asset.firstUpdate && newPrice != asset.price) {
+      asset.priceIncreased = (newPrice > asset.price);
+      asset.previousPrice = asset.price;
+    }
+    asset.price = newPrice;
+    asset.firstUpdate = false;
+    asset.fetchFailed = false;
+
+    // Ticker messages carry no timestamp; the arrival time is the source time
+    asset.sourceTime = now;
+    asset.fetchTime = now;
+    struct tm timeinfo;
+    gmtime_r(&now, &timeinfo);
+    strftime(asset.lastUpdated, sizeof(asset.lastUpdated), "%Y-%m-%dT%H:%M:%S.000Z", &timeinfo);
+
+    slot.pending = false;
+    slot.shownArrivalUs = (slot.asset == visibleAsset) ? slot.arrivalUs : 0;
+    updated++;
+  }
+  xSemaphoreGive(lock);
+  return updated;
+}
+
+uint32_t PriceStream::takeRenderLatencyUs(uint8_t asset) {
+  if (lock == nullptr) {
+    return 0;
+  }
+
+  uint32_t latency = 0;
+  xSemaphoreTake(lock, portMAX_DELAY);
+  for (int i = 0; i < slotCount; i++) {
+    if (slots[i].asset == asset && slots[i].shownArrivalUs != 0) {
+      latency = micros() - slots[i].shownArrivalUs;
+      slots[i].shownArrivalUs = 0;
+      break;
+    }
+  }
+  xSemaphoreGive(lock);
+  return latency;
+}
+
+void PriceStream::streamTaskEntry(void* param) {
+  static_cast<PriceStream*>(param)->run();
+}
+
+void PriceStream::run() {
+  uint8_t buffer[256];
+  secondStartedAt = millis();
+
+  for (;;) {
+    unsigned long now = millis();
+    if (now - secondStartedAt >= 1000) {
+      ticksPerSecond = ticksThisSecond;
+      ticksThisSecond = 0;
+      secondStartedAt = now;
+    }
+
+    if (paused) {
+      if (connected) {
+        Serial.println("Stream: Paused");
+        client->stop();
+        connected = false;
+        subscribed = false;
+      }
+      vTaskDelay(pdMS_TO_TICKS(200));
+      continue;
+    }
+
+    if (!connected) {
+      if (WiFi.status() != WL_CONNECTED || (long)(now - nextAttemptAt) < 0) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+        continue;
+      }
+      if (connectAndSubscribe()) {
+        Serial.printf("Stream: Connected to %s, %d pairs\n", host, slotCount);
+      } else {
+        client->stop();
+        scheduleRetry();
+      }
+      continue;
+    }
+
+    if (!client->connected()) {
+      disconnect("connection lost");
+      continue;
+    }
+
+    int available = client->available();
+    if (available > 0) {
+      size_t wanted = (size_t)available < sizeof(buffer) ? (size_t)available : sizeof(buffer);
+      int received = client->read(buffer, wanted);
+      if (received > 0) {
+        feed(buffer, received);
+      }
+      continue;
+    }
+
+    if (now - lastMessageAt > STREAM_IDLE_TIMEOUT_MS) {
+      disconnect("idle timeout");
+      continue;
+    }
+    vTaskDelay(pdMS_TO_TICKS(5));
+  }
+}
+
+// Accepts ws://host[:port][/path] and wss://host[:port][/path]
+bool PriceStream::parseUrl(const char* url) {
+  const char* rest;
+  if (strncmp(url, "wss://", 6) == 0) {
+    useTls = true;
+    port = 443;
+    rest = url + 6;
+  } else if (strncmp(url, "ws://", 5) == 0) {
+    useTls = false;
+    port = 80;
+    rest = url + 5;
+  } else {
+    return false;
+  }
+
+  size_t hostLength = strcspn(rest, ":/");
+  if (hostLength == 0 || hostLength >= sizeof(host)) {
+    return false;
+  }
+  memcpy(host, rest, hostLength);
+  host[hostLength] = '\0';
+  rest += hostLength;
+
+  if (*rest == ':') {
+    port = (uint16_t)strtoul(rest + 1, nullptr, 10);
+    rest += strcspn(rest, "/");
+  }
+  strlcpy(path, *rest ? rest : "/", sizeof(path));
+  client = useTls ? static_cast<Client*>(&secureClient) : static_cast<Client*>(&plainClient);
+  return port != 0;
+}
+
+bool PriceStream::connectAndSubscribe() {
+  if (useTls) {
+    secureClient.setInsecure(); // Skip SSL certificate verification (as the REST clients do)
+  }
+  if (!client->connect(host, port)) {
+    Serial.printf("Stream: Connect to %s:%u failed\n", host, port);
+    return false;
+  }
+
+  // Opening handshake
+  uint8_t keyBytes[16];
+  for (size_t i = 0; i < sizeof(keyBytes); i += 4) {
+    uint32_t value = esp_random();
+    memcpy(keyBytes + i, &value, 4);
+  }
+  char key[25];
+  base64Encode(keyBytes, sizeof(keyBytes), key);
+
+  char request[256];
+  int requestLength = snprintf(request, sizeof(request),
+                               "GET %s HTTP/1.1\r\n"
+                               "Host: %s\r\n"
+                               "Upgrade: websocket\r\n"
+                               "Connection: Upgrade\r\n"
+                               "Sec-WebSocket-Key: %s\r\n"
+                               "Sec-WebSocket-Version: 13\r\n\r\n",
+                               path, host, key);
+  client->write(reinterpret_cast<const uint8_t*>(request), requestLength);
+  if (!readHandshake()) {
+    return false;
+  }
+
+  // Fresh parser state for the new connection
+  frames.reset();
+  connected = true;
+  subscribed = false;
+  lastMessageAt = millis();
+
+  // {"method":"subscribe","params":{"channel":"ticker","symbol":["BTC/CAD",...]}}
+  StaticJsonDocument<384> doc;
+  doc["method"] = "subscribe";
+  JsonObject params = doc.createNestedObject("params");
+  params["channel"] = "ticker";
+  JsonArray symbols = params.createNestedArray("symbol");
+  for (int i = 0; i < slotCount; i++) {
+    symbols.add(slots[i].pair);
+  }
+  char subscribe[256];
+  size_t subscribeLength = serializeJson(doc, subscribe, sizeof(subscribe));
+  if (!sendFrame(WS_OPCODE_TEXT, reinterpret_cast<const uint8_t*>(subscribe), subscribeLength)) {
+    connected = false;
+    return false;
+  }
+  return true;
+}
+
+// Read the HTTP upgrade response; only "101 Switching Protocols" is accepted
+bool PriceStream::readHandshake() {
+  char line[128];
+  size_t lineLength = 0;
+  bool statusChecked = false;
+  unsigned long start = millis();
+
+  while (millis() - start < HANDSHAKE_TIMEOUT_MS) {
+    if (client->available() <= 0) {
+      if (!client->connected()) {
+        break;
+      }
+      vTaskDelay(pdMS_TO_TICKS(5));
+      continue;
+    }
+
+    char c = (char)client->read();
+    if (c == '\r') {
+      continue;
+    }
+    if (c != '\n') {
+      if (lineLength < sizeof(line) - 1) {
+        line[lineLength++] = c;
+      }
+      continue;
+    }
+
+    line[lineLength] = '\0';
+    if (!statusChecked) {
+      if (strstr(line, " 101") == nullptr) {
+        Serial.printf("Stream: Upgrade refused: %s\n", line);
+        return false;
+      }
+      statusChecked = true;
+    } else if (lineLength == 0) {
+      return true; // Blank line ends the headers
+    }
+    lineLength = 0;
+  }
+
+  Serial.println("Stream: Handshake timed out");
+  return false;
+}
+
+void PriceStream::disconnect(const char* reason) {
+  Serial.printf("Stream: Disconnected (%s)\n", reason);
+  client->stop();
+  connected = false;
+  subscribed = false;
+  scheduleRetry();
+}
+
+// Exponential backoff with up to 25% jitter so a fleet doesn't reconnect in step
+void PriceStream::scheduleRetry() {
+  reconnects++;
+  uint32_t jitter = esp_random() % (backoffMs / 4 + 1);
+  nextAttemptAt = millis() + backoffMs + jitter;
+  Serial.printf("Stream: Retrying in %lu ms (polling meanwhile)\n", (unsigned long)(backoffMs + jitter));
+  backoffMs = backoffMs * 2 > STREAM_BACKOFF_MAX_MS ? STREAM_BACKOFF_MAX_MS : backoffMs * 2;
+}
+
+// Feed received bytes through the frame parser. Frames may be split across
+// reads at any byte; only one message buffer is ever held.
+void PriceStream::feed(const uint8_t* data, size_t length) {
+  size_t i = 0;
+  while (i < length && connected) {
+    WsFrameEvent event;
+    uint32_t framesBefore = frames.getFramesTotal();
+    i += frames.feed(data + i, length - i, event);
+    if (frames.getFramesTotal() == framesBefore) {
+      break; // The rest of the frame comes with the next read
+    }
+    lastMessageAt = millis();
+
+    switch (event) {
+      case WS_EVENT_TEXT:
+        handleMessage(frames.message(), frames.messageLength());
+        break;
+      case WS_EVENT_OVERSIZED:
+        oversizedFrames++;
+        break;
+      case WS_EVENT_PING:
+        sendFrame(WS_OPCODE_PONG, frames.control(), frames.controlLength()); // Pong echoes the ping payload
+        break;
+      case WS_EVENT_CLOSE:
+        disconnect("closed by server");
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+// {"channel":"ticker","type":"update","data":[{"symbol":"BTC/CAD","last":91234.5,...}]}
+void PriceStream::handleMessage(const char* text, size_t length) {
+  StaticJsonDocument<768> doc;
+  DeserializationError error = deserializeJson(doc, text, length,
+                                               DeserializationOption::Filter(tickerFilter));
+  if (error) {
+    Serial.printf("Stream: JSON parsing error: %s\n", error.c_str());
+    return;
+  }
+
+  if (doc.containsKey("method")) {
+    // Subscribe acknowledgement
+    if (!(doc["success"] | false)) {
+      const char* reason = doc["error"] | "unknown error";
+      Serial.printf("Stream: Subscribe failed: %s\n", reason);
+    }
+    return;
+  }
+
+  const char* channel = doc["channel"] | "";
+  if (strcmp(channel, "ticker") != 0) {
+    return; // Heartbeats and status messages only keep the link alive
+  }
+
+  if (!subscribed) {
+    subscribed = true;
+    backoffMs = STREAM_BACKOFF_MIN_MS; // The feed works; reset the backoff
+  }
+
+  uint32_t arrivalUs = micros();
+  time_t arrivalTime = time(nullptr);
+  for (JsonVariant tick : doc["data"].as<JsonArray>()) {
+    const char* pair = tick["symbol"] | "";
+    float last = tick["last"] | 0.0f;
+    if (last <= 0.0f) {
+      continue;
+    }
+    for (int i = 0; i < slotCount; i++) {
+      if (strcmp(slots[i].pair, pair) == 0) {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        slots[i].price = last;
+        slots[i].arrivalUs = arrivalUs;
+        slots[i].pending = true;
+        xSemaphoreGive(lock);
+        if (candles != nullptr) {
+          candles->addSample(slots[i].asset, last, arrivalTime); // Every tick, not just applied ones
+        }
+        countTick();
+        break;
+      }
+    }
+  }
+}
+
+// Client frames are always masked (RFC 6455 section 5.3)
+bool PriceStream::sendFrame(uint8_t frameOpcode, const uint8_t* payload, size_t length) {
+  uint32_t maskKey = esp_random();
+  uint8_t mask[4];
+  memcpy(mask, &maskKey, sizeof(mask));
+  uint8_t frameHeader[8];
+  size_t frameHeaderLength = WsFrameParser::writeClientHeader(frameOpcode, length, mask, frameHeader);
+  if (frameHeaderLength == 0) {
+    return false;
+  }
+
+  if (client->write(frameHeader, frameHeaderLength) != frameHeaderLength) {
+    return false;
+  }
+
+  uint8_t chunk[64];
+  for (size_t offset = 0; offset < length; offset += sizeof(chunk)) {
+    size_t chunkLength = length - offset < sizeof(chunk) ? length - offset : sizeof(chunk);
+    for (size_t j = 0; j < chunkLength; j++) {
+      chunk[j] = payload[offset + j] ^ mask[(offset + j) & 3];
+    }
+    if (client->write(chunk, chunkLength) != chunkLength) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PriceStream::countTick() {
+  ticksTotal++;
+  ticksThisSecond++;
+}
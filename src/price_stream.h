@@ -0,0 +1,112 @@
+#ifndef PRICE_STREAM_H
+#define PRICE_STREAM_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <WiFiClientSecure.h>
+#include "config.h"
+#include "crypto_display.h"
+#include "candles.h"
+#include "ws_frame.h"
+
+// Streaming crypto prices over one WebSocket subscription to an exchange
+// ticker feed (Kraken v2 "ticker" channel, pairs named <SYMBOL>/<CURRENCY>).
+//
+// A background task owns the socket: it connects (TLS for wss://), subscribes,
+// and parses frames incrementally into a fixed buffer, keeping only the latest
+// price per pair. The main loop calls applyTicks() at the display rate, so any
+// number of ticks between two frames collapses into one AssetData update.
+// When the link drops the task reconnects with exponential backoff; until the
+// feed is live again the regular polling scheduler keeps prices fresh.
+class PriceStream {
+public:
+  PriceStream();
+
+  // Subscribe to every non-stock asset and start the stream task
+  bool begin(const AssetData* assets, int count);
+
+  // True while subscribed and a message arrived within STREAM_IDLE_TIMEOUT_MS
+  bool isLive() const;
+
+  // Feed every tick into candle aggregation (from the stream task)
+  void setCandles(CandleAggregator* aggregator) { candles = aggregator; }
+
+  // Close the feed and stay disconnected while paused (fleet display mode)
+  void setPaused(bool pause) { paused = pause; }
+
+  // True when the feed covers this asset (polling may skip it while live)
+  bool covers(uint8_t asset) const;
+
+  // Copy the latest tick per asset into AssetData (call from loop() at the
+  // display rate). visibleAsset is the asset on screen, whose applied tick is
+  // then timed until render. Returns the number of assets updated.
+  int applyTicks(AssetData* assets, int count, int visibleAsset);
+
+  // Tick-to-pixel latency for an asset that was just drawn: microseconds from
+  // arrival of the tick now on screen, or 0 if none is waiting to be measured
+  uint32_t takeRenderLatencyUs(uint8_t asset);
+
+  // Counters for metrics
+  uint32_t getTicksTotal() const { return ticksTotal; }
+  uint32_t getTicksPerSecond() const { return ticksPerSecond; }
+  uint32_t getFramesTotal() const { return frames.getFramesTotal(); }
+  uint32_t getReconnects() const { return reconnects; }
+  uint32_t getOversizedFrames() const { return oversizedFrames; }
+  TaskHandle_t getTaskHandle() const { return streamTask; }
+
+private:
+  // Latest tick for one subscribed pair
+  struct Slot {
+    char pair[16];          // e.g. "BTC/CAD"
+    uint8_t asset;          // Index into the assets array
+    float price;
+    uint32_t arrivalUs;     // micros() when the latest tick arrived
+    bool pending;           // Tick not yet applied to AssetData
+    uint32_t shownArrivalUs; // Arrival of the applied tick awaiting render (0 = none)
+  };
+
+  WiFiClientSecure secureClient;
+  WiFiClient plainClient;
+  Client* client;
+  char host[64];
+  uint16_t port;
+  char path[64];
+  bool useTls;
+
+  Slot slots[STREAM_MAX_SYMBOLS];
+  int slotCount;
+  SemaphoreHandle_t lock;
+  TaskHandle_t streamTask;
+  CandleAggregator* candles;
+
+  volatile bool paused;
+  volatile bool connected;
+  volatile bool subscribed;   // First ticker message seen on this connection
+  volatile unsigned long lastMessageAt;
+  unsigned long nextAttemptAt;
+  uint32_t backoffMs;
+
+  WsFrameParser frames;    // Only touched by the stream task
+
+  // Stats
+  volatile uint32_t ticksTotal;
+  volatile uint32_t ticksPerSecond;
+  uint32_t ticksThisSecond;
+  unsigned long secondStartedAt;
+  uint32_t reconnects;
+  uint32_t oversizedFrames;
+
+  static void streamTaskEntry(void* param);
+  void run();
+  bool parseUrl(const char* url);
+  bool connectAndSubscribe();
+  bool readHandshake();
+  void disconnect(const char* reason);
+  void scheduleRetry();
+  void feed(const uint8_t* data, size_t length);
+  void handleMessage(const char* text, size_t length);
+  bool sendFrame(uint8_t frameOpcode, const uint8_t* payload, size_t length);
+  void countTick();
+};
+
+#endif // PRICE_STREAM_H
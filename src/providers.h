@@ -0,0 +1,43 @@
+#ifndef PROVIDERS_H
+#define PROVIDERS_H
+
+// Upstream data providers (used to key per-provider metrics and state)
+enum Provider {
+  PROVIDER_CMC = 0,   // CoinMarketCap (crypto)
+  PROVIDER_FMP,       // Financial Modeling Prep (stocks)
+  PROVIDER_FX,        // Exchange rates (FX_RATES_URL)
+  PROVIDER_COUNT
+};
+
+inline const char* providerName(Provider provider) {
+  switch (provider) {
+    case PROVIDER_CMC: return "coinmarketcap";
+    case PROVIDER_FMP: return "fmp";
+    case PROVIDER_FX: return "fx";
+    default: return "unknown";
+  }
+}
+
+// Why a provider request failed (decides how soon it is retried)
+enum FetchError : uint8_t {
+  FETCH_ERROR_NONE = 0,
+  FETCH_ERROR_NETWORK,     // WiFi, DNS, connect, timeout, truncated body
+  FETCH_ERROR_SERVER,      // HTTP 5xx
+  FETCH_ERROR_RATE_LIMIT,  // HTTP 429
+  FETCH_ERROR_CLIENT,      // HTTP 401/403, bad URL: won't fix itself
+  FETCH_ERROR_RESPONSE     // Unparseable or incomplete data, other HTTP status
+};
+
+inline const char* fetchErrorName(FetchError error) {
+  switch (error) {
+    case FETCH_ERROR_NONE: return "none";
+    case FETCH_ERROR_NETWORK: return "network";
+    case FETCH_ERROR_SERVER: return "server";
+    case FETCH_ERROR_RATE_LIMIT: return "rate_limit";
+    case FETCH_ERROR_CLIENT: return "client";
+    case FETCH_ERROR_RESPONSE: return "response";
+    default: return "unknown";
+  }
+}
+
+#endif // PROVIDERS_H
@@ -0,0 +1,93 @@
+#include "retry_policy.h"
+
+RetryPolicy::RetryPolicy() {
+  memset(providers, 0, sizeof(providers));
+  changes = 0;
+}
+
+const char* RetryPolicy::stateName(BreakerState state) {
+  switch (state) {
+    case BREAKER_OPEN: return "open";
+    case BREAKER_HALF_OPEN: return "half_open";
+    default: return "closed";
+  }
+}
+
+bool RetryPolicy::allowRequest(Provider provider, unsigned long now) {
+  ProviderState& s = providers[provider];
+  if (s.state != BREAKER_OPEN) {
+    return true;
+  }
+  if (now - s.openedAt < s.openMs) {
+    return false;
+  }
+  s.state = BREAKER_HALF_OPEN;
+  changes++;
+  Serial.printf("Retry: %s breaker half-open, probing\n", providerName(provider));
+  return true;
+}
+
+unsigned long RetryPolicy::blockedForMs(Provider provider, unsigned long now) const {
+  const ProviderState& s = providers[provider];
+  if (s.state != BREAKER_OPEN || now - s.openedAt >= s.openMs) {
+    return 0;
+  }
+  return s.openMs - (now - s.openedAt);
+}
+
+void RetryPolicy::recordSuccess(Provider provider) {
+  ProviderState& s = providers[provider];
+  if (s.state != BREAKER_CLOSED) {
+    Serial.printf("Retry: %s breaker closed\n", providerName(provider));
+    changes++;
+  }
+  s.state = BREAKER_CLOSED;
+  s.failures = 0;
+  s.openMs = 0;
+  s.lastError = FETCH_ERROR_NONE;
+}
+
+unsigned long RetryPolicy::recordFailure(Provider provider, FetchError error, unsigned long now) {
+  ProviderState& s = providers[provider];
+  if (s.failures < UINT16_MAX) {
+    s.failures++;
+  }
+  s.lastError = error;
+
+  unsigned long delay = retryDelayMs(s.failures, error);
+  bool trip = s.state == BREAKER_HALF_OPEN || error == FETCH_ERROR_CLIENT ||
+              s.failures >= BREAKER_FAILURE_THRESHOLD;
+  if (trip && s.state != BREAKER_OPEN) {
+    if (s.state == BREAKER_HALF_OPEN) {
+      s.openMs = (s.openMs * 2 < BREAKER_MAX_OPEN_MS) ? s.openMs * 2 : BREAKER_MAX_OPEN_MS;
+    } else {
+      s.openMs = BREAKER_OPEN_MS;
+      s.trips++;
+    }
+    s.state = BREAKER_OPEN;
+    s.openedAt = now;
+    changes++;
+    Serial.printf("Retry: %s breaker open for %lus (%u failures, last %s)\n", providerName(provider),
+                  (unsigned long)(s.openMs / 1000), s.failures, fetchErrorName(error));
+  }
+  if (s.state == BREAKER_OPEN && delay < s.openMs) {
+    delay = s.openMs;
+  }
+  return delay;
+}
+
+unsigned long RetryPolicy::retryDelayMs(uint16_t failures, FetchError error) {
+  unsigned long delay = RETRY_BASE_MS;
+  for (uint16_t i = 1; i < failures && delay < RETRY_MAX_MS; i++) {
+    delay *= 2;
+  }
+  if (delay > RETRY_MAX_MS) {
+    delay = RETRY_MAX_MS;
+  }
+  // Equal jitter: half the backoff fixed, half random
+  delay = delay / 2 + esp_random() % (delay / 2 + 1);
+  if (error == FETCH_ERROR_RATE_LIMIT && delay < RETRY_RATE_LIMIT_MS) {
+    delay = RETRY_RATE_LIMIT_MS + esp_random() % (RETRY_BASE_MS + 1);
+  }
+  return delay;
+}
@@ -0,0 +1,62 @@
+#ifndef RETRY_POLICY_H
+#define RETRY_POLICY_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "providers.h"
+
+enum BreakerState : uint8_t {
+  BREAKER_CLOSED,     // Requests flow normally
+  BREAKER_OPEN,       // Provider is failing: no requests until the open period ends
+  BREAKER_HALF_OPEN   // Open period over: the next request is a probe
+};
+
+// Retry timing and a circuit breaker per provider. A failed request is
+// retried after an exponential backoff (RETRY_BASE_MS doubling per
+// consecutive failure, at least RETRY_RATE_LIMIT_MS after a 429) with equal
+// jitter, so devices that failed together don't retry together.
+// BREAKER_FAILURE_THRESHOLD failures in a row, or one client error
+// (401/403), open the breaker: the provider is left alone for the open
+// period, then one probe decides between closing and a doubled open period.
+class RetryPolicy {
+public:
+  RetryPolicy();
+
+  // Whether the provider may be called now (turns an expired open breaker half-open)
+  bool allowRequest(Provider provider, unsigned long now);
+
+  // Milliseconds until allowRequest() would pass (0 = now)
+  unsigned long blockedForMs(Provider provider, unsigned long now) const;
+
+  void recordSuccess(Provider provider);
+
+  // Record a failed request; returns how long to wait before retrying
+  unsigned long recordFailure(Provider provider, FetchError error, unsigned long now);
+
+  BreakerState state(Provider provider) const { return providers[provider].state; }
+  static const char* stateName(BreakerState state);
+  uint16_t consecutiveFailures(Provider provider) const { return providers[provider].failures; }
+  uint32_t tripCount(Provider provider) const { return providers[provider].trips; }
+  FetchError lastError(Provider provider) const { return providers[provider].lastError; }
+
+  // Jittered backoff after `failures` consecutive failures (also used for WiFi outages)
+  static unsigned long retryDelayMs(uint16_t failures, FetchError error);
+
+  // Bumped on every breaker state change, so publishers know when to resend
+  uint32_t changeCount() const { return changes; }
+
+private:
+  struct ProviderState {
+    BreakerState state;
+    uint16_t failures;        // Consecutive
+    uint32_t openMs;          // Current open period
+    unsigned long openedAt;
+    uint32_t trips;
+    FetchError lastError;
+  };
+
+  ProviderState providers[PROVIDER_COUNT];
+  uint32_t changes;
+};
+
+#endif // RETRY_POLICY_H
@@ -0,0 +1,145 @@
+#include "scheduler.h"
+#include <limits.h>
+
+RefreshScheduler::RefreshScheduler() {
+  assets = nullptr;
+  count = 0;
+  heapSize = 0;
+  memset(heap, 0, sizeof(heap));
+  memset(stats, 0, sizeof(stats));
+}
+
+void RefreshScheduler::begin(const AssetData* assetList, int assetCount, unsigned long now) {
+  if (assetCount > SCHEDULER_MAX_ASSETS) {
+    Serial.printf("Scheduler: %d assets, only the first %d are refreshed\n",
+                  assetCount, SCHEDULER_MAX_ASSETS);
+    assetCount = SCHEDULER_MAX_ASSETS;
+  }
+
+  assets = assetList;
+  count = assetCount;
+  heapSize = 0;
+  memset(stats, 0, sizeof(stats));
+  for (int i = 0; i < count; i++) {
+    Entry entry = {now, (uint8_t)i};
+    push(entry);
+  }
+}
+
+unsigned long RefreshScheduler::timeUntilNextDue(unsigned long now) const {
+  if (heapSize == 0) {
+    return ULONG_MAX; // Everything is checked out
+  }
+  if (!isBefore(now, heap[0].dueAt)) {
+    return 0;
+  }
+  return heap[0].dueAt - now;
+}
+
+int RefreshScheduler::takeDue(unsigned long now, uint8_t due[], int maxDue) {
+  unsigned long horizon = now + SCHEDULER_BATCH_WINDOW_MS;
+  int taken = 0;
+  while (heapSize > 0 && taken < maxDue && !isBefore(horizon, heap[0].dueAt)) {
+    Entry entry = pop();
+    stats[entry.asset].lastDueAt = entry.dueAt;
+    due[taken++] = entry.asset;
+  }
+  return taken;
+}
+
+int RefreshScheduler::upcoming(unsigned long now, unsigned long horizonMs, uint8_t assetsOut[],
+                               unsigned long dueAt[], int maxOut) const {
+  // A linear pass: the heap holds at most SCHEDULER_MAX_ASSETS entries
+  unsigned long horizon = now + horizonMs;
+  int found = 0;
+  for (int i = 0; i < heapSize && found < maxOut; i++) {
+    if (!isBefore(horizon, heap[i].dueAt)) {
+      assetsOut[found] = heap[i].asset;
+      dueAt[found++] = heap[i].dueAt;
+    }
+  }
+  return found;
+}
+
+unsigned long RefreshScheduler::lastDueAt(uint8_t asset) const {
+  return asset < count ? stats[asset].lastDueAt : 0;
+}
+
+void RefreshScheduler::schedule(uint8_t asset, unsigned long now, unsigned long delayMs) {
+  if (asset >= count) {
+    return;
+  }
+  Entry entry = {now + delayMs, asset};
+  push(entry);
+}
+
+void RefreshScheduler::recordRefresh(uint8_t asset, unsigned long now) {
+  if (asset >= count) {
+    return;
+  }
+
+  AssetStats& assetStats = stats[asset];
+  if (assetStats.refreshes > 0) {
+    // Exponential moving average (1/8 weight) of the gap between refreshes
+    uint32_t interval = now - assetStats.lastRefresh;
+    if (assetStats.achievedMs == 0) {
+      assetStats.achievedMs = interval;
+    } else {
+      assetStats.achievedMs += ((int32_t)interval - (int32_t)assetStats.achievedMs) / 8;
+    }
+  }
+  assetStats.lastRefresh = now;
+  assetStats.refreshes++;
+}
+
+uint32_t RefreshScheduler::achievedIntervalMs(uint8_t asset) const {
+  return asset < count ? stats[asset].achievedMs : 0;
+}
+
+uint32_t RefreshScheduler::refreshCount(uint8_t asset) const {
+  return asset < count ? stats[asset].refreshes : 0;
+}
+
+void RefreshScheduler::push(const Entry& entry) {
+  if (heapSize >= SCHEDULER_MAX_ASSETS) {
+    return;
+  }
+
+  // Sift up
+  int index = heapSize++;
+  while (index > 0) {
+    int parent = (index - 1) / 2;
+    if (!isBefore(entry.dueAt, heap[parent].dueAt)) {
+      break;
+    }
+    heap[index] = heap[parent];
+    index = parent;
+  }
+  heap[index] = entry;
+}
+
+RefreshScheduler::Entry RefreshScheduler::pop() {
+  Entry top = heap[0];
+  Entry last = heap[--heapSize];
+
+  // Sift the last entry down from the root
+  int index = 0;
+  while (true) {
+    int child = index * 2 + 1;
+    if (child >= heapSize) {
+      break;
+    }
+    if (child + 1 < heapSize && isBefore(heap[child + 1].dueAt, heap[child].dueAt)) {
+      child++;
+    }
+    if (!isBefore(heap[child].dueAt, last.dueAt)) {
+      break;
+    }
+    heap[index] = heap[child];
+    index = child;
+  }
+  if (heapSize > 0) {
+    heap[index] = last;
+  }
+  return top;
+}
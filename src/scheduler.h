@@ -0,0 +1,75 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "crypto_display.h"
+
+// Per-asset refresh deadlines kept in a binary min-heap keyed on the next
+// due time (millis). Each asset has its own cadence (AssetData::refreshIntervalMs);
+// assets falling due within SCHEDULER_BATCH_WINDOW_MS of each other are handed
+// out together so they can share one provider request.
+//
+// An asset is either in the heap or checked out by takeDue() until the
+// caller puts it back with schedule().
+class RefreshScheduler {
+public:
+  RefreshScheduler();
+
+  // Track these assets, all due immediately
+  void begin(const AssetData* assets, int count, unsigned long now);
+
+  // Milliseconds until the earliest deadline (0 = something is due)
+  unsigned long timeUntilNextDue(unsigned long now) const;
+
+  // Check out every asset due by now + SCHEDULER_BATCH_WINDOW_MS; returns
+  // the number of asset indices written to due[]
+  int takeDue(unsigned long now, uint8_t due[], int maxDue);
+
+  // Put an asset back, due delayMs from now
+  void schedule(uint8_t asset, unsigned long now, unsigned long delayMs);
+  
+  // Assets due within horizonMs (not yet checked out), in no particular
+  // order, with their deadlines; for preparing the next fetch
+  int upcoming(unsigned long now, unsigned long horizonMs, uint8_t assetsOut[], unsigned long dueAt[],
+               int maxOut) const;
+  
+  // Deadline the asset had when takeDue() last handed it out
+  unsigned long lastDueAt(uint8_t asset) const;
+
+  // Note a successful refresh (feeds the achieved-interval average)
+  void recordRefresh(uint8_t asset, unsigned long now);
+
+  // Achieved versus target cadence, for metrics
+  int assetCount() const { return count; }
+  const AssetData& asset(uint8_t index) const { return assets[index]; }
+  uint32_t achievedIntervalMs(uint8_t asset) const; // Smoothed, 0 until two refreshes
+  uint32_t refreshCount(uint8_t asset) const;
+
+private:
+  struct Entry {
+    unsigned long dueAt;
+    uint8_t asset;
+  };
+
+  struct AssetStats {
+    unsigned long lastRefresh;
+    unsigned long lastDueAt;
+    uint32_t achievedMs;
+    uint32_t refreshes;
+  };
+
+  const AssetData* assets;
+  int count;
+  Entry heap[SCHEDULER_MAX_ASSETS];
+  int heapSize;
+  AssetStats stats[SCHEDULER_MAX_ASSETS];
+
+  // Wrap-safe millis() comparison
+  static bool isBefore(unsigned long a, unsigned long b) { return (long)(a - b) < 0; }
+
+  void push(const Entry& entry);
+  Entry pop();
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,297 @@
+#include "ticker_view.h"
+#include "icons.h"
+#include "mem_alloc.h"
+
+// Every character a symbol or price can show
+static const char* TICKER_CHARSET = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789,.$-";
+
+// Strip geometry: inside the double frame line
+static const int STRIP_X = FRAME_MARGIN + 2;
+static const int STRIP_WIDTH = SCREEN_WIDTH - (FRAME_MARGIN + 2) * 2;
+static const int ICON_PIXELS = ICON_SIZE * ICON_SIZE;
+
+// Gaps inside one asset
+static const int SYMBOL_PRICE_GAP = 10;
+static const int PRICE_ARROW_GAP = 6;
+
+TickerView::TickerView(DisplaySurface& target)
+  : surface(target),
+    surfaceLock(nullptr),
+    itemLock(nullptr),
+    renderTask(nullptr),
+    running(false),
+    itemCount(0),
+    totalWidth(0),
+    offset(0),
+    icons(nullptr),
+    strip(nullptr),
+    frames(0),
+    lateFrames(0),
+    lastFrameAt(0) {
+  for (int i = 0; i < TICKER_MAX_ASSETS; i++) {
+    items[i].priceColor = COLOR_PRICE;
+    items[i].direction = 0;
+    items[i].hasIcon = false;
+    items[i].width = 0;
+  }
+  memset(frameUs, 0, sizeof(frameUs));
+}
+
+TickerView::~TickerView() {
+  memFree(icons);
+  memFree(strip);
+}
+
+bool TickerView::begin(SemaphoreHandle_t lock) {
+  surfaceLock = lock;
+  itemLock = xSemaphoreCreateMutex();
+
+  // Same core as loop() and one priority above it: frames preempt the loop
+  // (which mostly waits on the network) instead of queueing behind it
+  BaseType_t created = xTaskCreatePinnedToCore(renderTaskEntry, "ticker", 4096,
+                                               this, 2, &renderTask, 1);
+  if (created != pdPASS) {
+    Serial.println("Ticker: Failed to start render task");
+    renderTask = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool TickerView::prepare() {
+  if (strip != nullptr) {
+    return true;
+  }
+  // Font 2 at size 2, like the single view's prices, whatever was drawn last
+  surface.setTextFont(2);
+  surface.setTextSize(2);
+  if (!atlas.build(surface, TICKER_CHARSET)) {
+    return false;
+  }
+  if (atlas.height() > TICKER_HEIGHT) {
+    Serial.printf("Ticker: font is %d px, taller than the %d px strip\n", atlas.height(), TICKER_HEIGHT);
+    return false;
+  }
+  // The strip goes straight to SPI; icons are only read by the CPU
+  icons = (uint16_t*)memAlloc((size_t)TICKER_MAX_ASSETS * ICON_PIXELS * sizeof(uint16_t), MEM_BULK);
+  strip = (uint16_t*)memAlloc((size_t)STRIP_WIDTH * TICKER_HEIGHT * sizeof(uint16_t), MEM_DMA);
+  if (icons == nullptr || strip == nullptr) {
+    memFree(icons);
+    memFree(strip);
+    icons = nullptr;
+    strip = nullptr;
+    return false;
+  }
+  for (int i = 0; i < itemCount; i++) {
+    layout(i); // Items set before the atlas existed had no width
+  }
+  return true;
+}
+
+bool TickerView::start() {
+  if (renderTask == nullptr || !prepare()) {
+    return false;
+  }
+  lastFrameAt = 0; // The time spent stopped isn't a late frame
+  running = true;
+  xTaskNotifyGive(renderTask);
+  return true;
+}
+
+void TickerView::stop() {
+  if (!running) {
+    return;
+  }
+  running = false;
+  Serial.printf("Ticker: %lu frames, %lu late, frame time p50 %lu us, p95 %lu us, p99 %lu us\n",
+                (unsigned long)frames, (unsigned long)lateFrames,
+                (unsigned long)frameTimePercentile(50), (unsigned long)frameTimePercentile(95),
+                (unsigned long)frameTimePercentile(99));
+}
+
+void TickerView::setItem(int index, const char* symbol, const char* price, uint16_t priceColor, int8_t direction) {
+  if (index >= TICKER_MAX_ASSETS) {
+    return;
+  }
+  Item& item = items[index];
+  if (item.symbol == symbol && item.price == price && item.priceColor == priceColor &&
+      item.direction == direction) {
+    return;
+  }
+  xSemaphoreTake(itemLock, portMAX_DELAY);
+  item.symbol = symbol;
+  item.price = price;
+  item.priceColor = priceColor;
+  item.direction = direction;
+  layout(index);
+  xSemaphoreGive(itemLock);
+}
+
+void TickerView::setItemCount(int count) {
+  if (count > TICKER_MAX_ASSETS) {
+    count = TICKER_MAX_ASSETS;
+  }
+  if (count == itemCount) {
+    return;
+  }
+  xSemaphoreTake(itemLock, portMAX_DELAY);
+  itemCount = count;
+  totalWidth = 0;
+  for (int i = 0; i < itemCount; i++) {
+    totalWidth += items[i].width;
+  }
+  offset = totalWidth > 0 ? offset % totalWidth : 0;
+  xSemaphoreGive(itemLock);
+}
+
+void TickerView::setIcon(int index, const uint16_t* pixels) {
+  if (index >= TICKER_MAX_ASSETS || icons == nullptr || pixels == nullptr) {
+    return;
+  }
+  xSemaphoreTake(itemLock, portMAX_DELAY);
+  memcpy(icons + index * ICON_PIXELS, pixels, ICON_PIXELS * sizeof(uint16_t));
+  items[index].hasIcon = true;
+  xSemaphoreGive(itemLock);
+}
+
+// Width of one asset on the tape (caller holds itemLock). The arrow slot is
+// always reserved so a direction change doesn't shift the tape.
+void TickerView::layout(int index) {
+  Item& item = items[index];
+  int oldWidth = item.width;
+  item.width = 0;
+  if (atlas.ready()) {
+    item.width = ICON_SIZE + ICON_TEXT_GAP + atlas.textWidth(item.symbol.c_str()) + SYMBOL_PRICE_GAP +
+                 atlas.textWidth(item.price.c_str()) + PRICE_ARROW_GAP + ARROW_WIDTH + TICKER_ITEM_GAP;
+  }
+  if (index < itemCount) {
+    totalWidth += item.width - oldWidth;
+    offset = totalWidth > 0 ? offset % totalWidth : 0;
+  }
+}
+
+void TickerView::renderFrame() {
+  unsigned long started = micros();
+  if (lastFrameAt != 0 && started - lastFrameAt > TICKER_FRAME_MS * 1500UL) {
+    lateFrames++;
+  }
+  lastFrameAt = started;
+
+  xSemaphoreTake(itemLock, portMAX_DELAY);
+  compose();
+  if (totalWidth > 0) {
+    offset = (offset + TICKER_STEP_PX) % totalWidth;
+  }
+  xSemaphoreGive(itemLock);
+
+  // Checked under the lock: a screen change may have stopped us meanwhile
+  xSemaphoreTake(surfaceLock, portMAX_DELAY);
+  if (running) {
+    surface.pushImage(STRIP_X, TICKER_Y_POS, STRIP_WIDTH, TICKER_HEIGHT, strip);
+  }
+  xSemaphoreGive(surfaceLock);
+
+  unsigned long elapsed = micros() - started;
+  frameUs[frames % TICKER_FRAME_SAMPLES] = elapsed > UINT16_MAX ? UINT16_MAX : (uint16_t)elapsed;
+  frames++;
+}
+
+// Whole strip from the tape at the current offset (caller holds itemLock)
+void TickerView::compose() {
+  for (int i = 0; i < STRIP_WIDTH * TICKER_HEIGHT; i++) {
+    strip[i] = COLOR_BACKGROUND;
+  }
+  if (totalWidth <= 0) {
+    return;
+  }
+  // The tape repeats, so a short one fills the strip several times
+  int x = -offset;
+  for (int i = 0; x < STRIP_WIDTH; i = (i + 1) % itemCount) {
+    if (x + items[i].width > 0) {
+      drawItem(items[i], i, x);
+    }
+    x += items[i].width;
+  }
+}
+
+void TickerView::drawItem(const Item& item, int index, int x) {
+  int iconY = (TICKER_HEIGHT - ICON_SIZE) / 2;
+  if (item.hasIcon) {
+    blitImage(icons + index * ICON_PIXELS, ICON_SIZE, ICON_SIZE, x, iconY);
+  } else {
+    // Placeholder disc until a downloaded icon lands
+    fillDisc(x + ICON_SIZE / 2, iconY + ICON_SIZE / 2, ICON_SIZE / 2 - 1, COLOR_FRAME);
+  }
+  x += ICON_SIZE + ICON_TEXT_GAP;
+
+  int textY = (TICKER_HEIGHT - atlas.height()) / 2;
+  x += atlas.drawText(strip, STRIP_WIDTH, TICKER_HEIGHT, item.symbol.c_str(), x, textY,
+                      COLOR_TEXT, COLOR_BACKGROUND);
+  x += SYMBOL_PRICE_GAP;
+  x += atlas.drawText(strip, STRIP_WIDTH, TICKER_HEIGHT, item.price.c_str(), x, textY,
+                      item.priceColor, COLOR_BACKGROUND);
+  x += PRICE_ARROW_GAP;
+
+  if (item.direction != 0) {
+    blitImage(item.direction > 0 ? up_arrow : down_arrow, ARROW_WIDTH, ARROW_HEIGHT,
+              x, (TICKER_HEIGHT - ARROW_HEIGHT) / 2);
+  }
+}
+
+void TickerView::blitImage(const uint16_t* pixels, int w, int h, int x, int y) {
+  int left = x < 0 ? -x : 0;
+  int right = x + w > STRIP_WIDTH ? STRIP_WIDTH - x : w;
+  if (left >= right) {
+    return;
+  }
+  for (int row = 0; row < h; row++) {
+    memcpy(strip + (y + row) * STRIP_WIDTH + x + left, pixels + row * w + left,
+           (right - left) * sizeof(uint16_t));
+  }
+}
+
+void TickerView::fillDisc(int cx, int cy, int r, uint16_t color) {
+  for (int dy = -r; dy <= r; dy++) {
+    for (int dx = -r; dx <= r; dx++) {
+      int px = cx + dx;
+      if (dx * dx + dy * dy <= r * r && px >= 0 && px < STRIP_WIDTH) {
+        strip[(cy + dy) * STRIP_WIDTH + px] = color;
+      }
+    }
+  }
+}
+
+uint32_t TickerView::frameTimePercentile(int percent) const {
+  uint32_t count = frames < TICKER_FRAME_SAMPLES ? frames : TICKER_FRAME_SAMPLES;
+  if (count == 0) {
+    return 0;
+  }
+  uint16_t sorted[TICKER_FRAME_SAMPLES];
+  memcpy(sorted, frameUs, count * sizeof(uint16_t));
+  // Insertion sort: at most TICKER_FRAME_SAMPLES entries, no allocation
+  for (uint32_t i = 1; i < count; i++) {
+    uint16_t value = sorted[i];
+    uint32_t j = i;
+    for (; j > 0 && sorted[j - 1] > value; j--) {
+      sorted[j] = sorted[j - 1];
+    }
+    sorted[j] = value;
+  }
+  uint32_t rank = (count * percent + 99) / 100; // Nearest rank
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void TickerView::renderTaskEntry(void* param) {
+  TickerView* self = static_cast<TickerView*>(param);
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;) {
+    if (!self->running) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // Until start()
+      lastWake = xTaskGetTickCount();
+      continue;
+    }
+    // Fixed cadence: a slow frame shortens the next wait instead of adding up
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(TICKER_FRAME_MS));
+    self->renderFrame();
+  }
+}
@@ -0,0 +1,89 @@
+#ifndef TICKER_VIEW_H
+#define TICKER_VIEW_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "display_surface.h"
+#include "glyph_atlas.h"
+#include "fixed_string.h"
+
+// Every asset on one continuously scrolling strip: icon, symbol, price, arrow.
+//
+// Each frame is composed off-screen into a MEM_DMA RGB565 strip from copied
+// icons, glyph atlas masks and the arrow bitmaps, then sent with a single
+// pushImage(). A render task on the loop's core pushes frames every
+// TICKER_FRAME_MS at a higher priority than loop(), so blocking fetches don't
+// stall the scroll and rendering never delays button handling. The main loop
+// only hands over changed prices. Everything that draws on the surface holds
+// the shared surface lock.
+class TickerView {
+public:
+  explicit TickerView(DisplaySurface& target);
+  ~TickerView();
+
+  // Create the (idle) render task. The atlas and strip are built on first start().
+  bool begin(SemaphoreHandle_t surfaceLock);
+
+  // Callers hold the surface lock: once stop() returns, no frame is pushed
+  // until the next start(). start() builds the strip on first use and
+  // returns false when there isn't memory for it.
+  bool start();
+  void stop();
+  bool isRunning() const { return running; }
+
+  // Slot contents, from the main loop. Cheap when nothing changed.
+  // direction: 1 up, -1 down, 0 no arrow.
+  void setItem(int index, const char* symbol, const char* price, uint16_t priceColor, int8_t direction);
+  void setItemCount(int count);
+  void setIcon(int index, const uint16_t* pixels); // ICON_SIZE square, copied
+  bool hasIcon(int index) const { return index < TICKER_MAX_ASSETS && items[index].hasIcon; }
+
+  // Compose and push one frame and advance the scroll (the render task's body)
+  void renderFrame();
+
+  // Frame statistics
+  uint32_t frameCount() const { return frames; }
+  uint32_t lateFrameCount() const { return lateFrames; }    // Started over 1.5 periods after the last
+  uint32_t frameTimePercentile(int percent) const;          // Compose + push, over recent frames (us)
+  TaskHandle_t getTaskHandle() const { return renderTask; }
+
+private:
+  struct Item {
+    FixedString<12> symbol;
+    FixedString<24> price;
+    uint16_t priceColor;
+    int8_t direction;
+    bool hasIcon;
+    int width;
+  };
+
+  DisplaySurface& surface;
+  GlyphAtlas atlas;
+  SemaphoreHandle_t surfaceLock;
+  SemaphoreHandle_t itemLock;
+  TaskHandle_t renderTask;
+  volatile bool running;
+
+  Item items[TICKER_MAX_ASSETS];
+  int itemCount;
+  int totalWidth;
+  int offset;             // Scroll position into the tape
+  uint16_t* icons;        // TICKER_MAX_ASSETS icons (MEM_BULK)
+  uint16_t* strip;        // Frame being composed (MEM_DMA)
+
+  uint16_t frameUs[TICKER_FRAME_SAMPLES];
+  uint32_t frames;
+  uint32_t lateFrames;
+  unsigned long lastFrameAt;
+
+  bool prepare();
+  void layout(int index);
+  void compose();
+  void drawItem(const Item& item, int index, int x);
+  void blitImage(const uint16_t* pixels, int w, int h, int x, int y);
+  void fillDisc(int cx, int cy, int r, uint16_t color);
+
+  static void renderTaskEntry(void* param);
+};
+
+#endif // TICKER_VIEW_H
@@ -0,0 +1,35 @@
+#include "time_utils.h"
+#include <stdio.h>
+
+int32_t daysFromCivil(int year, int month, int day) {
+  // Howard Hinnant's algorithm: shift the year to start in March
+  year -= month <= 2;
+  const int32_t era = (year >= 0 ? year : year - 399) / 400;
+  const int32_t yearOfEra = year - era * 400;
+  const int32_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const int32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + dayOfEra - 719468;
+}
+
+time_t makeUtcTime(int year, int month, int day, int hour, int minute, int second) {
+  return (time_t)daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+time_t parseIso8601(const char* text) {
+  if (text == nullptr) {
+    return 0;
+  }
+
+  int year, month, day, hour, minute, second;
+  if (sscanf(text, "%4d-%2d-%2dT%2d:%2d:%2d", &year, &month, &day, &hour, &minute, &second) != 6) {
+    return 0;
+  }
+  if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+    return 0;
+  }
+  return makeUtcTime(year, month, day, hour, minute, second);
+}
+
+bool isClockSynced(time_t now) {
+  return now > 1577836800; // 2020-01-01T00:00:00Z
+}
@@ -0,0 +1,19 @@
+#ifndef TIME_UTILS_H
+#define TIME_UTILS_H
+
+#include <time.h>
+#include <stdint.h>
+
+// Days since 1970-01-01 for a proleptic Gregorian date (month 1-12)
+int32_t daysFromCivil(int year, int month, int day);
+
+// UTC broken-down time to epoch seconds (timegm replacement)
+time_t makeUtcTime(int year, int month, int day, int hour, int minute, int second);
+
+// Parse "YYYY-MM-DDTHH:MM:SS[.fff]Z" to epoch seconds; returns 0 if malformed
+time_t parseIso8601(const char* text);
+
+// True once NTP has set the clock (anything before 2020 is the boot default)
+bool isClockSynced(time_t now);
+
+#endif // TIME_UTILS_H
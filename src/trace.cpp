@@ -0,0 +1,70 @@
+#include "trace.h"
+
+TraceRecorder trace;
+
+TraceRecorder::TraceRecorder() {
+  memset(events, 0, sizeof(events));
+  head = 0;
+  count = 0;
+}
+
+void TraceRecorder::writeBinary(Print& out) const {
+  uint8_t header[HEADER_SIZE];
+  writeHeader(header);
+  out.write(header, sizeof(header));
+
+  for (uint16_t i = 0; i < count; i++) {
+    out.write(reinterpret_cast<const uint8_t*>(&eventAt(i)), sizeof(TraceEvent));
+  }
+}
+
+void TraceRecorder::writeHex(Print& out) const {
+  out.println("--- TRACE BEGIN ---");
+
+  uint8_t header[HEADER_SIZE];
+  writeHeader(header);
+  for (size_t i = 0; i < sizeof(header); i++) {
+    out.printf("%02x", header[i]);
+  }
+  out.println();
+
+  // One event per line keeps the capture readable and robust to dropped lines
+  for (uint16_t i = 0; i < count; i++) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&eventAt(i));
+    for (size_t j = 0; j < sizeof(TraceEvent); j++) {
+      out.printf("%02x", bytes[j]);
+    }
+    out.println();
+  }
+
+  out.println("--- TRACE END ---");
+}
+
+void TraceRecorder::clear() {
+  head = 0;
+  count = 0;
+}
+
+void TraceRecorder::writeHeader(uint8_t* header) const {
+  header[0] = 'M';
+  header[1] = '5';
+  header[2] = 'T';
+  header[3] = 'R';
+  header[4] = FORMAT_VERSION;
+  header[5] = TRACE_PHASE_COUNT;
+  header[6] = count & 0xFF;
+  header[7] = count >> 8;
+}
+
+const TraceEvent& TraceRecorder::eventAt(uint16_t index) const {
+  uint16_t oldest = (head + TRACE_BUFFER_EVENTS - count) % TRACE_BUFFER_EVENTS;
+  return events[(oldest + index) % TRACE_BUFFER_EVENTS];
+}
+
+TraceScope::TraceScope(TracePhase phase, uint8_t arg) : phase(phase), arg(arg) {
+  trace.begin(phase, arg);
+}
+
+TraceScope::~TraceScope() {
+  trace.end(phase, arg);
+}
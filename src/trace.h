@@ -0,0 +1,95 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Phases of an update cycle. Keep in sync with PHASE_NAMES in tools/trace_to_chrome.py
+enum TracePhase : uint8_t {
+  TRACE_UPDATE = 0,        // Whole fetch/update cycle
+  TRACE_WIFI_RECONNECT,
+  TRACE_DNS,
+  TRACE_TLS,
+  TRACE_HTTP_WAIT,         // Request sent until response headers received
+  TRACE_BODY_READ,
+  TRACE_PARSE,
+  TRACE_MQTT_PUBLISH,
+  TRACE_RENDER,
+  TRACE_PHASE_COUNT
+};
+
+// Value for TraceEvent::arg when an event has no argument
+#define TRACE_NO_ARG 0xFF
+
+// One begin or end mark (8 bytes, little-endian on the wire)
+struct TraceEvent {
+  uint32_t timestampUs;  // micros() at the mark (wraps every ~71 minutes)
+  uint8_t phase;         // TracePhase
+  uint8_t isEnd;         // 0 = begin, 1 = end
+  uint8_t arg;           // Phase argument, e.g. Provider for network phases
+  uint8_t reserved;
+};
+
+// Fixed RAM ring buffer of trace marks. Recording is a micros() call and an
+// 8-byte store, cheap enough to leave compiled in. The oldest events are
+// overwritten when the buffer is full. Only the main loop task records.
+//
+// Dump format: 8-byte header {'M','5','T','R', version, phaseCount, count (u16 LE)}
+// followed by `count` TraceEvents, oldest first.
+class TraceRecorder {
+public:
+  TraceRecorder();
+
+  void begin(TracePhase phase, uint8_t arg = TRACE_NO_ARG) { record(phase, 0, arg); }
+  void end(TracePhase phase, uint8_t arg = TRACE_NO_ARG) { record(phase, 1, arg); }
+
+  // Number of events currently stored and size of a binary dump
+  uint16_t size() const { return count; }
+  size_t dumpSize() const { return HEADER_SIZE + count * sizeof(TraceEvent); }
+
+  // Write the binary dump (e.g. to an MQTT stream)
+  void writeBinary(Print& out) const;
+
+  // Write the dump as hex lines between markers, for capture from a serial log
+  void writeHex(Print& out) const;
+
+  void clear();
+
+private:
+  static constexpr uint8_t FORMAT_VERSION = 1;
+  static constexpr size_t HEADER_SIZE = 8;
+
+  TraceEvent events[TRACE_BUFFER_EVENTS];
+  uint16_t head;   // Next slot to write
+  uint16_t count;
+
+  void record(TracePhase phase, uint8_t isEnd, uint8_t arg) {
+    TraceEvent& event = events[head];
+    event.timestampUs = micros();
+    event.phase = phase;
+    event.isEnd = isEnd;
+    event.arg = arg;
+    head = (head + 1) % TRACE_BUFFER_EVENTS;
+    if (count < TRACE_BUFFER_EVENTS) {
+      count++;
+    }
+  }
+
+  void writeHeader(uint8_t* header) const;
+  const TraceEvent& eventAt(uint16_t index) const; // 0 = oldest
+};
+
+// Marks begin on construction and end when leaving scope
+class TraceScope {
+public:
+  TraceScope(TracePhase phase, uint8_t arg = TRACE_NO_ARG);
+  ~TraceScope();
+
+private:
+  TracePhase phase;
+  uint8_t arg;
+};
+
+extern TraceRecorder trace;
+
+#endif // TRACE_H
@@ -0,0 +1,151 @@
+#include "ws_frame.h"
+
+WsFrameParser::WsFrameParser() {
+  framesTotal = 0;
+  reset();
+}
+
+void WsFrameParser::reset() {
+  state = STATE_HEADER;
+  headerLength = 0;
+  headerNeeded = 2;
+  opcode = 0;
+  messageOpcode = 0;
+  finalFragment = false;
+  masked = false;
+  payloadRemaining = 0;
+  payloadOffset = 0;
+  text[0] = '\0';
+  textLength = 0;
+  textOverflow = false;
+  messageDone = true;
+  controlCount = 0;
+}
+
+size_t WsFrameParser::feed(const uint8_t* data, size_t length, WsFrameEvent& event) {
+  event = WS_EVENT_NONE;
+  size_t i = 0;
+  while (i < length) {
+    if (state == STATE_HEADER) {
+      header[headerLength++] = data[i++];
+      if (headerLength == 2) {
+        // Now the full header size is known: extended length and mask key
+        uint8_t length7 = header[1] & 0x7F;
+        masked = (header[1] & 0x80) != 0;
+        headerNeeded = 2 + (length7 == 126 ? 2 : length7 == 127 ? 8 : 0) + (masked ? 4 : 0);
+      }
+      if (headerLength == headerNeeded) {
+        beginPayload();
+        if (payloadRemaining == 0) {
+          event = finishFrame();
+          return i;
+        }
+      }
+      continue;
+    }
+
+    // Payload bytes: copy as many as this chunk holds
+    size_t chunk = length - i;
+    if (chunk > payloadRemaining) {
+      chunk = (size_t)payloadRemaining;
+    }
+    const uint8_t* mask = header + headerNeeded - 4;
+    bool isControl = (opcode & 0x08) != 0;
+    for (size_t j = 0; j < chunk; j++) {
+      uint8_t value = data[i + j];
+      if (masked) {
+        value ^= mask[(payloadOffset + j) & 3];
+      }
+      if (isControl) {
+        if (controlCount < sizeof(controlData)) {
+          controlData[controlCount++] = value;
+        }
+      } else if (textLength < sizeof(text) - 1) {
+        text[textLength++] = (char)value;
+      } else {
+        textOverflow = true;
+      }
+    }
+    i += chunk;
+    payloadOffset += chunk;
+    payloadRemaining -= chunk;
+    if (payloadRemaining == 0) {
+      event = finishFrame();
+      return i;
+    }
+  }
+  return i;
+}
+
+void WsFrameParser::beginPayload() {
+  opcode = header[0] & 0x0F;
+  finalFragment = (header[0] & 0x80) != 0;
+
+  uint8_t length7 = header[1] & 0x7F;
+  if (length7 == 126) {
+    payloadRemaining = ((uint64_t)header[2] << 8) | header[3];
+  } else if (length7 == 127) {
+    payloadRemaining = 0;
+    for (int i = 0; i < 8; i++) {
+      payloadRemaining = (payloadRemaining << 8) | header[2 + i];
+    }
+  } else {
+    payloadRemaining = length7;
+  }
+  payloadOffset = 0;
+
+  if (opcode & 0x08) {
+    controlCount = 0;
+  } else if (opcode != WS_OPCODE_CONTINUATION || messageDone) {
+    // First fragment of a new message (a continuation with none open is dropped)
+    messageOpcode = opcode;
+    textLength = 0;
+    textOverflow = false;
+    messageDone = false;
+  }
+  state = STATE_PAYLOAD;
+}
+
+WsFrameEvent WsFrameParser::finishFrame() {
+  framesTotal++;
+  state = STATE_HEADER;
+  headerLength = 0;
+  headerNeeded = 2;
+
+  if (opcode == WS_OPCODE_CLOSE) {
+    return WS_EVENT_CLOSE;
+  }
+  if (opcode == WS_OPCODE_PING) {
+    return WS_EVENT_PING;
+  }
+  if (opcode == WS_OPCODE_PONG) {
+    return WS_EVENT_PONG;
+  }
+  if ((opcode & 0x08) || !finalFragment) {
+    return WS_EVENT_NONE; // Reserved control opcode, or more fragments to come
+  }
+
+  messageDone = true;
+  text[textLength] = '\0';
+  if (messageOpcode != WS_OPCODE_TEXT) {
+    return WS_EVENT_NONE; // Binary messages aren't used by the feed
+  }
+  return textOverflow ? WS_EVENT_OVERSIZED : WS_EVENT_TEXT;
+}
+
+size_t WsFrameParser::writeClientHeader(uint8_t frameOpcode, size_t length, const uint8_t mask[4], uint8_t* out) {
+  if (length > 0xFFFF) {
+    return 0;
+  }
+  size_t headerSize = 0;
+  out[headerSize++] = 0x80 | frameOpcode;
+  if (length < 126) {
+    out[headerSize++] = 0x80 | length;
+  } else {
+    out[headerSize++] = 0x80 | 126;
+    out[headerSize++] = length >> 8;
+    out[headerSize++] = length & 0xFF;
+  }
+  memcpy(out + headerSize, mask, 4);
+  return headerSize + 4;
+}
@@ -0,0 +1,83 @@
+#ifndef WS_FRAME_H
+#define WS_FRAME_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// WebSocket opcodes (RFC 6455)
+#define WS_OPCODE_CONTINUATION 0x0
+#define WS_OPCODE_TEXT 0x1
+#define WS_OPCODE_BINARY 0x2
+#define WS_OPCODE_CLOSE 0x8
+#define WS_OPCODE_PING 0x9
+#define WS_OPCODE_PONG 0xA
+
+// What a completed frame means for the connection
+enum WsFrameEvent : uint8_t {
+  WS_EVENT_NONE,       // Frame not complete yet, or a fragment/binary message
+  WS_EVENT_TEXT,       // A whole text message is in message()
+  WS_EVENT_OVERSIZED,  // A text message longer than STREAM_FRAME_BUFFER was dropped
+  WS_EVENT_PING,       // Ping; control() holds the payload to echo in a pong
+  WS_EVENT_PONG,
+  WS_EVENT_CLOSE
+};
+
+// Incremental parser for server-to-client WebSocket frames. Bytes are fed as
+// they come off the socket, split at any point; a frame's payload is
+// unmasked into one fixed message buffer (fragments are joined), so no
+// allocation happens however large or chopped up the traffic is.
+class WsFrameParser {
+public:
+  WsFrameParser();
+
+  // Fresh state for a new connection
+  void reset();
+
+  // Consume bytes up to the end of the next complete frame and return how
+  // many were taken. event says what that frame was, or WS_EVENT_NONE when
+  // the bytes ran out first; call again with the rest.
+  size_t feed(const uint8_t* data, size_t length, WsFrameEvent& event);
+
+  // The last text message (NUL-terminated), valid until the next feed()
+  const char* message() const { return text; }
+  size_t messageLength() const { return textLength; }
+
+  // The last control frame's payload (at most 125 bytes)
+  const uint8_t* control() const { return controlData; }
+  size_t controlLength() const { return controlCount; }
+
+  uint32_t getFramesTotal() const { return framesTotal; }
+
+  // Header for a masked client frame (RFC 6455 section 5.3); out needs 8
+  // bytes. Returns the header length, or 0 for payloads over 64KB.
+  static size_t writeClientHeader(uint8_t frameOpcode, size_t length, const uint8_t mask[4], uint8_t* out);
+
+private:
+  enum State : uint8_t {
+    STATE_HEADER,   // Collecting the 2-14 header bytes
+    STATE_PAYLOAD
+  };
+
+  State state;
+  uint8_t header[14];     // Base header, extended length and mask key
+  uint8_t headerLength;
+  uint8_t headerNeeded;
+  uint8_t opcode;
+  uint8_t messageOpcode;  // Opcode of the first fragment of the current message
+  bool finalFragment;
+  bool masked;
+  uint64_t payloadRemaining;
+  uint64_t payloadOffset;
+  char text[STREAM_FRAME_BUFFER];
+  size_t textLength;
+  bool textOverflow;
+  bool messageDone;       // The last data frame was final; the next one starts a message
+  uint8_t controlData[125];
+  size_t controlCount;
+  uint32_t framesTotal;
+
+  void beginPayload();
+  WsFrameEvent finishFrame();
+};
+
+#endif // WS_FRAME_H
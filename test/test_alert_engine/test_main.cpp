@@ -0,0 +1,271 @@
+// AlertEngine crossing rules on small rule sets, rules on flash through the
+// fs::FS stand-in, and a 100,000-rule benchmark whose crossings are checked
+// against a scan of every rule on every check.
+
+#include <Arduino.h>
+#include <FS.h>
+#include <unity.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include "alert_engine.h"
+
+static const time_t START = 1736942400; // 2025-01-15 12:00 UTC
+static const int BENCH_RULES = 100000;
+static const int BENCH_STEPS = 20000;
+
+static AssetData assets[2];
+static AlertEngine* engine;
+
+static void setRules(const char* text) {
+  TEST_ASSERT_GREATER_THAN(0, engine->setRules(text, strlen(text)));
+}
+
+static void checkPrice(uint8_t asset, float price, time_t now) {
+  assets[asset].price = price;
+  engine->check(asset, assets[asset], nullptr, now);
+}
+
+static int takeAll(AlertEvent* events, int size) {
+  int taken = 0;
+  AlertEvent event;
+  while (engine->takeFired(event)) {
+    if (taken < size) {
+      events[taken] = event;
+    }
+    taken++;
+  }
+  return taken;
+}
+
+void setUp(void) {
+  memset(assets, 0, sizeof(assets));
+  assets[0].symbol = "BTC";
+  assets[1].symbol = "ETH";
+  engine = new AlertEngine();
+  TEST_ASSERT_TRUE(engine->begin(assets, 2));
+}
+
+void tearDown(void) {
+  delete engine;
+  engine = nullptr;
+}
+
+void test_first_price_fires_nothing(void) {
+  setRules("BTC above 100\nBTC below 200\n");
+  checkPrice(0, 150.0f, START);
+  TEST_ASSERT_EQUAL_INT(0, takeAll(nullptr, 0));
+}
+
+void test_jump_across_levels_fires_each_level(void) {
+  setRules("BTC above 101\nBTC above 103\nBTC above 102\nBTC above 110\nETH above 102\n");
+  checkPrice(0, 100.0f, START);
+  checkPrice(1, 100.0f, START);
+  checkPrice(0, 103.0f, START + 1); // Reaching a level counts
+
+  AlertEvent events[4];
+  TEST_ASSERT_EQUAL_INT(3, takeAll(events, 4));
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL_UINT8(0, events[i].asset);
+    TEST_ASSERT_EQUAL_INT(ALERT_ABOVE, events[i].kind);
+    TEST_ASSERT_EQUAL_FLOAT(101.0f + i, events[i].threshold); // Lowest level first
+    TEST_ASSERT_EQUAL_FLOAT(103.0f, events[i].value);
+  }
+}
+
+void test_fall_fires_no_above_rule(void) {
+  setRules("BTC above 101\nBTC above 102\n");
+  checkPrice(0, 105.0f, START);
+  checkPrice(0, 90.0f, START + 1);
+  checkPrice(0, 100.0f, START + 2); // Rising below every level
+  TEST_ASSERT_EQUAL_INT(0, takeAll(nullptr, 0));
+}
+
+void test_below_fires_on_a_fall_only(void) {
+  setRules("BTC below 95\nBTC below 90\nBTC below 80\n");
+  checkPrice(0, 100.0f, START);
+  checkPrice(0, 102.0f, START + 1);
+  TEST_ASSERT_EQUAL_INT(0, takeAll(nullptr, 0));
+
+  checkPrice(0, 89.5f, START + 2);
+  AlertEvent events[3];
+  TEST_ASSERT_EQUAL_INT(2, takeAll(events, 3));
+  TEST_ASSERT_EQUAL_INT(ALERT_BELOW, events[0].kind);
+  TEST_ASSERT_EQUAL_FLOAT(95.0f, events[0].threshold); // Reported as written
+  TEST_ASSERT_EQUAL_FLOAT(90.0f, events[1].threshold);
+  TEST_ASSERT_EQUAL_FLOAT(89.5f, events[1].value);
+
+  checkPrice(0, 120.0f, START + 3);
+  TEST_ASSERT_EQUAL_INT(0, takeAll(nullptr, 0));
+}
+
+void test_cooldown_suppresses_a_second_crossing(void) {
+  setRules("BTC above 100\n");
+  checkPrice(0, 99.0f, START);
+  checkPrice(0, 101.0f, START + 1);
+  TEST_ASSERT_EQUAL_INT(1, takeAll(nullptr, 0));
+
+  // Back and through again inside the cooldown: counted, not fired
+  checkPrice(0, 99.0f, START + 2);
+  checkPrice(0, 101.0f, START + ALERT_COOLDOWN_SEC);
+  TEST_ASSERT_EQUAL_INT(0, takeAll(nullptr, 0));
+  TEST_ASSERT_EQUAL_UINT32(1, engine->suppressedCount());
+
+  checkPrice(0, 99.0f, START + ALERT_COOLDOWN_SEC);
+  checkPrice(0, 101.0f, START + 1 + ALERT_COOLDOWN_SEC);
+  TEST_ASSERT_EQUAL_INT(1, takeAll(nullptr, 0));
+  TEST_ASSERT_EQUAL_UINT32(2, engine->firedCount());
+}
+
+void test_move_and_stale_rules(void) {
+  setRules("BTC move 5 1h\nBTC stale 900\n");
+  AssetStats stats = AssetStats();
+  for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+    stats.windowChange[w] = 0.0f;
+  }
+  assets[0].price = 100.0f;
+  assets[0].sourceTime = START;
+  engine->check(0, assets[0], &stats, START);
+
+  // A 6% drop over the hour is a 5% move; the 15m window isn't watched
+  stats.windowChange[STATS_WINDOW_COUNT - 1] = -6.0f;
+  stats.windowChange[0] = -7.0f;
+  engine->check(0, assets[0], &stats, START + 60);
+  AlertEvent events[2];
+  TEST_ASSERT_EQUAL_INT(1, takeAll(events, 2));
+  TEST_ASSERT_EQUAL_INT(ALERT_MOVE, events[0].kind);
+  TEST_ASSERT_EQUAL_UINT8(STATS_WINDOW_COUNT - 1, events[0].window);
+
+  engine->check(0, assets[0], &stats, START + 900);
+  TEST_ASSERT_EQUAL_INT(1, takeAll(events, 2));
+  TEST_ASSERT_EQUAL_INT(ALERT_STALE, events[0].kind);
+}
+
+void test_rules_survive_save_and_load(void) {
+  setRules("# levels\nBTC above 100000\nETH below 2500.5\nBTC bogus 1\n");
+  TEST_ASSERT_EQUAL_size_t(2, engine->ruleCount());
+  TEST_ASSERT_EQUAL_UINT32(1, engine->rejectedCount());
+
+  fs::FS flash;
+  TEST_ASSERT_TRUE(engine->save(flash));
+  AlertEngine loaded;
+  TEST_ASSERT_TRUE(loaded.begin(assets, 2));
+  TEST_ASSERT_TRUE(loaded.load(flash));
+  TEST_ASSERT_EQUAL_size_t(2, loaded.ruleCount());
+
+  assets[1].price = 2600.0f;
+  loaded.check(1, assets[1], nullptr, START);
+  assets[1].price = 2500.0f;
+  loaded.check(1, assets[1], nullptr, START + 1);
+  AlertEvent event;
+  TEST_ASSERT_TRUE(loaded.takeFired(event));
+  TEST_ASSERT_EQUAL_FLOAT(2500.5f, event.threshold);
+}
+
+// Reference for the benchmark: every rule compared on every check
+struct NaiveRule {
+  int asset;
+  int series; // 0 price, 1 negated price, 2 move over the first window
+  float threshold;
+};
+
+void test_benchmark_100k_rules_match_a_full_scan(void) {
+  delete engine;
+  engine = new AlertEngine();
+  TEST_ASSERT_TRUE(engine->begin(assets, 2, BENCH_RULES));
+  const float base[2] = {100000.0f, 3000.0f};
+  char window[8];
+  MarketStats::windowName(0, window, sizeof(window));
+
+  srand(42);
+  std::string text;
+  std::vector<NaiveRule> naive;
+  for (int r = 0; r < BENCH_RULES; r++) {
+    int asset = r % 2;
+    int kind = rand() % 10; // 4 above, 4 below, 2 move
+    char line[48];
+    NaiveRule rule = {asset, kind < 4 ? 0 : kind < 8 ? 1 : 2, 0.0f};
+    float value = rule.series == 2 ? 0.5f + (float)(rand() % 950) / 100.0f
+                                   : base[asset] * (0.9f + (float)(rand() % 20001) / 100000.0f);
+    snprintf(line, sizeof(line), "%.2f", value);
+    rule.threshold = strtof(line, nullptr) * (rule.series == 1 ? -1.0f : 1.0f);
+    naive.push_back(rule);
+    text += assets[asset].symbol;
+    text += rule.series == 0 ? " above " : rule.series == 1 ? " below " : " move ";
+    text += line;
+    if (rule.series == 2) {
+      text += ' ';
+      text += window;
+    }
+    text += '\n';
+  }
+
+  unsigned long started = micros();
+  TEST_ASSERT_EQUAL_INT(BENCH_RULES, engine->setRules(text.c_str(), text.size()));
+  unsigned long loadUs = micros() - started;
+
+  AssetStats stats[2] = {AssetStats(), AssetStats()};
+  float last[2][3] = {{NAN, NAN, NAN}, {NAN, NAN, NAN}};
+  uint64_t naiveCrossings = 0;
+  unsigned long engineUs = 0;
+  unsigned long naiveUs = 0;
+  for (int step = 0; step < BENCH_STEPS; step++) {
+    time_t now = START + step;
+    for (int a = 0; a < 2; a++) {
+      // Ticks of up to 0.05%, the window change drifting by up to 0.05 points
+      assets[a].price *= 1.0f + (float)(rand() % 101 - 50) / 100000.0f;
+      if (assets[a].price < base[a] * 0.85f || assets[a].price > base[a] * 1.15f || step == 0) {
+        assets[a].price = base[a];
+      }
+      float change = stats[a].windowChange[0] + (float)(rand() % 101 - 50) / 1000.0f;
+      for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+        stats[a].windowChange[w] = fabsf(change) > 12.0f ? 0.0f : change;
+      }
+    }
+
+    started = micros();
+    for (int a = 0; a < 2; a++) {
+      engine->check(a, assets[a], &stats[a], now);
+    }
+    engineUs += micros() - started;
+    takeAll(nullptr, 0);
+
+    started = micros();
+    float current[2][3];
+    for (int a = 0; a < 2; a++) {
+      current[a][0] = assets[a].price;
+      current[a][1] = -assets[a].price;
+      current[a][2] = fabsf(stats[a].windowChange[0]);
+    }
+    for (size_t r = 0; r < naive.size(); r++) {
+      float previous = last[naive[r].asset][naive[r].series];
+      if (previous < naive[r].threshold && naive[r].threshold <= current[naive[r].asset][naive[r].series]) {
+        naiveCrossings++;
+      }
+    }
+    memcpy(last, current, sizeof(last));
+    naiveUs += micros() - started;
+  }
+
+  uint64_t engineCrossings = (uint64_t)engine->firedCount() + engine->suppressedCount();
+  printf("AlertEngine: %d rules loaded in %lu ms; %d steps x 2 assets, %.2f us per asset check "
+         "(full scan %.0f us), %llu crossings, %u fired\n",
+         BENCH_RULES, loadUs / 1000, BENCH_STEPS, engineUs / (2.0 * BENCH_STEPS), naiveUs / (2.0 * BENCH_STEPS),
+         (unsigned long long)engineCrossings, (unsigned)engine->firedCount());
+
+  TEST_ASSERT_GREATER_THAN(0, naiveCrossings);
+  TEST_ASSERT_EQUAL_UINT64(naiveCrossings, engineCrossings);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_price_fires_nothing);
+  RUN_TEST(test_jump_across_levels_fires_each_level);
+  RUN_TEST(test_fall_fires_no_above_rule);
+  RUN_TEST(test_below_fires_on_a_fall_only);
+  RUN_TEST(test_cooldown_suppresses_a_second_crossing);
+  RUN_TEST(test_move_and_stale_rules);
+  RUN_TEST(test_rules_survive_save_and_load);
+  RUN_TEST(test_benchmark_100k_rules_match_a_full_scan);
+  return UNITY_END();
+}
@@ -0,0 +1,156 @@
+// CryptoDisplay rendered into a FramebufferSurface: a golden image of the
+// price screen, incremental redraws against a clean repaint, and a day of
+// updates replayed against the per-frame traffic budget.
+//
+// A golden mismatch writes the frame to display_asset.png for inspection.
+
+#include <Arduino.h>
+#include <unity.h>
+#include "crypto_display.h"
+#include "framebuffer_surface.h"
+
+// FNV-1a over the framebuffer of the BTC screen at 104231.50 CAD.
+// Update after an intended layout change (check the PNG first).
+static const uint32_t GOLDEN_ASSET_HASH = 0x54d44e23;
+
+// A day of display calls: one every STEP, a new price for every asset each
+// PRICE, the next asset every ROTATE
+static const int REPLAY_STEP_SEC = 5;
+static const int REPLAY_ROTATE_SEC = 300;
+static const int REPLAY_PRICE_SEC = 60;
+
+static FramebufferSurface surface;
+static FramebufferSurface reference;
+
+static AssetData makeAsset(const char* symbol, const char* name, int nameWidth, float price) {
+  // No source time: the footer shows lastUpdated, whatever the host clock says
+  AssetData asset = AssetData();
+  asset.symbol = symbol;
+  asset.name = name;
+  asset.price = price;
+  strlcpy(asset.lastUpdated, "2025-01-15T12:00:00Z", sizeof(asset.lastUpdated));
+  asset.nameWidth = nameWidth;
+  asset.currency = "CAD";
+  asset.exchange = EXCHANGE_NONE;
+  asset.refreshIntervalMs = REFRESH_CRYPTO_MS;
+  asset.previousPrice = price;
+  asset.change24h = 1.25f;
+  return asset;
+}
+
+static uint32_t frameHash(const FramebufferSurface& target) {
+  uint32_t hash = 2166136261u;
+  const uint8_t* bytes = (const uint8_t*)target.pixels();
+  for (size_t i = 0; i < sizeof(uint16_t) * SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+void setUp(void) {
+  surface.resetStats();
+  reference.resetStats();
+}
+
+void tearDown(void) {
+}
+
+void test_asset_screen_matches_golden(void) {
+  CryptoDisplay display(surface);
+  display.begin();
+  AssetData btc = makeAsset("BTC", "Bitcoin", 90, 104231.50f);
+  display.displayAsset(btc);
+
+  uint32_t hash = frameHash(surface);
+  if (hash != GOLDEN_ASSET_HASH) {
+    surface.writePng("display_asset.png");
+    char message[64];
+    snprintf(message, sizeof(message), "frame hash 0x%08x (see display_asset.png)", (unsigned)hash);
+    TEST_FAIL_MESSAGE(message);
+  }
+}
+
+void test_price_redraw_matches_full_repaint(void) {
+  CryptoDisplay display(surface);
+  display.begin();
+  AssetData btc = makeAsset("BTC", "Bitcoin", 90, 104231.50f);
+  display.displayAsset(btc);
+  // Same width (digits roll in place), then a longer price (full price redraw)
+  const float prices[] = {104239.75f, 99870.10f, 1004231.00f};
+  for (size_t i = 0; i < sizeof(prices) / sizeof(prices[0]); i++) {
+    btc.previousPrice = btc.price;
+    btc.price = prices[i];
+    btc.priceIncreased = btc.price > btc.previousPrice;
+    display.displayAsset(btc);
+
+    CryptoDisplay fresh(reference);
+    fresh.begin();
+    fresh.displayAsset(btc);
+    TEST_ASSERT_EQUAL_INT(0, surface.countDifferences(reference));
+  }
+}
+
+void test_day_replay_stays_within_budget(void) {
+  CryptoDisplay display(surface);
+  display.begin();
+  AssetData assets[] = {
+    makeAsset("BTC", "Bitcoin", 90, 104231.50f),
+    makeAsset("ETH", "Ethereum", 102, 4512.25f),
+    makeAsset("XRP", "XRP", 42, 3.1234f),
+  };
+  const int count = sizeof(assets) / sizeof(assets[0]);
+  srand(42);
+  surface.resetStats();
+
+  uint32_t switches = 0;
+  uint32_t idleFrames = 0;
+  uint32_t idleBytes = 0;
+  int current = -1;
+  unsigned long started = micros();
+  for (int second = 0; second < 24 * 3600; second += REPLAY_STEP_SEC) {
+    if (second % REPLAY_PRICE_SEC == 0) {
+      for (int i = 0; i < count; i++) {
+        float step = (float)(rand() % 2001 - 1000) / 100000.0f; // +/- 1%
+        assets[i].previousPrice = assets[i].price;
+        assets[i].price *= 1.0f + step;
+        assets[i].priceIncreased = step > 0.0f;
+      }
+    }
+    int index = (second / REPLAY_ROTATE_SEC) % count;
+    bool newPrice = second % REPLAY_PRICE_SEC == 0;
+    if (index != current) {
+      switches++;
+      current = index;
+    }
+    display.displayAsset(assets[index]);
+    if (!newPrice && surface.lastFrameStats().fullClears == 0) {
+      idleFrames++;
+      idleBytes += surface.lastFrameStats().bytesPushed();
+    }
+  }
+  unsigned long elapsed = micros() - started;
+
+  const SurfaceStats& totals = surface.totalStats();
+  uint32_t fullScreen = SCREEN_WIDTH * SCREEN_HEIGHT * 2;
+  printf("Day replay: %u frames in %lu ms, %llu bytes (%u per frame), %u draw calls, "
+         "%u full clears, %u per idle frame\n",
+         (unsigned)surface.frameCount(), elapsed / 1000, (unsigned long long)totals.bytesPushed(),
+         (unsigned)(totals.bytesPushed() / surface.frameCount()), (unsigned)totals.drawCalls,
+         (unsigned)totals.fullClears, idleFrames > 0 ? (unsigned)(idleBytes / idleFrames) : 0u);
+
+  // Only asset switches clear the screen
+  TEST_ASSERT_EQUAL_UINT32(switches, totals.fullClears);
+  // A frame with nothing new only redraws the frame outline
+  TEST_ASSERT_GREATER_THAN_UINT32(0, idleFrames);
+  TEST_ASSERT_LESS_THAN_UINT32(fullScreen / 20, idleBytes / idleFrames);
+  // Across the day, well under a tenth of a full repaint per frame
+  TEST_ASSERT_LESS_THAN_UINT32(fullScreen / 10, totals.bytesPushed() / surface.frameCount());
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_asset_screen_matches_golden);
+  RUN_TEST(test_price_redraw_matches_full_repaint);
+  RUN_TEST(test_day_replay_stays_within_budget);
+  return UNITY_END();
+}
@@ -0,0 +1,209 @@
+// FixedString truncation at the edges of its capacity, and a month of
+// update cycles through the modules that build text with it (prices, grid
+// cells, change figures, alerts) without a single heap allocation.
+//
+// Allocations are counted by wrapping malloc, which needs glibc; elsewhere
+// the month is skipped.
+
+#include <Arduino.h>
+#include <unity.h>
+#include "fixed_string.h"
+#include "alert_engine.h"
+#include "crypto_display.h"
+#include "framebuffer_surface.h"
+#include "market_stats.h"
+
+#if defined(__GLIBC__)
+#define COUNT_ALLOCATIONS 1
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+
+static volatile uint32_t heapCalls = 0;
+
+extern "C" void* malloc(size_t size) {
+  heapCalls++;
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+  heapCalls++;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) {
+  heapCalls++;
+  return __libc_realloc(pointer, size);
+}
+#endif
+
+static const time_t START = 1736942400; // 2025-01-15 12:00 UTC
+static const int CYCLE_SEC = 60;         // One refresh of every asset
+static const int MONTH_CYCLES = 30 * 24 * 3600 / CYCLE_SEC;
+
+// appendv() the way the repo's variadic wrappers call it
+template <size_t N>
+static void appendVia(FixedString<N>& text, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  text.appendv(format, args);
+  va_end(args);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_append_cuts_at_capacity(void) {
+  FixedString<8> text("abc");
+  text.append("defg");
+  TEST_ASSERT_EQUAL_STRING("abcdefg", text.c_str());
+  TEST_ASSERT_FALSE(text.truncated()); // Exactly full
+
+  text.append("h");
+  TEST_ASSERT_EQUAL_STRING("abcdefg", text.c_str());
+  TEST_ASSERT_TRUE(text.truncated());
+  TEST_ASSERT_EQUAL_size_t(7, text.length());
+
+  FixedString<8> longer("0123456789");
+  TEST_ASSERT_EQUAL_STRING("0123456", longer.c_str());
+  TEST_ASSERT_TRUE(longer.truncated());
+
+  FixedString<4> chars;
+  chars += 'a';
+  chars += 'b';
+  chars += 'c';
+  TEST_ASSERT_FALSE(chars.truncated());
+  chars += 'd';
+  TEST_ASSERT_EQUAL_STRING("abc", chars.c_str());
+  TEST_ASSERT_TRUE(chars.truncated());
+
+  FixedString<8> counted;
+  counted.append("abcdef", 3);
+  TEST_ASSERT_EQUAL_STRING("abc", counted.c_str());
+  counted.append(nullptr);
+  TEST_ASSERT_EQUAL_STRING("abc", counted.c_str());
+  TEST_ASSERT_FALSE(counted.truncated());
+}
+
+void test_appendv_cuts_at_capacity(void) {
+  FixedString<10> text("id=");
+  appendVia(text, "%d", 123456);
+  TEST_ASSERT_EQUAL_STRING("id=123456", text.c_str());
+  TEST_ASSERT_FALSE(text.truncated()); // Exactly full
+
+  FixedString<10> over("id=");
+  appendVia(over, "%d-%s", 42, "overflowing");
+  TEST_ASSERT_EQUAL_STRING("id=42-ove", over.c_str());
+  TEST_ASSERT_EQUAL_size_t(9, over.length());
+  TEST_ASSERT_TRUE(over.truncated());
+
+  // Full already: nothing lands, and the cut is still reported
+  appendVia(over, "%s", "x");
+  TEST_ASSERT_EQUAL_STRING("id=42-ove", over.c_str());
+  TEST_ASSERT_TRUE(over.truncated());
+}
+
+void test_format_replaces_and_resets_the_cut(void) {
+  FixedString<12> text;
+  text.format("%s %.2f", "BTC", 104231.5);
+  TEST_ASSERT_EQUAL_STRING("BTC 104231.", text.c_str()); // "BTC 104231.50" is 13
+  TEST_ASSERT_TRUE(text.truncated());
+
+  text.format("%s", "ETH");
+  TEST_ASSERT_EQUAL_STRING("ETH", text.c_str());
+  TEST_ASSERT_FALSE(text.truncated());
+
+  text.appendf(" %+.1f%%", -2.26);
+  TEST_ASSERT_EQUAL_STRING("ETH -2.3%", text.c_str());
+  TEST_ASSERT_EQUAL_size_t(9, text.length());
+
+  FixedString<6> price;
+  price.format("%.2f", 3.5);
+  TEST_ASSERT_EQUAL_STRING("3.50", price.c_str());
+  price.format("%.2f", 12345.678);
+  TEST_ASSERT_EQUAL_STRING("12345", price.c_str());
+  TEST_ASSERT_TRUE(price.truncated());
+}
+
+void test_month_of_cycles_allocates_nothing(void) {
+#if COUNT_ALLOCATIONS
+  static FramebufferSurface surface;
+  CryptoDisplay display(surface);
+  MarketStats stats;
+  AlertEngine alerts;
+  AssetData assets[4];
+  const char* symbols[4] = {"BTC", "ETH", "XRP", "MSFT"};
+  const float prices[4] = {104231.5f, 4512.25f, 3.1234f, 431.1f};
+  for (int i = 0; i < 4; i++) {
+    assets[i] = AssetData();
+    assets[i].symbol = symbols[i];
+    assets[i].name = symbols[i];
+    assets[i].nameWidth = 60;
+    assets[i].currency = i < 3 ? "CAD" : "USD";
+    assets[i].price = prices[i];
+    assets[i].firstUpdate = true;
+  }
+  const char rules[] = "BTC above 105000\nBTC below 100000\nETH move 2 1h\nMSFT stale 900\n";
+
+  // Everything that allocates does it here, once
+  display.begin();
+  stats.begin();
+  alerts.begin(assets, 4);
+  alerts.setRules(rules, sizeof(rules) - 1);
+  Serial.muted = true;
+
+  srand(3);
+  uint32_t warmupCalls = 0;
+  char message[48];
+  AlertEvent event;
+  for (int cycle = 0; cycle < MONTH_CYCLES; cycle++) {
+    time_t now = START + (time_t)cycle * CYCLE_SEC;
+    for (int i = 0; i < 4; i++) {
+      AssetData& asset = assets[i];
+      asset.previousPrice = asset.price;
+      asset.price *= 1.0f + (float)(rand() % 2001 - 1000) / 200000.0f;
+      asset.priceIncreased = asset.price > asset.previousPrice;
+      asset.firstUpdate = false;
+      asset.sourceTime = now;
+      snprintf(asset.lastUpdated, sizeof(asset.lastUpdated), "%ld", (long)now);
+      stats.recordPrice(i, asset, now);
+      alerts.check(i, asset, &stats.get(i), now);
+    }
+    while (alerts.takeFired(event)) {
+      alerts.describe(event, message, sizeof(message));
+      display.showToast(message, TOAST_ALERT);
+    }
+    // The single view for each asset, then the overview
+    for (int i = 0; i < 4; i++) {
+      display.displayAsset(assets[i]);
+    }
+    display.displayGrid(assets, 4, 0);
+
+    // stdio and the first frames may set up buffers once
+    if (cycle == 0) {
+      warmupCalls = heapCalls;
+    }
+  }
+  Serial.muted = false;
+
+  TEST_ASSERT_GREATER_THAN(0, warmupCalls); // The wrapper saw the setup
+  uint32_t monthCalls = heapCalls - warmupCalls;
+  printf("FixedString: %d cycles (a month at %d s), %u heap calls after the first cycle, %u alerts fired\n",
+         MONTH_CYCLES, CYCLE_SEC, (unsigned)monthCalls, (unsigned)alerts.firedCount());
+  TEST_ASSERT_EQUAL_UINT32(0, monthCalls);
+#else
+  TEST_IGNORE_MESSAGE("allocation counting needs glibc");
+#endif
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_append_cuts_at_capacity);
+  RUN_TEST(test_appendv_cuts_at_capacity);
+  RUN_TEST(test_format_replaces_and_resets_the_cut);
+  RUN_TEST(test_month_of_cycles_allocates_nothing);
+  return UNITY_END();
+}
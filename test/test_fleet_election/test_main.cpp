@@ -0,0 +1,330 @@
+// FleetElection rules one event at a time, then whole fleets on a simulated
+// broker: retained status and claim, per-message latency, gateways dropping
+// off (their Last Will flips status to "offline") and coming back. After
+// every hand-over the fleet has to settle on one gateway that every node
+// names, and a configured gateway has to end up in charge whenever it is up.
+
+#include <Arduino.h>
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "fleet_election.h"
+
+static const unsigned long STEP_MS = 10;
+static const unsigned long SETTLE_MS = FLEET_ELECTION_WAIT_MS + FLEET_ELECTION_JITTER_MS + 2000;
+static const int SIM_NODES = 8;
+static const int SIM_ROUNDS = 500;
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_auto_node_waits_then_claims(void) {
+  FleetElection node;
+  node.begin(FLEET_ROLE_AUTO, "m5crypto-aa0001");
+  TEST_ASSERT_FALSE(node.isGateway());
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_NONE, node.connected(1000, 1234));
+  TEST_ASSERT_TRUE(node.electionPending());
+
+  unsigned long due = 1000 + FLEET_ELECTION_WAIT_MS + 1234 % (FLEET_ELECTION_JITTER_MS + 1);
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_NONE, node.poll(due - 1));
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_PROMOTE, node.poll(due));
+  TEST_ASSERT_TRUE(node.isGateway());
+  TEST_ASSERT_EQUAL_STRING("m5crypto-aa0001", node.getGatewayId());
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_NONE, node.poll(due + 1000));
+
+  // Its own claim coming back changes nothing
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_NONE, node.claimSeen("m5crypto-aa0001", false));
+  TEST_ASSERT_TRUE(node.isGateway());
+}
+
+void test_retained_online_status_cancels_the_claim(void) {
+  FleetElection node;
+  node.begin(FLEET_ROLE_AUTO, "m5crypto-aa0002");
+  node.connected(0, 0);
+  node.statusSeen(true, 50, 0);
+  node.claimSeen("m5crypto-ff0000", false);
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_NONE, node.poll(SETTLE_MS));
+  TEST_ASSERT_FALSE(node.isGateway());
+  TEST_ASSERT_EQUAL_STRING("m5crypto-ff0000", node.getGatewayId());
+
+  // The gateway's Last Will: elect straight away (plus jitter)
+  node.statusSeen(false, 20000, 700);
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_NONE, node.poll(20699));
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_PROMOTE, node.poll(20700));
+}
+
+void test_display_and_standalone_never_claim(void) {
+  FleetElection display;
+  display.begin(FLEET_ROLE_DISPLAY, "m5crypto-aa0003");
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_NONE, display.connected(0, 0));
+  display.statusSeen(false, 10, 0);
+  TEST_ASSERT_FALSE(display.electionPending());
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_NONE, display.poll(SETTLE_MS));
+  TEST_ASSERT_FALSE(display.isGateway());
+
+  FleetElection gateway;
+  gateway.begin(FLEET_ROLE_GATEWAY, "m5crypto-aa0004");
+  TEST_ASSERT_TRUE(gateway.isGateway());
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_CLAIM, gateway.connected(0, 0));
+  TEST_ASSERT_EQUAL_STRING("m5crypto-aa0004", gateway.getGatewayId());
+}
+
+void test_simultaneous_claims_settle_on_lowest_id(void) {
+  FleetElection low;
+  FleetElection high;
+  low.begin(FLEET_ROLE_AUTO, "m5crypto-000001");
+  high.begin(FLEET_ROLE_AUTO, "m5crypto-000002");
+  low.connected(0, 0);
+  high.connected(0, 0);
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_PROMOTE, low.poll(FLEET_ELECTION_WAIT_MS));
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_PROMOTE, high.poll(FLEET_ELECTION_WAIT_MS));
+
+  // The claims cross: the lower id reasserts, the higher steps down
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_CLAIM, low.claimSeen("m5crypto-000002", false));
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_DEMOTE, high.claimSeen("m5crypto-000001", false));
+  TEST_ASSERT_TRUE(low.isGateway());
+  TEST_ASSERT_FALSE(high.isGateway());
+  TEST_ASSERT_EQUAL_STRING("m5crypto-000001", high.getGatewayId());
+}
+
+void test_configured_gateway_beats_an_elected_one(void) {
+  FleetElection elected;
+  elected.begin(FLEET_ROLE_AUTO, "m5crypto-000001");
+  elected.connected(0, 0);
+  elected.poll(FLEET_ELECTION_WAIT_MS);
+  TEST_ASSERT_TRUE(elected.isGateway());
+  // A higher id still wins when it is configured
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_DEMOTE, elected.claimSeen("m5crypto-ffffff", true));
+
+  FleetElection configured;
+  configured.begin(FLEET_ROLE_GATEWAY, "m5crypto-ffffff");
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_CLAIM, configured.claimSeen("m5crypto-000001", false));
+  TEST_ASSERT_TRUE(configured.isGateway());
+
+  // Two configured gateways: lowest id reasserts, the other keeps going and says so
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_NONE, configured.claimSeen("m5crypto-000002", true));
+  TEST_ASSERT_TRUE(configured.isGateway());
+  FleetElection lowConfigured;
+  lowConfigured.begin(FLEET_ROLE_GATEWAY, "m5crypto-000002");
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_CLAIM, lowConfigured.claimSeen("m5crypto-ffffff", true));
+
+  // A cleared claim is not a rival
+  TEST_ASSERT_EQUAL_INT(FLEET_ACTION_NONE, lowConfigured.claimSeen("", false));
+  TEST_ASSERT_TRUE(lowConfigured.isGateway());
+}
+
+// Fleet on a broker: publishes update the retained topic at once and reach
+// every connected node after 5-300 ms, in the order the broker got them
+struct Delivery {
+  unsigned long at;
+  int node;
+  bool claim;     // Claim topic, else status
+  bool online;
+  std::string id;
+  bool forced;
+};
+
+struct SimNode {
+  FleetElection election;
+  FleetRole role;
+  char id[32];
+  bool up;
+};
+
+struct Broker {
+  bool statusOnline;
+  std::string claimId;
+  bool claimForced;
+  std::vector<Delivery> queue;
+  unsigned long lastDelivery[SIM_NODES];
+  uint32_t promotions;
+  uint32_t demotions;
+};
+
+static SimNode nodes[SIM_NODES];
+static Broker broker;
+
+static void send(unsigned long now, int to, bool claim, bool online, const std::string& id, bool forced) {
+  unsigned long at = now + 5 + (unsigned long)(rand() % 296);
+  if (at < broker.lastDelivery[to]) {
+    at = broker.lastDelivery[to]; // One connection per subscriber: no overtaking
+  }
+  broker.lastDelivery[to] = at;
+  Delivery delivery = {at, to, claim, online, id, forced};
+  broker.queue.push_back(delivery);
+}
+
+static void publish(unsigned long now, bool claim, bool online, const std::string& id, bool forced) {
+  if (claim) {
+    broker.claimId = id;
+    broker.claimForced = forced;
+  } else {
+    broker.statusOnline = online;
+  }
+  for (int i = 0; i < SIM_NODES; i++) {
+    if (nodes[i].up) {
+      send(now, i, claim, online, id, forced);
+    }
+  }
+}
+
+static void act(unsigned long now, int i, FleetAction action) {
+  SimNode& node = nodes[i];
+  switch (action) {
+    case FLEET_ACTION_PROMOTE:
+      broker.promotions++;
+      publish(now, false, true, "", false); // Reconnected with the status Last Will
+      publish(now, true, false, node.id, node.role == FLEET_ROLE_GATEWAY);
+      break;
+    case FLEET_ACTION_CLAIM:
+      publish(now, true, false, node.id, node.role == FLEET_ROLE_GATEWAY);
+      break;
+    case FLEET_ACTION_DEMOTE:
+      broker.demotions++;
+      break;
+    default:
+      break;
+  }
+}
+
+static void connect(unsigned long now, int i) {
+  SimNode& node = nodes[i];
+  node.election.begin(node.role, node.id);
+  node.up = true;
+  if (node.election.isGateway()) {
+    publish(now, false, true, "", false);
+  }
+  // Retained messages arrive right after subscribing
+  send(now, i, false, broker.statusOnline, "", false);
+  send(now, i, true, false, broker.claimId, broker.claimForced);
+  act(now, i, node.election.connected(now, rand()));
+}
+
+// A node drops off; a gateway's Last Will marks the gateway offline
+static void drop(unsigned long now, int i) {
+  nodes[i].up = false;
+  if (nodes[i].election.isGateway()) {
+    publish(now, false, false, "", false);
+  }
+}
+
+static void run(unsigned long& now, unsigned long duration) {
+  for (unsigned long end = now + duration; now < end; now += STEP_MS) {
+    for (size_t q = 0; q < broker.queue.size();) {
+      Delivery delivery = broker.queue[q];
+      if (delivery.at > now) {
+        q++;
+        continue;
+      }
+      broker.queue.erase(broker.queue.begin() + q);
+      SimNode& node = nodes[delivery.node];
+      if (!node.up) {
+        continue;
+      }
+      act(now, delivery.node, delivery.claim ? node.election.claimSeen(delivery.id.c_str(), delivery.forced)
+                                             : node.election.statusSeen(delivery.online, now, rand()));
+    }
+    for (int i = 0; i < SIM_NODES; i++) {
+      if (nodes[i].up) {
+        act(now, i, nodes[i].election.poll(now));
+      }
+    }
+  }
+}
+
+// One gateway among the nodes that are up, named by all of them and by the
+// retained claim; returns its index
+static int settledGateway() {
+  int gateway = -1;
+  for (int i = 0; i < SIM_NODES; i++) {
+    if (nodes[i].up && nodes[i].election.isGateway()) {
+      TEST_ASSERT_EQUAL_INT_MESSAGE(-1, gateway, "two gateways");
+      gateway = i;
+    }
+  }
+  TEST_ASSERT_NOT_EQUAL(-1, gateway);
+  for (int i = 0; i < SIM_NODES; i++) {
+    if (nodes[i].up) {
+      TEST_ASSERT_EQUAL_STRING(nodes[gateway].id, nodes[i].election.getGatewayId());
+    }
+  }
+  TEST_ASSERT_EQUAL_STRING(nodes[gateway].id, broker.claimId.c_str());
+  TEST_ASSERT_TRUE(broker.statusOnline);
+  return gateway;
+}
+
+static void simulate(bool withConfiguredGateway, uint32_t seed) {
+  srand(seed);
+  broker = Broker();
+  broker.statusOnline = false;
+  broker.claimForced = false;
+  for (int i = 0; i < SIM_NODES; i++) {
+    nodes[i].role = (withConfiguredGateway && i == SIM_NODES - 1) ? FLEET_ROLE_GATEWAY : FLEET_ROLE_AUTO;
+    snprintf(nodes[i].id, sizeof(nodes[i].id), "m5crypto-%06x", (unsigned)(rand() & 0xFFFFFF));
+    nodes[i].up = false;
+  }
+
+  Serial.muted = true;
+  unsigned long now = 1;
+  for (int i = 0; i < SIM_NODES; i++) {
+    connect(now + rand() % 2000, i); // Power comes back across the room
+  }
+  run(now, SETTLE_MS);
+  int handovers = 0;
+  for (int round = 0; round < SIM_ROUNDS; round++) {
+    int gateway = settledGateway();
+    if (withConfiguredGateway && nodes[SIM_NODES - 1].up) {
+      TEST_ASSERT_EQUAL_INT(SIM_NODES - 1, gateway);
+    }
+
+    // Usually the gateway drops, sometimes another node; the ones that are
+    // down come back a little later, some during the election
+    int victim = rand() % 3 ? gateway : rand() % SIM_NODES;
+    if (victim == gateway) {
+      handovers++;
+    }
+    int up = 0;
+    for (int i = 0; i < SIM_NODES; i++) {
+      up += nodes[i].up;
+    }
+    if (up > 2) {
+      drop(now, victim);
+    }
+    run(now, rand() % 4000);
+    for (int i = 0; i < SIM_NODES; i++) {
+      if (!nodes[i].up && rand() % 2) {
+        connect(now, i);
+      }
+    }
+    run(now, SETTLE_MS);
+  }
+  Serial.muted = false;
+  printf("FleetElection: %d nodes%s, %d rounds, %d gateway hand-overs, %u promotions, %u demotions "
+         "(concurrent claims settled)\n",
+         SIM_NODES, withConfiguredGateway ? " (one configured gateway)" : "", SIM_ROUNDS, handovers,
+         (unsigned)broker.promotions, (unsigned)broker.demotions);
+  TEST_ASSERT_GREATER_OR_EQUAL(handovers, broker.promotions);
+}
+
+void test_fleet_settles_after_every_hand_over(void) {
+  simulate(false, 17);
+}
+
+void test_fleet_with_a_configured_gateway(void) {
+  simulate(true, 29);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_auto_node_waits_then_claims);
+  RUN_TEST(test_retained_online_status_cancels_the_claim);
+  RUN_TEST(test_display_and_standalone_never_claim);
+  RUN_TEST(test_simultaneous_claims_settle_on_lowest_id);
+  RUN_TEST(test_configured_gateway_beats_an_elected_one);
+  RUN_TEST(test_fleet_settles_after_every_hand_over);
+  RUN_TEST(test_fleet_with_a_configured_gateway);
+  return UNITY_END();
+}
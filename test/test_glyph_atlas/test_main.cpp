@@ -0,0 +1,147 @@
+// GlyphAtlas against drawString on a FramebufferSurface: the same pixels for
+// the same text, rolling redraws that end where a full draw would, and a
+// benchmark of price updates through both paths.
+
+#include <Arduino.h>
+#include <M5Unified.h>
+#include <unity.h>
+#include "config.h"
+#include "framebuffer_surface.h"
+#include "glyph_atlas.h"
+
+static const int BENCH_UPDATES = 50000; // Keeps the uint32 pixel totals from wrapping
+static const int PRICE_X = 30;
+static const int PRICE_Y = 43;
+
+static FramebufferSurface text;
+static FramebufferSurface blitted;
+static GlyphAtlas* atlas;
+
+// "104,231.50" like CryptoDisplay
+static void formatPrice(char* out, double price) {
+  char digits[24];
+  snprintf(digits, sizeof(digits), "%.2f", price);
+  const char* point = strchr(digits, '.');
+  int whole = point - digits;
+  int k = 0;
+  for (int i = 0; i < whole; i++) {
+    if (i > 0 && (whole - i) % 3 == 0) {
+      out[k++] = ',';
+    }
+    out[k++] = digits[i];
+  }
+  strcpy(out + k, point);
+}
+
+// One price step of -0.20 to +0.20
+static double step(double price) {
+  return price + (rand() % 41 - 20) / 100.0;
+}
+
+void setUp(void) {
+  text = FramebufferSurface();
+  blitted = FramebufferSurface();
+  text.setTextFont(2);
+  text.setTextSize(2);
+  atlas = new GlyphAtlas();
+  TEST_ASSERT_TRUE(atlas->build(text));
+  text.resetStats();
+  srand(1);
+}
+
+void tearDown(void) {
+  delete atlas;
+}
+
+void test_blit_matches_draw_string(void) {
+  const char* prices[] = {"104,231.50", "0.62", "-1.00", "$3,999.99"};
+  for (size_t i = 0; i < sizeof(prices) / sizeof(prices[0]); i++) {
+    text.fillScreen(COLOR_BACKGROUND);
+    blitted.fillScreen(COLOR_BACKGROUND);
+    TEST_ASSERT_TRUE(atlas->covers(prices[i]));
+    text.setTextColor(COLOR_PRICE, COLOR_BACKGROUND);
+    text.setTextDatum(TL_DATUM);
+    int width = text.drawString(prices[i], PRICE_X, PRICE_Y);
+    TEST_ASSERT_EQUAL_INT(width, atlas->drawText(blitted, prices[i], PRICE_X, PRICE_Y, COLOR_PRICE, COLOR_BACKGROUND));
+    TEST_ASSERT_EQUAL_INT(0, text.countDifferences(blitted));
+  }
+  TEST_ASSERT_FALSE(atlas->covers("BTC"));
+}
+
+void test_rolling_redraws_end_like_a_full_draw(void) {
+  char previous[24];
+  char current[24];
+  double price = 104231.50;
+  formatPrice(previous, price);
+  atlas->drawText(blitted, previous, PRICE_X, PRICE_Y, COLOR_PRICE, COLOR_BACKGROUND);
+  for (int i = 0; i < 1000; i++) {
+    price = step(price);
+    formatPrice(current, price);
+    TEST_ASSERT_TRUE(atlas->sameLayout(current, previous));
+    atlas->drawText(blitted, current, PRICE_X, PRICE_Y, COLOR_PRICE, COLOR_BACKGROUND, previous);
+    strcpy(previous, current);
+  }
+  TEST_ASSERT_GREATER_THAN(0, atlas->skippedCount());
+
+  text.setTextColor(COLOR_PRICE, COLOR_BACKGROUND);
+  text.setTextDatum(TL_DATUM);
+  text.drawString(current, PRICE_X, PRICE_Y);
+  TEST_ASSERT_EQUAL_INT(0, text.countDifferences(blitted));
+  TEST_ASSERT_FALSE(atlas->sameLayout("9,999.99", "10,000.00"));
+}
+
+void test_benchmark_blit_against_draw_string(void) {
+  char previous[24] = "";
+  char current[24];
+
+  // The old price path: clear the strip, measure, draw the string
+  double price = 104231.50;
+  unsigned long started = micros();
+  for (int i = 0; i < BENCH_UPDATES; i++) {
+    price = step(price);
+    formatPrice(current, price);
+    text.fillRect(FRAME_MARGIN + 2, PRICE_Y - 5, SCREEN_WIDTH - FRAME_MARGIN * 2 - 4, 25, COLOR_BACKGROUND);
+    text.setTextColor(COLOR_PRICE, COLOR_BACKGROUND);
+    text.setTextDatum(TL_DATUM);
+    text.drawString(current, CENTER_X - text.textWidth(current) / 2, PRICE_Y);
+  }
+  unsigned long textUs = micros() - started;
+
+  // The atlas: only the digits that changed while the layout holds
+  price = 104231.50;
+  srand(1);
+  started = micros();
+  for (int i = 0; i < BENCH_UPDATES; i++) {
+    price = step(price);
+    formatPrice(current, price);
+    bool rolling = previous[0] != '\0' && atlas->sameLayout(current, previous);
+    if (!rolling) {
+      blitted.fillRect(FRAME_MARGIN + 2, PRICE_Y - 5, SCREEN_WIDTH - FRAME_MARGIN * 2 - 4, 25, COLOR_BACKGROUND);
+    }
+    atlas->drawText(blitted, current, CENTER_X - atlas->textWidth(current) / 2, PRICE_Y, COLOR_PRICE,
+                    COLOR_BACKGROUND, rolling ? previous : nullptr);
+    strcpy(previous, current);
+  }
+  unsigned long atlasUs = micros() - started;
+
+  const SurfaceStats& textStats = text.totalStats();
+  const SurfaceStats& atlasStats = blitted.totalStats();
+  printf("GlyphAtlas: drawString %.2f us, %u bytes, %.1f calls per update; "
+         "atlas %.2f us, %u bytes, %.1f calls per update (%u blits, %u cells skipped, %u bytes of masks)\n",
+         (double)textUs / BENCH_UPDATES, (unsigned)(textStats.bytesPushed() / BENCH_UPDATES),
+         (double)textStats.drawCalls / BENCH_UPDATES, (double)atlasUs / BENCH_UPDATES,
+         (unsigned)(atlasStats.bytesPushed() / BENCH_UPDATES), (double)atlasStats.drawCalls / BENCH_UPDATES,
+         (unsigned)atlas->blitCount(), (unsigned)atlas->skippedCount(), (unsigned)atlas->memoryBytes());
+
+  // Same final picture, a fraction of the traffic
+  TEST_ASSERT_EQUAL_INT(0, text.countDifferences(blitted));
+  TEST_ASSERT_LESS_THAN(textStats.bytesPushed() / 4, atlasStats.bytesPushed());
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_blit_matches_draw_string);
+  RUN_TEST(test_rolling_redraws_end_like_a_full_draw);
+  RUN_TEST(test_benchmark_blit_against_draw_string);
+  return UNITY_END();
+}
@@ -0,0 +1,114 @@
+// The overview grid through CryptoDisplay on a FramebufferSurface: bytes
+// pushed per update from the surface's per-frame counters, and incremental
+// cell redraws against a clean repaint.
+
+#include <Arduino.h>
+#include <unity.h>
+#include "crypto_display.h"
+#include "framebuffer_surface.h"
+
+static const int ASSETS = 6;
+static const int BENCH_UPDATES = 10000;
+
+static FramebufferSurface surface;
+static FramebufferSurface reference;
+static AssetData assets[ASSETS];
+
+static void resetAssets() {
+  const char* symbols[ASSETS] = {"BTC", "ETH", "XRP", "SOL", "MSFT", "AAPL"};
+  const float prices[ASSETS] = {104231.5f, 4512.25f, 3.1234f, 241.7f, 431.1f, 228.4f};
+  for (int i = 0; i < ASSETS; i++) {
+    assets[i] = AssetData();
+    assets[i].symbol = symbols[i];
+    assets[i].name = symbols[i];
+    assets[i].price = prices[i];
+    assets[i].change24h = 1.5f - i;
+    assets[i].currency = "CAD";
+  }
+}
+
+// One cell filled once. A redraw clears the cell and draws text over it, so
+// it pushes between one and two of these
+static uint32_t cellBytes() {
+  int x, y, w, h;
+  GridView::cellRect(0, x, y, w, h);
+  return (uint32_t)w * h * 2;
+}
+
+void setUp(void) {
+  surface.resetStats();
+  reference.resetStats();
+  resetAssets();
+}
+
+void tearDown(void) {
+}
+
+void test_first_frame_paints_everything(void) {
+  CryptoDisplay display(surface);
+  display.begin();
+  display.displayGrid(assets, ASSETS, 0);
+  const SurfaceStats& frame = surface.lastFrameStats();
+  TEST_ASSERT_EQUAL_UINT32(1, frame.fullClears);
+  TEST_ASSERT_GREATER_OR_EQUAL(SCREEN_WIDTH * SCREEN_HEIGHT * 2, frame.bytesPushed());
+}
+
+void test_unchanged_refresh_pushes_nothing(void) {
+  CryptoDisplay display(surface);
+  display.begin();
+  display.displayGrid(assets, ASSETS, 0);
+  display.displayGrid(assets, ASSETS, 0);
+  TEST_ASSERT_EQUAL_UINT32(0, surface.lastFrameStats().bytesPushed());
+  TEST_ASSERT_EQUAL_UINT32(0, surface.lastFrameStats().drawCalls);
+}
+
+void test_price_update_pushes_one_cell(void) {
+  CryptoDisplay display(surface);
+  display.begin();
+  display.displayGrid(assets, ASSETS, 0);
+  assets[2].price = 3.2f;
+  display.displayGrid(assets, ASSETS, 0);
+  uint32_t bytes = surface.lastFrameStats().bytesPushed();
+  TEST_ASSERT_GREATER_THAN(cellBytes(), bytes);
+  TEST_ASSERT_LESS_OR_EQUAL(2 * cellBytes(), bytes);
+  TEST_ASSERT_EQUAL_UINT32(0, surface.lastFrameStats().fullClears);
+}
+
+void test_cell_redraws_match_a_full_repaint(void) {
+  CryptoDisplay display(surface);
+  display.begin();
+  display.displayGrid(assets, ASSETS, 0);
+  uint32_t firstBytes = surface.lastFrameStats().bytesPushed();
+  srand(5);
+
+  uint32_t updateBytes = 0;
+  uint32_t updateCalls = 0;
+  for (int i = 0; i < BENCH_UPDATES; i++) {
+    AssetData& asset = assets[rand() % ASSETS];
+    asset.price *= 1.0f + (float)(rand() % 201 - 100) / 100000.0f;
+    asset.change24h += (float)(rand() % 21 - 10) / 100.0f;
+    display.displayGrid(assets, ASSETS, 0);
+    updateBytes += surface.lastFrameStats().bytesPushed();
+    updateCalls += surface.lastFrameStats().drawCalls;
+  }
+  printf("GridView: %d single-asset updates, %u bytes and %.1f draw calls per update "
+         "(one cell's area is %u bytes; the first frame pushed %u)\n",
+         BENCH_UPDATES, (unsigned)(updateBytes / BENCH_UPDATES), (double)updateCalls / BENCH_UPDATES,
+         (unsigned)cellBytes(), (unsigned)firstBytes);
+  TEST_ASSERT_LESS_OR_EQUAL(2 * cellBytes(), updateBytes / BENCH_UPDATES);
+  TEST_ASSERT_LESS_THAN(firstBytes / 10, updateBytes / BENCH_UPDATES);
+
+  CryptoDisplay fresh(reference);
+  fresh.begin();
+  fresh.displayGrid(assets, ASSETS, 0);
+  TEST_ASSERT_EQUAL_INT(0, surface.countDifferences(reference));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_frame_paints_everything);
+  RUN_TEST(test_unchanged_refresh_pushes_nothing);
+  RUN_TEST(test_price_update_pushes_one_cell);
+  RUN_TEST(test_cell_redraws_match_a_full_repaint);
+  return UNITY_END();
+}
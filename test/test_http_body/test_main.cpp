@@ -0,0 +1,401 @@
+// HttpBodyStream against canned responses served in irregular socket reads:
+// plain and chunked bodies, gzip with and without the optional header
+// fields, bodies larger than the 32KB window, deflate data ending mid-byte
+// with the trailer split between tinfl's look-ahead and the socket, a
+// kept-alive connection left at the next response, and the truncated/corrupt
+// cases. The benchmark
+// inflates a large quote response the way deserializeJson pulls it.
+//
+// gzip bodies are produced with zlib, the same library the miniz stand-in
+// inflates with; the header with every optional field is built by hand.
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <unity.h>
+#include <zlib.h>
+#include <string>
+#include <vector>
+#include "http_body.h"
+
+static const int BENCH_BODIES = 50;
+
+// A socket with a response waiting: reads return 1..maxRead bytes, and the
+// server closes after the last byte unless the connection is kept alive
+class CannedClient : public WiFiClient {
+public:
+  CannedClient(const std::string& bytes, size_t maxRead, bool keepAlive = false)
+      : data(bytes), pos(0), maxRead(maxRead), keepAlive(keepAlive), reads(0) {}
+
+  uint8_t connected() override { return pos < data.size() || keepAlive; }
+  int available() override { return (int)(data.size() - pos); }
+  int read(uint8_t* buffer, size_t size) override {
+    size_t count = size < maxRead ? size : maxRead;
+    count = 1 + (reads++ * 7919) % count; // Irregular, like TCP segments
+    if (count > data.size() - pos) {
+      count = data.size() - pos;
+    }
+    memcpy(buffer, data.data() + pos, count);
+    pos += count;
+    return (int)count;
+  }
+  using WiFiClient::read;
+
+  std::string unread() const { return data.substr(pos); }
+
+private:
+  std::string data;
+  size_t pos;
+  size_t maxRead;
+  bool keepAlive;
+  uint32_t reads;
+};
+
+// A quotes-shaped JSON body of about `bytes`
+static std::string quotesJson(size_t bytes) {
+  std::string json = "{\"status\":{\"error_code\":0},\"data\":[";
+  char entry[160];
+  for (int id = 1; json.size() < bytes; id++) {
+    snprintf(entry, sizeof(entry),
+             "%s{\"id\":%d,\"symbol\":\"C%d\",\"quote\":{\"CAD\":{\"price\":%.6f,\"percent_change_24h\":%.4f}}}",
+             id > 1 ? "," : "", id, id, (rand() % 10000000) / 100.0, (rand() % 2001 - 1000) / 100.0);
+    json += entry;
+  }
+  return json + "]}";
+}
+
+static std::string gzipped(const std::string& text, int level = 6) {
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  TEST_ASSERT_EQUAL_INT(Z_OK, deflateInit2(&z, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY));
+  std::string out(deflateBound(&z, text.size()), '\0');
+  z.next_in = (Bytef*)text.data();
+  z.avail_in = text.size();
+  z.next_out = (Bytef*)&out[0];
+  z.avail_out = out.size();
+  TEST_ASSERT_EQUAL_INT(Z_STREAM_END, deflate(&z, Z_FINISH));
+  out.resize(z.total_out);
+  deflateEnd(&z);
+  return out;
+}
+
+static void appendLittleEndian(std::string& out, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    out += (char)((value >> (8 * i)) & 0xFF);
+  }
+}
+
+// FEXTRA, FNAME, FCOMMENT and FHCRC set, as few servers bother to send
+static std::string gzippedWithHeaderFields(const std::string& text) {
+  std::string out("\x1f\x8b\x08\x1e\0\0\0\0\0\x03", 10);
+  out += std::string("\x04\0AB\x01\x02", 6);   // 4 extra bytes
+  out += std::string("quotes.json\0", 12);
+  out += std::string("stand-in\0", 9);
+  out += std::string("\xAA\xBB", 2);          // Header CRC (not checked)
+
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  TEST_ASSERT_EQUAL_INT(Z_OK, deflateInit2(&z, 9, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY));
+  std::string raw(deflateBound(&z, text.size()), '\0');
+  z.next_in = (Bytef*)text.data();
+  z.avail_in = text.size();
+  z.next_out = (Bytef*)&raw[0];
+  z.avail_out = raw.size();
+  TEST_ASSERT_EQUAL_INT(Z_STREAM_END, deflate(&z, Z_FINISH));
+  raw.resize(z.total_out);
+  deflateEnd(&z);
+
+  out += raw;
+  appendLittleEndian(out, crc32(0, (const Bytef*)text.data(), text.size()));
+  appendLittleEndian(out, (uint32_t)text.size());
+  return out;
+}
+
+// Unused bits in the last byte of a gzip member's deflate data: zlib reports
+// them when Z_BLOCK stops at the end of the final block
+static int deflatePaddingBits(const std::string& wire) {
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  TEST_ASSERT_EQUAL_INT(Z_OK, inflateInit2(&z, -15));
+  std::string out(1 << 16, '\0');
+  z.next_in = (Bytef*)wire.data() + 10; // Plain 10-byte header
+  z.avail_in = wire.size() - 10;
+  int padding = -1;
+  while (padding < 0) {
+    z.next_out = (Bytef*)&out[0];
+    z.avail_out = out.size();
+    TEST_ASSERT_EQUAL_INT(Z_OK, inflate(&z, Z_BLOCK));
+    if ((z.data_type & 192) == 192) {
+      padding = z.data_type & 7;
+    }
+  }
+  inflateEnd(&z);
+  return padding;
+}
+
+// Transfer-Encoding: chunked with irregular chunk sizes, an extension and a trailer
+static std::string chunkedEncoding(const std::string& body) {
+  std::string out;
+  char line[32];
+  for (size_t pos = 0, n = 0; pos < body.size(); n++) {
+    size_t size = 1 + (n * 2654435761u) % 3000;
+    if (size > body.size() - pos) {
+      size = body.size() - pos;
+    }
+    snprintf(line, sizeof(line), n % 5 == 0 ? "%zx;name=value\r\n" : "%zX\r\n", size);
+    out += line;
+    out += body.substr(pos, size);
+    out += "\r\n";
+    pos += size;
+  }
+  return out + "0\r\nX-Checksum: none\r\n\r\n";
+}
+
+// Read the whole body the way deserializeJson does: readBytes() in blocks,
+// with single read()/peek() calls mixed in
+static std::string readAll(HttpBodyStream& body) {
+  std::string out;
+  char block[301];
+  for (int n = 0;; n++) {
+    if (n % 3 == 0) {
+      int peeked = body.peek();
+      int value = body.read();
+      if (value < 0) {
+        break;
+      }
+      TEST_ASSERT_EQUAL_INT(peeked, value);
+      out += (char)value;
+      continue;
+    }
+    size_t count = body.readBytes(block, sizeof(block));
+    if (count == 0) {
+      break;
+    }
+    out.append(block, count);
+  }
+  return out;
+}
+
+static HTTPClient* http;
+
+void setUp(void) {
+  http = new HTTPClient();
+  srand(11);
+}
+
+void tearDown(void) {
+  delete http;
+}
+
+void test_plain_body_with_content_length(void) {
+  std::string json = quotesJson(5000);
+  CannedClient socket(json + "HTTP/1.1 200 OK", 700, true); // Next response already queued
+  http->respondWith(HTTP_CODE_OK, &socket, json.size());
+
+  HttpBodyStream body;
+  TEST_ASSERT_TRUE(body.begin(*http));
+  TEST_ASSERT_FALSE(body.isCompressed());
+  TEST_ASSERT_EQUAL_STRING(json.c_str(), readAll(body).c_str());
+  TEST_ASSERT_TRUE(body.end());
+  TEST_ASSERT_EQUAL_size_t(json.size(), body.wireBytes());
+  TEST_ASSERT_EQUAL_size_t(json.size(), body.decodedBytes());
+  TEST_ASSERT_EQUAL_STRING("HTTP/1.1 200 OK", socket.unread().c_str());
+}
+
+void test_chunked_body_leaves_the_next_response(void) {
+  std::string json = quotesJson(20000);
+  CannedClient socket(chunkedEncoding(json) + "HTTP/1.1 200 OK", 1460, true);
+  http->respondWith(HTTP_CODE_OK, &socket, -1);
+  http->setResponseHeader("Transfer-Encoding", "Chunked");
+
+  HttpBodyStream body;
+  TEST_ASSERT_TRUE(body.begin(*http));
+  TEST_ASSERT_EQUAL_STRING(json.c_str(), readAll(body).c_str());
+  TEST_ASSERT_TRUE(body.end());
+  TEST_ASSERT_NULL(body.getError());
+  TEST_ASSERT_EQUAL_STRING("HTTP/1.1 200 OK", socket.unread().c_str());
+}
+
+void test_gzip_body_larger_than_the_window(void) {
+  std::string json = quotesJson(150000);
+  std::string wire = gzipped(json);
+  CannedClient socket(wire, 1460);
+  http->respondWith(HTTP_CODE_OK, &socket, wire.size());
+  http->setResponseHeader("Content-Encoding", "gzip");
+
+  HttpBodyStream body;
+  TEST_ASSERT_TRUE(body.begin(*http));
+  TEST_ASSERT_TRUE(body.isCompressed());
+  TEST_ASSERT_EQUAL_STRING(json.c_str(), readAll(body).c_str());
+  TEST_ASSERT_TRUE(body.end());
+  TEST_ASSERT_EQUAL_size_t(wire.size(), body.wireBytes());
+  TEST_ASSERT_EQUAL_size_t(json.size(), body.decodedBytes());
+  TEST_ASSERT_EQUAL_size_t(HTTP_BODY_INPUT_SIZE + sizeof(tinfl_decompressor) + TINFL_LZ_DICT_SIZE,
+                           body.bufferBytes());
+}
+
+void test_chunked_gzip_with_every_header_field(void) {
+  std::string json = quotesJson(40000);
+  std::string wire = gzippedWithHeaderFields(json);
+  CannedClient socket(chunkedEncoding(wire), 97);
+  http->respondWith(HTTP_CODE_OK, &socket, -1);
+  http->setResponseHeader("Transfer-Encoding", "chunked");
+  http->setResponseHeader("Content-Encoding", "GZIP");
+
+  HttpBodyStream body;
+  TEST_ASSERT_TRUE(body.begin(*http));
+  TEST_ASSERT_EQUAL_STRING(json.c_str(), readAll(body).c_str());
+  TEST_ASSERT_TRUE(body.end());
+  TEST_ASSERT_EQUAL_size_t(wire.size(), body.wireBytes());
+}
+
+// tinfl leaves the end of the deflate data mid-byte in its bit buffer, with
+// up to 4 trailer bytes after it; every split of the trailer between that
+// look-ahead and the input has to give back the right CRC and length
+void test_trailer_after_a_mid_byte_end(void) {
+  int midByte = 0;
+  int aligned = 0;
+  for (int length = 1; length <= 64; length++) {
+    std::string text = quotesJson(length * 5).substr(0, length * 5);
+    for (int level = 0; level <= 9; level += 9) { // Stored blocks end byte aligned
+      std::string wire = gzipped(text, level);
+      (deflatePaddingBits(wire) ? midByte : aligned)++;
+      for (size_t maxRead = 1; maxRead <= 12; maxRead++) {
+        CannedClient socket(wire, maxRead);
+        http->respondWith(HTTP_CODE_OK, &socket, wire.size());
+        http->setResponseHeader("Content-Encoding", "gzip");
+        HttpBodyStream body;
+        TEST_ASSERT_TRUE(body.begin(*http));
+        TEST_ASSERT_EQUAL_STRING(text.c_str(), readAll(body).c_str());
+        TEST_ASSERT_TRUE_MESSAGE(body.end(), body.getError());
+        TEST_ASSERT_EQUAL_size_t(text.size(), body.decodedBytes());
+      }
+    }
+  }
+  TEST_ASSERT_GREATER_THAN(0, midByte);
+  TEST_ASSERT_GREATER_THAN(0, aligned);
+}
+
+void test_end_drains_an_unread_body(void) {
+  std::string json = quotesJson(60000);
+  std::string wire = gzipped(json);
+  CannedClient socket(chunkedEncoding(wire) + "NEXT", 512, true);
+  http->respondWith(HTTP_CODE_OK, &socket, -1);
+  http->setResponseHeader("Transfer-Encoding", "chunked");
+  http->setResponseHeader("Content-Encoding", "gzip");
+
+  // The parser stops early (a filter matched everything it needed)
+  HttpBodyStream body;
+  TEST_ASSERT_TRUE(body.begin(*http));
+  char start[100];
+  TEST_ASSERT_EQUAL_size_t(sizeof(start), body.readBytes(start, sizeof(start)));
+  TEST_ASSERT_TRUE(body.end());
+  TEST_ASSERT_EQUAL_size_t(json.size(), body.decodedBytes()); // Trailer checked all the same
+  TEST_ASSERT_EQUAL_STRING("NEXT", socket.unread().c_str());
+}
+
+void test_bad_bodies_fail(void) {
+  std::string json = quotesJson(10000);
+  std::string wire = gzipped(json);
+
+  // Unsupported encoding
+  {
+    CannedClient socket(json, 512);
+    http->respondWith(HTTP_CODE_OK, &socket, json.size());
+    http->setResponseHeader("Content-Encoding", "br");
+    HttpBodyStream body;
+    TEST_ASSERT_FALSE(body.begin(*http));
+    TEST_ASSERT_EQUAL_STRING("Unsupported Content-Encoding", body.getError());
+  }
+  // Not gzip at all
+  {
+    CannedClient socket(json, 512);
+    http->respondWith(HTTP_CODE_OK, &socket, json.size());
+    http->setResponseHeader("Content-Encoding", "gzip");
+    HttpBodyStream body;
+    TEST_ASSERT_FALSE(body.begin(*http));
+    TEST_ASSERT_EQUAL_STRING("Not a gzip body", body.getError());
+  }
+  // CRC in the trailer doesn't match
+  {
+    std::string bad = wire;
+    bad[bad.size() - 8] ^= 0x01;
+    CannedClient socket(bad, 512);
+    http->respondWith(HTTP_CODE_OK, &socket, bad.size());
+    HttpBodyStream body;
+    TEST_ASSERT_TRUE(body.begin(*http));
+    readAll(body);
+    TEST_ASSERT_FALSE(body.end());
+    TEST_ASSERT_EQUAL_STRING("gzip checksum mismatch", body.getError());
+  }
+  // Server closes halfway through a Content-Length body
+  {
+    CannedClient socket(wire.substr(0, wire.size() / 2), 512);
+    http->respondWith(HTTP_CODE_OK, &socket, wire.size());
+    HttpBodyStream body;
+    TEST_ASSERT_TRUE(body.begin(*http));
+    std::string partial = readAll(body);
+    TEST_ASSERT_LESS_THAN(json.size(), partial.size());
+    TEST_ASSERT_EQUAL_STRING_LEN(json.c_str(), partial.c_str(), partial.size());
+    TEST_ASSERT_FALSE(body.end());
+    TEST_ASSERT_EQUAL_STRING("Connection closed mid-body", body.getError());
+  }
+  // Chunked body cut off before the last chunk
+  {
+    std::string chunked = chunkedEncoding(json);
+    CannedClient socket(chunked.substr(0, chunked.size() - 30), 512);
+    http->respondWith(HTTP_CODE_OK, &socket, -1);
+    http->setResponseHeader("Content-Encoding", "identity");
+    http->setResponseHeader("Transfer-Encoding", "chunked");
+    HttpBodyStream body;
+    TEST_ASSERT_TRUE(body.begin(*http));
+    readAll(body);
+    TEST_ASSERT_FALSE(body.end());
+    TEST_ASSERT_NOT_NULL(body.getError());
+  }
+}
+
+void test_benchmark_inflate_while_reading(void) {
+  std::string json = quotesJson(200000);
+  std::string wire = gzipped(json);
+  std::string chunked = chunkedEncoding(wire);
+  http->setResponseHeader("Transfer-Encoding", "chunked");
+  http->setResponseHeader("Content-Encoding", "gzip");
+
+  uint32_t inflateUs = 0;
+  size_t buffered = 0;
+  unsigned long started = micros();
+  for (int n = 0; n < BENCH_BODIES; n++) {
+    CannedClient socket(chunked, 1460);
+    http->respondWith(HTTP_CODE_OK, &socket, -1);
+    HttpBodyStream body;
+    TEST_ASSERT_TRUE(body.begin(*http));
+    char block[256];
+    size_t decoded = 0;
+    for (size_t count; (count = body.readBytes(block, sizeof(block))) > 0;) {
+      decoded += count;
+    }
+    TEST_ASSERT_TRUE(body.end());
+    TEST_ASSERT_EQUAL_size_t(json.size(), decoded);
+    inflateUs += body.inflateMicros();
+    buffered = body.bufferBytes();
+  }
+  unsigned long elapsed = micros() - started;
+  printf("HttpBodyStream: %u byte body as %u gzip bytes (chunked), %.0f us per body (%.0f us inflating), "
+         "%u bytes buffered\n",
+         (unsigned)json.size(), (unsigned)wire.size(), (double)elapsed / BENCH_BODIES,
+         (double)inflateUs / BENCH_BODIES, (unsigned)buffered);
+  TEST_ASSERT_LESS_THAN(json.size(), buffered); // Never the whole body
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_plain_body_with_content_length);
+  RUN_TEST(test_chunked_body_leaves_the_next_response);
+  RUN_TEST(test_gzip_body_larger_than_the_window);
+  RUN_TEST(test_chunked_gzip_with_every_header_field);
+  RUN_TEST(test_trailer_after_a_mid_byte_end);
+  RUN_TEST(test_end_drains_an_unread_body);
+  RUN_TEST(test_bad_bodies_fail);
+  RUN_TEST(test_benchmark_inflate_while_reading);
+  return UNITY_END();
+}
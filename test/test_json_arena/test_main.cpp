@@ -0,0 +1,150 @@
+// JsonArena behind ArenaJsonDocument: once the first update cycle has
+// measured each user, parsing the same responses again allocates nothing;
+// a second document while the arena is taken gets its own block, and an
+// overflow doubles the user's capacity until the document fits.
+//
+// Allocations are counted where memAlloc() ends up, in heap_caps_malloc().
+// jsonArena is one global, so each test uses its own JSON users.
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <unity.h>
+#include <string>
+#include "json_arena.h"
+
+static const int REPEATS = 100;
+
+static int mallocs;
+static int reallocs;
+static int frees;
+
+void* heap_caps_malloc(size_t size, uint32_t) {
+  mallocs++;
+  return malloc(size);
+}
+
+void* heap_caps_realloc(void* ptr, size_t size, uint32_t) {
+  reallocs++;
+  return realloc(ptr, size);
+}
+
+void heap_caps_free(void* ptr) {
+  if (ptr != nullptr) {
+    frees++;
+  }
+  free(ptr);
+}
+
+// A quotes-shaped response with `coins` entries
+static std::string quotesJson(int coins) {
+  std::string json = "{\"status\":{\"error_code\":0},\"data\":{";
+  char entry[160];
+  for (int id = 1; id <= coins; id++) {
+    snprintf(entry, sizeof(entry),
+             "%s\"%d\":{\"id\":%d,\"symbol\":\"C%d\",\"quote\":{\"CAD\":{\"price\":%d.25,\"percent_change_24h\":1.5}}}",
+             id > 1 ? "," : "", id, id, id, 1000 + id);
+    json += entry;
+  }
+  return json + "}}";
+}
+
+static bool parse(JsonUser user, size_t hint, const std::string& json) {
+  ArenaJsonDocument doc(user, hint);
+  DeserializationError error = deserializeJson(doc, json.c_str());
+  return !error && doc.memoryUsage() > 0;
+}
+
+void setUp(void) {
+  mallocs = 0;
+  reallocs = 0;
+  frees = 0;
+}
+
+void tearDown(void) {
+}
+
+void test_repeated_parses_allocate_nothing(void) {
+  std::string quotes = quotesJson(3);
+  std::string rates = "{\"result\":\"success\",\"rates\":{\"USD\":1,\"CAD\":1.37,\"EUR\":0.92}}";
+
+  // First cycle: sized from the hints, then measured
+  TEST_ASSERT_TRUE(parse(JSON_USER_CMC_QUOTES, 32768, quotes));
+  TEST_ASSERT_TRUE(parse(JSON_USER_FX_RATES, 4096, rates));
+  TEST_ASSERT_TRUE(jsonArena.need(JSON_USER_CMC_QUOTES) > 0);
+  TEST_ASSERT_TRUE(jsonArena.need(JSON_USER_CMC_QUOTES) < 32768);
+
+  // Second cycle shrinks the arena once to the largest measured need
+  TEST_ASSERT_TRUE(parse(JSON_USER_CMC_QUOTES, 32768, quotes));
+  TEST_ASSERT_TRUE(parse(JSON_USER_FX_RATES, 4096, rates));
+  TEST_ASSERT_EQUAL_size_t(jsonArena.need(JSON_USER_CMC_QUOTES), jsonArena.bufferSize());
+
+  int mallocsBefore = mallocs;
+  int freesBefore = frees;
+  uint32_t resizes = jsonArena.resizeCount();
+  for (int i = 0; i < REPEATS; i++) {
+    TEST_ASSERT_TRUE(parse(JSON_USER_CMC_QUOTES, 32768, quotes));
+    TEST_ASSERT_TRUE(parse(JSON_USER_FX_RATES, 4096, rates));
+  }
+  TEST_ASSERT_EQUAL_INT(mallocsBefore, mallocs);
+  TEST_ASSERT_EQUAL_INT(freesBefore, frees);
+  TEST_ASSERT_EQUAL_INT(0, reallocs);
+  TEST_ASSERT_EQUAL_UINT32(resizes, jsonArena.resizeCount());
+  TEST_ASSERT_EQUAL_UINT32(0, jsonArena.fallbackCount());
+  TEST_ASSERT_EQUAL_UINT32(0, jsonArena.overflows(JSON_USER_CMC_QUOTES));
+}
+
+void test_nested_document_gets_its_own_block(void) {
+  std::string state = "{\"online\":true,\"assets\":[1,2,3]}";
+  TEST_ASSERT_TRUE(parse(JSON_USER_MQTT_STATE, 512, state)); // Measured once
+  int mallocsBefore = mallocs;
+  uint32_t fallbacks = jsonArena.fallbackCount();
+  {
+    ArenaJsonDocument outer(JSON_USER_MQTT_STATE, 512);
+    TEST_ASSERT_FALSE(deserializeJson(outer, state.c_str()));
+    TEST_ASSERT_EQUAL_INT(mallocsBefore, mallocs); // The arena itself
+
+    ArenaJsonDocument inner(JSON_USER_MQTT_DISCOVERY, 256);
+    TEST_ASSERT_FALSE(deserializeJson(inner, state.c_str()));
+    TEST_ASSERT_EQUAL_INT(mallocsBefore + 1, mallocs);
+    TEST_ASSERT_EQUAL_UINT32(fallbacks + 1, jsonArena.fallbackCount());
+  }
+  TEST_ASSERT_EQUAL_INT(1, frees); // The nested block only; the arena is kept
+
+  // The arena is free again for the next document
+  TEST_ASSERT_TRUE(parse(JSON_USER_MQTT_STATE, 512, state));
+  TEST_ASSERT_EQUAL_UINT32(fallbacks + 1, jsonArena.fallbackCount());
+  TEST_ASSERT_EQUAL_INT(mallocsBefore + 1, mallocs);
+}
+
+void test_overflow_doubles_until_it_fits(void) {
+  std::string fleet = quotesJson(40);
+  Serial.muted = true;
+  int attempts = 1;
+  while (!parse(JSON_USER_FLEET, 64, fleet)) {
+    TEST_ASSERT_EQUAL_UINT32(attempts, jsonArena.overflows(JSON_USER_FLEET));
+    TEST_ASSERT_TRUE(attempts < 16);
+    attempts++;
+  }
+  Serial.muted = false;
+  TEST_ASSERT_TRUE(attempts > 1);
+  TEST_ASSERT_EQUAL_size_t(0, jsonArena.need(JSON_USER_FLEET) % JSON_ARENA_ROUND_BYTES);
+
+  // Measured with headroom after one more parse, then the need stays put
+  TEST_ASSERT_TRUE(parse(JSON_USER_FLEET, 64, fleet));
+  size_t need = jsonArena.need(JSON_USER_FLEET);
+  int mallocsBefore = mallocs;
+  for (int i = 0; i < REPEATS; i++) {
+    TEST_ASSERT_TRUE(parse(JSON_USER_FLEET, 64, fleet));
+  }
+  TEST_ASSERT_EQUAL_INT(mallocsBefore, mallocs);
+  TEST_ASSERT_EQUAL_size_t(need, jsonArena.need(JSON_USER_FLEET));
+  TEST_ASSERT_EQUAL_UINT32(attempts - 1, jsonArena.overflows(JSON_USER_FLEET));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_repeated_parses_allocate_nothing);
+  RUN_TEST(test_nested_document_gets_its_own_block);
+  RUN_TEST(test_overflow_doubles_until_it_fits);
+  return UNITY_END();
+}
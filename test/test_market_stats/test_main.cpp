@@ -0,0 +1,200 @@
+// MarketStats against straightforward recomputation: the sliding Welford
+// volatility against a two-pass standard deviation of the same returns, the
+// change windows against the price the window started at, and the EMAs
+// against their closed form. The benchmark streams millions of ticks and
+// checks the sliding variance hasn't drifted at the end.
+
+#include <Arduino.h>
+#include <unity.h>
+#include <math.h>
+#include <vector>
+#include "market_stats.h"
+
+static const time_t START = 1736942400; // 2025-01-15 12:00 UTC
+static const int BENCH_ASSETS = STATS_MAX_ASSETS;
+static const uint32_t BENCH_TICKS = 4000000;
+
+static MarketStats stats;
+
+static AssetData makeAsset(float price) {
+  AssetData asset = AssetData();
+  asset.symbol = "BTC";
+  asset.price = price;
+  asset.change24h = -1000.0f; // No provider figure unless a test sets one
+  return asset;
+}
+
+// +/- 0.5% per step, deterministic
+static float walk(float price) {
+  return price * (1.0f + (float)(rand() % 1001 - 500) / 100000.0f);
+}
+
+// Sample standard deviation of the returns between consecutive prices
+static double twoPassVolatility(const std::vector<float>& prices) {
+  std::vector<double> returns;
+  for (size_t i = 1; i < prices.size(); i++) {
+    returns.push_back((prices[i] / prices[i - 1] - 1.0f) * 100.0f);
+  }
+  double mean = 0;
+  for (size_t i = 0; i < returns.size(); i++) {
+    mean += returns[i];
+  }
+  mean /= returns.size();
+  double m2 = 0;
+  for (size_t i = 0; i < returns.size(); i++) {
+    m2 += (returns[i] - mean) * (returns[i] - mean);
+  }
+  return sqrt(m2 / (returns.size() - 1));
+}
+
+void setUp(void) {
+  stats = MarketStats();
+  stats.begin();
+  srand(7);
+}
+
+void tearDown(void) {
+}
+
+void test_volatility_matches_two_pass_over_the_ring(void) {
+  AssetData asset = makeAsset(50000.0f);
+  std::vector<float> sampled;
+  stats.recordPrice(0, asset, START);
+  sampled.push_back(asset.price);
+  TEST_ASSERT_FLOAT_IS_NAN(stats.get(0).volatility);
+
+  // Well past the ring size, so returns have been evicted many times
+  for (int i = 1; i < STATS_HISTORY * 20; i++) {
+    asset.price = walk(asset.price);
+    stats.recordPrice(0, asset, START + (time_t)i * STATS_SAMPLE_SEC);
+    sampled.push_back(asset.price);
+
+    std::vector<float> ring(sampled.size() > STATS_HISTORY ? sampled.end() - STATS_HISTORY : sampled.begin(),
+                            sampled.end());
+    if (ring.size() < 3) {
+      TEST_ASSERT_FLOAT_IS_NAN(stats.get(0).volatility);
+      continue;
+    }
+    double expected = twoPassVolatility(ring);
+    TEST_ASSERT_FLOAT_WITHIN(expected * 1e-4, expected, stats.get(0).volatility);
+  }
+}
+
+void test_ticks_between_samples_leave_volatility_alone(void) {
+  AssetData asset = makeAsset(100.0f);
+  stats.recordPrice(0, asset, START);
+  asset.price = 101.0f;
+  stats.recordPrice(0, asset, START + STATS_SAMPLE_SEC);
+  asset.price = 100.0f;
+  stats.recordPrice(0, asset, START + 2 * STATS_SAMPLE_SEC);
+  float before = stats.get(0).volatility;
+
+  // Wild ticks inside one sample period don't enter the ring
+  for (int second = 1; second < STATS_SAMPLE_SEC; second++) {
+    asset.price = (second % 2) ? 150.0f : 50.0f;
+    stats.recordPrice(0, asset, START + 2 * STATS_SAMPLE_SEC + second);
+  }
+  TEST_ASSERT_EQUAL_FLOAT(before, stats.get(0).volatility);
+}
+
+void test_window_change_uses_the_price_at_the_window_start(void) {
+  AssetData asset = makeAsset(2000.0f);
+  std::vector<float> sampled;
+  std::vector<time_t> sampledAt;
+  int longest = (int)MarketStats::windowSeconds(STATS_WINDOW_COUNT - 1);
+
+  // Ticks every 7 s; samples land on the first tick of each period
+  for (time_t now = START; now < START + 2 * longest; now += 7) {
+    asset.price = walk(asset.price);
+    stats.recordPrice(0, asset, now);
+    if (sampledAt.empty() || now - sampledAt.back() >= STATS_SAMPLE_SEC) {
+      sampled.push_back(asset.price);
+      sampledAt.push_back(now);
+    }
+    for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+      time_t windowStart = now - (time_t)MarketStats::windowSeconds(w);
+      if (windowStart < START) {
+        TEST_ASSERT_FLOAT_IS_NAN(stats.get(0).windowChange[w]);
+        continue;
+      }
+      // Newest sample at or before the window start
+      size_t index = 0;
+      while (index + 1 < sampledAt.size() && sampledAt[index + 1] <= windowStart) {
+        index++;
+      }
+      float expected = (asset.price / sampled[index] - 1.0f) * 100.0f;
+      TEST_ASSERT_FLOAT_WITHIN(1e-4f, expected, stats.get(0).windowChange[w]);
+    }
+  }
+}
+
+void test_ema_follows_a_step_with_its_time_constant(void) {
+  AssetData asset = makeAsset(100.0f);
+  stats.recordPrice(0, asset, START);
+  asset.price = 200.0f;
+  stats.recordPrice(0, asset, START + 300);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 100.0f + 100.0f * (1.0f - expf(-300.0f / STATS_EMA_FAST_SEC)),
+                           stats.get(0).emaFast);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 100.0f + 100.0f * (1.0f - expf(-300.0f / STATS_EMA_SLOW_SEC)),
+                           stats.get(0).emaSlow);
+
+  // A burst of ticks at the same second doesn't move them
+  float fast = stats.get(0).emaFast;
+  for (int i = 0; i < 100; i++) {
+    stats.recordPrice(0, asset, START + 300);
+  }
+  TEST_ASSERT_EQUAL_FLOAT(fast, stats.get(0).emaFast);
+}
+
+void test_change24h_follows_the_price_between_quotes(void) {
+  AssetData asset = makeAsset(110.0f);
+  asset.change24h = 10.0f; // 100 a day ago
+  stats.recordQuote(0, asset, START);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 10.0f, asset.change24h);
+  asset.price = 120.0f;
+  stats.recordPrice(0, asset, START + 5);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 20.0f, asset.change24h);
+}
+
+void test_benchmark_millions_of_ticks(void) {
+  AssetData assets[BENCH_ASSETS];
+  std::vector<float> sampled[BENCH_ASSETS];
+  for (int a = 0; a < BENCH_ASSETS; a++) {
+    assets[a] = makeAsset(100.0f + a);
+  }
+
+  // One tick per asset per second, round robin
+  unsigned long started = micros();
+  for (uint32_t tick = 0; tick < BENCH_TICKS; tick++) {
+    int a = tick % BENCH_ASSETS;
+    time_t now = START + tick / BENCH_ASSETS;
+    assets[a].price = walk(assets[a].price);
+    stats.recordPrice(a, assets[a], now);
+    if ((now - START) % STATS_SAMPLE_SEC == 0) {
+      sampled[a].push_back(assets[a].price);
+    }
+  }
+  unsigned long elapsed = micros() - started;
+  printf("MarketStats: %u ticks over %d assets in %lu ms (%.0f ns per tick)\n", (unsigned)BENCH_TICKS,
+         BENCH_ASSETS, elapsed / 1000, elapsed * 1000.0 / BENCH_TICKS);
+
+  // After ~4000 evictions per asset the sliding sums still match the ring
+  for (int a = 0; a < BENCH_ASSETS; a++) {
+    TEST_ASSERT_GREATER_THAN(STATS_HISTORY * 10, sampled[a].size());
+    std::vector<float> ring(sampled[a].end() - STATS_HISTORY, sampled[a].end());
+    double expected = twoPassVolatility(ring);
+    TEST_ASSERT_FLOAT_WITHIN(expected * 1e-3, expected, stats.get(a).volatility);
+    TEST_ASSERT_EQUAL_UINT32(BENCH_TICKS / BENCH_ASSETS, stats.get(a).updates);
+  }
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_volatility_matches_two_pass_over_the_ring);
+  RUN_TEST(test_ticks_between_samples_leave_volatility_alone);
+  RUN_TEST(test_window_change_uses_the_price_at_the_window_start);
+  RUN_TEST(test_ema_follows_a_step_with_its_time_constant);
+  RUN_TEST(test_change24h_follows_the_price_between_quotes);
+  RUN_TEST(test_benchmark_millions_of_ticks);
+  return UNITY_END();
+}
@@ -0,0 +1,245 @@
+// memAlloc placement on a test heap with separate internal and PSRAM
+// regions: which region each placement is served from, the fall back to
+// internal memory when PSRAM is missing or full, reallocation across
+// regions, the per-placement counters and the largest-block low-water mark.
+//
+// memHasPsram() probes psramFound() once per boot, so the run without PSRAM
+// happens in a forked child before this process probes (POSIX only).
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <unity.h>
+#include <map>
+#include "mem_alloc.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#include <unistd.h>
+#define CAN_FORK 1
+#endif
+
+enum Region : uint8_t { REGION_INTERNAL, REGION_PSRAM };
+
+struct Block {
+  size_t size;
+  Region region;
+};
+
+// Capacity left per region; blocks remember where they live
+static size_t regionFree[2];
+static std::map<void*, Block> blocks;
+static uint32_t lastCaps;
+static size_t largestInternalBlock = 110000;
+static bool psramPresent = true;
+static int psramProbes = 0;
+
+bool psramFound() {
+  psramProbes++;
+  return psramPresent;
+}
+
+void* heap_caps_malloc(size_t size, uint32_t caps) {
+  lastCaps = caps;
+  Region region = (caps & MALLOC_CAP_SPIRAM) ? REGION_PSRAM : REGION_INTERNAL;
+  if (size > regionFree[region]) {
+    return nullptr;
+  }
+  void* ptr = malloc(size > 0 ? size : 1);
+  regionFree[region] -= size;
+  Block block = {size, region};
+  blocks[ptr] = block;
+  return ptr;
+}
+
+void heap_caps_free(void* ptr) {
+  std::map<void*, Block>::iterator found = blocks.find(ptr);
+  if (found == blocks.end()) {
+    return;
+  }
+  regionFree[found->second.region] += found->second.size;
+  blocks.erase(found);
+  free(ptr);
+}
+
+// Always moves, into the region the caps ask for; the old block stays on failure
+void* heap_caps_realloc(void* ptr, size_t size, uint32_t caps) {
+  void* moved = heap_caps_malloc(size, caps);
+  if (moved == nullptr) {
+    return nullptr;
+  }
+  size_t oldSize = blocks[ptr].size;
+  memcpy(moved, ptr, oldSize < size ? oldSize : size);
+  heap_caps_free(ptr);
+  return moved;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? 0 : largestInternalBlock;
+}
+
+static Region regionOf(void* ptr) {
+  TEST_ASSERT_TRUE(blocks.count(ptr) == 1);
+  return blocks[ptr].region;
+}
+
+void setUp(void) {
+  regionFree[REGION_INTERNAL] = 64 * 1024;
+  regionFree[REGION_PSRAM] = 256 * 1024;
+}
+
+void tearDown(void) {
+  while (!blocks.empty()) {
+    heap_caps_free(blocks.begin()->first);
+  }
+}
+
+// Runs first: nothing has probed PSRAM in this process yet
+void test_without_psram_bulk_is_internal(void) {
+#if CAN_FORK
+  TEST_ASSERT_EQUAL_INT(0, psramProbes);
+  fflush(stdout);
+  pid_t child = fork();
+  TEST_ASSERT_NOT_EQUAL(-1, child);
+  if (child == 0) {
+    psramPresent = false;
+    void* bulk = memAlloc(1000, MEM_BULK);
+    bool ok = bulk != nullptr && regionOf(bulk) == REGION_INTERNAL && (lastCaps & MALLOC_CAP_SPIRAM) == 0 &&
+              memPlacementStats(MEM_BULK).fallbacks == 1 && !memHasPsram();
+    _exit(ok ? 0 : 1);
+  }
+  int status = 0;
+  waitpid(child, &status, 0);
+  TEST_ASSERT_TRUE(WIFEXITED(status));
+  TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+  TEST_ASSERT_EQUAL_INT(0, psramProbes); // The child's probe stayed in the child
+#else
+  TEST_IGNORE_MESSAGE("needs fork()");
+#endif
+}
+
+void test_placements_pick_their_region(void) {
+  MemPlacementStats before[MEM_PLACEMENT_COUNT];
+  for (int p = 0; p < MEM_PLACEMENT_COUNT; p++) {
+    before[p] = memPlacementStats((MemPlacement)p);
+  }
+
+  void* canvas = memAlloc(240 * 20 * 2, MEM_DMA);
+  TEST_ASSERT_EQUAL_INT(REGION_INTERNAL, regionOf(canvas));
+  TEST_ASSERT_TRUE(lastCaps & MALLOC_CAP_DMA);
+  void* hot = memAlloc(64, MEM_INTERNAL);
+  TEST_ASSERT_EQUAL_INT(REGION_INTERNAL, regionOf(hot));
+  TEST_ASSERT_FALSE(lastCaps & MALLOC_CAP_DMA);
+  void* arena = memAlloc(16 * 1024, MEM_BULK);
+  TEST_ASSERT_EQUAL_INT(REGION_PSRAM, regionOf(arena));
+  TEST_ASSERT_TRUE(memHasPsram());
+
+  for (int p = 0; p < MEM_PLACEMENT_COUNT; p++) {
+    TEST_ASSERT_EQUAL_UINT32(before[p].allocations + 1, memPlacementStats((MemPlacement)p).allocations);
+    TEST_ASSERT_EQUAL_UINT32(before[p].fallbacks, memPlacementStats((MemPlacement)p).fallbacks);
+  }
+  memFree(canvas);
+  memFree(hot);
+  memFree(arena);
+  memFree(nullptr);
+  TEST_ASSERT_TRUE(blocks.empty());
+  TEST_ASSERT_EQUAL_INT(1, psramProbes); // Probed once, then cached
+}
+
+void test_full_psram_falls_back_to_internal(void) {
+  MemPlacementStats before = memPlacementStats(MEM_BULK);
+  regionFree[REGION_PSRAM] = 4096;
+
+  void* fits = memAlloc(4096, MEM_BULK);
+  TEST_ASSERT_EQUAL_INT(REGION_PSRAM, regionOf(fits));
+  void* spilled = memAlloc(8192, MEM_BULK);
+  TEST_ASSERT_NOT_NULL(spilled);
+  TEST_ASSERT_EQUAL_INT(REGION_INTERNAL, regionOf(spilled));
+  TEST_ASSERT_EQUAL_UINT32(before.fallbacks + 1, memPlacementStats(MEM_BULK).fallbacks);
+
+  // Nowhere left: a counted failure, not a crash
+  Serial.muted = true;
+  void* none = memAlloc(128 * 1024, MEM_BULK);
+  Serial.muted = false;
+  TEST_ASSERT_NULL(none);
+  TEST_ASSERT_EQUAL_UINT32(before.failures + 1, memPlacementStats(MEM_BULK).failures);
+  TEST_ASSERT_EQUAL_UINT32(before.allocations + 2, memPlacementStats(MEM_BULK).allocations);
+
+  // DMA buffers never go to PSRAM, even when internal memory is short
+  regionFree[REGION_INTERNAL] = 100;
+  regionFree[REGION_PSRAM] = 64 * 1024;
+  Serial.muted = true;
+  TEST_ASSERT_NULL(memAlloc(4800, MEM_DMA));
+  Serial.muted = false;
+}
+
+void test_realloc_moves_within_the_placement(void) {
+  regionFree[REGION_PSRAM] = 10000;
+  uint8_t* buffer = (uint8_t*)memAlloc(4000, MEM_BULK);
+  for (int i = 0; i < 4000; i++) {
+    buffer[i] = (uint8_t)i;
+  }
+
+  // Grows in PSRAM while it fits, then spills to internal with the data intact
+  buffer = (uint8_t*)memRealloc(buffer, 6000, MEM_BULK);
+  TEST_ASSERT_EQUAL_INT(REGION_PSRAM, regionOf(buffer));
+  buffer = (uint8_t*)memRealloc(buffer, 12000, MEM_BULK);
+  TEST_ASSERT_NOT_NULL(buffer);
+  TEST_ASSERT_EQUAL_INT(REGION_INTERNAL, regionOf(buffer));
+  for (int i = 0; i < 4000; i++) {
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)i, buffer[i]);
+  }
+
+  // Too big for either: nullptr and the old block untouched
+  uint32_t failures = memPlacementStats(MEM_BULK).failures;
+  TEST_ASSERT_NULL(memRealloc(buffer, 1024 * 1024, MEM_BULK));
+  TEST_ASSERT_EQUAL_UINT32(failures + 1, memPlacementStats(MEM_BULK).failures);
+  TEST_ASSERT_EQUAL_UINT8(200, buffer[200]);
+  memFree(buffer);
+
+  // nullptr reallocates like memAlloc
+  void* fresh = memRealloc(nullptr, 100, MEM_INTERNAL);
+  TEST_ASSERT_EQUAL_INT(REGION_INTERNAL, regionOf(fresh));
+  memFree(fresh);
+}
+
+void test_calloc_zeroes_and_rejects_overflow(void) {
+  uint32_t* table = (uint32_t*)memCalloc(256, sizeof(uint32_t), MEM_BULK);
+  TEST_ASSERT_NOT_NULL(table);
+  for (int i = 0; i < 256; i++) {
+    TEST_ASSERT_EQUAL_UINT32(0, table[i]);
+  }
+  TEST_ASSERT_EQUAL_size_t(1024, blocks[table].size);
+  size_t held = blocks.size();
+  TEST_ASSERT_NULL(memCalloc(SIZE_MAX / 2, 4, MEM_BULK));
+  TEST_ASSERT_EQUAL_size_t(held, blocks.size());
+  memFree(table);
+}
+
+void test_heap_low_water_mark(void) {
+  largestInternalBlock = 90000;
+  memSampleHeap(10000);
+  TEST_ASSERT_EQUAL_UINT32(90000, memLargestInternalBlockMin());
+
+  // Samples are throttled to MEM_SAMPLE_MS
+  largestInternalBlock = 40000;
+  memSampleHeap(10000 + MEM_SAMPLE_MS - 1);
+  TEST_ASSERT_EQUAL_UINT32(90000, memLargestInternalBlockMin());
+  memSampleHeap(10000 + MEM_SAMPLE_MS);
+  TEST_ASSERT_EQUAL_UINT32(40000, memLargestInternalBlockMin());
+
+  // The minimum stays after the heap recovers
+  largestInternalBlock = 100000;
+  memSampleHeap(10000 + 2 * MEM_SAMPLE_MS);
+  TEST_ASSERT_EQUAL_UINT32(40000, memLargestInternalBlockMin());
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_without_psram_bulk_is_internal);
+  RUN_TEST(test_placements_pick_their_region);
+  RUN_TEST(test_full_psram_falls_back_to_internal);
+  RUN_TEST(test_realloc_moves_within_the_placement);
+  RUN_TEST(test_calloc_zeroes_and_rejects_overflow);
+  RUN_TEST(test_heap_low_water_mark);
+  return UNITY_END();
+}
@@ -0,0 +1,232 @@
+// PriceHistory on the in-memory fs::FS: points through flush and reboot,
+// compaction down to the coarsest tier, recovery of a torn active segment,
+// range queries that leave other segments closed, and a month of appends.
+//
+// Prices are 1000 + the minute since START, so every stored point tells
+// which raw sample it came from.
+
+#include <Arduino.h>
+#include <FS.h>
+#include <unity.h>
+#include <vector>
+#include "price_history.h"
+
+static const time_t START = 1736942400; // 2025-01-15 12:00 UTC
+static const int ASSETS = 16;
+static const char* SYMBOLS[ASSETS] = {"BTC", "ETH", "XRP", "SOL", "ADA", "DOGE", "DOT", "LTC",
+                                      "MSFT", "AAPL", "NVDA", "AMZN", "GOOG", "META", "TSLA", "AMD"};
+
+static fs::FS* flash;
+static AssetData assets[ASSETS];
+
+static float priceAt(time_t epoch) {
+  return 1000.0f + (float)((epoch - START) / HISTORY_SAMPLE_SEC);
+}
+
+static time_t sampleEpoch(float price) {
+  return START + (time_t)(price - 1000.0f) * HISTORY_SAMPLE_SEC;
+}
+
+// One sample per asset every HISTORY_SAMPLE_SEC from START for `minutes`
+static void record(PriceHistory& history, int count, int minutes) {
+  for (int minute = 0; minute < minutes; minute++) {
+    time_t now = START + (time_t)minute * HISTORY_SAMPLE_SEC;
+    for (int i = 0; i < count; i++) {
+      assets[i].sourceTime = now;
+      assets[i].price = priceAt(now);
+    }
+    history.sample(assets, count, now);
+  }
+}
+
+static void collect(const HistoryPoint& point, void* context) {
+  static_cast<std::vector<HistoryPoint>*>(context)->push_back(point);
+}
+
+static std::vector<HistoryPoint> query(PriceHistory& history, const char* symbol, time_t from, time_t to) {
+  std::vector<HistoryPoint> points;
+  history.query(symbol, from, to, collect, &points);
+  return points;
+}
+
+void setUp(void) {
+  flash = new fs::FS();
+  for (int i = 0; i < ASSETS; i++) {
+    assets[i] = AssetData();
+    assets[i].symbol = SYMBOLS[i];
+  }
+}
+
+void tearDown(void) {
+  delete flash;
+}
+
+void test_points_survive_flush_and_reboot(void) {
+  PriceHistory history;
+  TEST_ASSERT_TRUE(history.begin(*flash));
+  record(history, 2, 100);
+
+  // Buffered points answer queries before they reach flash
+  std::vector<HistoryPoint> points = query(history, "ETH", START, START + 100 * 60);
+  TEST_ASSERT_EQUAL_size_t(100, points.size());
+  TEST_ASSERT_TRUE(history.flush());
+
+  PriceHistory rebooted;
+  TEST_ASSERT_TRUE(rebooted.begin(*flash));
+  TEST_ASSERT_EQUAL_UINT32(200, rebooted.storedRecords(PriceHistory::TIER_RAW));
+  points = query(rebooted, "ETH", START + 60, START + 120);
+  TEST_ASSERT_EQUAL_size_t(2, points.size());
+  TEST_ASSERT_EQUAL_INT32(START + 60, points[0].epoch);
+  TEST_ASSERT_EQUAL_FLOAT(priceAt(START + 60), points[0].price);
+  TEST_ASSERT_EQUAL_size_t(0, query(rebooted, "SOL", START, START + 6000).size());
+}
+
+void test_compaction_reaches_every_tier(void) {
+  PriceHistory history;
+  TEST_ASSERT_TRUE(history.begin(*flash));
+  const int minutes = 10 * 24 * 60;
+  record(history, ASSETS, minutes);
+  history.flush();
+
+  TEST_ASSERT_EQUAL_INT(HISTORY_RAW_SEGMENTS + 1, history.segmentCount(PriceHistory::TIER_RAW));
+  TEST_ASSERT_EQUAL_INT(HISTORY_ROLLUP_1_SEGMENTS + 1, history.segmentCount(PriceHistory::TIER_ROLLUP_1));
+  TEST_ASSERT_GREATER_THAN(0, history.storedRecords(PriceHistory::TIER_ROLLUP_2));
+  TEST_ASSERT_EQUAL_UINT32(0, history.writeErrorCount());
+
+  // Oldest first across the tiers (the first point off a tier's bucket grid
+  // starts the next tier); each rollup point is a close from its bucket
+  std::vector<HistoryPoint> points = query(history, "MSFT", 0, START + minutes * 60);
+  TEST_ASSERT_GREATER_THAN(0, points.size());
+  uint32_t bucketSec = HISTORY_ROLLUP_2_SEC;
+  int rollup2 = 0;
+  int rollup1 = 0;
+  for (size_t i = 0; i < points.size(); i++) {
+    if (i > 0) {
+      TEST_ASSERT_GREATER_OR_EQUAL(points[i - 1].epoch, points[i].epoch);
+      // Coarser tiers cover everything before the finer ones: no gaps
+      TEST_ASSERT_LESS_OR_EQUAL(HISTORY_ROLLUP_2_SEC, points[i].epoch - points[i - 1].epoch);
+    }
+    time_t source = sampleEpoch(points[i].price);
+    if (bucketSec == HISTORY_ROLLUP_2_SEC && points[i].epoch % HISTORY_ROLLUP_2_SEC != 0) {
+      bucketSec = HISTORY_ROLLUP_1_SEC;
+    }
+    if (bucketSec == HISTORY_ROLLUP_1_SEC && points[i].epoch % HISTORY_ROLLUP_1_SEC != 0) {
+      bucketSec = HISTORY_SAMPLE_SEC;
+    }
+    if (bucketSec == HISTORY_SAMPLE_SEC) {
+      TEST_ASSERT_EQUAL_INT32(points[i].epoch, source);
+      continue;
+    }
+    (bucketSec == HISTORY_ROLLUP_2_SEC ? rollup2 : rollup1)++;
+    TEST_ASSERT_EQUAL_INT32(0, points[i].epoch % bucketSec);
+    TEST_ASSERT_GREATER_OR_EQUAL(points[i].epoch, source);
+    TEST_ASSERT_LESS_THAN(points[i].epoch + (time_t)bucketSec, source);
+  }
+  TEST_ASSERT_GREATER_THAN(0, rollup2);
+  TEST_ASSERT_GREATER_THAN(0, rollup1);
+  TEST_ASSERT_EQUAL_INT32(START + (minutes - 1) * 60, points.back().epoch);
+}
+
+void test_torn_active_segment_is_recovered(void) {
+  {
+    PriceHistory history;
+    TEST_ASSERT_TRUE(history.begin(*flash));
+    record(history, 2, 50);
+    history.flush();
+  }
+  // Power lost halfway through the next record
+  const char* active = "/hist/0_0.bin";
+  TEST_ASSERT_TRUE(flash->exists(active));
+  File file = flash->open(active, FILE_APPEND);
+  const uint8_t half[5] = {1, 2, 3, 4, 5};
+  file.write(half, sizeof(half));
+  file.close();
+
+  PriceHistory history;
+  TEST_ASSERT_TRUE(history.begin(*flash));
+  TEST_ASSERT_EQUAL_UINT32(100, history.storedRecords(PriceHistory::TIER_RAW));
+  // New points go to a fresh, aligned segment
+  TEST_ASSERT_EQUAL_INT(2, history.segmentCount(PriceHistory::TIER_RAW));
+
+  // Resampling starts after the last point on flash
+  for (int minute = 50; minute < 60; minute++) {
+    time_t now = START + minute * 60;
+    assets[0].sourceTime = now;
+    assets[0].price = priceAt(now);
+    history.sample(assets, 1, now);
+  }
+  history.flush();
+  std::vector<HistoryPoint> points = query(history, "BTC", START, START + 3600);
+  TEST_ASSERT_EQUAL_size_t(60, points.size());
+  for (size_t i = 0; i < points.size(); i++) {
+    TEST_ASSERT_EQUAL_INT32(START + (time_t)i * 60, points[i].epoch);
+    TEST_ASSERT_EQUAL_FLOAT(priceAt(points[i].epoch), points[i].price);
+  }
+}
+
+void test_range_query_opens_only_overlapping_segments(void) {
+  PriceHistory history;
+  TEST_ASSERT_TRUE(history.begin(*flash));
+  record(history, ASSETS, 8 * 64); // About eight raw segments
+  history.flush();
+  int segments = history.segmentCount(PriceHistory::TIER_RAW);
+  TEST_ASSERT_GREATER_THAN(4, segments);
+
+  uint32_t scanned = history.segmentsScannedCount();
+  uint32_t skipped = history.segmentsSkippedCount();
+  time_t from = START + 100 * 60;
+  std::vector<HistoryPoint> points = query(history, "ETH", from, from + 10 * 60);
+  TEST_ASSERT_EQUAL_size_t(11, points.size());
+  TEST_ASSERT_EQUAL_UINT32(1, history.segmentsScannedCount() - scanned);
+  // Every other segment of every tier is skipped from the index alone
+  TEST_ASSERT_EQUAL_UINT32(segments - 1 + history.segmentCount(PriceHistory::TIER_ROLLUP_1) +
+                           history.segmentCount(PriceHistory::TIER_ROLLUP_2),
+                           history.segmentsSkippedCount() - skipped);
+}
+
+void test_benchmark_month_of_appends(void) {
+  PriceHistory history;
+  TEST_ASSERT_TRUE(history.begin(*flash));
+  const int minutes = 30 * 24 * 60;
+  unsigned long started = micros();
+  record(history, ASSETS, minutes);
+  history.flush();
+  unsigned long elapsed = micros() - started;
+  uint32_t appended = history.appendedCount();
+  printf("PriceHistory: %u points (a month of %d assets) in %lu ms, %.2f us per point; "
+         "%u file writes, %llu bytes written, %u compactions, %u bytes on flash\n",
+         (unsigned)appended, ASSETS, elapsed / 1000, (double)elapsed / appended, (unsigned)flash->writeCalls(),
+         (unsigned long long)flash->bytesWritten(), (unsigned)history.compactionCount(),
+         (unsigned)flash->usedBytes());
+
+  time_t end = START + (time_t)minutes * 60;
+  const struct {
+    const char* name;
+    time_t from;
+  } ranges[] = {{"1h", end - 3600}, {"24h", end - 86400}, {"7d", end - 7 * 86400}, {"all", 0}};
+  for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++) {
+    uint32_t scanned = history.segmentsScannedCount();
+    size_t found = query(history, "BTC", ranges[r].from, end).size();
+    printf("PriceHistory: query %-3s %5u points in %u us, %u segments read\n", ranges[r].name, (unsigned)found,
+           (unsigned)history.lastQueryMicros(), (unsigned)(history.segmentsScannedCount() - scanned));
+  }
+
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)minutes * ASSETS, appended);
+  TEST_ASSERT_EQUAL_UINT32(0, history.writeErrorCount());
+  // Fixed space: every tier at its budget plus the active segment, and the index
+  size_t segmentBytes = HISTORY_SEGMENT_RECORDS * 12;
+  size_t budget = (HISTORY_RAW_SEGMENTS + HISTORY_ROLLUP_1_SEGMENTS + HISTORY_ROLLUP_2_SEGMENTS + 3) * segmentBytes;
+  TEST_ASSERT_LESS_THAN(budget + 4096, flash->usedBytes());
+  // Buffered: one write per HISTORY_BUFFER_RECORDS points, plus compaction and the index
+  TEST_ASSERT_LESS_THAN(appended / 16, flash->writeCalls());
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_points_survive_flush_and_reboot);
+  RUN_TEST(test_compaction_reaches_every_tier);
+  RUN_TEST(test_torn_active_segment_is_recovered);
+  RUN_TEST(test_range_query_opens_only_overlapping_segments);
+  RUN_TEST(test_benchmark_month_of_appends);
+  return UNITY_END();
+}
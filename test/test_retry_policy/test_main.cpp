@@ -0,0 +1,204 @@
+// RetryPolicy breaker transitions (closed -> open after the failure
+// threshold or one client error, half-open after the open period, probe
+// success and failure) and the jittered backoff: its bounds per failure
+// count, the RETRY_MAX_MS cap and the RETRY_RATE_LIMIT_MS floor after a 429.
+//
+// esp_random() is replaced so a test can pick the jitter.
+
+#include <Arduino.h>
+#include <unity.h>
+#include <limits.h>
+#include "retry_policy.h"
+
+static const unsigned long START = 1000000;
+
+static uint32_t randomValue;
+static bool randomFromRand;
+
+uint32_t esp_random() {
+  return randomFromRand ? ((uint32_t)rand() << 16) ^ (uint32_t)rand() : randomValue;
+}
+
+static RetryPolicy* policy;
+
+// Backoff before jitter after `failures` consecutive failures
+static unsigned long fullBackoff(uint16_t failures) {
+  unsigned long delay = RETRY_BASE_MS;
+  for (uint16_t i = 1; i < failures && delay < RETRY_MAX_MS; i++) {
+    delay *= 2;
+  }
+  return delay < RETRY_MAX_MS ? delay : RETRY_MAX_MS;
+}
+
+static void openBreaker(Provider provider, unsigned long now) {
+  for (int i = 0; i < BREAKER_FAILURE_THRESHOLD; i++) {
+    policy->recordFailure(provider, FETCH_ERROR_SERVER, now);
+  }
+  TEST_ASSERT_EQUAL_INT(BREAKER_OPEN, policy->state(provider));
+}
+
+void setUp(void) {
+  policy = new RetryPolicy();
+  randomValue = 0;
+  randomFromRand = false;
+  srand(41);
+  Serial.muted = true;
+}
+
+void tearDown(void) {
+  Serial.muted = false;
+  delete policy;
+}
+
+void test_breaker_opens_after_the_threshold(void) {
+  for (int i = 1; i < BREAKER_FAILURE_THRESHOLD; i++) {
+    unsigned long delay = policy->recordFailure(PROVIDER_CMC, FETCH_ERROR_NETWORK, START);
+    TEST_ASSERT_EQUAL_INT(BREAKER_CLOSED, policy->state(PROVIDER_CMC));
+    TEST_ASSERT_EQUAL_UINT32(fullBackoff(i) / 2, delay);
+    TEST_ASSERT_TRUE(policy->allowRequest(PROVIDER_CMC, START));
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, policy->changeCount());
+
+  unsigned long delay = policy->recordFailure(PROVIDER_CMC, FETCH_ERROR_NETWORK, START);
+  TEST_ASSERT_EQUAL_INT(BREAKER_OPEN, policy->state(PROVIDER_CMC));
+  TEST_ASSERT_EQUAL_UINT32(BREAKER_OPEN_MS, delay); // Never retried inside the open period
+  TEST_ASSERT_EQUAL_UINT32(1, policy->tripCount(PROVIDER_CMC));
+  TEST_ASSERT_EQUAL_UINT32(1, policy->changeCount());
+  TEST_ASSERT_EQUAL_UINT16(BREAKER_FAILURE_THRESHOLD, policy->consecutiveFailures(PROVIDER_CMC));
+  TEST_ASSERT_EQUAL_INT(FETCH_ERROR_NETWORK, policy->lastError(PROVIDER_CMC));
+
+  TEST_ASSERT_FALSE(policy->allowRequest(PROVIDER_CMC, START + BREAKER_OPEN_MS - 1));
+  TEST_ASSERT_EQUAL_UINT32(1, policy->blockedForMs(PROVIDER_CMC, START + BREAKER_OPEN_MS - 1));
+  TEST_ASSERT_EQUAL_UINT32(BREAKER_OPEN_MS, policy->blockedForMs(PROVIDER_CMC, START));
+
+  // Other providers are unaffected
+  TEST_ASSERT_EQUAL_INT(BREAKER_CLOSED, policy->state(PROVIDER_FMP));
+  TEST_ASSERT_TRUE(policy->allowRequest(PROVIDER_FMP, START));
+}
+
+void test_client_error_opens_at_once(void) {
+  policy->recordFailure(PROVIDER_FMP, FETCH_ERROR_CLIENT, START);
+  TEST_ASSERT_EQUAL_INT(BREAKER_OPEN, policy->state(PROVIDER_FMP));
+  TEST_ASSERT_EQUAL_UINT32(1, policy->tripCount(PROVIDER_FMP));
+  TEST_ASSERT_FALSE(policy->allowRequest(PROVIDER_FMP, START + 1000));
+
+  // Failures while open don't trip it again or move the open period
+  policy->recordFailure(PROVIDER_FMP, FETCH_ERROR_CLIENT, START + 1000);
+  TEST_ASSERT_EQUAL_UINT32(1, policy->tripCount(PROVIDER_FMP));
+  TEST_ASSERT_EQUAL_UINT32(BREAKER_OPEN_MS - 2000, policy->blockedForMs(PROVIDER_FMP, START + 2000));
+}
+
+void test_half_open_probe_success_closes(void) {
+  openBreaker(PROVIDER_CMC, START);
+  unsigned long probeAt = START + BREAKER_OPEN_MS;
+  TEST_ASSERT_EQUAL_UINT32(0, policy->blockedForMs(PROVIDER_CMC, probeAt));
+  TEST_ASSERT_TRUE(policy->allowRequest(PROVIDER_CMC, probeAt));
+  TEST_ASSERT_EQUAL_INT(BREAKER_HALF_OPEN, policy->state(PROVIDER_CMC));
+  TEST_ASSERT_EQUAL_UINT32(2, policy->changeCount());
+
+  policy->recordSuccess(PROVIDER_CMC);
+  TEST_ASSERT_EQUAL_INT(BREAKER_CLOSED, policy->state(PROVIDER_CMC));
+  TEST_ASSERT_EQUAL_UINT16(0, policy->consecutiveFailures(PROVIDER_CMC));
+  TEST_ASSERT_EQUAL_INT(FETCH_ERROR_NONE, policy->lastError(PROVIDER_CMC));
+  TEST_ASSERT_EQUAL_UINT32(3, policy->changeCount());
+
+  // The count starts over: one failure is a retry, not a new trip
+  policy->recordFailure(PROVIDER_CMC, FETCH_ERROR_SERVER, probeAt);
+  TEST_ASSERT_EQUAL_INT(BREAKER_CLOSED, policy->state(PROVIDER_CMC));
+  policy->recordSuccess(PROVIDER_CMC);
+  TEST_ASSERT_EQUAL_UINT32(3, policy->changeCount()); // Closed to closed is no change
+}
+
+void test_half_open_probe_failure_doubles_the_open_period(void) {
+  openBreaker(PROVIDER_FX, START);
+  unsigned long now = START;
+  unsigned long openMs = BREAKER_OPEN_MS;
+  for (int probe = 0; probe < 8; probe++) {
+    now += openMs;
+    TEST_ASSERT_TRUE(policy->allowRequest(PROVIDER_FX, now));
+    TEST_ASSERT_EQUAL_INT(BREAKER_HALF_OPEN, policy->state(PROVIDER_FX));
+
+    unsigned long delay = policy->recordFailure(PROVIDER_FX, FETCH_ERROR_NETWORK, now);
+    openMs = openMs * 2 < BREAKER_MAX_OPEN_MS ? openMs * 2 : BREAKER_MAX_OPEN_MS;
+    TEST_ASSERT_EQUAL_INT(BREAKER_OPEN, policy->state(PROVIDER_FX));
+    TEST_ASSERT_EQUAL_UINT32(openMs, policy->blockedForMs(PROVIDER_FX, now));
+    TEST_ASSERT_EQUAL_UINT32(openMs, delay);
+  }
+  TEST_ASSERT_EQUAL_UINT32(BREAKER_MAX_OPEN_MS, openMs); // Reached the cap within 8 probes
+  TEST_ASSERT_EQUAL_UINT32(1, policy->tripCount(PROVIDER_FX)); // Still the same outage
+
+  // Recovery resets the open period for the next trip
+  now += openMs;
+  TEST_ASSERT_TRUE(policy->allowRequest(PROVIDER_FX, now));
+  policy->recordSuccess(PROVIDER_FX);
+  openBreaker(PROVIDER_FX, now);
+  TEST_ASSERT_EQUAL_UINT32(BREAKER_OPEN_MS, policy->blockedForMs(PROVIDER_FX, now));
+  TEST_ASSERT_EQUAL_UINT32(2, policy->tripCount(PROVIDER_FX));
+}
+
+void test_backoff_jitter_bounds_and_cap(void) {
+  for (uint16_t failures = 1; failures <= 12; failures++) {
+    unsigned long full = fullBackoff(failures);
+    randomValue = 0;
+    TEST_ASSERT_EQUAL_UINT32(full / 2, RetryPolicy::retryDelayMs(failures, FETCH_ERROR_SERVER));
+    randomValue = full / 2; // The largest jitter
+    TEST_ASSERT_EQUAL_UINT32(full, RetryPolicy::retryDelayMs(failures, FETCH_ERROR_SERVER));
+  }
+  TEST_ASSERT_EQUAL_UINT32(RETRY_MAX_MS, fullBackoff(12));
+
+  randomFromRand = true;
+  const uint16_t counts[] = {1, 2, 3, 7, 40, 1000, UINT16_MAX};
+  for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+    unsigned long full = fullBackoff(counts[c]);
+    unsigned long lowest = ULONG_MAX;
+    unsigned long highest = 0;
+    for (int i = 0; i < 2000; i++) {
+      unsigned long delay = RetryPolicy::retryDelayMs(counts[c], FETCH_ERROR_NETWORK);
+      lowest = delay < lowest ? delay : lowest;
+      highest = delay > highest ? delay : highest;
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(full / 2, lowest);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(full, highest);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(RETRY_MAX_MS, highest);
+    TEST_ASSERT_TRUE(highest - lowest > full / 4); // Actually spread out
+  }
+}
+
+void test_rate_limit_floor(void) {
+  // Below the floor: RETRY_RATE_LIMIT_MS plus up to RETRY_BASE_MS of jitter
+  randomValue = 0;
+  TEST_ASSERT_EQUAL_UINT32(RETRY_RATE_LIMIT_MS, RetryPolicy::retryDelayMs(1, FETCH_ERROR_RATE_LIMIT));
+  randomValue = RETRY_BASE_MS;
+  TEST_ASSERT_EQUAL_UINT32(RETRY_RATE_LIMIT_MS + RETRY_BASE_MS,
+                           RetryPolicy::retryDelayMs(1, FETCH_ERROR_RATE_LIMIT));
+
+  // Other errors keep the short backoff
+  randomValue = 0;
+  TEST_ASSERT_EQUAL_UINT32(RETRY_BASE_MS / 2, RetryPolicy::retryDelayMs(1, FETCH_ERROR_SERVER));
+
+  // A backoff already past the floor is left alone
+  uint16_t failures = 1;
+  while (fullBackoff(failures) / 2 < RETRY_RATE_LIMIT_MS) {
+    failures++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(fullBackoff(failures) / 2, RetryPolicy::retryDelayMs(failures, FETCH_ERROR_RATE_LIMIT));
+
+  // Through the policy, every 429 before the breaker opens waits at least the floor
+  randomFromRand = true;
+  for (int i = 1; i < BREAKER_FAILURE_THRESHOLD; i++) {
+    unsigned long delay = policy->recordFailure(PROVIDER_CMC, FETCH_ERROR_RATE_LIMIT, START);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(RETRY_RATE_LIMIT_MS, delay);
+    TEST_ASSERT_EQUAL_INT(BREAKER_CLOSED, policy->state(PROVIDER_CMC));
+  }
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_breaker_opens_after_the_threshold);
+  RUN_TEST(test_client_error_opens_at_once);
+  RUN_TEST(test_half_open_probe_success_closes);
+  RUN_TEST(test_half_open_probe_failure_doubles_the_open_period);
+  RUN_TEST(test_backoff_jitter_bounds_and_cap);
+  RUN_TEST(test_rate_limit_floor);
+  return UNITY_END();
+}
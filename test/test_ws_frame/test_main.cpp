@@ -0,0 +1,239 @@
+// WsFrameParser on hand-built frames: unmasked and masked payloads, the 16-
+// and 64-bit length forms, fragmented messages with a ping in between,
+// oversized messages, frames split at every byte, and a feed benchmark with
+// ticker messages chopped at random read sizes.
+
+#include <Arduino.h>
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "ws_frame.h"
+
+static const int BENCH_MESSAGES = 200000;
+static const char TICK[] = "{\"channel\":\"ticker\",\"type\":\"update\",\"data\":"
+                           "[{\"symbol\":\"BTC/CAD\",\"last\":104231.5}]}";
+
+static WsFrameParser* parser;
+
+// One frame as a server (mask = nullptr) or client would send it.
+// lengthBytes forces the 0, 2 or 8 byte extended length form.
+static void appendFrame(std::vector<uint8_t>& out, uint8_t first, const std::string& payload,
+                        const uint8_t* mask = nullptr, int lengthBytes = -1) {
+  size_t length = payload.size();
+  if (lengthBytes < 0) {
+    lengthBytes = length < 126 ? 0 : length <= 0xFFFF ? 2 : 8;
+  }
+  out.push_back(first);
+  uint8_t maskBit = mask ? 0x80 : 0;
+  if (lengthBytes == 0) {
+    out.push_back(maskBit | (uint8_t)length);
+  } else {
+    out.push_back(maskBit | (lengthBytes == 2 ? 126 : 127));
+    for (int i = lengthBytes - 1; i >= 0; i--) {
+      out.push_back((uint8_t)((uint64_t)length >> (8 * i)));
+    }
+  }
+  if (mask) {
+    out.insert(out.end(), mask, mask + 4);
+  }
+  for (size_t i = 0; i < length; i++) {
+    out.push_back((uint8_t)payload[i] ^ (mask ? mask[i & 3] : 0));
+  }
+}
+
+// Feed everything, `step` bytes at a time; returns the events in order
+static std::vector<WsFrameEvent> feedAll(const std::vector<uint8_t>& bytes, size_t step) {
+  std::vector<WsFrameEvent> events;
+  for (size_t offset = 0; offset < bytes.size(); offset += step) {
+    size_t length = bytes.size() - offset < step ? bytes.size() - offset : step;
+    size_t i = 0;
+    while (i < length) {
+      WsFrameEvent event;
+      i += parser->feed(bytes.data() + offset + i, length - i, event);
+      if (event != WS_EVENT_NONE) {
+        events.push_back(event);
+      }
+    }
+  }
+  return events;
+}
+
+void setUp(void) {
+  parser = new WsFrameParser();
+}
+
+void tearDown(void) {
+  delete parser;
+}
+
+void test_unmasked_text_frame(void) {
+  std::vector<uint8_t> bytes;
+  appendFrame(bytes, 0x80 | WS_OPCODE_TEXT, "{\"channel\":\"heartbeat\"}");
+  appendFrame(bytes, 0x80 | WS_OPCODE_TEXT, "second");
+
+  // One frame per call, even when the read holds more
+  WsFrameEvent event;
+  size_t taken = parser->feed(bytes.data(), bytes.size(), event);
+  TEST_ASSERT_EQUAL_size_t(2 + 23, taken);
+  TEST_ASSERT_EQUAL_INT(WS_EVENT_TEXT, event);
+  TEST_ASSERT_EQUAL_STRING("{\"channel\":\"heartbeat\"}", parser->message());
+  TEST_ASSERT_EQUAL_size_t(23, parser->messageLength());
+
+  taken += parser->feed(bytes.data() + taken, bytes.size() - taken, event);
+  TEST_ASSERT_EQUAL_size_t(bytes.size(), taken);
+  TEST_ASSERT_EQUAL_INT(WS_EVENT_TEXT, event);
+  TEST_ASSERT_EQUAL_STRING("second", parser->message());
+  TEST_ASSERT_EQUAL_UINT32(2, parser->getFramesTotal());
+}
+
+void test_masked_extended_lengths_split_at_every_byte(void) {
+  const uint8_t mask[4] = {0x37, 0xFA, 0x21, 0x3D};
+  std::string medium(300, 'm');
+  std::string small = "tiny";
+  for (size_t i = 0; i < medium.size(); i++) {
+    medium[i] = (char)('a' + i % 26);
+  }
+  std::vector<uint8_t> bytes;
+  appendFrame(bytes, 0x80 | WS_OPCODE_TEXT, medium, mask);        // 16-bit length
+  appendFrame(bytes, 0x80 | WS_OPCODE_TEXT, small, mask, 8);      // 64-bit length, short payload
+  appendFrame(bytes, 0x80 | WS_OPCODE_TEXT, "", nullptr);         // Empty message
+
+  std::vector<WsFrameEvent> events = feedAll(bytes, 1);
+  TEST_ASSERT_EQUAL_size_t(3, events.size());
+  TEST_ASSERT_EQUAL_INT(WS_EVENT_TEXT, events[2]);
+  TEST_ASSERT_EQUAL_STRING("", parser->message());
+
+  // The same stream again, checking each message as it completes
+  parser->reset();
+  size_t i = 0;
+  const char* expected[] = {medium.c_str(), small.c_str(), ""};
+  for (int frame = 0; frame < 3; frame++) {
+    WsFrameEvent event = WS_EVENT_NONE;
+    while (event == WS_EVENT_NONE) {
+      i += parser->feed(bytes.data() + i, 1, event);
+    }
+    TEST_ASSERT_EQUAL_INT(WS_EVENT_TEXT, event);
+    TEST_ASSERT_EQUAL_STRING(expected[frame], parser->message());
+  }
+  TEST_ASSERT_EQUAL_size_t(bytes.size(), i);
+}
+
+void test_fragments_join_around_a_ping(void) {
+  std::vector<uint8_t> bytes;
+  appendFrame(bytes, WS_OPCODE_TEXT, "{\"channel\":");              // FIN clear
+  appendFrame(bytes, 0x80 | WS_OPCODE_PING, "keepalive");           // Control frames may interleave
+  appendFrame(bytes, WS_OPCODE_CONTINUATION, "\"ticker\",");
+  appendFrame(bytes, 0x80 | WS_OPCODE_CONTINUATION, "\"data\":[]}");
+  appendFrame(bytes, 0x80 | WS_OPCODE_CONTINUATION, "stray");       // No message open: dropped
+  appendFrame(bytes, 0x80 | WS_OPCODE_PONG, "");
+  appendFrame(bytes, 0x80 | WS_OPCODE_CLOSE, "\x03\xe8");
+
+  size_t i = 0;
+  WsFrameEvent event;
+  i += parser->feed(bytes.data() + i, bytes.size() - i, event);
+  TEST_ASSERT_EQUAL_INT(WS_EVENT_NONE, event);
+  i += parser->feed(bytes.data() + i, bytes.size() - i, event);
+  TEST_ASSERT_EQUAL_INT(WS_EVENT_PING, event);
+  TEST_ASSERT_EQUAL_size_t(9, parser->controlLength());
+  TEST_ASSERT_EQUAL_MEMORY("keepalive", parser->control(), 9);
+  i += parser->feed(bytes.data() + i, bytes.size() - i, event);
+  TEST_ASSERT_EQUAL_INT(WS_EVENT_NONE, event);
+  i += parser->feed(bytes.data() + i, bytes.size() - i, event);
+  TEST_ASSERT_EQUAL_INT(WS_EVENT_TEXT, event);
+  TEST_ASSERT_EQUAL_STRING("{\"channel\":\"ticker\",\"data\":[]}", parser->message());
+
+  std::vector<uint8_t> rest(bytes.begin() + i, bytes.end());
+  std::vector<WsFrameEvent> events = feedAll(rest, rest.size());
+  TEST_ASSERT_EQUAL_size_t(2, events.size());
+  TEST_ASSERT_EQUAL_INT(WS_EVENT_PONG, events[0]);
+  TEST_ASSERT_EQUAL_INT(WS_EVENT_CLOSE, events[1]);
+  TEST_ASSERT_EQUAL_UINT32(7, parser->getFramesTotal());
+}
+
+void test_oversized_message_is_dropped_and_parsing_continues(void) {
+  const uint8_t mask[4] = {1, 2, 3, 4};
+  std::string big(STREAM_FRAME_BUFFER + 100, 'x');
+  std::vector<uint8_t> bytes;
+  appendFrame(bytes, 0x80 | WS_OPCODE_TEXT, big, mask, 8);
+  appendFrame(bytes, 0x80 | WS_OPCODE_BINARY, "\x01\x02");   // Not for the feed: no event
+  appendFrame(bytes, 0x80 | WS_OPCODE_TEXT, "after");
+
+  std::vector<WsFrameEvent> events = feedAll(bytes, 256);
+  TEST_ASSERT_EQUAL_size_t(2, events.size());
+  TEST_ASSERT_EQUAL_INT(WS_EVENT_OVERSIZED, events[0]);
+  TEST_ASSERT_EQUAL_INT(WS_EVENT_TEXT, events[1]);
+  TEST_ASSERT_EQUAL_STRING("after", parser->message());
+}
+
+void test_client_header_round_trips(void) {
+  const uint8_t mask[4] = {0xA1, 0xB2, 0xC3, 0xD4};
+  const size_t lengths[] = {0, 125, 126, 1000, 0xFFFF};
+  for (size_t n = 0; n < sizeof(lengths) / sizeof(lengths[0]); n++) {
+    std::string payload(lengths[n], 'p');
+    std::vector<uint8_t> bytes(8);
+    size_t headerSize = WsFrameParser::writeClientHeader(WS_OPCODE_TEXT, payload.size(), mask, bytes.data());
+    TEST_ASSERT_EQUAL_size_t(lengths[n] < 126 ? 6 : 8, headerSize);
+    bytes.resize(headerSize);
+    for (size_t i = 0; i < payload.size(); i++) {
+      bytes.push_back((uint8_t)payload[i] ^ mask[i & 3]);
+    }
+    std::vector<WsFrameEvent> events = feedAll(bytes, 97);
+    TEST_ASSERT_EQUAL_size_t(1, events.size());
+    TEST_ASSERT_EQUAL_INT(lengths[n] < STREAM_FRAME_BUFFER ? WS_EVENT_TEXT : WS_EVENT_OVERSIZED, events[0]);
+    if (events[0] == WS_EVENT_TEXT) {
+      TEST_ASSERT_EQUAL_STRING(payload.c_str(), parser->message());
+    }
+  }
+  uint8_t header[8];
+  TEST_ASSERT_EQUAL_size_t(0, WsFrameParser::writeClientHeader(WS_OPCODE_TEXT, 0x10000, mask, header));
+}
+
+void test_benchmark_ticker_stream(void) {
+  std::vector<uint8_t> bytes;
+  for (int m = 0; m < BENCH_MESSAGES; m++) {
+    appendFrame(bytes, 0x80 | WS_OPCODE_TEXT, TICK);
+  }
+
+  // Reads of 1-256 bytes, like the stream task's socket buffer
+  srand(9);
+  std::vector<size_t> reads;
+  for (size_t total = 0; total < bytes.size();) {
+    size_t read = 1 + rand() % 256;
+    reads.push_back(read);
+    total += read;
+  }
+
+  int messages = 0;
+  size_t offset = 0;
+  unsigned long started = micros();
+  for (size_t r = 0; r < reads.size(); r++) {
+    size_t length = bytes.size() - offset < reads[r] ? bytes.size() - offset : reads[r];
+    size_t i = 0;
+    while (i < length) {
+      WsFrameEvent event;
+      i += parser->feed(bytes.data() + offset + i, length - i, event);
+      if (event == WS_EVENT_TEXT && parser->messageLength() == sizeof(TICK) - 1) {
+        messages++;
+      }
+    }
+    offset += length;
+  }
+  unsigned long elapsed = micros() - started;
+  printf("WsFrameParser: %d messages (%u bytes) in %u reads, %.1f ns per message, %.0f MB/s\n", messages,
+         (unsigned)bytes.size(), (unsigned)reads.size(), elapsed * 1000.0 / BENCH_MESSAGES,
+         bytes.size() / (elapsed > 0 ? (double)elapsed : 1.0));
+
+  TEST_ASSERT_EQUAL_INT(BENCH_MESSAGES, messages);
+  TEST_ASSERT_EQUAL_STRING(TICK, parser->message());
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_unmasked_text_frame);
+  RUN_TEST(test_masked_extended_lengths_split_at_every_byte);
+  RUN_TEST(test_fragments_join_around_a_ping);
+  RUN_TEST(test_oversized_message_is_dropped_and_parsing_continues);
+  RUN_TEST(test_client_header_round_trips);
+  RUN_TEST(test_benchmark_ticker_stream);
+  return UNITY_END();
+}
@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+"""Local HTTPS stand-in for the quote providers, serving gzip bodies.
+
+Usage: api_stand_in.py --cert cert.pem --key key.pem [--port 8443]
+                       [--no-gzip] [--chunked] [--padding 40]
+                       [--faults 500:0.2,429:0.1,timeout:0.05]
+
+Answers the requests APIClient makes, with CoinMarketCap-shaped quotes (by id
+or symbol), the id map, Financial Modeling Prep quotes and exchange rates.
+Bodies are gzipped when the request's Accept-Encoding allows it (unless
+--no-gzip), sent chunked with --chunked, and each request is logged with its
+raw and on-the-wire size. --padding adds filler fields per coin so payloads
+are about as large as the real ones.
+
+--faults makes a share of requests fail, to exercise the retry policy and
+circuit breakers: any HTTP status (500, 503, 429, 401, ...), "timeout" (the
+response never comes), "reset" (the connection drops before a response) or
+"truncate" (half the body, then the connection drops). Each fault has its own
+probability; the rest are answered normally. Watch the device log and
+<prefix>/provider/<name>/breaker on MQTT as they pile up.
+
+The device skips certificate checks, so a self-signed pair is enough:
+    openssl req -x509 -newkey rsa:2048 -nodes -days 365 -subj /CN=stand-in \\
+        -keyout key.pem -out cert.pem
+Point secrets.h at it, e.g.
+    #define API_BASE_URL "https://<this-pc-ip>:8443/v2/cryptocurrency/quotes/latest"
+    #define CMC_MAP_URL  "https://<this-pc-ip>:8443/v1/cryptocurrency/map"
+and compare m5crypto_response_bytes, m5crypto_response_decoded_bytes and
+m5crypto_inflate_us on the metrics endpoint with and without --no-gzip.
+"""
+import argparse
+import gzip
+import json
+import random
+import ssl
+import time
+from datetime import datetime, timezone
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlparse
+
+COINS = {"BTC": (1, 90000.0), "ETH": (1027, 3500.0), "XRP": (52, 0.9),
+         "SOL": (5426, 180.0), "DOGE": (74, 0.15), "ADA": (2010, 0.6)}
+STOCKS = {"MSFT": 420.0, "AAPL": 230.0, "SHOP.TO": 150.0}
+RATES = {"USD": 1.0, "CAD": 1.37, "EUR": 0.92, "GBP": 0.79, "JPY": 150.0}
+prices = {}
+faults = []  # (kind, probability)
+
+
+def now_iso():
+    return datetime.now(timezone.utc).strftime("%Y-%m-%dT%H:%M:%S.000Z")
+
+
+def parse_faults(spec):
+    parsed = []
+    for item in filter(None, spec.split(",")):
+        kind, probability = item.split(":")
+        if not kind.isdigit() and kind not in ("timeout", "reset", "truncate"):
+            raise argparse.ArgumentTypeError("unknown fault %r" % kind)
+        parsed.append((kind, float(probability)))
+    if sum(p for _, p in parsed) > 1:
+        raise argparse.ArgumentTypeError("fault probabilities add up to more than 1")
+    return parsed
+
+
+def pick_fault():
+    roll = random.random()
+    for kind, probability in faults:
+        if roll < probability:
+            return kind
+        roll -= probability
+    return None
+
+
+def walk(symbol, start):
+    prices[symbol] = prices.get(symbol, start) * (1 + random.gauss(0, 0.001))
+    return prices[symbol]
+
+
+def coin(symbol, convert, padding):
+    coin_id, start = COINS[symbol]
+    rate = RATES.get(convert, 1.0)
+    entry = {
+        "id": coin_id, "name": symbol.title(), "symbol": symbol, "is_active": 1,
+        "quote": {convert: {
+            "price": walk(symbol, start) * rate,
+            "percent_change_1h": random.uniform(-1, 1),
+            "percent_change_24h": random.uniform(-5, 5),
+            "percent_change_7d": random.uniform(-10, 10),
+            "last_updated": now_iso(),
+        }},
+    }
+    entry.update({"field_%d" % i: "x" * 24 for i in range(padding)})
+    return entry
+
+
+def cmc_quotes(query, padding):
+    convert = query.get("convert", ["USD"])[0]
+    if "id" in query:
+        ids = query["id"][0].split(",")
+        by_id = {str(coin_id): symbol for symbol, (coin_id, _) in COINS.items()}
+        data = {i: coin(by_id[i], convert, padding) for i in ids if i in by_id}
+    else:
+        symbols = query.get("symbol", [""])[0].split(",")
+        data = {s: [coin(s, convert, padding)] for s in symbols if s in COINS}
+    return {"status": {"error_code": 0}, "data": data}
+
+
+def cmc_map(query):
+    symbols = query.get("symbol", [""])[0].split(",")
+    return {"data": [{"id": COINS[s][0], "symbol": s, "rank": rank + 1}
+                     for rank, s in enumerate(symbols) if s in COINS]}
+
+
+def fmp_quotes(query):
+    symbols = (query.get("symbols") or query.get("symbol") or [""])[0].split(",")
+    return [{"symbol": s, "price": walk(s, STOCKS[s]), "changePercentage": random.uniform(-2, 2),
+             "timestamp": int(time.time())} for s in symbols if s in STOCKS]
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # Keep-alive, like the real providers
+
+    def do_GET(self):
+        url = urlparse(self.path)
+        query = parse_qs(url.query)
+        if url.path.endswith("/quotes/latest"):
+            body = cmc_quotes(query, self.server.args.padding)
+        elif url.path.endswith("/cryptocurrency/map"):
+            body = cmc_map(query)
+        elif url.path.endswith("quote"):
+            body = fmp_quotes(query)
+        elif url.path.startswith("/v6/latest"):
+            body = {"result": "success", "time_last_update_unix": int(time.time()), "rates": RATES}
+        else:
+            self.send_error(404)
+            return
+
+        fault = pick_fault()
+        if fault is not None:
+            print("%s %s: injecting %s" % (self.client_address[0], url.path, fault))
+        if fault == "timeout":
+            time.sleep(60)
+            self.close_connection = True
+            return
+        if fault == "reset":
+            self.close_connection = True
+            return
+        if fault is not None and fault.isdigit():
+            self.send_error(int(fault))
+            return
+
+        raw = json.dumps(body).encode()
+        payload = raw
+        accepts = self.headers.get("Accept-Encoding", "")
+        use_gzip = not self.server.args.no_gzip and "gzip" in accepts
+        if use_gzip:
+            payload = gzip.compress(raw)
+
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        if use_gzip:
+            self.send_header("Content-Encoding", "gzip")
+        if self.server.args.chunked:
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            if fault == "truncate":
+                payload = payload[:len(payload) // 2]
+                self.close_connection = True
+            for start in range(0, len(payload), 1000):
+                part = payload[start:start + 1000]
+                self.wfile.write(b"%x\r\n%s\r\n" % (len(part), part))
+            if fault != "truncate":
+                self.wfile.write(b"0\r\n\r\n")
+        else:
+            self.send_header("Content-Length", str(len(payload)))
+            self.end_headers()
+            if fault == "truncate":
+                self.wfile.write(payload[:len(payload) // 2])
+                self.close_connection = True
+            else:
+                self.wfile.write(payload)
+        print("%s %s: %d bytes raw, %d on the wire (%s)" % (
+            self.client_address[0], url.path, len(raw), len(payload), "gzip" if use_gzip else "identity"))
+
+    def log_message(self, format, *args):
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--port", type=int, default=8443)
+    parser.add_argument("--cert", required=True)
+    parser.add_argument("--key", required=True)
+    parser.add_argument("--no-gzip", action="store_true", help="always send identity bodies")
+    parser.add_argument("--chunked", action="store_true", help="use chunked transfer encoding")
+    parser.add_argument("--padding", type=int, default=40, help="filler fields per coin")
+    parser.add_argument("--faults", type=parse_faults, default=[],
+                        help="comma-separated kind:probability (HTTP status, timeout, reset, truncate)")
+    args = parser.parse_args()
+    faults.extend(args.faults)
+
+    server = ThreadingHTTPServer(("0.0.0.0", args.port), Handler)
+    server.args = args
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    context.load_cert_chain(args.cert, args.key)
+    server.socket = context.wrap_socket(server.socket, server_side=True)
+    print("listening on https://0.0.0.0:%d/ (%s%s%s)" % (
+        args.port, "identity" if args.no_gzip else "gzip", ", chunked" if args.chunked else "",
+        ", faults " + ",".join("%s:%g" % fault for fault in faults) if faults else ""))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
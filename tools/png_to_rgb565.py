@@ -0,0 +1,29 @@
+#!/usr/bin/env python3
+"""Convert a PNG into the raw 24x24 RGB565 format served to the icon cache.
+
+Usage: png_to_rgb565.py input.png output.rgb565
+Transparent pixels are composited onto black (the display background).
+"""
+import struct
+import sys
+
+from PIL import Image
+
+ICON_SIZE = 24
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+
+    image = Image.open(sys.argv[1]).convert("RGBA").resize((ICON_SIZE, ICON_SIZE))
+    background = Image.new("RGBA", image.size, (0, 0, 0, 255))
+    image = Image.alpha_composite(background, image).convert("RGB")
+
+    with open(sys.argv[2], "wb") as out:
+        for r, g, b in image.getdata():
+            out.write(struct.pack("<H", ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3)))
+
+
+if __name__ == "__main__":
+    main()
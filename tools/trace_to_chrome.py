@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Convert a phase trace dump from the device into Chrome trace JSON.
+
+Usage: trace_to_chrome.py INPUT [OUTPUT.json]
+
+INPUT is either the binary dump published on <prefix>/trace, e.g.
+    mosquitto_sub -h <broker> -t m5crypto/trace -C 1 > trace.bin
+or a serial log containing the hex block printed after sending 't'.
+Open the result in chrome://tracing or https://ui.perfetto.dev.
+"""
+import json
+import struct
+import sys
+
+# Must match enum TracePhase in src/trace.h
+PHASE_NAMES = [
+    "update",
+    "wifi_reconnect",
+    "dns",
+    "tls",
+    "http_wait",
+    "body_read",
+    "parse",
+    "mqtt_publish",
+    "render",
+]
+
+# Must match enum Provider in src/providers.h
+PROVIDER_NAMES = ["coinmarketcap", "fmp", "fx"]
+
+HEADER = struct.Struct("<4sBBH")
+EVENT = struct.Struct("<IBBBB")
+NO_ARG = 0xFF
+
+
+def read_dump(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data.startswith(b"M5TR"):
+        return data
+
+    # Serial capture: hex lines between the markers
+    lines = data.decode("utf-8", errors="replace").splitlines()
+    try:
+        start = max(i for i, line in enumerate(lines) if "--- TRACE BEGIN ---" in line)
+    except ValueError:
+        sys.exit("No trace dump found in %s" % path)
+    hex_lines = []
+    for line in lines[start + 1:]:
+        if "--- TRACE END ---" in line:
+            break
+        hex_lines.append(line.strip())
+    return bytes.fromhex("".join(hex_lines))
+
+
+def convert(data):
+    magic, version, phase_count, count = HEADER.unpack_from(data)
+    if magic != b"M5TR" or version != 1:
+        sys.exit("Unsupported trace format")
+    if phase_count != len(PHASE_NAMES):
+        print("warning: device has %d phases, tool knows %d" % (phase_count, len(PHASE_NAMES)),
+              file=sys.stderr)
+
+    events = []
+    offset_us = 0
+    previous = None
+    for i in range(count):
+        timestamp, phase, is_end, arg, _ = EVENT.unpack_from(data, HEADER.size + i * EVENT.size)
+        # micros() wraps every 2^32 us; keep the timeline monotonic
+        if previous is not None and timestamp < previous:
+            offset_us += 1 << 32
+        previous = timestamp
+
+        name = PHASE_NAMES[phase] if phase < len(PHASE_NAMES) else "phase_%d" % phase
+        event = {
+            "name": name,
+            "ph": "E" if is_end else "B",
+            "ts": timestamp + offset_us,
+            "pid": 1,
+            "tid": 1,
+        }
+        if arg != NO_ARG:
+            provider = PROVIDER_NAMES[arg] if arg < len(PROVIDER_NAMES) else str(arg)
+            event["args"] = {"provider": provider}
+        events.append(event)
+
+    # Drop end marks whose begin was overwritten in the ring buffer
+    depth = {}
+    trimmed = []
+    for event in events:
+        key = event["name"]
+        if event["ph"] == "B":
+            depth[key] = depth.get(key, 0) + 1
+        elif depth.get(key, 0) == 0:
+            continue
+        else:
+            depth[key] -= 1
+        trimmed.append(event)
+
+    return {"traceEvents": trimmed, "displayTimeUnit": "ms"}
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.exit(__doc__)
+    result = json.dumps(convert(read_dump(sys.argv[1])), indent=1)
+    if len(sys.argv) == 3:
+        with open(sys.argv[2], "w") as f:
+            f.write(result)
+    else:
+        print(result)
+
+
+if __name__ == "__main__":
+    main()
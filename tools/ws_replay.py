@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""Local WebSocket stand-in for the streaming price feed.
+
+Usage: ws_replay.py [--port 8765] [--rate 200] [RECORDING]
+
+Speaks just enough of the Kraken v2 ticker protocol for the device: it accepts
+the subscribe request, then sends ticker updates at --rate messages/second.
+RECORDING is a file with one captured feed message per line, e.g.
+    websocat wss://ws.kraken.com/v2 > ticks.jsonl   (after sending a subscribe)
+Lines are replayed in a loop and re-timed to --rate. Without a recording,
+random-walk ticks are generated for the subscribed pairs.
+
+Point the device at it with  #define STREAM_URL "ws://<this-pc-ip>:8765/"
+and watch m5crypto_stream_ticks_per_second / m5crypto_tick_to_pixel_ms on
+the metrics endpoint.
+"""
+import argparse
+import base64
+import hashlib
+import json
+import random
+import socket
+import struct
+import threading
+import time
+
+GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+START_PRICES = {"BTC": 90000.0, "ETH": 3500.0, "XRP": 0.9}
+
+
+def read_exactly(conn, count):
+    data = b""
+    while len(data) < count:
+        chunk = conn.recv(count - len(data))
+        if not chunk:
+            raise ConnectionError("client closed")
+        data += chunk
+    return data
+
+
+def read_frame(conn):
+    first, second = read_exactly(conn, 2)
+    opcode = first & 0x0F
+    length = second & 0x7F
+    if length == 126:
+        length = struct.unpack(">H", read_exactly(conn, 2))[0]
+    elif length == 127:
+        length = struct.unpack(">Q", read_exactly(conn, 8))[0]
+    mask = read_exactly(conn, 4) if second & 0x80 else b"\0\0\0\0"
+    payload = bytearray(read_exactly(conn, length))
+    for i in range(length):
+        payload[i] ^= mask[i & 3]
+    return opcode, bytes(payload)
+
+
+def send_frame(conn, payload, opcode=0x1):
+    header = bytes([0x80 | opcode])
+    if len(payload) < 126:
+        header += bytes([len(payload)])
+    elif len(payload) < 65536:
+        header += bytes([126]) + struct.pack(">H", len(payload))
+    else:
+        header += bytes([127]) + struct.pack(">Q", len(payload))
+    conn.sendall(header + payload)
+
+
+def handshake(conn):
+    request = b""
+    while b"\r\n\r\n" not in request:
+        chunk = conn.recv(1024)
+        if not chunk:
+            raise ConnectionError("client closed during handshake")
+        request += chunk
+    key = ""
+    for line in request.decode("latin-1").split("\r\n"):
+        if line.lower().startswith("sec-websocket-key:"):
+            key = line.split(":", 1)[1].strip()
+    accept = base64.b64encode(hashlib.sha1((key + GUID).encode()).digest()).decode()
+    conn.sendall(("HTTP/1.1 101 Switching Protocols\r\n"
+                  "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                  "Sec-WebSocket-Accept: %s\r\n\r\n" % accept).encode())
+
+
+def synthetic_ticks(pairs):
+    prices = {pair: START_PRICES.get(pair.split("/")[0], 100.0) for pair in pairs}
+    while True:
+        for pair in pairs:
+            prices[pair] *= 1 + random.gauss(0, 0.0005)
+            yield json.dumps({"channel": "ticker", "type": "update",
+                              "data": [{"symbol": pair, "last": round(prices[pair], 4)}]})
+
+
+def recorded_ticks(path):
+    with open(path) as f:
+        lines = [line.strip() for line in f if '"ticker"' in line]
+    if not lines:
+        raise SystemExit("No ticker messages in %s" % path)
+    while True:
+        for line in lines:
+            yield line
+
+
+def serve_client(conn, address, args):
+    print("client %s:%d connected" % address)
+    try:
+        handshake(conn)
+        opcode, payload = read_frame(conn)
+        request = json.loads(payload)
+        pairs = request.get("params", {}).get("symbol", [])
+        print("subscribed:", ", ".join(pairs))
+        send_frame(conn, json.dumps({"method": "subscribe", "success": True}).encode())
+
+        # Answer pings/closes from the device in the background
+        def reader():
+            try:
+                while True:
+                    opcode, payload = read_frame(conn)
+                    if opcode == 0x8:
+                        break
+                    if opcode == 0x9:
+                        send_frame(conn, payload, 0xA)
+            except (ConnectionError, OSError):
+                pass
+        threading.Thread(target=reader, daemon=True).start()
+
+        ticks = recorded_ticks(args.recording) if args.recording else synthetic_ticks(pairs)
+        interval = 1.0 / args.rate
+        sent = 0
+        started = report = time.monotonic()
+        next_send = started
+        for message in ticks:
+            send_frame(conn, message.encode())
+            sent += 1
+            next_send += interval
+            now = time.monotonic()
+            if now - report >= 5:
+                print("%.0f msg/s" % (sent / (now - started)))
+                report = now
+            if next_send > now:
+                time.sleep(next_send - now)
+    except (ConnectionError, OSError, ValueError) as error:
+        print("client %s:%d gone: %s" % (address[0], address[1], error))
+    finally:
+        conn.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--port", type=int, default=8765)
+    parser.add_argument("--rate", type=float, default=200, help="messages per second")
+    parser.add_argument("recording", nargs="?")
+    args = parser.parse_args()
+
+    server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    server.bind(("0.0.0.0", args.port))
+    server.listen(4)
+    print("listening on ws://0.0.0.0:%d/ at %.0f msg/s" % (args.port, args.rate))
+    while True:
+        conn, address = server.accept()
+        threading.Thread(target=serve_client, args=(conn, address, args), daemon=True).start()
+
+
+if __name__ == "__main__":
+    main()